@@ -20,103 +20,322 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
 #include "DShowUtil.h"
 
+// Sliding window statistics over the last N samples
+//
+// The window starts out filled with zeros. The average is maintained incrementally, and the minimum and maximum
+// values (plain and absolute) are tracked with monotonic queues of buffer slots, so that adding a sample and every
+// query are O(1) (amortized). Only SetNumSamples and OffsetValues need to touch the whole window.
+//
+// The results are the same as those of the previous scan-based implementation:
+//  - The average is the sum of the samples divided by N one by one, which truncates every sample for integer types.
+//  - Resizing keeps the samples in the window, and fills any new slots with zeros.
+//  - When samples of equal magnitude but different sign are in the window, AbsMinimum and AbsMaximum return the one
+//    stored in the lowest buffer slot. Both sign variants are kept in the queues for that.
+//
+// Debug builds verify every update against a full scan of the window, see VerifyWindow.
 template <class T> class FloatingAverage
 {
   public:
     FloatingAverage(unsigned int iNumSamples = 10) { SetNumSamples(iNumSamples); }
 
-    ~FloatingAverage() { free(m_Samples); }
+    ~FloatingAverage()
+    {
+        free(m_Samples);
+        free(m_QueueBuffer);
+    }
 
+    // Change the window size, the samples in the window are kept and new slots are filled with zeros
     void SetNumSamples(unsigned int iNumSamples)
     {
+        if (iNumSamples == 0)
+            iNumSamples = 1;
+
         if (iNumSamples > m_NumSamplesAlloc)
         {
             m_Samples = (T *)realloc(m_Samples, iNumSamples * sizeof(T));
+            m_QueueBuffer = (unsigned int *)realloc(m_QueueBuffer, iNumSamples * sizeof(unsigned int) * QueueNB);
             m_NumSamplesAlloc = iNumSamples;
         }
         if (iNumSamples > m_NumSamples)
             memset(m_Samples + m_NumSamples, 0, sizeof(T) * (iNumSamples - m_NumSamples));
         m_NumSamples = iNumSamples;
+
+        if (m_CurrentSample >= m_NumSamples)
+            m_CurrentSample = 0;
+
+        for (int i = 0; i < QueueNB; ++i)
+            m_Queues[i].Init(m_QueueBuffer + i * m_NumSamples, m_NumSamples);
+
+        RecalculateAverage();
+        RebuildQueues(true);
+
+        VerifyWindow();
+    }
+
+    // Reset all samples in the window to zero
+    void Reset()
+    {
+        memset(m_Samples, 0, sizeof(T) * m_NumSamples);
+        m_Average = 0;
+        m_CurrentSample = 0;
+
+        // the newest of the zero samples represents all of them in the queues
+        for (int i = 0; i < QueueNB; ++i)
+        {
+            m_Queues[i].Clear();
+            m_Queues[i].PushBack(m_NumSamples - 1);
+        }
     }
 
     void Sample(T fSample)
     {
-        m_Samples[m_CurrentSample] = fSample;
+        const unsigned int slot = m_CurrentSample;
+
+        // the sample in the current slot is the oldest one, and leaves the window
+        for (int i = 0; i < QueueNB; ++i)
+        {
+            if (!m_Queues[i].Empty() && m_Queues[i].Front() == slot)
+                m_Queues[i].PopFront();
+        }
+
+        m_Average += fSample / (T)m_NumSamples - m_Samples[slot] / (T)m_NumSamples;
+        m_Samples[slot] = fSample;
         if (++m_CurrentSample >= m_NumSamples)
         {
             m_CurrentSample = 0;
+
+            // re-calculate the average once per window to avoid accumulating rounding errors
+            RecalculateAverage();
         }
+
+        PushSample(slot, true);
+
+        VerifyWindow();
     }
 
-    T Average() const
+    T Average() const { return m_Average; }
+
+    T Minimum() const { return m_Samples[m_Queues[QueueMin].Front()]; }
+
+    T AbsMinimum() const { return AbsExtreme(m_Queues[QueueAbsMin]); }
+
+    T Maximum() const { return m_Samples[m_Queues[QueueMax].Front()]; }
+
+    T AbsMaximum() const { return AbsExtreme(m_Queues[QueueAbsMax]); }
+
+    // Add a value to all samples in the window
+    void OffsetValues(T value)
     {
-        T fAverage = 0;
         for (unsigned int i = 0; i < m_NumSamples; ++i)
         {
-            fAverage += m_Samples[i] / m_NumSamples;
+            m_Samples[i] += value;
         }
-        return fAverage;
+        RecalculateAverage();
+
+        // Minimum and maximum keep their order under an offset, the absolute values do not
+        RebuildQueues(false);
+
+        VerifyWindow();
     }
 
-    T Minimum() const
+    unsigned int CurrentSample() const { return m_CurrentSample; }
+
+  private:
+    // Fixed-capacity double-ended queue of buffer slots, from the oldest to the newest sample
+    class SlotQueue
     {
-        T min = m_Samples[0];
-        for (unsigned int i = 1; i < m_NumSamples; ++i)
+      public:
+        void Init(unsigned int *pBuffer, unsigned int capacity)
         {
-            if (m_Samples[i] < min)
-                min = m_Samples[i];
+            m_pBuffer = pBuffer;
+            m_Capacity = capacity;
+            Clear();
+        }
+
+        void Clear() { m_Head = m_Count = 0; }
+        bool Empty() const { return m_Count == 0; }
+        unsigned int Size() const { return m_Count; }
+
+        unsigned int Front() const { return m_pBuffer[m_Head]; }
+        unsigned int Back() const { return m_pBuffer[Wrap(m_Head + m_Count - 1)]; }
+        unsigned int At(unsigned int idx) const { return m_pBuffer[Wrap(m_Head + idx)]; }
+
+        void PushBack(unsigned int slot)
+        {
+            assert(m_Count < m_Capacity);
+            m_pBuffer[Wrap(m_Head + m_Count)] = slot;
+            m_Count++;
         }
-        return min;
-    }
 
-    T AbsMinimum() const
+        void PopBack() { m_Count--; }
+
+        void PopFront()
+        {
+            m_Head = Wrap(m_Head + 1);
+            m_Count--;
+        }
+
+      private:
+        unsigned int Wrap(unsigned int idx) const { return idx >= m_Capacity ? idx - m_Capacity : idx; }
+
+        unsigned int *m_pBuffer = nullptr;
+        unsigned int m_Capacity = 0;
+        unsigned int m_Head = 0;
+        unsigned int m_Count = 0;
+    };
+
+    enum
     {
-        T min = m_Samples[0];
-        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        QueueMin,
+        QueueMax,
+        QueueAbsMin,
+        QueueAbsMax,
+
+        QueueNB
+    };
+
+    // Append the sample in a slot to the queues, after removing the samples that can no longer become the extreme
+    // value. In the absolute queues, a sample of the same magnitude only replaces an earlier one of the same sign.
+    void PushSample(unsigned int slot, bool bMinMax)
+    {
+        const T value = m_Samples[slot];
+
+        if (bMinMax)
         {
-            if (abs(m_Samples[i]) < abs(min))
-                min = m_Samples[i];
+            while (!m_Queues[QueueMin].Empty() && m_Samples[m_Queues[QueueMin].Back()] >= value)
+                m_Queues[QueueMin].PopBack();
+            m_Queues[QueueMin].PushBack(slot);
+
+            while (!m_Queues[QueueMax].Empty() && m_Samples[m_Queues[QueueMax].Back()] <= value)
+                m_Queues[QueueMax].PopBack();
+            m_Queues[QueueMax].PushBack(slot);
         }
-        return min;
+
+        while (!m_Queues[QueueAbsMin].Empty())
+        {
+            const T back = m_Samples[m_Queues[QueueAbsMin].Back()];
+            if (abs(back) < abs(value) || (abs(back) == abs(value) && back != value))
+                break;
+            m_Queues[QueueAbsMin].PopBack();
+        }
+        m_Queues[QueueAbsMin].PushBack(slot);
+
+        while (!m_Queues[QueueAbsMax].Empty())
+        {
+            const T back = m_Samples[m_Queues[QueueAbsMax].Back()];
+            if (abs(back) > abs(value) || (abs(back) == abs(value) && back != value))
+                break;
+            m_Queues[QueueAbsMax].PopBack();
+        }
+        m_Queues[QueueAbsMax].PushBack(slot);
     }
 
-    T Maximum() const
+    // The extreme magnitude is at the front of an absolute queue, possibly followed by samples of the same magnitude
+    // with the other sign. Of those, return the one in the lowest buffer slot.
+    T AbsExtreme(const SlotQueue &queue) const
     {
-        T max = m_Samples[0];
-        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        const T front = m_Samples[queue.Front()];
+        if (queue.Size() == 1 || abs(m_Samples[queue.At(1)]) != abs(front))
+            return front;
+
+        // the magnitudes are monotonic along the queue, find the end of the run with the extreme magnitude
+        unsigned int lo = 1, hi = queue.Size();
+        while (lo < hi)
         {
-            if (m_Samples[i] > max)
-                max = m_Samples[i];
+            const unsigned int mid = (lo + hi) / 2;
+            if (abs(m_Samples[queue.At(mid)]) == abs(front))
+                lo = mid + 1;
+            else
+                hi = mid;
         }
-        return max;
+        const unsigned int count = lo;
+
+        // from the oldest to the newest sample, the slots run from the current slot up to the end of the buffer, and
+        // then wrap around to zero. The lowest slot is the first one after the wrap, if there is any.
+        lo = 0;
+        hi = count;
+        while (lo < hi)
+        {
+            const unsigned int mid = (lo + hi) / 2;
+            if (queue.At(mid) >= m_CurrentSample)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        return m_Samples[queue.At(lo < count ? lo : 0)];
     }
 
-    T AbsMaximum() const
+    void RecalculateAverage()
     {
-        T max = m_Samples[0];
-        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        T average = 0;
+        for (unsigned int i = 0; i < m_NumSamples; ++i)
         {
-            if (abs(m_Samples[i]) > abs(max))
-                max = m_Samples[i];
+            average += m_Samples[i] / (T)m_NumSamples;
         }
-        return max;
+        m_Average = average;
     }
 
-    void OffsetValues(T value) const
+    void RebuildQueues(bool bMinMax)
     {
+        if (bMinMax)
+        {
+            m_Queues[QueueMin].Clear();
+            m_Queues[QueueMax].Clear();
+        }
+        m_Queues[QueueAbsMin].Clear();
+        m_Queues[QueueAbsMax].Clear();
+
+        // from the oldest to the newest sample
         for (unsigned int i = 0; i < m_NumSamples; ++i)
         {
-            m_Samples[i] += value;
+            unsigned int slot = m_CurrentSample + i;
+            PushSample(slot >= m_NumSamples ? slot - m_NumSamples : slot, bMinMax);
         }
     }
 
-    unsigned int CurrentSample() const { return m_CurrentSample; }
+#ifdef DEBUG
+    // Compare the incremental results against the scan-based implementation
+    void VerifyWindow() const
+    {
+        double dMagnitude = 1.0;
+        T average = 0, minValue = m_Samples[0], maxValue = m_Samples[0], absMinValue = m_Samples[0],
+          absMaxValue = m_Samples[0];
+        for (unsigned int i = 0; i < m_NumSamples; ++i)
+        {
+            average += m_Samples[i] / (T)m_NumSamples;
+            dMagnitude += abs((double)m_Samples[i]);
+            if (m_Samples[i] < minValue)
+                minValue = m_Samples[i];
+            if (m_Samples[i] > maxValue)
+                maxValue = m_Samples[i];
+            if (abs(m_Samples[i]) < abs(absMinValue))
+                absMinValue = m_Samples[i];
+            if (abs(m_Samples[i]) > abs(absMaxValue))
+                absMaxValue = m_Samples[i];
+        }
+
+        // the running average may differ from the scan in the last bits with floating point types
+        assert(abs((double)m_Average - (double)average) <= dMagnitude * 1e-5);
+        assert(Minimum() == minValue);
+        assert(Maximum() == maxValue);
+        assert(AbsMinimum() == absMinValue);
+        assert(AbsMaximum() == absMaxValue);
+    }
+#else
+    void VerifyWindow() const {}
+#endif
 
-  private:
     T *m_Samples = nullptr;
     unsigned int m_NumSamples = 0;
     unsigned int m_NumSamplesAlloc = 0;
     unsigned int m_CurrentSample = 0;
+
+    T m_Average = 0;
+
+    unsigned int *m_QueueBuffer = nullptr;
+    SlotQueue m_Queues[QueueNB];
 };
@@ -0,0 +1,44 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "ProcessingCounter.h"
+
+static LONGLONG GetFrequency()
+{
+    static const LONGLONG llFrequency = []() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        return frequency.QuadPart;
+    }();
+    return llFrequency;
+}
+
+LONGLONG CProcessingCounter::Now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+REFERENCE_TIME CProcessingCounter::TicksToTime(LONGLONG llTicks)
+{
+    const LONGLONG llFrequency = GetFrequency();
+    return (llTicks / llFrequency) * 10000000LL + (llTicks % llFrequency) * 10000000LL / llFrequency;
+}
@@ -0,0 +1,63 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Accumulated processing time and item count of one processing stage
+// The counters are updated by the processing thread while the application reads them from its own thread, so all
+// updates are atomic
+class CProcessingCounter
+{
+  public:
+    // Current time, in performance counter ticks
+    static LONGLONG Now();
+    // Performance counter ticks in 100ns units
+    static REFERENCE_TIME TicksToTime(LONGLONG llTicks);
+
+    void Reset()
+    {
+        InterlockedExchange64(&m_llTicks, 0);
+        InterlockedExchange64(&m_llCount, 0);
+    }
+
+    // Adds the time since llStart (obtained from Now()) and llCount items, and returns the current time
+    LONGLONG Add(LONGLONG llStart, LONGLONG llCount = 1)
+    {
+        const LONGLONG llNow = Now();
+        AddTicks(llNow - llStart);
+        AddCount(llCount);
+        return llNow;
+    }
+
+    void AddTicks(LONGLONG llTicks)
+    {
+        if (llTicks > 0)
+            InterlockedExchangeAdd64(&m_llTicks, llTicks);
+    }
+
+    void AddCount(LONGLONG llCount = 1) { InterlockedExchangeAdd64(&m_llCount, llCount); }
+
+    LONGLONG GetTicks() const { return m_llTicks; }
+    ULONGLONG GetCount() const { return (ULONGLONG)m_llCount; }
+    REFERENCE_TIME GetTime() const { return TicksToTime(m_llTicks); }
+
+  private:
+    volatile LONGLONG m_llTicks = 0;
+    volatile LONGLONG m_llCount = 0;
+};
@@ -137,3 +137,124 @@ template <class T> class GrowableArray
     DWORD m_count = 0;     // Nominal count.
     DWORD m_allocated = 0; // Actual allocation size.
 };
+
+// Class template: Re-sizable array with a read offset, for data that is consumed from the front.
+
+// Consume() only advances the start of the array, instead of moving the remaining data to the front.
+// The data is moved to the front when the space at the end is needed again, so Ptr() is always contiguous.
+// Allocate() and SetSize() are relative to the current start of the array.
+// Clear() keeps the allocated memory for re-use, call Free() to release it.
+
+template <class T> class OffsetArray
+{
+  public:
+    OffsetArray() {}
+
+    virtual ~OffsetArray() { free(m_pArray); }
+
+    // Allocate: Reserves memory for the array, but does not increase the count.
+    HRESULT Allocate(DWORD alloc)
+    {
+        if (m_offset + alloc <= m_allocated && m_pArray)
+            return S_OK;
+
+        // move the data to the front first, that might already make enough room
+        if (m_offset > 0)
+        {
+            memmove(m_pArray, m_pArray + m_offset, m_count * sizeof(T));
+            m_offset = 0;
+        }
+
+        if (alloc > m_allocated || !m_pArray)
+        {
+            // leave room to consume and append a few times before the data needs to be moved again
+            DWORD allocNew = (alloc < MAXDWORD / 2) ? alloc * 2 : alloc;
+            T *pNew = (T *)realloc(m_pArray, sizeof(T) * allocNew);
+            if (!pNew)
+            {
+                Free();
+                return E_OUTOFMEMORY;
+            }
+            m_pArray = pNew;
+            ZeroMemory(m_pArray + m_allocated, (allocNew - m_allocated) * sizeof(T));
+            m_allocated = allocNew;
+        }
+        return S_OK;
+    }
+
+    void Clear() { m_offset = m_count = 0; }
+
+    void Free()
+    {
+        free(m_pArray);
+        m_pArray = nullptr;
+        m_offset = m_count = m_allocated = 0;
+    }
+
+    // SetSize: Changes the count, and grows the array if needed.
+    HRESULT SetSize(DWORD count)
+    {
+        HRESULT hr = S_OK;
+        if (m_offset + count > m_allocated)
+        {
+            hr = Allocate(count);
+        }
+        if (SUCCEEDED(hr))
+        {
+            m_count = count;
+        }
+        return hr;
+    }
+
+    HRESULT Append(const T *other, DWORD dwSize)
+    {
+        DWORD old = GetCount();
+        HRESULT hr = SetSize(old + dwSize);
+        if (SUCCEEDED(hr))
+            memcpy(Ptr() + old, other, dwSize * sizeof(T));
+
+        return hr;
+    }
+
+    void Consume(DWORD dwSize)
+    {
+        ASSERT(dwSize <= m_count);
+
+        if (dwSize >= m_count)
+            Clear();
+        else
+        {
+            m_offset += dwSize;
+            m_count -= dwSize;
+        }
+    }
+
+    DWORD GetCount() const { return m_count; }
+    DWORD GetAllocated() const { return m_allocated - m_offset; }
+
+    // Accessor.
+    T &operator[](DWORD index)
+    {
+        assert(index < m_count);
+        return m_pArray[m_offset + index];
+    }
+
+    // Const accessor.
+    const T &operator[](DWORD index) const
+    {
+        assert(index < m_count);
+        return m_pArray[m_offset + index];
+    }
+
+    // Return the underlying array, starting at the first unconsumed element.
+    T *Ptr() { return m_pArray ? m_pArray + m_offset : nullptr; }
+
+  protected:
+    OffsetArray &operator=(const OffsetArray &r);
+    OffsetArray(const OffsetArray &r);
+
+    T *m_pArray = nullptr;
+    DWORD m_offset = 0;    // Start of the data.
+    DWORD m_count = 0;     // Nominal count.
+    DWORD m_allocated = 0; // Actual allocation size.
+};
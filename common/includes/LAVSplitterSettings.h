@@ -192,4 +192,17 @@ interface __declspec(uuid("774A919D-EA95-4A87-8A1E-F48ABE8499C7")) ILAVFSettings
 
     // Get the maximum queue size, in number of packets
     STDMETHOD_(DWORD, GetMaxQueueSize)() = 0;
+
+    // Get the demuxing statistics since playback was started
+    // With iCodec = -1, the totals of the demuxer are returned: packets read from the file, their size in bytes,
+    // and the time spent reading them (in 100ns units). Otherwise the statistics of the stream parser for the codec
+    // with the given index are returned: its media subtype, packets parsed, bytes, and time spent in it. All streams
+    // with the same media subtype are counted together. Returns S_FALSE if there is no codec with the index.
+    // All parameters are optional.
+    STDMETHOD(GetDemuxStats)(int iCodec, GUID *pSubtype, ULONGLONG *pPackets, ULONGLONG *pBytes,
+                             REFERENCE_TIME *prtTime) = 0;
+
+    // Get the number of packet and packet buffer allocations of this splitter since playback was started
+    // Divided by the packets read from GetDemuxStats, this gives the allocations per packet
+    STDMETHOD(GetPacketAllocations)(ULONGLONG *pAllocations) = 0;
 };
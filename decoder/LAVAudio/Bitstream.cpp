@@ -23,7 +23,6 @@
 #include <MMReg.h>
 #include "moreuuids.h"
 
-#define LAV_BITSTREAM_BUFFER_SIZE 4096
 #define LAV_BITSTREAM_DTS_HD_HR_RATE 192000
 #define LAV_BITSTREAM_DTS_HD_MA_RATE 768000
 
@@ -53,100 +52,34 @@ BOOL CLAVAudio::IsBitstreaming(AVCodecID codec)
     return FALSE;
 }
 
-HRESULT CLAVAudio::InitBitstreaming()
-{
-    // Alloc buffer for the AVIO context
-    BYTE *buffer = (BYTE *)CoTaskMemAlloc(LAV_BITSTREAM_BUFFER_SIZE + AV_INPUT_BUFFER_PADDING_SIZE);
-    if (!buffer)
-        return E_OUTOFMEMORY;
-
-    // Create AVIO context
-    m_avioBitstream = avio_alloc_context(buffer, LAV_BITSTREAM_BUFFER_SIZE, 1, this, nullptr, BSWriteBuffer, nullptr);
-    if (!m_avioBitstream)
-    {
-        SAFE_CO_FREE(buffer);
-        return E_FAIL;
-    }
-
-    return S_OK;
-}
-
-HRESULT CLAVAudio::ShutdownBitstreaming()
-{
-    if (m_avioBitstream)
-    {
-        SAFE_CO_FREE(m_avioBitstream->buffer);
-        av_freep(&m_avioBitstream);
-    }
-    return S_OK;
-}
-
-// Static function for the AVIO context that writes the buffer into our own output buffer
-int CLAVAudio::BSWriteBuffer(void *opaque, uint8_t *buf, int buf_size)
-{
-    CLAVAudio *filter = (CLAVAudio *)opaque;
-    filter->m_bsOutput.Append(buf, buf_size);
-    return buf_size;
-}
-
 HRESULT CLAVAudio::CreateBitstreamContext(AVCodecID codec, WAVEFORMATEX *wfe)
 {
-    int ret = 0;
-
-    if (m_avBSContext)
+    if (m_bBitstreaming)
         FreeBitstreamContext();
     m_bsParser.Reset();
 
     DbgLog((LOG_TRACE, 20, "Creating Bistreaming Context..."));
 
-    ret = avformat_alloc_output_context2(&m_avBSContext, nullptr, "spdif", nullptr);
-    if (ret < 0 || !m_avBSContext)
-    {
-        DbgLog((LOG_ERROR, 10, L"::CreateBitstreamContext() -- alloc of avformat spdif muxer failed (ret: %d)", ret));
-        goto fail;
-    }
-
-    m_avBSContext->pb = m_avioBitstream;
-    m_avBSContext->oformat->flags |= AVFMT_NOFILE;
-
-    // flush IO after every packet, so we can send it to the audio renderer immediately
-    m_avBSContext->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+    m_IECState.channels = wfe->nChannels;
+    m_IECState.sample_rate = wfe->nSamplesPerSec;
+    m_IECState.dtshd_skip = FALSE;
+    m_IECState.eac3_frames = 0;
 
     // DTS-HD is by default off, unless explicitly asked for
     if (m_settings.DTSHDFraming && m_settings.bBitstream[Bitstream_DTSHD] && !m_bForceDTSCore)
     {
         m_DTSBitstreamMode = DTS_HDMA;
-        av_opt_set_int(m_avBSContext->priv_data, "dtshd_rate", LAV_BITSTREAM_DTS_HD_MA_RATE, 0);
+        m_IECState.dtshd_rate = LAV_BITSTREAM_DTS_HD_MA_RATE;
     }
     else
     {
         m_DTSBitstreamMode = DTS_Core;
-        av_opt_set_int(m_avBSContext->priv_data, "dtshd_rate", 0, 0);
+        m_IECState.dtshd_rate = 0;
     }
-    av_opt_set_int(m_avBSContext->priv_data, "dtshd_fallback_time", -1, 0);
 
-    AVStream *st = avformat_new_stream(m_avBSContext, 0);
-    if (!st)
-    {
-        DbgLog((LOG_ERROR, 10, L"::CreateBitstreamContext() -- alloc of output stream failed"));
-        goto fail;
-    }
-    st->codecpar->codec_id = codec;
-    st->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
-    st->codecpar->channels = wfe->nChannels;
-    st->codecpar->sample_rate = wfe->nSamplesPerSec;
-
-    ret = avformat_write_header(m_avBSContext, nullptr);
-    if (ret < 0)
-    {
-        DbgLog((LOG_ERROR, 10, L"::CreateBitstreamContext() -- av_write_header returned an error code (%d)", -ret));
-        goto fail;
-    }
+    m_bBitstreaming = TRUE;
 
     return S_OK;
-fail:
-    FreeBitstreamContext();
-    return E_FAIL;
 }
 
 HRESULT CLAVAudio::UpdateBitstreamContext()
@@ -155,7 +88,7 @@ HRESULT CLAVAudio::UpdateBitstreamContext()
         return E_UNEXPECTED;
 
     BOOL bBitstream = IsBitstreaming(m_nCodecId);
-    if ((bBitstream && !m_avBSContext) || (!bBitstream && m_avBSContext))
+    if ((bBitstream && !m_bBitstreaming) || (!bBitstream && m_bBitstreaming))
     {
         CMediaType mt = m_pInput->CurrentMediaType();
 
@@ -177,17 +110,17 @@ HRESULT CLAVAudio::UpdateBitstreamContext()
     }
 
     // Configure DTS-HD setting
-    if (m_avBSContext)
+    if (m_bBitstreaming)
     {
         if (m_settings.bBitstream[Bitstream_DTSHD] && m_settings.DTSHDFraming && !m_bForceDTSCore)
         {
             m_DTSBitstreamMode = DTS_HDMA;
-            av_opt_set_int(m_avBSContext->priv_data, "dtshd_rate", LAV_BITSTREAM_DTS_HD_MA_RATE, 0);
+            m_IECState.dtshd_rate = LAV_BITSTREAM_DTS_HD_MA_RATE;
         }
         else
         {
             m_DTSBitstreamMode = DTS_Core; // Force auto-detection
-            av_opt_set_int(m_avBSContext->priv_data, "dtshd_rate", 0, 0);
+            m_IECState.dtshd_rate = 0;
         }
     }
 
@@ -196,15 +129,11 @@ HRESULT CLAVAudio::UpdateBitstreamContext()
 
 HRESULT CLAVAudio::FreeBitstreamContext()
 {
-    if (m_avBSContext)
-    {
-        av_write_trailer(m_avBSContext); // For the SPDIF muxer that frees the buffers
-        avformat_free_context(m_avBSContext);
-    }
-    m_avBSContext = nullptr;
+    m_bBitstreaming = FALSE;
 
     // Dump any remaining data
     m_bsOutput.SetSize(0);
+    m_IECState.eac3_frames = 0;
 
     // reset TrueHD MAT state
     memset(&m_TrueHDMATState, 0, sizeof(m_TrueHDMATState));
@@ -313,22 +242,16 @@ void CLAVAudio::ActivateDTSHDMuxing()
     }
     else
     {
-        av_opt_set_int(m_avBSContext->priv_data, "dtshd_rate",
-                       (m_DTSBitstreamMode == DTS_HDHR) ? LAV_BITSTREAM_DTS_HD_HR_RATE : LAV_BITSTREAM_DTS_HD_MA_RATE,
-                       0);
+        m_IECState.dtshd_rate =
+            (m_DTSBitstreamMode == DTS_HDHR) ? LAV_BITSTREAM_DTS_HD_HR_RATE : LAV_BITSTREAM_DTS_HD_MA_RATE;
     }
 }
 
 HRESULT CLAVAudio::Bitstream(const BYTE *pDataBuffer, int buffsize, int &consumed, HRESULT *hrDeliver)
 {
     HRESULT hr = S_OK;
-    int ret = 0;
     BOOL bFlush = (pDataBuffer == nullptr);
 
-    AVPacket avpkt;
-    av_init_packet(&avpkt);
-    avpkt.duration = 1;
-
     consumed = 0;
     while (buffsize > 0)
     {
@@ -396,37 +319,33 @@ HRESULT CLAVAudio::Bitstream(const BYTE *pDataBuffer, int buffsize, int &consume
                         ActivateDTSHDMuxing();
                 }
 
-                avpkt.data = pOut;
-                avpkt.size = pOut_size;
-
-                // Write SPDIF muxed frame
-                ret = av_write_frame(m_avBSContext, &avpkt);
-                if (ret < 0)
+                // Frame the data for IEC 61937, E-AC3 frames might be collected into a combined burst first
+                IEC61937Burst burst;
+                hr = IEC61937PrepareBurst(pOut, pOut_size, burst);
+                if (FAILED(hr))
                 {
-                    DbgLog((LOG_ERROR, 20, "::Bitstream(): av_write_frame returned error code (%d)", -ret));
-                    m_bsOutput.SetSize(0);
+                    DbgLog((LOG_ERROR, 20, "::Bitstream(): IEC 61937 framing failed"));
                     continue;
                 }
 
                 m_bUpdateTimeCache = TRUE;
 
-                // Set long-time cache to the first timestamp encountered, used by TrueHD and E-AC3 because the S/PDIF
-                // muxer caches data internally If the current timestamp is not valid, use the last delivery timestamp
-                // in m_rtStart
+                // Set long-time cache to the first timestamp encountered, used by TrueHD and E-AC3 because multiple
+                // frames can be combined into one burst If the current timestamp is not valid, use the last delivery
+                // timestamp in m_rtStart
                 if (m_rtBitstreamCache == AV_NOPTS_VALUE)
                     m_rtBitstreamCache = m_rtStartInputCache != AV_NOPTS_VALUE ? m_rtStartInputCache : m_rtStart;
 
-                // Deliver frame
-                if (m_bsOutput.GetCount() > 0)
+                // Deliver the burst, unless more frames are needed to complete it
+                if (hr == S_OK)
                 {
-                    *hrDeliver = DeliverBitstream(m_nCodecId, m_bsOutput.Ptr(), m_bsOutput.GetCount(),
-                                                  m_rtStartInputCache, m_rtStopInputCache);
+                    *hrDeliver = DeliverIEC61937Burst(burst, m_rtStartInputCache, m_rtStopInputCache);
                     m_bsOutput.SetSize(0);
                 }
             }
 
             /* if the bitstreaming context is lost at this point, then the deliver function caused a fallback to PCM */
-            if (m_avBSContext == nullptr)
+            if (!m_bBitstreaming)
                 return S_FALSE;
         }
     }
@@ -436,26 +355,60 @@ HRESULT CLAVAudio::Bitstream(const BYTE *pDataBuffer, int buffsize, int &consume
 
 HRESULT CLAVAudio::DeliverBitstream(AVCodecID codec, const BYTE *buffer, DWORD dwSize, REFERENCE_TIME rtStartInput,
                                     REFERENCE_TIME rtStopInput, BOOL bSwap)
+{
+    CMediaType mt;
+    IMediaSample *pOut = nullptr;
+    BYTE *pDataOut = nullptr;
+
+    HRESULT hr = GetBitstreamBuffer(codec, dwSize, mt, &pOut, &pDataOut);
+    if (FAILED(hr) || !pOut)
+        return hr;
+
+    // byte-swap if needed
+    if (bSwap)
+    {
+        lav_spdif_bswap_buf16((uint16_t *)pDataOut, (uint16_t *)buffer, dwSize >> 1);
+    }
+    else
+    {
+        memcpy(pDataOut, buffer, dwSize);
+    }
+
+    return DeliverBitstreamSample(pOut, mt, hr == S_OK, dwSize, rtStartInput, rtStopInput);
+}
+
+// Get an output sample for a bitstream packet of dwSize bytes
+// Returns S_OK if the media type changed, and S_FALSE if it did not (or without a sample while flushing)
+HRESULT CLAVAudio::GetBitstreamBuffer(AVCodecID codec, DWORD dwSize, CMediaType &mt, IMediaSample **ppOut,
+                                      BYTE **ppDataOut)
 {
     HRESULT hr = S_OK;
 
+    *ppOut = nullptr;
     if (m_bFlushing)
         return S_FALSE;
 
-    CMediaType mt = CreateBitstreamMediaType(codec, m_bsParser.m_dwSampleRate);
+    mt = CreateBitstreamMediaType(codec, m_bsParser.m_dwSampleRate);
 
     if (FAILED(hr = ReconnectOutput(dwSize, mt)))
     {
         return hr;
     }
 
-    IMediaSample *pOut;
-    BYTE *pDataOut = nullptr;
-    if (FAILED(GetDeliveryBuffer(&pOut, &pDataOut)))
+    if (FAILED(GetDeliveryBuffer(ppOut, ppDataOut)))
     {
         return E_FAIL;
     }
 
+    return hr;
+}
+
+// Timestamp and deliver a filled bitstream sample, this consumes the sample
+HRESULT CLAVAudio::DeliverBitstreamSample(IMediaSample *pOut, CMediaType &mt, BOOL bMediaTypeChanged, DWORD dwSize,
+                                          REFERENCE_TIME rtStartInput, REFERENCE_TIME rtStopInput)
+{
+    HRESULT hr = S_OK;
+
     if (m_bResyncTimestamp && (rtStartInput != AV_NOPTS_VALUE || m_rtBitstreamCache != AV_NOPTS_VALUE))
     {
         if (m_rtBitstreamCache != AV_NOPTS_VALUE)
@@ -525,17 +478,7 @@ HRESULT CLAVAudio::DeliverBitstream(AVCodecID codec, const BYTE *buffer, DWORD d
 
     pOut->SetActualDataLength(dwSize);
 
-    // byte-swap if needed
-    if (bSwap)
-    {
-        lav_spdif_bswap_buf16((uint16_t *)pDataOut, (uint16_t *)buffer, dwSize >> 1);
-    }
-    else
-    {
-        memcpy(pDataOut, buffer, dwSize);
-    }
-
-    if (hr == S_OK)
+    if (bMediaTypeChanged)
     {
         hr = m_pOutput->GetConnected()->QueryAccept(&mt);
         if (hr == S_FALSE && m_nCodecId == AV_CODEC_ID_DTS && m_DTSBitstreamMode != DTS_Core)
@@ -555,7 +498,7 @@ HRESULT CLAVAudio::DeliverBitstream(AVCodecID codec, const BYTE *buffer, DWORD d
         pOut->SetMediaType(&mt);
     }
 
-    hr = m_pOutput->Deliver(pOut);
+    hr = DeliverOutputSample(pOut);
     if (FAILED(hr))
     {
         DbgLog((LOG_ERROR, 10, L"::DeliverBitstream failed with code: %0#.8x", hr));
@@ -0,0 +1,276 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVAudio.h"
+
+extern "C"
+{
+#include "libavformat/spdif.h"
+    extern __declspec(dllimport) const uint32_t avpriv_dca_sample_rates[16];
+};
+
+// IEC 61937 burst packer for AC3, E-AC3 and DTS/DTS-HD
+//
+// Every audio frame is wrapped into a data burst, consisting of the preamble, the payload and zero padding up to the
+// repetition period of the codec. The burst is written straight into the output sample in little-endian 16-bit
+// words, the big-endian payload is byte-swapped while being copied.
+// The framing matches the libavformat spdif muxer, which was used for this previously.
+
+#define IEC61937_AC3_BURST_SIZE (1536 * 4)
+#define IEC61937_EAC3_BURST_SIZE (6144 * 4)
+
+static const BYTE dtshd_start_code[10] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xfe, 0xfe};
+
+static int dts4_subtype(int period)
+{
+    switch (period)
+    {
+    case 512: return 0x0;
+    case 1024: return 0x1;
+    case 2048: return 0x2;
+    case 4096: return 0x3;
+    case 8192: return 0x4;
+    case 16384: return 0x5;
+    }
+    return -1;
+}
+
+HRESULT CLAVAudio::IEC61937BurstAC3(const BYTE *p, int buffsize, IEC61937Burst &burst)
+{
+    if (buffsize < 6)
+        return E_FAIL;
+
+    int bitstream_mode = p[5] & 0x7;
+    burst.wDataType = IEC61937_AC3 | (bitstream_mode << 8);
+    burst.dwBurstSize = IEC61937_AC3_BURST_SIZE;
+
+    return S_OK;
+}
+
+HRESULT CLAVAudio::IEC61937BurstEAC3(const BYTE *p, int buffsize, IEC61937Burst &burst)
+{
+    static const int eac3_repeat[4] = {6, 3, 2, 1};
+
+    if (buffsize < 6)
+        return E_FAIL;
+
+    // E-AC3 frames with less than 6 audio blocks are combined into one burst
+    int repeat = 1;
+    int bsid = p[5] >> 3;
+    if (bsid > 10 && (p[4] & 0xc0) != 0xc0) /* fscod */
+        repeat = eac3_repeat[(p[4] & 0x30) >> 4]; /* numblkscod */
+
+    if (repeat > 1 || m_IECState.eac3_frames > 0)
+    {
+        m_bsOutput.Append(p, buffsize);
+        if (++m_IECState.eac3_frames < repeat)
+            return S_FALSE;
+
+        burst.pPayload = m_bsOutput.Ptr();
+        burst.dwPayloadSize = m_bsOutput.GetCount();
+        m_IECState.eac3_frames = 0;
+    }
+
+    burst.wDataType = IEC61937_EAC3;
+    burst.wLengthCode = (WORD)burst.dwPayloadSize;
+    burst.dwBurstSize = IEC61937_EAC3_BURST_SIZE;
+
+    return S_OK;
+}
+
+HRESULT CLAVAudio::IEC61937BurstDTS(const BYTE *p, int buffsize, IEC61937Burst &burst)
+{
+    int blocks = 0, sample_rate = 0, core_size = 0;
+
+    if (buffsize < 9)
+        return E_FAIL;
+
+    switch (AV_RB32(p))
+    {
+    case DCA_MARKER_RAW_BE:
+        blocks = (AV_RB16(p + 4) >> 2) & 0x7f;
+        core_size = ((AV_RB24(p + 5) >> 4) & 0x3fff) + 1;
+        sample_rate = avpriv_dca_sample_rates[(p[8] >> 2) & 0x0f];
+        break;
+    case DCA_MARKER_RAW_LE:
+        blocks = (AV_RL16(p + 4) >> 2) & 0x7f;
+        burst.bSwap = FALSE;
+        break;
+    case DCA_MARKER_14B_BE: blocks = (((p[5] & 0x07) << 4) | ((p[6] & 0x3f) >> 2)); break;
+    case DCA_MARKER_14B_LE:
+        blocks = (((p[4] & 0x07) << 4) | ((p[7] & 0x3f) >> 2));
+        burst.bSwap = FALSE;
+        break;
+    default:
+        // this includes DTS-HD frames without a core, which can only be sent together with one
+        DbgLog((LOG_TRACE, 20, L"CLAVAudio::IEC61937BurstDTS(): Unsupported DTS syncword 0x%08x", AV_RB32(p)));
+        return E_FAIL;
+    }
+    blocks++;
+
+    // DTS type IV burst, which carries the core together with the DTS-HD extensions
+    if (m_IECState.dtshd_rate)
+    {
+        if (!core_size || !sample_rate)
+            return E_FAIL;
+
+        int period = m_IECState.dtshd_rate * (blocks << 5) / sample_rate;
+        int subtype = dts4_subtype(period);
+        if (subtype < 0)
+        {
+            DbgLog((LOG_TRACE, 20, L"CLAVAudio::IEC61937BurstDTS(): No DTS-HD burst for a period of %d", period));
+            return E_FAIL;
+        }
+
+        burst.wDataType = IEC61937_DTSHD | (subtype << 8);
+        burst.dwBurstSize = period * 4;
+
+        // If the frame does not fit into the burst, only send the core from then on
+        int pkt_size = buffsize;
+        if (sizeof(dtshd_start_code) + 2 + pkt_size > burst.dwBurstSize - BURST_HEADER_SIZE && !m_IECState.dtshd_skip)
+        {
+            DbgLog((LOG_TRACE, 10, L"CLAVAudio::IEC61937BurstDTS(): DTS-HD bitrate too high, sending the core only"));
+            m_IECState.dtshd_skip = TRUE;
+        }
+        if (m_IECState.dtshd_skip)
+            pkt_size = core_size;
+
+        // the payload is prefixed with the DTS-HD start code and its size
+        memcpy(burst.header, dtshd_start_code, sizeof(dtshd_start_code));
+        AV_WB16(burst.header + sizeof(dtshd_start_code), pkt_size);
+        burst.dwHeaderSize = sizeof(dtshd_start_code) + 2;
+        burst.dwPayloadSize = pkt_size;
+
+        // Align so that (length_code & 0xf) == 0x8, which is reportedly required by some receivers
+        burst.wLengthCode = (WORD)(FFALIGN(burst.dwHeaderSize + burst.dwPayloadSize + 0x8, 0x10) - 0x8);
+        return S_OK;
+    }
+
+    switch (blocks)
+    {
+    case 512 >> 5: burst.wDataType = IEC61937_DTS1; break;
+    case 1024 >> 5: burst.wDataType = IEC61937_DTS2; break;
+    case 2048 >> 5: burst.wDataType = IEC61937_DTS3; break;
+    default:
+        DbgLog((LOG_TRACE, 20, L"CLAVAudio::IEC61937BurstDTS(): %d samples per DTS frame are not supported",
+                blocks << 5));
+        return E_FAIL;
+    }
+
+    // only send the core
+    if (core_size && core_size < buffsize)
+    {
+        burst.dwPayloadSize = core_size;
+        burst.wLengthCode = (WORD)(core_size << 3);
+    }
+
+    burst.dwBurstSize = blocks << 7;
+
+    // A frame that fills the whole period is sent without a preamble (ie. DTS in WAV)
+    if (burst.dwPayloadSize == burst.dwBurstSize)
+        burst.bPreamble = FALSE;
+
+    return S_OK;
+}
+
+HRESULT CLAVAudio::IEC61937PrepareBurst(const BYTE *p, int buffsize, IEC61937Burst &burst)
+{
+    burst.pPayload = p;
+    burst.dwPayloadSize = buffsize;
+    burst.wLengthCode = (WORD)(FFALIGN(buffsize, 2) << 3);
+
+    HRESULT hr = E_FAIL;
+    switch (m_nCodecId)
+    {
+    case AV_CODEC_ID_AC3: hr = IEC61937BurstAC3(p, buffsize, burst); break;
+    case AV_CODEC_ID_EAC3: hr = IEC61937BurstEAC3(p, buffsize, burst); break;
+    case AV_CODEC_ID_DTS: hr = IEC61937BurstDTS(p, buffsize, burst); break;
+    default: ASSERT(0); break;
+    }
+    if (hr != S_OK)
+        return hr;
+
+    if (burst.dwHeaderSize + burst.dwPayloadSize + (burst.bPreamble ? BURST_HEADER_SIZE : 0) > burst.dwBurstSize)
+    {
+        DbgLog((LOG_TRACE, 20, L"CLAVAudio::IEC61937PrepareBurst(): Frame of %u bytes exceeds the burst size of %u",
+                burst.dwPayloadSize, burst.dwBurstSize));
+        // drop the collected E-AC3 frames with it
+        m_bsOutput.SetSize(0);
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+void CLAVAudio::IEC61937WriteBurst(const IEC61937Burst &burst, BYTE *pOut)
+{
+    BYTE *p = pOut;
+
+    if (burst.bPreamble)
+    {
+        AV_WL16(p + 0, SYNCWORD1);
+        AV_WL16(p + 2, SYNCWORD2);
+        AV_WL16(p + 4, burst.wDataType);
+        AV_WL16(p + 6, burst.wLengthCode);
+        p += BURST_HEADER_SIZE;
+    }
+
+    if (burst.dwHeaderSize)
+    {
+        lav_spdif_bswap_buf16((uint16_t *)p, (const uint16_t *)burst.header, (int)(burst.dwHeaderSize >> 1));
+        p += burst.dwHeaderSize;
+    }
+
+    const DWORD dwWords = burst.dwPayloadSize >> 1;
+    if (burst.bSwap)
+        lav_spdif_bswap_buf16((uint16_t *)p, (const uint16_t *)burst.pPayload, (int)dwWords);
+    else
+        memcpy(p, burst.pPayload, dwWords << 1);
+    p += dwWords << 1;
+
+    // a final lone byte is padded to a full word, and swapped along with the rest of the payload
+    if (burst.dwPayloadSize & 1)
+    {
+        if (burst.bSwap)
+            AV_WL16(p, burst.pPayload[burst.dwPayloadSize - 1] << 8);
+        else
+            AV_WB16(p, burst.pPayload[burst.dwPayloadSize - 1] << 8);
+        p += 2;
+    }
+
+    // zero padding up to the end of the burst
+    memset(p, 0, burst.dwBurstSize - (p - pOut));
+}
+
+HRESULT CLAVAudio::DeliverIEC61937Burst(const IEC61937Burst &burst, REFERENCE_TIME rtStartInput,
+                                        REFERENCE_TIME rtStopInput)
+{
+    CMediaType mt;
+    IMediaSample *pOut = nullptr;
+    BYTE *pDataOut = nullptr;
+
+    HRESULT hr = GetBitstreamBuffer(m_nCodecId, burst.dwBurstSize, mt, &pOut, &pDataOut);
+    if (FAILED(hr) || !pOut)
+        return hr;
+
+    IEC61937WriteBurst(burst, pDataOut);
+
+    return DeliverBitstreamSample(pOut, mt, hr == S_OK, burst.dwBurstSize, rtStartInput, rtStopInput);
+}
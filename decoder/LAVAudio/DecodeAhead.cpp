@@ -0,0 +1,272 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVAudio.h"
+
+// Decode-ahead mode
+//
+// Input samples are queued by Receive() and decoded on a dedicated worker thread, while the finished output
+// samples are handed to a COutputQueue, which delivers them downstream on yet another thread.
+// The upstream streaming thread therefore only blocks when the input queue is full.
+//
+// Stream events (flush, end of stream, new segment) wait for the decoder thread to drain the input queue before
+// they are processed, and are then forwarded through the output queue, which keeps them in order with the data.
+//
+// The decoder state is guarded by m_csDecode instead of the receive lock of the base class. The input pin holds the
+// receive lock while Receive() waits for space in the queue, and while end of stream waits for the queue to drain, so
+// the decoder thread must never need it.
+
+HRESULT CLAVAudio::StartStreaming()
+{
+    m_Stats.Reset();
+
+    if (m_settings.DecodeAhead && m_pOutput->IsConnected())
+    {
+        DbgLog((LOG_TRACE, 10, L"CLAVAudio::StartStreaming(): Starting decode-ahead"));
+
+        HRESULT hr = S_OK;
+        CLAVAudioOutputQueue *pQueue = new CLAVAudioOutputQueue(m_pOutput->GetConnected(), &hr);
+        if (FAILED(hr))
+        {
+            DbgLog((LOG_ERROR, 10, L"-> Creating the output queue failed, hr: %0#.8x", hr));
+            SAFE_DELETE(pQueue);
+        }
+
+        {
+            CAutoLock lock(&m_csInputQueue);
+            m_pOutputQueue = pQueue;
+        }
+
+        StartDecodeThread();
+    }
+    return __super::StartStreaming();
+}
+
+HRESULT CLAVAudio::StopStreaming()
+{
+    // Stop() already shut down the decoder thread, only the output queue is left
+    CLAVAudioOutputQueue *pQueue = nullptr;
+    {
+        CAutoLock lock(&m_csInputQueue);
+        pQueue = m_pOutputQueue;
+        m_pOutputQueue = nullptr;
+    }
+    SAFE_DELETE(pQueue);
+
+#ifdef DEBUG
+    static const WCHAR *stageNames[LAVAudioStage_NB] = {L"Decode", L"PostProcess", L"Queue", L"Deliver"};
+    for (int i = 0; i < LAVAudioStage_NB; i++)
+    {
+        const ULONGLONG samples = m_Stats.GetSamples((LAVAudioStage)i);
+        const REFERENCE_TIME rtTime = m_Stats.GetTime((LAVAudioStage)i);
+        if (samples && rtTime)
+            DbgLog((LOG_TRACE, 10, L"CLAVAudio::StopStreaming(): %s: %I64u samples, %.2f Msamples/s", stageNames[i],
+                    samples, samples / (rtTime / 10.0)));
+    }
+#endif
+
+    return __super::StopStreaming();
+}
+
+STDMETHODIMP CLAVAudio::Stop()
+{
+    // The decoder thread needs to finish before the base class tears down streaming, as it may still be processing a
+    // sample
+    StopDecodeThread();
+    return __super::Stop();
+}
+
+HRESULT CLAVAudio::StartDecodeThread()
+{
+    CAutoLock lock(&m_csInputQueue);
+    if (m_bDecodeThreadActive)
+        return S_FALSE;
+
+    m_hrDecodeThread = S_OK;
+    m_bDecodeThreadBusy = FALSE;
+    m_evInputAvailable.Reset();
+    m_evDecodeIdle.Set();
+
+    if (!Create())
+    {
+        DbgLog((LOG_ERROR, 10, L"CLAVAudio::StartDecodeThread(): Failed to create the decoder thread"));
+        return E_FAIL;
+    }
+
+    m_bDecodeThreadActive = TRUE;
+    return S_OK;
+}
+
+HRESULT CLAVAudio::StopDecodeThread()
+{
+    {
+        CAutoLock lock(&m_csInputQueue);
+        if (!m_bDecodeThreadActive)
+            return S_FALSE;
+        m_bDecodeThreadActive = FALSE;
+    }
+
+    ClearInputQueue();
+
+    CAMThread::CallWorker(CMD_EXIT);
+    CAMThread::Close();
+
+    m_evDecodeIdle.Set();
+    return S_OK;
+}
+
+HRESULT CLAVAudio::QueueInputSample(IMediaSample *pIn)
+{
+    for (;;)
+    {
+        {
+            CAutoLock lock(&m_csInputQueue);
+            if (!m_bDecodeThreadActive)
+                break;
+
+            if (m_bFlushing)
+                return S_FALSE;
+
+            // report errors of the decoder thread back upstream
+            if (FAILED(m_hrDecodeThread))
+                return m_hrDecodeThread;
+
+            if (m_InputQueue.size() < DECODE_AHEAD_INPUT_QUEUE)
+            {
+                pIn->AddRef();
+                m_InputQueue.push_back(pIn);
+
+                m_evDecodeIdle.Reset();
+                m_evInputAvailable.Set();
+                return S_OK;
+            }
+        }
+
+        // wait for the decoder to make room in the queue
+        m_evInputSpace.Wait();
+    }
+
+    // the decoder thread was shut down, process synchronously
+    CAutoLock cAutoLock(&m_csDecode);
+    return ProcessInputSample(pIn);
+}
+
+void CLAVAudio::ClearInputQueue()
+{
+    CAutoLock lock(&m_csInputQueue);
+
+    if (!m_InputQueue.empty())
+        DbgLog((LOG_TRACE, 10, L"CLAVAudio::ClearInputQueue(): Dropping %d queued samples", m_InputQueue.size()));
+
+    for (IMediaSample *pSample : m_InputQueue)
+        pSample->Release();
+    m_InputQueue.clear();
+
+    m_evInputAvailable.Reset();
+    if (!m_bDecodeThreadBusy)
+        m_evDecodeIdle.Set();
+
+    // release a blocked Receive call
+    m_evInputSpace.Set();
+}
+
+void CLAVAudio::WaitForDecodeIdle()
+{
+    {
+        CAutoLock lock(&m_csInputQueue);
+        if (!m_bDecodeThreadActive)
+            return;
+    }
+
+    // the event is signalled again once the queue is empty and the decoder thread is done with its sample, or when the
+    // thread is stopped
+    m_evDecodeIdle.Wait();
+}
+
+HRESULT CLAVAudio::DeliverOutputSample(IMediaSample *pSample)
+{
+    if (m_pOutputQueue)
+    {
+        // the queue releases the sample after delivering it
+        pSample->AddRef();
+        return m_pOutputQueue->Receive(pSample);
+    }
+
+    return m_pOutput->Deliver(pSample);
+}
+
+DWORD CLAVAudio::ThreadProc()
+{
+    SetThreadName(-1, "LAVAudio Decoder");
+
+    HANDLE hWait[2] = {GetRequestHandle(), m_evInputAvailable};
+
+    for (;;)
+    {
+        DWORD dwWait = WaitForMultipleObjects(countof(hWait), hWait, FALSE, INFINITE);
+        if (dwWait == WAIT_OBJECT_0)
+        {
+            DWORD cmd = GetRequest();
+            Reply(S_OK);
+            ASSERT(cmd == CMD_EXIT);
+            return 0;
+        }
+
+        IMediaSample *pSample = nullptr;
+        {
+            CAutoLock lock(&m_csInputQueue);
+            if (!m_InputQueue.empty())
+            {
+                pSample = m_InputQueue.front();
+                m_InputQueue.pop_front();
+                m_bDecodeThreadBusy = TRUE;
+                m_evInputSpace.Set();
+            }
+
+            if (m_InputQueue.empty())
+                m_evInputAvailable.Reset();
+        }
+
+        if (!pSample)
+            continue;
+
+        HRESULT hr;
+        {
+            CAutoLock cAutoLock(&m_csDecode);
+            hr = ProcessInputSample(pSample);
+        }
+        SafeRelease(&pSample);
+
+        {
+            CAutoLock lock(&m_csInputQueue);
+            if (FAILED(hr) && !m_bFlushing && SUCCEEDED(m_hrDecodeThread))
+            {
+                DbgLog((LOG_TRACE, 10, L"CLAVAudio::ThreadProc(): Processing failed, hr: %0#.8x", hr));
+                m_hrDecodeThread = hr;
+            }
+
+            m_bDecodeThreadBusy = FALSE;
+            if (m_InputQueue.empty())
+                m_evDecodeIdle.Set();
+        }
+    }
+
+    return 0;
+}
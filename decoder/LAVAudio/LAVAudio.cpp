@@ -85,9 +85,10 @@ CLAVAudio::CLAVAudio(LPUNKNOWN pUnk, HRESULT *phr)
         return;
     }
 
-    LoadSettings();
+    // no decoder thread is running yet, so there is nothing to wait for
+    m_evDecodeIdle.Set();
 
-    InitBitstreaming();
+    LoadSettings();
 
 #ifdef DEBUG
     DbgSetModuleLevel(LOG_CUSTOM1, DWORD_MAX); // FFMPEG messages use custom1
@@ -104,10 +105,13 @@ CLAVAudio::CLAVAudio(LPUNKNOWN pUnk, HRESULT *phr)
 
 CLAVAudio::~CLAVAudio()
 {
+    StopDecodeThread();
+    SAFE_DELETE(m_pOutputQueue);
+
     SAFE_DELETE(m_pTrayIcon);
     ffmpeg_shutdown();
 
-    ShutdownBitstreaming();
+    SAFE_DELETE(m_pMixingBuffer);
 
     if (m_hDllExtraDecoder)
     {
@@ -187,6 +191,8 @@ HRESULT CLAVAudio::LoadDefaults()
     m_settings.MixingLFELevel = 0;
 
     m_settings.SuppressFormatChanges = FALSE;
+    m_settings.DecodeAhead = FALSE;
+    m_settings.OutputSampleRate = 0;
 
     return S_OK;
 }
@@ -337,6 +343,14 @@ HRESULT CLAVAudio::ReadSettings(HKEY rootKey)
         bFlag = reg.ReadBOOL(L"SampleConvertDither", hr);
         if (SUCCEEDED(hr))
             m_settings.SampleConvertDither = bFlag;
+
+        bFlag = reg.ReadBOOL(L"DecodeAhead", hr);
+        if (SUCCEEDED(hr))
+            m_settings.DecodeAhead = bFlag;
+
+        dwVal = reg.ReadDWORD(L"OutputSampleRate", hr);
+        if (SUCCEEDED(hr) && (dwVal == 0 || (dwVal >= 8000 && dwVal <= 192000)))
+            m_settings.OutputSampleRate = dwVal;
     }
 
     CRegistry regF = CRegistry(rootKey, LAVC_AUDIO_REGISTRY_KEY_FORMATS, hr, TRUE);
@@ -411,6 +425,8 @@ HRESULT CLAVAudio::SaveSettings()
         }
 
         reg.WriteBOOL(L"SampleConvertDither", m_settings.SampleConvertDither);
+        reg.WriteBOOL(L"DecodeAhead", m_settings.DecodeAhead);
+        reg.WriteDWORD(L"OutputSampleRate", m_settings.OutputSampleRate);
     }
     return S_OK;
 }
@@ -437,6 +453,8 @@ void CLAVAudio::ffmpeg_shutdown()
         avresample_close(m_avrContext);
         avresample_free(&m_avrContext);
     }
+    m_Mixer.Reset();
+    m_Resampler.Close();
 
     FreeBitstreamContext();
 
@@ -851,6 +869,31 @@ STDMETHODIMP_(BOOL) CLAVAudio::GetOutput51LegacyLayout()
     return m_settings.Output51Legacy;
 }
 
+STDMETHODIMP_(BOOL) CLAVAudio::GetDecodeAhead()
+{
+    return m_settings.DecodeAhead;
+}
+
+STDMETHODIMP CLAVAudio::SetDecodeAhead(BOOL bDecodeAhead)
+{
+    m_settings.DecodeAhead = bDecodeAhead;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVAudio::GetOutputSampleRate()
+{
+    return m_settings.OutputSampleRate;
+}
+
+STDMETHODIMP CLAVAudio::SetOutputSampleRate(DWORD dwSampleRate)
+{
+    if (dwSampleRate != 0 && (dwSampleRate < 8000 || dwSampleRate > 192000))
+        return E_INVALIDARG;
+
+    m_settings.OutputSampleRate = dwSampleRate;
+    return SaveSettings();
+}
+
 // ILAVAudioStatus
 BOOL CLAVAudio::IsSampleFormatSupported(LAVAudioSampleFormat sfCheck)
 {
@@ -864,7 +907,7 @@ HRESULT CLAVAudio::GetDecodeDetails(const char **pCodec, const char **pDecodeFor
     {
         return E_UNEXPECTED;
     }
-    if (m_avBSContext)
+    if (m_bBitstreaming)
     {
         if (pCodec)
         {
@@ -873,11 +916,11 @@ HRESULT CLAVAudio::GetDecodeDetails(const char **pCodec, const char **pDecodeFor
         }
         if (pnChannels)
         {
-            *pnChannels = m_avBSContext->streams[0]->codecpar->channels;
+            *pnChannels = m_IECState.channels;
         }
         if (pSampleRate)
         {
-            *pSampleRate = m_avBSContext->streams[0]->codecpar->sample_rate;
+            *pSampleRate = m_IECState.sample_rate;
         }
         if (pDecodeFormat)
         {
@@ -937,7 +980,7 @@ HRESULT CLAVAudio::GetOutputDetails(const char **pOutputFormat, int *pnChannels,
     {
         return E_UNEXPECTED;
     }
-    if (m_avBSContext)
+    if (m_bBitstreaming)
     {
         if (pOutputFormat)
         {
@@ -967,6 +1010,7 @@ HRESULT CLAVAudio::GetOutputDetails(const char **pOutputFormat, int *pnChannels,
 HRESULT CLAVAudio::EnableVolumeStats()
 {
     DbgLog((LOG_TRACE, 1, L"Volume Statistics Enabled"));
+    m_VolumeSnapshot.Reset();
     m_bVolumeStats = TRUE;
     return S_OK;
 }
@@ -975,21 +1019,61 @@ HRESULT CLAVAudio::DisableVolumeStats()
 {
     DbgLog((LOG_TRACE, 1, L"Volume Statistics Disabled"));
     m_bVolumeStats = FALSE;
+    m_VolumeSnapshot.Reset();
     return S_OK;
 }
 
 HRESULT CLAVAudio::GetChannelVolumeAverage(WORD nChannel, float *pfDb)
 {
     CheckPointer(pfDb, E_POINTER);
-    if (!m_pOutput || m_pOutput->IsConnected() == FALSE || !m_bVolumeStats || m_avBSContext)
+    if (!m_pOutput || m_pOutput->IsConnected() == FALSE || !m_bVolumeStats || m_bBitstreaming)
+    {
+        return E_UNEXPECTED;
+    }
+    if (!m_VolumeSnapshot.Read(nChannel, pfDb, nullptr))
+    {
+        return E_INVALIDARG;
+    }
+    return S_OK;
+}
+
+HRESULT CLAVAudio::GetChannelVolumePeak(WORD nChannel, float *pfDb)
+{
+    CheckPointer(pfDb, E_POINTER);
+    if (!m_pOutput || m_pOutput->IsConnected() == FALSE || !m_bVolumeStats || m_bBitstreaming)
     {
         return E_UNEXPECTED;
     }
-    if (nChannel >= m_OutputQueue.wChannels || nChannel >= 8)
+    if (!m_VolumeSnapshot.Read(nChannel, nullptr, pfDb))
     {
         return E_INVALIDARG;
     }
-    *pfDb = m_faVolume[nChannel].Average();
+    return S_OK;
+}
+
+HRESULT CLAVAudio::GetDecodeQueueDepth(int *pnInputQueue, int *pnOutputQueue)
+{
+    CAutoLock lock(&m_csInputQueue);
+    if (pnInputQueue)
+    {
+        *pnInputQueue = (int)m_InputQueue.size();
+    }
+    if (pnOutputQueue)
+    {
+        *pnOutputQueue = m_pOutputQueue ? m_pOutputQueue->GetQueueCount() : 0;
+    }
+    return m_bDecodeThreadActive ? S_OK : S_FALSE;
+}
+
+HRESULT CLAVAudio::GetProcessingStats(LAVAudioStage stage, ULONGLONG *pSamples, REFERENCE_TIME *prtTime)
+{
+    if (stage < 0 || stage >= LAVAudioStage_NB)
+        return E_INVALIDARG;
+
+    if (pSamples)
+        *pSamples = m_Stats.GetSamples(stage);
+    if (prtTime)
+        *prtTime = m_Stats.GetTime(stage);
     return S_OK;
 }
 
@@ -1023,7 +1107,7 @@ HRESULT CLAVAudio::CheckInputType(const CMediaType *mtIn)
 HRESULT CLAVAudio::GetMediaType(int iPosition, CMediaType *pMediaType)
 {
     DbgLog((LOG_TRACE, 5, L"GetMediaType"));
-    if (m_pInput->IsConnected() == FALSE || !((m_pAVCtx && m_pAVCodec) || m_avBSContext))
+    if (m_pInput->IsConnected() == FALSE || !((m_pAVCtx && m_pAVCodec) || m_bBitstreaming))
     {
         return E_UNEXPECTED;
     }
@@ -1033,7 +1117,7 @@ HRESULT CLAVAudio::GetMediaType(int iPosition, CMediaType *pMediaType)
         return E_INVALIDARG;
     }
 
-    if (m_avBSContext)
+    if (m_bBitstreaming)
     {
         if (iPosition == 0)
         {
@@ -1049,7 +1133,6 @@ HRESULT CLAVAudio::GetMediaType(int iPosition, CMediaType *pMediaType)
         }
     }
 
-    const int nSamplesPerSec = m_pAVCtx->sample_rate;
     int nChannels = m_pAVCtx->channels;
     DWORD dwChannelMask = get_channel_mask(nChannels);
 
@@ -1094,6 +1177,14 @@ HRESULT CLAVAudio::GetMediaType(int iPosition, CMediaType *pMediaType)
         }
     }
 
+    // resampled audio is output in the same formats as mixed audio
+    const int nSamplesPerSec = GetTargetSampleRate(m_pAVCtx->sample_rate, nChannels);
+    if (nSamplesPerSec != m_pAVCtx->sample_rate)
+    {
+        lav_sample_fmt = SampleFormat_FP32;
+        bits = 32;
+    }
+
     // map to legacy 5.1 if user requested
     if (dwChannelMask == AV_CH_LAYOUT_5POINT1 && m_settings.Output51Legacy)
         dwChannelMask = AV_CH_LAYOUT_5POINT1_BACK;
@@ -1143,11 +1234,20 @@ HRESULT CLAVAudio::ReconnectOutput(long cbBuffer, CMediaType &mt)
         if (cbBuffer > props.cbBuffer)
         {
             DbgLog((LOG_TRACE, 10, L"::ReconnectOutput(): -> Increasing buffer size"));
-            props.cBuffers = 4;
+            props.cBuffers = m_settings.DecodeAhead ? DECODE_AHEAD_OUTPUT_BUFFERS : 4;
             props.cbBuffer = cbBuffer * 3 / 2;
 
-            if (FAILED(hr = m_pOutput->DeliverBeginFlush()) || FAILED(hr = m_pOutput->DeliverEndFlush()) ||
-                FAILED(hr = pAllocator->Decommit()) || FAILED(hr = pAllocator->SetProperties(&props, &actual)) ||
+            if (m_pOutputQueue)
+            {
+                m_pOutputQueue->BeginFlush();
+                m_pOutputQueue->EndFlush();
+            }
+            else if (FAILED(hr = m_pOutput->DeliverBeginFlush()) || FAILED(hr = m_pOutput->DeliverEndFlush()))
+            {
+                goto done;
+            }
+
+            if (FAILED(hr = pAllocator->Decommit()) || FAILED(hr = pAllocator->SetProperties(&props, &actual)) ||
                 FAILED(hr = pAllocator->Commit()))
             {
                 goto done;
@@ -1247,10 +1347,11 @@ HRESULT CLAVAudio::CheckTransform(const CMediaType *mtIn, const CMediaType *mtOu
     else
     {
         // Check for valid pcm settings, but only when output type is changing
-        if (!m_avBSContext && m_pAVCtx && *mtOut != m_pOutput->CurrentMediaType())
+        if (!m_bBitstreaming && m_pAVCtx && *mtOut != m_pOutput->CurrentMediaType())
         {
             WAVEFORMATEX *wfex = (WAVEFORMATEX *)mtOut->pbFormat;
-            if (wfex->nSamplesPerSec != m_pAVCtx->sample_rate)
+            if (wfex->nSamplesPerSec != m_pAVCtx->sample_rate &&
+                wfex->nSamplesPerSec != GetTargetSampleRate(m_pAVCtx->sample_rate, wfex->nChannels))
             {
                 return VFW_E_TYPE_NOT_ACCEPTED;
             }
@@ -1270,7 +1371,8 @@ HRESULT CLAVAudio::DecideBufferSize(IMemAllocator *pAllocator, ALLOCATOR_PROPERT
     WAVEFORMATEX* wfe = (WAVEFORMATEX*)mt.Format();
     UNUSED_ALWAYS(wfe); */
 
-    pProperties->cBuffers = 4;
+    // decode-ahead needs additional buffers to queue samples for delivery
+    pProperties->cBuffers = m_settings.DecodeAhead ? DECODE_AHEAD_OUTPUT_BUFFERS : 4;
     // TODO: we should base this on the output media type
     pProperties->cbBuffer = LAV_AUDIO_BUFFER_SIZE; // 48KHz 6ch 32bps 100ms
     pProperties->cbAlign = 1;
@@ -1288,7 +1390,7 @@ HRESULT CLAVAudio::DecideBufferSize(IMemAllocator *pAllocator, ALLOCATOR_PROPERT
 
 HRESULT CLAVAudio::ffmpeg_init(AVCodecID codec, const void *format, const GUID format_type, DWORD formatlen)
 {
-    CAutoLock lock(&m_csReceive);
+    CAutoLock lock(&m_csDecode);
     ffmpeg_shutdown();
     DbgLog((LOG_TRACE, 10, L"::ffmpeg_init(): Initializing decoder for codec %S", avcodec_get_name(codec)));
 
@@ -1596,6 +1698,7 @@ HRESULT CLAVAudio::ffmpeg_init(AVCodecID codec, const void *format, const GUID f
     m_bMixingSettingsChanged = TRUE;
     m_SuppressLayout = 0;
     m_bMPEGAudioResync = (m_pInput->CurrentMediaType().subtype == MEDIASUBTYPE_MPEG1AudioPayload);
+    ResetSyncScanners();
 
     return S_OK;
 }
@@ -1684,7 +1787,7 @@ HRESULT CLAVAudio::CompleteConnect(PIN_DIRECTION dir, IPin *pReceivePin)
     if (dir == PINDIR_OUTPUT)
     {
         // check that we connected with a bitstream type, or go back to decoding otherwise
-        if (m_avBSContext && m_settings.bBitstreamingFallback)
+        if (m_bBitstreaming && m_settings.bBitstreamingFallback)
         {
             CMediaType &mt = m_pOutput->CurrentMediaType();
             WAVEFORMATEX *wfe = (WAVEFORMATEX *)mt.Format();
@@ -1710,25 +1813,39 @@ HRESULT CLAVAudio::CompleteConnect(PIN_DIRECTION dir, IPin *pReceivePin)
 HRESULT CLAVAudio::EndOfStream()
 {
     DbgLog((LOG_TRACE, 10, L"CLAVAudio::EndOfStream()"));
-    CAutoLock cAutoLock(&m_csReceive);
+    WaitForDecodeIdle();
+    CAutoLock cAutoLock(&m_csDecode);
 
     // Flush the last data out of the parser
     ProcessBuffer(nullptr);
     ProcessBuffer(nullptr, TRUE);
 
+    // The resampler holds back half its filter length of samples
+    DrainResampler();
+
     FlushOutput(TRUE);
+
+    if (m_pOutputQueue)
+    {
+        m_pOutputQueue->EOS();
+        return S_OK;
+    }
     return __super::EndOfStream();
 }
 
 HRESULT CLAVAudio::PerformFlush()
 {
-    CAutoLock cAutoLock(&m_csReceive);
+    CAutoLock cAutoLock(&m_csDecode);
 
     m_buff.Clear();
+    ResetSyncScanners();
     FlushOutput(FALSE);
     FlushDecoder();
 
     m_bsOutput.SetSize(0);
+    m_IECState.eac3_frames = 0;
+
+    m_Resampler.Reset();
 
     m_rtStart = 0;
     m_bQueueResync = TRUE;
@@ -1746,18 +1863,37 @@ HRESULT CLAVAudio::BeginFlush()
 {
     DbgLog((LOG_TRACE, 10, L"CLAVAudio::BeginFlush()"));
     m_bFlushing = TRUE;
+
+    // discard any samples still waiting for the decoder
+    ClearInputQueue();
+
+    if (m_pOutputQueue)
+    {
+        m_pOutputQueue->BeginFlush();
+        return S_OK;
+    }
     return __super::BeginFlush();
 }
 
 HRESULT CLAVAudio::EndFlush()
 {
     DbgLog((LOG_TRACE, 10, L"CLAVAudio::EndFlush()"));
-    CAutoLock cAutoLock(&m_csReceive);
+    WaitForDecodeIdle();
+    CAutoLock cAutoLock(&m_csDecode);
 
     if (m_bDVDPlayback)
         PerformFlush();
 
-    HRESULT hr = __super::EndFlush();
+    HRESULT hr = S_OK;
+    if (m_pOutputQueue)
+        m_pOutputQueue->EndFlush();
+    else
+        hr = __super::EndFlush();
+
+    {
+        CAutoLock lock(&m_csInputQueue);
+        m_hrDecodeThread = S_OK;
+    }
     m_bFlushing = FALSE;
     return hr;
 }
@@ -1765,7 +1901,8 @@ HRESULT CLAVAudio::EndFlush()
 HRESULT CLAVAudio::NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, double dRate)
 {
     DbgLog((LOG_TRACE, 10, L"CLAVAudio::NewSegment() tStart: %I64d, tStop: %I64d, dRate: %.2f", tStart, tStop, dRate));
-    CAutoLock cAutoLock(&m_csReceive);
+    WaitForDecodeIdle();
+    CAutoLock cAutoLock(&m_csDecode);
 
     PerformFlush();
 
@@ -1773,6 +1910,12 @@ HRESULT CLAVAudio::NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, doubl
         m_dRate = dRate;
     else
         m_dRate = 1.0;
+
+    if (m_pOutputQueue)
+    {
+        m_pOutputQueue->NewSegment(tStart, tStop, dRate);
+        return S_OK;
+    }
     return __super::NewSegment(tStart, tStop, dRate);
 }
 
@@ -1802,16 +1945,34 @@ HRESULT CLAVAudio::FlushDecoder()
 
 HRESULT CLAVAudio::Receive(IMediaSample *pIn)
 {
-    CAutoLock cAutoLock(&m_csReceive);
-
-    HRESULT hr;
-
     AM_SAMPLE2_PROPERTIES const *pProps = m_pInput->SampleProps();
     if (pProps->dwStreamId != AM_STREAM_MEDIA)
     {
-        return m_pOutput->Deliver(pIn);
+        // keep stream control samples in order with any data still queued for decoding
+        WaitForDecodeIdle();
+
+        CAutoLock cAutoLock(&m_csDecode);
+        return DeliverOutputSample(pIn);
+    }
+
+    BOOL bDecodeThreadActive;
+    {
+        CAutoLock lock(&m_csInputQueue);
+        bDecodeThreadActive = m_bDecodeThreadActive;
     }
 
+    // QueueInputSample re-checks the state under the lock and falls back to synchronous decoding
+    if (bDecodeThreadActive)
+        return QueueInputSample(pIn);
+
+    CAutoLock cAutoLock(&m_csDecode);
+    return ProcessInputSample(pIn);
+}
+
+HRESULT CLAVAudio::ProcessInputSample(IMediaSample *pIn)
+{
+    HRESULT hr;
+
     AM_MEDIA_TYPE *pmt;
     if (SUCCEEDED(pIn->GetMediaType(&pmt)) && pmt)
     {
@@ -1821,6 +1982,7 @@ HRESULT CLAVAudio::Receive(IMediaSample *pIn)
         DeleteMediaType(pmt);
         pmt = nullptr;
         m_buff.Clear();
+        ResetSyncScanners();
 
         m_bQueueResync = TRUE;
     }
@@ -1862,6 +2024,7 @@ HRESULT CLAVAudio::Receive(IMediaSample *pIn)
     {
         DbgLog((LOG_ERROR, 10, L"::Receive(): Discontinuity, flushing decoder.."));
         m_buff.Clear();
+        ResetSyncScanners();
         FlushOutput(FALSE);
         FlushDecoder();
         m_bQueueResync = TRUE;
@@ -1923,13 +2086,21 @@ HRESULT CLAVAudio::Receive(IMediaSample *pIn)
     {
         DbgLog((LOG_TRACE, 10, L"Too much audio buffered, aborting"));
         m_buff.Clear();
+        ResetSyncScanners();
         m_bQueueResync = TRUE;
         return E_FAIL;
     }
 
-    m_buff.Allocate(bufflen + len + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (FAILED(m_buff.Allocate(bufflen + len + AV_INPUT_BUFFER_PADDING_SIZE)))
+    {
+        m_bQueueResync = TRUE;
+        return E_OUTOFMEMORY;
+    }
     m_buff.Append(pDataIn, len);
 
+    // the buffer is re-used after consuming data, so the padding needs to be cleared explicitly
+    memset(m_buff.Ptr() + m_buff.GetCount(), 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
     hr = ProcessBuffer(pIn);
 
     if (FAILED(hr))
@@ -1959,7 +2130,9 @@ HRESULT CLAVAudio::ResyncMPEGAudio()
     uint8_t *buf = m_buff.Ptr();
     int size = m_buff.GetCount();
 
-    for (int i = 0; i < (size - 3); i++)
+    // Offsets before the scanner position were rejected by previous calls already
+    int i, pending = -1;
+    while ((i = m_MPEGSyncScanner.Find(buf, size - 3)) >= 0)
     {
         uint32_t header, header2;
         int frame_size = check_mpegaudio_header(buf + i, &header);
@@ -1973,21 +2146,41 @@ HRESULT CLAVAudio::ResyncMPEGAudio()
                     DbgLog((LOG_TRACE, 10, L"CLAVAudio::ResyncMPEGAudio(): Skipping %d bytes of junk", i));
                     m_buff.Consume(i);
                 }
+                m_MPEGSyncScanner.Reset();
                 return S_OK;
             }
         }
+        else if (frame_size > 0 && pending < 0)
+        {
+            // The following frame is not available yet, check this header again once more data arrived
+            pending = i;
+        }
+        m_MPEGSyncScanner.SetPosition(i + 1);
     }
 
+    if (pending >= 0)
+        m_MPEGSyncScanner.SetPosition(pending);
+
     if (size > 64 * 1024)
     {
         DbgLog((LOG_TRACE, 10,
                 L"CLAVAudio::ResyncMPEGAudio(): No matching headers found in 64kb of data, aborting search"));
+        m_MPEGSyncScanner.Reset();
         return S_OK;
     }
 
     return S_FALSE;
 }
 
+// Check a DTS sync word candidate, 6 bytes need to be available
+static bool is_dts_sync_word(const uint8_t *p)
+{
+    const uint32_t state = AV_RB32(p);
+    return (state == DCA_MARKER_14B_LE && (p[4] & 0xF0) == 0xF0 && p[5] == 0x07) ||
+           (state == DCA_MARKER_14B_BE && p[4] == 0x07 && (p[5] & 0xF0) == 0xF0) || state == DCA_MARKER_RAW_LE ||
+           state == DCA_MARKER_RAW_BE;
+}
+
 HRESULT CLAVAudio::ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF)
 {
     HRESULT hr = S_OK, hr2 = S_OK;
@@ -2001,20 +2194,16 @@ HRESULT CLAVAudio::ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF)
     {
         if (m_bFindDTSInPCM)
         {
-            int i = 0, count = 0;
-            uint32_t state = -1;
-            for (i = 0; i < buffer_size; ++i)
+            // Only the data appended since the last call is scanned
+            int i;
+            while ((i = m_DTSSyncScanner.Find(p, buffer_size - 5)) >= 0)
             {
-                state = (state << 8) | p[i];
-                if ((state == DCA_MARKER_14B_LE && (i < buffer_size - 2) && (p[i + 1] & 0xF0) == 0xF0 &&
-                     p[i + 2] == 0x07) ||
-                    (state == DCA_MARKER_14B_BE && (i < buffer_size - 2) && p[i + 1] == 0x07 &&
-                     (p[i + 2] & 0xF0) == 0xF0) ||
-                    state == DCA_MARKER_RAW_LE || state == DCA_MARKER_RAW_BE)
-                {
-                    count++;
-                }
+                if (is_dts_sync_word(p + i))
+                    m_nDTSSyncWords++;
+                m_DTSSyncScanner.SetPosition(i + 1);
             }
+
+            const int count = m_nDTSSyncWords;
             if (count >= 4)
             {
                 DbgLog((LOG_TRACE, 10,
@@ -2100,7 +2289,7 @@ HRESULT CLAVAudio::ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF)
     }
 
     // If a bitstreaming context exists, we should bitstream
-    if (m_avBSContext)
+    if (m_bBitstreaming)
     {
         hr2 = Bitstream(p, buffer_size, consumed, &hr);
         if (FAILED(hr2))
@@ -2123,11 +2312,19 @@ HRESULT CLAVAudio::ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF)
     else
     {
         // Decoding
+        // The decoded frames are post-processed and delivered from within the decoder, those are accounted to their
+        // own stages
+        const LONGLONG llStart = CLAVAudioProcessingStats::Now();
+        const LONGLONG llNestedTicks = m_Stats.GetTicksFrom(LAVAudioStage_PostProcess);
+
         // Consume the buffer data
         if (m_pDTSDecoderContext)
             hr2 = DecodeDTS(p, buffer_size, consumed, &hr);
         else
             hr2 = Decode(p, buffer_size, consumed, &hr, pMediaSample);
+
+        m_Stats.AddTicks(LAVAudioStage_Decode, CLAVAudioProcessingStats::Now() - llStart -
+                                                   (m_Stats.GetTicksFrom(LAVAudioStage_PostProcess) - llNestedTicks));
         // FAILED - throw away the data
         if (FAILED(hr2))
         {
@@ -2567,6 +2764,10 @@ HRESULT CLAVAudio::GetDeliveryBuffer(IMediaSample **pSample, BYTE **pData)
 
 HRESULT CLAVAudio::QueueOutput(BufferDetails &buffer)
 {
+    const LONGLONG llStart = CLAVAudioProcessingStats::Now();
+    const LONGLONG llDeliverTicks = m_Stats.GetTicksFrom(LAVAudioStage_Deliver);
+    const unsigned nSamples = buffer.nSamples;
+
     HRESULT hr = S_OK;
     if (m_OutputQueue.wChannels != buffer.wChannels || m_OutputQueue.sfFormat != buffer.sfFormat ||
         m_OutputQueue.dwSamplesPerSec != buffer.dwSamplesPerSec ||
@@ -2612,16 +2813,24 @@ HRESULT CLAVAudio::QueueOutput(BufferDetails &buffer)
         hr = FlushOutput();
     }
 
+    m_Stats.AddTicks(LAVAudioStage_Queue, CLAVAudioProcessingStats::Now() - llStart -
+                                              (m_Stats.GetTicksFrom(LAVAudioStage_Deliver) - llDeliverTicks));
+    m_Stats.AddSamples(LAVAudioStage_Queue, nSamples);
+
     return hr;
 }
 
 HRESULT CLAVAudio::FlushOutput(BOOL bDeliver)
 {
-    CAutoLock cAutoLock(&m_csReceive);
+    CAutoLock cAutoLock(&m_csDecode);
 
     HRESULT hr = S_OK;
     if (bDeliver && m_OutputQueue.nSamples > 0)
+    {
+        const LONGLONG llStart = CLAVAudioProcessingStats::Now();
         hr = Deliver(m_OutputQueue);
+        m_Stats.Add(LAVAudioStage_Deliver, llStart, m_OutputQueue.nSamples);
+    }
 
     // Clear Queue
     m_OutputQueue.nSamples = 0;
@@ -2802,9 +3011,9 @@ HRESULT CLAVAudio::Deliver(BufferDetails &buffer)
 
     pOut->SetActualDataLength(buffer.bBuffer->GetCount());
 
-    memcpy(pDataOut, buffer.bBuffer->Ptr(), buffer.bBuffer->GetCount());
+    CopyOutputBuffer(buffer, pDataOut);
 
-    hr = m_pOutput->Deliver(pOut);
+    hr = DeliverOutputSample(pOut);
     if (FAILED(hr))
     {
         DbgLog((LOG_ERROR, 10, L"::Deliver failed with code: %0#.8x", hr));
@@ -21,13 +21,20 @@
 
 #include "LAVAudioSettings.h"
 #include "FloatingAverage.h"
+#include "VolumeStats.h"
+#include "Mixer.h"
+#include "Resampler.h"
+#include "SyncScanner.h"
 #include "Media.h"
 #include "BitstreamParser.h"
 #include "PostProcessor.h"
+#include "ProcessingStats.h"
 
 #include "ISpecifyPropertyPages2.h"
 #include "BaseTrayIcon.h"
 
+#include <deque>
+
 //////////////////// Configuration //////////////////////////
 
 // Buffer Size for decoded PCM: 1s of 192kHz 32-bit with 8 channels
@@ -43,6 +50,11 @@
 // Maximum desync that we attribute to jitter before re-syncing (10ms)
 #define MAX_JITTER_DESYNC 100000i64
 
+// Decode-ahead: number of input samples queued ahead of the decoder thread
+#define DECODE_AHEAD_INPUT_QUEUE 16
+// Decode-ahead: number of output buffers, to allow queueing samples towards the renderer
+#define DECODE_AHEAD_OUTPUT_BUFFERS 8
+
 //////////////////// End Configuration //////////////////////
 
 #define AV_CODEC_ID_PCM_SxxBE (AVCodecID)0x19001
@@ -75,11 +87,25 @@ struct BufferDetails
 
 struct DTSDecoder;
 
+// Output queue for decode-ahead mode, delivers samples on its own thread
+class CLAVAudioOutputQueue : public COutputQueue
+{
+  public:
+    CLAVAudioOutputQueue(IPin *pInputPin, HRESULT *phr) : COutputQueue(pInputPin, phr, FALSE, TRUE) {}
+
+    int GetQueueCount()
+    {
+        CAutoLock lock(this);
+        return m_List ? m_List->GetCount() : 0;
+    }
+};
+
 class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     : public CTransformFilter
     , public ISpecifyPropertyPages2
     , public ILAVAudioSettings
     , public ILAVAudioStatus
+    , protected CAMThread
 {
   public:
     CLAVAudio(LPUNKNOWN pUnk, HRESULT *phr);
@@ -137,6 +163,10 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     STDMETHODIMP_(BOOL) GetSuppressFormatChanges();
     STDMETHODIMP SetOutput51LegacyLayout(BOOL b51Legacy);
     STDMETHODIMP_(BOOL) GetOutput51LegacyLayout();
+    STDMETHODIMP_(BOOL) GetDecodeAhead();
+    STDMETHODIMP SetDecodeAhead(BOOL bDecodeAhead);
+    STDMETHODIMP_(DWORD) GetOutputSampleRate();
+    STDMETHODIMP SetOutputSampleRate(DWORD dwSampleRate);
 
     // ILAVAudioStatus
     STDMETHODIMP_(BOOL) IsSampleFormatSupported(LAVAudioSampleFormat sfCheck);
@@ -146,6 +176,9 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     STDMETHODIMP EnableVolumeStats();
     STDMETHODIMP DisableVolumeStats();
     STDMETHODIMP GetChannelVolumeAverage(WORD nChannel, float *pfDb);
+    STDMETHODIMP GetDecodeQueueDepth(int *pnInputQueue, int *pnOutputQueue);
+    STDMETHODIMP GetChannelVolumePeak(WORD nChannel, float *pfDb);
+    STDMETHODIMP GetProcessingStats(LAVAudioStage stage, ULONGLONG *pSamples, REFERENCE_TIME *prtTime);
 
     // CTransformFilter
     HRESULT CheckInputType(const CMediaType *mtIn);
@@ -156,6 +189,7 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     HRESULT Receive(IMediaSample *pIn);
 
     STDMETHODIMP JoinFilterGraph(IFilterGraph *pGraph, LPCWSTR pName);
+    STDMETHODIMP Stop();
 
     // Optional Overrides
     HRESULT CheckConnect(PIN_DIRECTION dir, IPin *pPin);
@@ -169,6 +203,9 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
 
     HRESULT BreakConnect(PIN_DIRECTION Dir);
 
+    HRESULT StartStreaming();
+    HRESULT StopStreaming();
+
   public:
     // Pin Configuration
     const static AMOVIESETUP_MEDIATYPE sudPinTypesIn[];
@@ -197,6 +234,7 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     CMediaType CreateMediaType(LAVAudioSampleFormat outputFormat, DWORD nSamplesPerSec, WORD nChannels,
                                DWORD dwChannelMask, WORD wBitsPerSample = 0) const;
     HRESULT ReconnectOutput(long cbBuffer, CMediaType &mt);
+    HRESULT ProcessInputSample(IMediaSample *pIn);
     HRESULT ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF = FALSE);
     HRESULT Decode(const BYTE *p, int buffsize, int &consumed, HRESULT *hrDeliver, IMediaSample *pMediaSample);
     HRESULT PostProcess(BufferDetails *buffer);
@@ -208,18 +246,35 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
 
     HRESULT PerformFlush();
     HRESULT Deliver(BufferDetails &buffer);
+    HRESULT DeliverOutputSample(IMediaSample *pSample);
+
+    // Decode-ahead
+    enum
+    {
+        CMD_EXIT
+    };
+    DWORD ThreadProc();
+
+    HRESULT StartDecodeThread();
+    HRESULT StopDecodeThread();
+    HRESULT QueueInputSample(IMediaSample *pIn);
+    void ClearInputQueue();
+    void WaitForDecodeIdle();
 
     void CreateBDLPCMHeader(BYTE *pBuf, const WAVEFORMATEX_HDMV_LPCM *wfex_lpcm) const;
     void CreateDVDLPCMHeader(BYTE *pBuf, const WAVEFORMATEX *wfex) const;
     HRESULT ParseRealAudioHeader(const BYTE *extra, const size_t extralen);
     HRESULT ResyncMPEGAudio();
+    void ResetSyncScanners()
+    {
+        m_DTSSyncScanner.Reset();
+        m_MPEGSyncScanner.Reset();
+        m_nDTSSyncWords = 0;
+    }
 
-    void UpdateVolumeStats(const BufferDetails &buffer);
+    void CopyOutputBuffer(const BufferDetails &buffer, BYTE *pDataOut);
 
     BOOL IsBitstreaming(AVCodecID codec);
-    HRESULT InitBitstreaming();
-    HRESULT ShutdownBitstreaming();
-    static int BSWriteBuffer(void *opaque, uint8_t *buf, int buf_size);
 
     HRESULT CreateBitstreamContext(AVCodecID codec, WAVEFORMATEX *wfe);
     HRESULT UpdateBitstreamContext();
@@ -229,6 +284,32 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     HRESULT Bitstream(const BYTE *p, int buffsize, int &consumed, HRESULT *hrDeliver);
     HRESULT DeliverBitstream(AVCodecID codec, const BYTE *buffer, DWORD dwSize, REFERENCE_TIME rtStartInput,
                              REFERENCE_TIME rtStopInput, BOOL bSwap = false);
+    HRESULT GetBitstreamBuffer(AVCodecID codec, DWORD dwSize, CMediaType &mt, IMediaSample **ppOut, BYTE **ppDataOut);
+    HRESULT DeliverBitstreamSample(IMediaSample *pOut, CMediaType &mt, BOOL bMediaTypeChanged, DWORD dwSize,
+                                   REFERENCE_TIME rtStartInput, REFERENCE_TIME rtStopInput);
+
+    // IEC 61937 data burst, written into the output sample by IEC61937WriteBurst
+    struct IEC61937Burst
+    {
+        WORD wDataType = 0;    // burst-info (Pc)
+        WORD wLengthCode = 0;  // length-code (Pd)
+        DWORD dwBurstSize = 0; // repetition period in bytes, including preamble and padding
+        BOOL bPreamble = TRUE;
+        BOOL bSwap = TRUE; // the payload is big-endian
+
+        BYTE header[12]; // big-endian header in front of the payload (DTS-HD)
+        DWORD dwHeaderSize = 0;
+
+        const BYTE *pPayload = nullptr;
+        DWORD dwPayloadSize = 0;
+    };
+
+    HRESULT IEC61937PrepareBurst(const BYTE *p, int buffsize, IEC61937Burst &burst);
+    HRESULT IEC61937BurstAC3(const BYTE *p, int buffsize, IEC61937Burst &burst);
+    HRESULT IEC61937BurstEAC3(const BYTE *p, int buffsize, IEC61937Burst &burst);
+    HRESULT IEC61937BurstDTS(const BYTE *p, int buffsize, IEC61937Burst &burst);
+    void IEC61937WriteBurst(const IEC61937Burst &burst, BYTE *pOut);
+    HRESULT DeliverIEC61937Burst(const IEC61937Burst &burst, REFERENCE_TIME rtStartInput, REFERENCE_TIME rtStopInput);
 
     HRESULT BitstreamTrueHD(const BYTE *p, int buffsize, HRESULT *hrDeliver);
     void MATWriteHeader();
@@ -259,6 +340,10 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     HRESULT PadTo32(BufferDetails *buffer);
 
     HRESULT PerformAVRProcessing(BufferDetails *buffer);
+    HRESULT PerformMixing(BufferDetails *buffer, DWORD dwMixingLayout, LAVAudioSampleFormat outputFormat,
+                          DWORD dwOutputRate);
+    DWORD GetTargetSampleRate(DWORD dwSampleRate, int nChannels) const;
+    HRESULT DrainResampler();
 
   private:
     AVCodecID m_nCodecId = AV_CODEC_ID_NONE;
@@ -280,7 +365,7 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     REFERENCE_TIME m_rtBitstreamCache = AV_NOPTS_VALUE;  // Bitstreaming time cache
     BOOL m_bUpdateTimeCache = TRUE;
 
-    GrowableArray<BYTE> m_buff; // Input Buffer
+    OffsetArray<BYTE> m_buff; // Input Buffer
     LAVAudioSampleFormat m_DecodeFormat = SampleFormat_16;
     LAVAudioSampleFormat m_MixingInputFormat = SampleFormat_None;
     LAVAudioSampleFormat m_FallbackFormat = SampleFormat_None;
@@ -294,6 +379,12 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     BOOL m_bAVResampleFailed = FALSE;
     BOOL m_bMixingSettingsChanged = FALSE;
 
+    CAudioMixer m_Mixer;
+    GrowableArray<BYTE> *m_pMixingBuffer = nullptr; // spare output buffer of the mixer
+    BOOL m_bMixingClipProtection = FALSE;
+
+    CAudioResampler m_Resampler;
+
     // Settings
     struct AudioSettings
     {
@@ -324,11 +415,17 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
         DWORD MixingLFELevel;
 
         BOOL SuppressFormatChanges;
+        BOOL DecodeAhead;
+        DWORD OutputSampleRate;
     } m_settings;
     BOOL m_bRuntimeConfig = FALSE;
 
     BOOL m_bVolumeStats = FALSE;          // Volume Stats gathering enabled
-    FloatingAverage<float> m_faVolume[8]; // Floating Average for volume (8 channels)
+    FloatingAverage<float> m_faVolume[LAV_VOLUME_STATS_CHANNELS];     // Floating Average for volume (8 channels)
+    FloatingAverage<float> m_faVolumePeak[LAV_VOLUME_STATS_CHANNELS]; // Peak volume of the recent buffers
+    CVolumeSnapshot m_VolumeSnapshot;                                 // Volume levels for the status interface
+
+    CLAVAudioProcessingStats m_Stats;
 
     BOOL m_bQueueResync = FALSE;
     BOOL m_bResyncTimestamp = FALSE;
@@ -336,8 +433,7 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     BOOL m_bJustFlushed = TRUE;
     BufferDetails m_OutputQueue;
 
-    AVIOContext *m_avioBitstream = nullptr;
-    AVFormatContext *m_avBSContext = nullptr;
+    BOOL m_bBitstreaming = FALSE;
     GrowableArray<BYTE> m_bsOutput;
     BOOL m_bBitStreamingSettingsChanged = FALSE;
     BOOL m_bBitstreamOverride[Bitstream_NB] = {FALSE};
@@ -349,6 +445,10 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     BOOL m_bDVDPlayback = FALSE;
     BOOL m_bMPEGAudioResync = FALSE;
 
+    CSyncScanner m_DTSSyncScanner{SyncPatternsDTS, countof(SyncPatternsDTS)};
+    CSyncScanner m_MPEGSyncScanner{SyncPatternsMPEGAudio, countof(SyncPatternsMPEGAudio)};
+    int m_nDTSSyncWords = 0;
+
     FloatingAverage<REFERENCE_TIME> m_faJitter{50};
     REFERENCE_TIME m_JitterLimit = MAX_JITTER_DESYNC;
 
@@ -368,6 +468,17 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     int m_ChannelMapOutputChannels = 0;
     DWORD m_ChannelMapOutputLayout = 0;
 
+    // AC3/E-AC3/DTS Bitstreaming
+    struct
+    {
+        int channels = 0; // input format
+        int sample_rate = 0;
+
+        DWORD dtshd_rate = 0;    // DTS type IV rate, or 0 for DTS core bursts
+        BOOL dtshd_skip = FALSE; // DTS-HD did not fit into the burst, only the core is sent
+        int eac3_frames = 0;     // E-AC3 frames collected in m_bsOutput
+    } m_IECState;
+
     // TrueHD Bitstreaming
     struct
     {
@@ -396,4 +507,19 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     } m_raData;
 
     CBaseTrayIcon *m_pTrayIcon = nullptr;
+
+    // Guards the decoder state, taken by the streaming thread and the decode-ahead thread
+    CCritSec m_csDecode;
+
+    // Decode-ahead, the queue, thread state and result are guarded by m_csInputQueue
+    CCritSec m_csInputQueue;
+    std::deque<IMediaSample *> m_InputQueue;
+    BOOL m_bDecodeThreadActive = FALSE;
+    BOOL m_bDecodeThreadBusy = FALSE;
+    CAMEvent m_evInputAvailable{TRUE};
+    CAMEvent m_evInputSpace;
+    CAMEvent m_evDecodeIdle{TRUE};
+    HRESULT m_hrDecodeThread = S_OK;
+
+    CLAVAudioOutputQueue *m_pOutputQueue = nullptr;
 };
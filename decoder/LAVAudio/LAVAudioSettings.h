@@ -94,6 +94,16 @@ typedef enum LAVAudioMixingMode
     MatrixEncoding_NB
 } LAVAudioMixingMode;
 
+// Processing stages reported by ILAVAudioStatus::GetProcessingStats
+typedef enum LAVAudioStage
+{
+    LAVAudioStage_Decode,      // decoding and interleaving into the decoded sample format
+    LAVAudioStage_PostProcess, // channel remapping, mixing and sample format conversion
+    LAVAudioStage_Queue,       // collecting the decoded frames into output buffers
+    LAVAudioStage_Deliver,     // delivery to the downstream filter, including waiting for output buffers
+    LAVAudioStage_NB
+} LAVAudioStage;
+
 // LAV Audio configuration interface
 interface __declspec(uuid("4158A22B-6553-45D0-8069-24716F8FF171")) ILAVAudioSettings : public IUnknown
 {
@@ -199,6 +209,16 @@ interface __declspec(uuid("4158A22B-6553-45D0-8069-24716F8FF171")) ILAVAudioSett
     // Fallback to audio decoding if bitstreaming is not supported by the audio renderer/hardware
     STDMETHOD_(BOOL, GetBitstreamingFallback)() = 0;
     STDMETHOD(SetBitstreamingFallback)(BOOL bBitstreamingFallback) = 0;
+
+    // Decode-ahead mode: decode and deliver on worker threads, decoupled from the upstream streaming thread
+    // Changes take effect the next time playback is started
+    STDMETHOD_(BOOL, GetDecodeAhead)() = 0;
+    STDMETHOD(SetDecodeAhead)(BOOL bDecodeAhead) = 0;
+
+    // Fixed output sample rate: resample all decoded audio to the given rate (8000 - 192000 Hz), together with mixing
+    // A rate of 0 disables resampling, and the audio is output at its source rate (default)
+    STDMETHOD_(DWORD, GetOutputSampleRate)() = 0;
+    STDMETHOD(SetOutputSampleRate)(DWORD dwSampleRate) = 0;
 };
 
 // LAV Audio Status Interface
@@ -223,4 +243,16 @@ interface __declspec(uuid("A668B8F2-BA87-4F63-9D41-768F7DE9C50E")) ILAVAudioStat
 
     // Get Volume Average for the given channel
     STDMETHOD(GetChannelVolumeAverage)(WORD nChannel, float *pfDb) = 0;
+
+    // Get the number of samples waiting in the decode-ahead queues
+    // Returns S_FALSE if decode-ahead is not active
+    STDMETHOD(GetDecodeQueueDepth)(int *pnInputQueue, int *pnOutputQueue) = 0;
+
+    // Get the peak volume of the given channel over the recent buffers
+    STDMETHOD(GetChannelVolumePeak)(WORD nChannel, float *pfDb) = 0;
+
+    // Get the processing statistics of a stage since streaming was started
+    // pSamples receives the number of samples (per channel) processed by the stage, prtTime the time spent in it
+    // (in 100ns units). Bitstreamed audio is not included.
+    STDMETHOD(GetProcessingStats)(LAVAudioStage stage, ULONGLONG * pSamples, REFERENCE_TIME * prtTime) = 0;
 };
@@ -534,69 +534,39 @@ HRESULT CLAVAudio::ParseRealAudioHeader(const BYTE *extra, const size_t extralen
     return S_OK;
 }
 
-// Gets a sample from the buffer for processing
-// The sample is returned as a floating point, with either single or double precision, depending on the template type
-// DO NOT USE WITH AN INTEGER TYPE - only double and float are allowed
-template <class T> T get_sample_from_buffer(const BYTE *const pBuffer, LAVAudioSampleFormat sfFormat)
+// Copies the buffer into the output sample
+// When volume statistics are enabled, the RMS and peak level of every channel are measured in the same pass,
+// converted into reference dB values, and published for the status interface
+void CLAVAudio::CopyOutputBuffer(const BufferDetails &buffer, BYTE *pDataOut)
 {
-    T fSample = 0.0;
-    switch (sfFormat)
+    float fSumSquares[LAV_VOLUME_STATS_CHANNELS], fPeak[LAV_VOLUME_STATS_CHANNELS];
+    if (!m_bVolumeStats || !lav_copy_volume_stats(pDataOut, buffer.bBuffer->Ptr(), buffer.nSamples, buffer.wChannels,
+                                                  buffer.sfFormat, fSumSquares, fPeak))
     {
-    case SampleFormat_U8:
-        fSample = (T)(*(uint8_t *)pBuffer);
-        fSample = (fSample + INT8_MIN) / INT8_MAX;
-        break;
-    case SampleFormat_16:
-        fSample = (T)(*(int16_t *)pBuffer);
-        fSample /= INT16_MAX;
-        break;
-    case SampleFormat_24:
-        fSample += pBuffer[0] << 8;
-        fSample += pBuffer[1] << 16;
-        fSample += pBuffer[2] << 24;
-        fSample /= INT32_MAX;
-        break;
-    case SampleFormat_32:
-        fSample = (T)(*(int32_t *)pBuffer);
-        fSample /= INT32_MAX;
-        break;
-    case SampleFormat_FP32: fSample = (T) * (float *)pBuffer; break;
+        memcpy(pDataOut, buffer.bBuffer->Ptr(), buffer.bBuffer->GetCount());
+        return;
     }
-    return fSample;
-}
 
-// This function calculates the Root mean square (RMS) of all samples in the buffer,
-// converts the result into a reference dB value, and adds it to the volume floating average
-void CLAVAudio::UpdateVolumeStats(const BufferDetails &buffer)
-{
-    const BYTE bSampleSize = get_byte_per_sample(buffer.sfFormat);
-    const DWORD dwSamplesPerChannel = buffer.nSamples;
-    const BYTE *pBuffer = buffer.bBuffer->Ptr();
-    float *const fChAvg = (float *)calloc(buffer.wChannels, sizeof(float));
-    for (DWORD i = 0; i < dwSamplesPerChannel; ++i)
+    float fAverage[LAV_VOLUME_STATS_CHANNELS], fPeakHold[LAV_VOLUME_STATS_CHANNELS];
+    for (WORD ch = 0; ch < buffer.wChannels; ++ch)
     {
-        for (WORD ch = 0; ch < buffer.wChannels; ++ch)
+        if (fSumSquares[ch] > FLT_EPSILON)
         {
-            const float fSample = get_sample_from_buffer<float>(pBuffer, buffer.sfFormat);
-            fChAvg[ch] += fSample * fSample;
-            pBuffer += bSampleSize;
-        }
-    }
-
-    for (int ch = 0; ch < buffer.wChannels; ++ch)
-    {
-        if (fChAvg[ch] > FLT_EPSILON)
-        {
-            const float fAvgSqrt = sqrt(fChAvg[ch] / dwSamplesPerChannel);
-            const float fDb = 20.0f * log10(fAvgSqrt);
-            m_faVolume[ch].Sample(fDb);
+            const float fAvgSqrt = sqrt(fSumSquares[ch] / buffer.nSamples);
+            m_faVolume[ch].Sample(20.0f * log10(fAvgSqrt));
         }
         else
         {
             m_faVolume[ch].Sample(-100.0f);
         }
+
+        m_faVolumePeak[ch].Sample(fPeak[ch] > FLT_EPSILON ? max(20.0f * log10(fPeak[ch]), -100.0f) : -100.0f);
+
+        fAverage[ch] = m_faVolume[ch].Average();
+        fPeakHold[ch] = m_faVolumePeak[ch].Maximum();
     }
-    free(fChAvg);
+
+    m_VolumeSnapshot.Publish(buffer.wChannels, fAverage, fPeakHold);
 }
 
 #define MAX_SPEAKER_LAYOUT 18
@@ -0,0 +1,613 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "Mixer.h"
+
+#include <immintrin.h>
+
+extern "C"
+{
+#include "libavutil/common.h"
+#include "libavutil/cpu.h"
+#include "libavutil/intreadwrite.h"
+}
+
+// number of samples the dither noise is generated for at once
+#define LAV_MIXER_DITHER_BLOCK 1024
+
+// Sample loaders
+// Every loader reads one sample and returns it as a normalized float
+
+struct MixLoaderU8
+{
+    static const unsigned SampleSize = 1;
+    static __forceinline float Load(const BYTE *p) { return (float)(*p + INT8_MIN) * (1.0f / 128.0f); }
+};
+
+struct MixLoaderS16
+{
+    static const unsigned SampleSize = 2;
+    static __forceinline float Load(const BYTE *p) { return (float)*(const int16_t *)p * (1.0f / 32768.0f); }
+};
+
+struct MixLoaderS24
+{
+    static const unsigned SampleSize = 3;
+    static __forceinline float Load(const BYTE *p)
+    {
+        return (float)(int32_t)((p[0] << 8) | (p[1] << 16) | (p[2] << 24)) * (1.0f / 2147483648.0f);
+    }
+};
+
+struct MixLoaderS32
+{
+    static const unsigned SampleSize = 4;
+    static __forceinline float Load(const BYTE *p) { return (float)*(const int32_t *)p * (1.0f / 2147483648.0f); }
+};
+
+struct MixLoaderFP32
+{
+    static const unsigned SampleSize = 4;
+    static __forceinline float Load(const BYTE *p) { return *(const float *)p; }
+};
+
+// Every input channel is broadcast and multiplied with its column of the matrix, which holds the coefficients for
+// all output channels. Up to 4 output channels fit in one vector, up to 8 in two.
+// The full vectors are stored even if there are fewer output channels, the next sample overwrites the excess.
+// nInChannels is a template parameter for the common layouts (5.1 and 7.1), so the loop can be unrolled
+template <class Loader, unsigned nFixedInChannels, unsigned nOutVectors>
+static void mix_matrix(float *pOut, const BYTE *pIn, unsigned nSamples, unsigned nInChannels, unsigned nOutChannels,
+                       const float (*matrix)[LAV_MIXER_MAX_OUT_CHANNELS])
+{
+    if (nFixedInChannels)
+        nInChannels = nFixedInChannels;
+
+    for (unsigned i = 0; i < nSamples; ++i)
+    {
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        for (unsigned ch = 0; ch < nInChannels; ++ch)
+        {
+            const __m128 s = _mm_set1_ps(Loader::Load(pIn));
+            pIn += Loader::SampleSize;
+
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(s, _mm_loadu_ps(matrix[ch])));
+            if (nOutVectors > 1)
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(s, _mm_loadu_ps(matrix[ch] + 4)));
+        }
+
+        _mm_storeu_ps(pOut, acc0);
+        if (nOutVectors > 1)
+            _mm_storeu_ps(pOut + 4, acc1);
+        pOut += nOutChannels;
+    }
+}
+
+// AVX2 version for up to 8 output channels, which all fit into one vector
+template <class Loader, unsigned nFixedInChannels>
+static void mix_matrix_avx2(float *pOut, const BYTE *pIn, unsigned nSamples, unsigned nInChannels,
+                            unsigned nOutChannels, const float (*matrix)[LAV_MIXER_MAX_OUT_CHANNELS])
+{
+    if (nFixedInChannels)
+        nInChannels = nFixedInChannels;
+
+    for (unsigned i = 0; i < nSamples; ++i)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        for (unsigned ch = 0; ch < nInChannels; ++ch)
+        {
+            const __m256 s = _mm256_set1_ps(Loader::Load(pIn));
+            pIn += Loader::SampleSize;
+
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(s, _mm256_loadu_ps(matrix[ch])));
+        }
+
+        _mm256_storeu_ps(pOut, acc);
+        pOut += nOutChannels;
+    }
+}
+
+// AVX2 version for up to 4 output channels, which mixes two samples at once, one in each 128-bit lane
+// The second sample is stored last, so it overwrites the excess of the first one
+template <class Loader, unsigned nFixedInChannels>
+static void mix_matrix_avx2_pairs(float *pOut, const BYTE *pIn, unsigned nSamples, unsigned nInChannels,
+                                  unsigned nOutChannels, const float (*matrix)[LAV_MIXER_MAX_OUT_CHANNELS])
+{
+    if (nFixedInChannels)
+        nInChannels = nFixedInChannels;
+
+    const unsigned nInStride = nInChannels * Loader::SampleSize;
+
+    unsigned i = 0;
+    for (; i + 2 <= nSamples; i += 2)
+    {
+        __m256 acc = _mm256_setzero_ps();
+        for (unsigned ch = 0; ch < nInChannels; ++ch)
+        {
+            const __m256 s = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(Loader::Load(pIn))),
+                                                  _mm_set1_ps(Loader::Load(pIn + nInStride)), 1);
+            pIn += Loader::SampleSize;
+
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(s, _mm256_broadcast_ps((const __m128 *)matrix[ch])));
+        }
+
+        _mm_storeu_ps(pOut, _mm256_castps256_ps128(acc));
+        _mm_storeu_ps(pOut + nOutChannels, _mm256_extractf128_ps(acc, 1));
+        pIn += nInStride;
+        pOut += 2 * nOutChannels;
+    }
+
+    if (i < nSamples)
+        mix_matrix<Loader, nFixedInChannels, 1>(pOut, pIn, nSamples - i, nInChannels, nOutChannels, matrix);
+}
+
+template <class Loader, unsigned nOutVectors>
+static void mix_matrix_layout(float *pOut, const BYTE *pIn, unsigned nSamples, unsigned nInChannels,
+                              unsigned nOutChannels, const float (*matrix)[LAV_MIXER_MAX_OUT_CHANNELS])
+{
+    switch (nInChannels)
+    {
+    case 6: mix_matrix<Loader, 6, nOutVectors>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix); break;
+    case 8: mix_matrix<Loader, 8, nOutVectors>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix); break;
+    default: mix_matrix<Loader, 0, nOutVectors>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix); break;
+    }
+}
+
+template <class Loader, bool bPairs>
+static void mix_matrix_layout_avx2(float *pOut, const BYTE *pIn, unsigned nSamples, unsigned nInChannels,
+                                   unsigned nOutChannels, const float (*matrix)[LAV_MIXER_MAX_OUT_CHANNELS])
+{
+    switch (nInChannels)
+    {
+    case 6:
+        (bPairs ? mix_matrix_avx2_pairs<Loader, 6> : mix_matrix_avx2<Loader, 6>)(pOut, pIn, nSamples, nInChannels,
+                                                                                 nOutChannels, matrix);
+        break;
+    case 8:
+        (bPairs ? mix_matrix_avx2_pairs<Loader, 8> : mix_matrix_avx2<Loader, 8>)(pOut, pIn, nSamples, nInChannels,
+                                                                                 nOutChannels, matrix);
+        break;
+    default:
+        (bPairs ? mix_matrix_avx2_pairs<Loader, 0> : mix_matrix_avx2<Loader, 0>)(pOut, pIn, nSamples, nInChannels,
+                                                                                 nOutChannels, matrix);
+        break;
+    }
+}
+
+template <class Loader>
+static void mix_matrix_format(float *pOut, const BYTE *pIn, unsigned nSamples, unsigned nInChannels,
+                              unsigned nOutChannels, const float (*matrix)[LAV_MIXER_MAX_OUT_CHANNELS], bool bAVX2)
+{
+    if (bAVX2 && nOutChannels <= 4)
+        mix_matrix_layout_avx2<Loader, true>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix);
+    else if (bAVX2)
+        mix_matrix_layout_avx2<Loader, false>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix);
+    else if (nOutChannels <= 4)
+        mix_matrix_layout<Loader, 1>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix);
+    else
+        mix_matrix_layout<Loader, 2>(pOut, pIn, nSamples, nInChannels, nOutChannels, matrix);
+}
+
+// Without mixing, the samples are only converted to float
+template <class Loader>
+static void mix_identity(float *pOut, const BYTE *pIn, size_t nCount)
+{
+    for (size_t i = 0; i < nCount; ++i)
+        pOut[i] = Loader::Load(pIn + i * Loader::SampleSize);
+}
+
+CAudioMixer::CAudioMixer()
+{
+    m_CPUFlags = av_get_cpu_flags();
+
+    // fixed seeds, every generator needs a different non-zero state
+    for (int i = 0; i < _countof(m_DitherState); ++i)
+        m_DitherState[i] = 0x9e3779b9u * (i + 1);
+    memset(m_DitherHistory, 0, sizeof(m_DitherHistory));
+}
+
+void CAudioMixer::Reset()
+{
+    m_nInChannels = m_nOutChannels = 0;
+    m_bIdentity = false;
+    memset(m_DitherHistory, 0, sizeof(m_DitherHistory));
+}
+
+bool CAudioMixer::SetMatrix(const double *pMatrix, int nStride, unsigned nInChannels, unsigned nOutChannels)
+{
+    Reset();
+
+    if (nInChannels == 0 || nInChannels > LAV_MIXER_MAX_IN_CHANNELS || nOutChannels == 0 ||
+        nOutChannels > LAV_MIXER_MAX_OUT_CHANNELS)
+        return false;
+
+    bool bIdentity = (nInChannels == nOutChannels);
+
+    memset(m_Matrix, 0, sizeof(m_Matrix));
+    for (unsigned out = 0; out < nOutChannels; ++out)
+    {
+        for (unsigned in = 0; in < nInChannels; ++in)
+        {
+            m_Matrix[in][out] = (float)pMatrix[out * nStride + in];
+            bIdentity = bIdentity && m_Matrix[in][out] == (in == out ? 1.0f : 0.0f);
+        }
+    }
+
+    m_nInChannels = nInChannels;
+    m_nOutChannels = nOutChannels;
+    m_bIdentity = bIdentity;
+    m_fGain = 1.0f;
+
+    return true;
+}
+
+bool CAudioMixer::IsFormatSupported(LAVAudioSampleFormat sfFormat)
+{
+    switch (sfFormat)
+    {
+    case SampleFormat_U8:
+    case SampleFormat_16:
+    case SampleFormat_24:
+    case SampleFormat_32:
+    case SampleFormat_FP32: return true;
+    }
+    return false;
+}
+
+bool CAudioMixer::IsOutputFormatSupported(LAVAudioSampleFormat sfFormat)
+{
+    switch (sfFormat)
+    {
+    case SampleFormat_16:
+    case SampleFormat_24:
+    case SampleFormat_32:
+    case SampleFormat_FP32: return true;
+    }
+    return false;
+}
+
+void CAudioMixer::Mix(float *pOut, const BYTE *pIn, unsigned nSamples, LAVAudioSampleFormat sfFormat) const
+{
+    ASSERT(IsValid());
+    if (nSamples == 0)
+        return;
+
+    if (m_bIdentity)
+    {
+        const size_t nCount = (size_t)nSamples * m_nOutChannels;
+        switch (sfFormat)
+        {
+        case SampleFormat_U8: mix_identity<MixLoaderU8>(pOut, pIn, nCount); break;
+        case SampleFormat_16: mix_identity<MixLoaderS16>(pOut, pIn, nCount); break;
+        case SampleFormat_24: mix_identity<MixLoaderS24>(pOut, pIn, nCount); break;
+        case SampleFormat_32: mix_identity<MixLoaderS32>(pOut, pIn, nCount); break;
+        case SampleFormat_FP32: memcpy(pOut, pIn, nCount * sizeof(float)); break;
+        default: ASSERT(0); break;
+        }
+        return;
+    }
+
+    const bool bAVX2 = !!(m_CPUFlags & AV_CPU_FLAG_AVX2);
+    switch (sfFormat)
+    {
+    case SampleFormat_U8:
+        mix_matrix_format<MixLoaderU8>(pOut, pIn, nSamples, m_nInChannels, m_nOutChannels, m_Matrix, bAVX2);
+        break;
+    case SampleFormat_16:
+        mix_matrix_format<MixLoaderS16>(pOut, pIn, nSamples, m_nInChannels, m_nOutChannels, m_Matrix, bAVX2);
+        break;
+    case SampleFormat_24:
+        mix_matrix_format<MixLoaderS24>(pOut, pIn, nSamples, m_nInChannels, m_nOutChannels, m_Matrix, bAVX2);
+        break;
+    case SampleFormat_32:
+        mix_matrix_format<MixLoaderS32>(pOut, pIn, nSamples, m_nInChannels, m_nOutChannels, m_Matrix, bAVX2);
+        break;
+    case SampleFormat_FP32:
+        mix_matrix_format<MixLoaderFP32>(pOut, pIn, nSamples, m_nInChannels, m_nOutChannels, m_Matrix, bAVX2);
+        break;
+    default: ASSERT(0); break;
+    }
+}
+
+float CAudioMixer::ClipProtection(float *pSamples, size_t nCount)
+{
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 peak4 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= nCount; i += 4)
+        peak4 = _mm_max_ps(peak4, _mm_and_ps(_mm_loadu_ps(pSamples + i), absmask));
+
+    float fPeaks[4];
+    _mm_storeu_ps(fPeaks, peak4);
+    float fPeak = max(max(fPeaks[0], fPeaks[1]), max(fPeaks[2], fPeaks[3]));
+    for (; i < nCount; ++i)
+        fPeak = max(fPeak, fabsf(pSamples[i]));
+
+    if (fPeak <= 1.0f)
+        return m_fGain;
+
+    // scale the matrix down so that these samples would just reach full scale
+    const float fScale = 1.0f / fPeak;
+    m_fGain *= fScale;
+    DbgLog((LOG_TRACE, 10, L"CAudioMixer::ClipProtection(): Peak of %.3f, reducing the gain to %.3f", fPeak, m_fGain));
+    for (unsigned in = 0; in < m_nInChannels; ++in)
+    {
+        for (unsigned out = 0; out < m_nOutChannels; ++out)
+            m_Matrix[in][out] *= fScale;
+    }
+    m_bIdentity = false;
+
+    const __m128 scale4 = _mm_set1_ps(fScale);
+    for (i = 0; i + 4 <= nCount; i += 4)
+        _mm_storeu_ps(pSamples + i, _mm_mul_ps(_mm_loadu_ps(pSamples + i), scale4));
+    for (; i < nCount; ++i)
+        pSamples[i] *= fScale;
+
+    return m_fGain;
+}
+
+// Sample converters
+// The dither noise, if any, is added after scaling to the output range. pNoise holds the uniform noise of the previous
+// nChannels samples followed by that of the samples to convert, the difference of both is the high-pass filtered
+// triangular noise of every channel.
+
+static __forceinline __m128 dither_sse2(__m128 v, const float *pNoise, unsigned nChannels, size_t i)
+{
+    return _mm_add_ps(v, _mm_sub_ps(_mm_loadu_ps(pNoise + nChannels + i), _mm_loadu_ps(pNoise + i)));
+}
+
+static __forceinline __m256 dither_avx2(__m256 v, const float *pNoise, unsigned nChannels, size_t i)
+{
+    return _mm256_add_ps(v, _mm256_sub_ps(_mm256_loadu_ps(pNoise + nChannels + i), _mm256_loadu_ps(pNoise + i)));
+}
+
+static __forceinline float convert_scalar(const float *pSrc, size_t i, float scale, float min, float max,
+                                          const float *pNoise, unsigned nChannels)
+{
+    float v = pSrc[i] * scale;
+    if (pNoise)
+        v += pNoise[nChannels + i] - pNoise[i];
+    return av_clipf(v, min, max);
+}
+
+static void convert_s16_sse2(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise, unsigned nChannels)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 vmin = _mm_set1_ps(-32768.0f), vmax = _mm_set1_ps(32767.0f);
+    int16_t *pOut = (int16_t *)pDst;
+
+    size_t i = 0;
+    for (; i + 8 <= nCount; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(pSrc + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(pSrc + i + 4), scale);
+        if (pNoise)
+        {
+            a = dither_sse2(a, pNoise, nChannels, i);
+            b = dither_sse2(b, pNoise, nChannels, i + 4);
+        }
+        a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+        b = _mm_min_ps(_mm_max_ps(b, vmin), vmax);
+        _mm_storeu_si128((__m128i *)(pOut + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    for (; i < nCount; ++i)
+        pOut[i] = (int16_t)lrintf(convert_scalar(pSrc, i, 32768.0f, -32768.0f, 32767.0f, pNoise, nChannels));
+}
+
+// Same as the SSE2 version, with 16 samples at a time
+// The pack works within each 128-bit lane, so the 64-bit blocks are put back in order afterwards
+static void convert_s16_avx2(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise, unsigned nChannels)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 vmin = _mm256_set1_ps(-32768.0f), vmax = _mm256_set1_ps(32767.0f);
+    int16_t *pOut = (int16_t *)pDst;
+
+    size_t i = 0;
+    for (; i + 16 <= nCount; i += 16)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(pSrc + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(pSrc + i + 8), scale);
+        if (pNoise)
+        {
+            a = dither_avx2(a, pNoise, nChannels, i);
+            b = dither_avx2(b, pNoise, nChannels, i + 8);
+        }
+        a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+        b = _mm256_min_ps(_mm256_max_ps(b, vmin), vmax);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i *)(pOut + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    if (i < nCount)
+        convert_s16_sse2((BYTE *)(pOut + i), pSrc + i, nCount - i, pNoise ? pNoise + i : nullptr, nChannels);
+}
+
+// Pack the low 24 bits of the 4 32-bit samples into 12 bytes
+static __forceinline void store_s24_sse2(BYTE *pOut, __m128i v)
+{
+    const __m128i maskEven = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+    const __m128i maskOdd = _mm_set_epi32(0x00ffffff, 0, 0x00ffffff, 0);
+
+    // 6 bytes in every 64-bit half
+    v = _mm_or_si128(_mm_and_si128(v, maskEven), _mm_srli_epi64(_mm_and_si128(v, maskOdd), 8));
+    // move the upper 6 bytes down next to the lower ones
+    v = _mm_or_si128(_mm_move_epi64(v), _mm_slli_si128(_mm_srli_si128(v, 8), 6));
+
+    _mm_storel_epi64((__m128i *)pOut, v);
+    AV_WN32(pOut + 8, _mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+}
+
+static void convert_s24_sse2(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise, unsigned nChannels)
+{
+    const __m128 scale = _mm_set1_ps(8388608.0f);
+    const __m128 vmin = _mm_set1_ps(-8388608.0f), vmax = _mm_set1_ps(8388607.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= nCount; i += 4)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(pSrc + i), scale);
+        if (pNoise)
+            a = dither_sse2(a, pNoise, nChannels, i);
+        a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+        store_s24_sse2(pDst + i * 3, _mm_cvtps_epi32(a));
+    }
+    for (; i < nCount; ++i)
+    {
+        const int32_t v = lrintf(convert_scalar(pSrc, i, 8388608.0f, -8388608.0f, 8388607.0f, pNoise, nChannels));
+        AV_WL16(pDst + i * 3, v);
+        pDst[i * 3 + 2] = (BYTE)(v >> 16);
+    }
+}
+
+static void convert_s24_avx2(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise, unsigned nChannels)
+{
+    const __m256 scale = _mm256_set1_ps(8388608.0f);
+    const __m256 vmin = _mm256_set1_ps(-8388608.0f), vmax = _mm256_set1_ps(8388607.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= nCount; i += 8)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(pSrc + i), scale);
+        if (pNoise)
+            a = dither_avx2(a, pNoise, nChannels, i);
+        a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+
+        const __m256i v = _mm256_cvtps_epi32(a);
+        store_s24_sse2(pDst + i * 3, _mm256_castsi256_si128(v));
+        store_s24_sse2(pDst + i * 3 + 12, _mm256_extracti128_si256(v, 1));
+    }
+    if (i < nCount)
+        convert_s24_sse2(pDst + i * 3, pSrc + i, nCount - i, pNoise ? pNoise + i : nullptr, nChannels);
+}
+
+// 2147483520.0f is the largest float below 2^31
+static void convert_s32_sse2(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise, unsigned nChannels)
+{
+    const __m128 scale = _mm_set1_ps(2147483648.0f);
+    const __m128 vmin = _mm_set1_ps(-2147483648.0f), vmax = _mm_set1_ps(2147483520.0f);
+    int32_t *pOut = (int32_t *)pDst;
+
+    size_t i = 0;
+    for (; i + 4 <= nCount; i += 4)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(pSrc + i), scale);
+        if (pNoise)
+            a = dither_sse2(a, pNoise, nChannels, i);
+        a = _mm_min_ps(_mm_max_ps(a, vmin), vmax);
+        _mm_storeu_si128((__m128i *)(pOut + i), _mm_cvtps_epi32(a));
+    }
+    for (; i < nCount; ++i)
+        pOut[i] = lrintf(convert_scalar(pSrc, i, 2147483648.0f, -2147483648.0f, 2147483520.0f, pNoise, nChannels));
+}
+
+static void convert_s32_avx2(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise, unsigned nChannels)
+{
+    const __m256 scale = _mm256_set1_ps(2147483648.0f);
+    const __m256 vmin = _mm256_set1_ps(-2147483648.0f), vmax = _mm256_set1_ps(2147483520.0f);
+    int32_t *pOut = (int32_t *)pDst;
+
+    size_t i = 0;
+    for (; i + 8 <= nCount; i += 8)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(pSrc + i), scale);
+        if (pNoise)
+            a = dither_avx2(a, pNoise, nChannels, i);
+        a = _mm256_min_ps(_mm256_max_ps(a, vmin), vmax);
+        _mm256_storeu_si256((__m256i *)(pOut + i), _mm256_cvtps_epi32(a));
+    }
+    if (i < nCount)
+        convert_s32_sse2((BYTE *)(pOut + i), pSrc + i, nCount - i, pNoise ? pNoise + i : nullptr, nChannels);
+}
+
+// Uniform noise in [-0.5, 0.5), from 8 xorshift generators running side by side
+// nCount is rounded up to a multiple of 8
+void CAudioMixer::GenerateDither(float *pNoise, size_t nCount)
+{
+    const __m128i exponent = _mm_set1_epi32(0x3f800000);
+    const __m128 offset = _mm_set1_ps(1.5f);
+
+    __m128i state0 = _mm_loadu_si128((const __m128i *)m_DitherState);
+    __m128i state1 = _mm_loadu_si128((const __m128i *)(m_DitherState + 4));
+    for (size_t i = 0; i < nCount; i += 8)
+    {
+        state0 = _mm_xor_si128(state0, _mm_slli_epi32(state0, 13));
+        state1 = _mm_xor_si128(state1, _mm_slli_epi32(state1, 13));
+        state0 = _mm_xor_si128(state0, _mm_srli_epi32(state0, 17));
+        state1 = _mm_xor_si128(state1, _mm_srli_epi32(state1, 17));
+        state0 = _mm_xor_si128(state0, _mm_slli_epi32(state0, 5));
+        state1 = _mm_xor_si128(state1, _mm_slli_epi32(state1, 5));
+
+        // the upper 23 bits become the mantissa of a float in [1, 2)
+        const __m128 r0 = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state0, 9), exponent));
+        const __m128 r1 = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state1, 9), exponent));
+        _mm_storeu_ps(pNoise + i, _mm_sub_ps(r0, offset));
+        _mm_storeu_ps(pNoise + i + 4, _mm_sub_ps(r1, offset));
+    }
+    _mm_storeu_si128((__m128i *)m_DitherState, state0);
+    _mm_storeu_si128((__m128i *)(m_DitherState + 4), state1);
+}
+
+void CAudioMixer::Convert(BYTE *pDst, const float *pSrc, unsigned nSamples, LAVAudioSampleFormat sfFormat,
+                          bool bDither)
+{
+    ASSERT(IsValid());
+
+    typedef void (*ConvertFunc)(BYTE *pDst, const float *pSrc, size_t nCount, const float *pNoise,
+                                unsigned nChannels);
+
+    const bool bAVX2 = !!(m_CPUFlags & AV_CPU_FLAG_AVX2);
+    ConvertFunc convert = nullptr;
+    size_t nSampleSize = 0;
+    switch (sfFormat)
+    {
+    case SampleFormat_16:
+        convert = bAVX2 ? convert_s16_avx2 : convert_s16_sse2;
+        nSampleSize = 2;
+        break;
+    case SampleFormat_24:
+        convert = bAVX2 ? convert_s24_avx2 : convert_s24_sse2;
+        nSampleSize = 3;
+        break;
+    case SampleFormat_32:
+        convert = bAVX2 ? convert_s32_avx2 : convert_s32_sse2;
+        nSampleSize = 4;
+        break;
+    default: ASSERT(0); return;
+    }
+
+    const size_t nCount = (size_t)nSamples * m_nOutChannels;
+    if (!bDither)
+    {
+        convert(pDst, pSrc, nCount, nullptr, 0);
+        return;
+    }
+
+    // the noise is generated in blocks, with the noise of the last sample of every channel in front of it
+    const unsigned nChannels = m_nOutChannels;
+    float noise[LAV_MIXER_MAX_OUT_CHANNELS + LAV_MIXER_DITHER_BLOCK];
+    for (size_t i = 0; i < nCount; i += LAV_MIXER_DITHER_BLOCK)
+    {
+        const size_t nBlock = min(nCount - i, (size_t)LAV_MIXER_DITHER_BLOCK);
+        memcpy(noise, m_DitherHistory, nChannels * sizeof(float));
+        GenerateDither(noise + nChannels, nBlock);
+        memcpy(m_DitherHistory, noise + nBlock, nChannels * sizeof(float));
+
+        convert(pDst + i * nSampleSize, pSrc + i, nBlock, noise, nChannels);
+    }
+}
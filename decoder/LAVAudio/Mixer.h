@@ -0,0 +1,78 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVAudioSettings.h"
+
+#define LAV_MIXER_MAX_IN_CHANNELS 32
+#define LAV_MIXER_MAX_OUT_CHANNELS 8
+
+// Mixes interleaved PCM samples through a channel matrix into interleaved float samples, and converts those to the
+// output sample format
+class CAudioMixer
+{
+  public:
+    CAudioMixer();
+
+    // Select the kernels for the given AV_CPU_FLAG_* flags, by default those of the CPU are used
+    void SetCPUFlags(int flags) { m_CPUFlags = flags; }
+
+    // Set the matrix, with one row of nInChannels coefficients per output channel, nStride apart
+    bool SetMatrix(const double *pMatrix, int nStride, unsigned nInChannels, unsigned nOutChannels);
+    void Reset();
+
+    bool IsValid() const { return m_nOutChannels != 0; }
+    unsigned GetOutChannels() const { return m_nOutChannels; }
+
+    // Check if the input format can be mixed
+    static bool IsFormatSupported(LAVAudioSampleFormat sfFormat);
+    // Check if the mixed samples can be converted to the output format
+    static bool IsOutputFormatSupported(LAVAudioSampleFormat sfFormat);
+
+    // Mix nSamples samples from pIn into pOut
+    // pOut needs room for LAV_MIXER_MAX_OUT_CHANNELS floats more than the output, which are overwritten
+    void Mix(float *pOut, const BYTE *pIn, unsigned nSamples, LAVAudioSampleFormat sfFormat) const;
+
+    // Reduce the gain of the matrix if the mixed samples exceed full scale, and scale those samples down as well
+    // Returns the new gain of the matrix
+    float ClipProtection(float *pSamples, size_t nCount);
+
+    // Convert nSamples mixed samples to 16, 24 or 32-bit integer, with clipping
+    // 16-bit output can be dithered with triangular high-pass noise, like avresample does
+    // The conversion can be done in-place, since the output samples are never larger than the input
+    void Convert(BYTE *pDst, const float *pSrc, unsigned nSamples, LAVAudioSampleFormat sfFormat, bool bDither);
+
+  private:
+    void GenerateDither(float *pNoise, size_t nCount);
+
+    int m_CPUFlags = 0;
+
+    unsigned m_nInChannels = 0;
+    unsigned m_nOutChannels = 0;
+    bool m_bIdentity = false;
+    float m_fGain = 1.0f;
+
+    // one column of coefficients per input channel, padded to LAV_MIXER_MAX_OUT_CHANNELS output channels
+    float m_Matrix[LAV_MIXER_MAX_IN_CHANNELS][LAV_MIXER_MAX_OUT_CHANNELS];
+
+    // xorshift generators of the dither noise, and the last noise value of every channel for the high-pass filter
+    uint32_t m_DitherState[8];
+    float m_DitherHistory[LAV_MIXER_MAX_OUT_CHANNELS];
+};
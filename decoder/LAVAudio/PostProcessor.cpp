@@ -473,6 +473,159 @@ HRESULT CLAVAudio::Truncate32Buffer(BufferDetails *buffer)
     return S_OK;
 }
 
+DWORD CLAVAudio::GetTargetSampleRate(DWORD dwSampleRate, int nChannels) const
+{
+    if (m_settings.OutputSampleRate && nChannels <= LAV_RESAMPLER_MAX_CHANNELS)
+        return m_settings.OutputSampleRate;
+    return dwSampleRate;
+}
+
+// Queue the samples held back by the resampler, by processing enough silence in the last input format
+HRESULT CLAVAudio::DrainResampler()
+{
+    const unsigned nSamples = m_Resampler.GetDrainSamples();
+    if (nSamples == 0)
+        return S_FALSE;
+
+    BufferDetails tail;
+    tail.sfFormat = m_MixingInputFormat;
+    tail.wBitsPerSample = get_byte_per_sample(m_MixingInputFormat) << 3;
+    tail.dwSamplesPerSec = m_Resampler.GetInRate();
+    tail.nSamples = nSamples;
+    tail.wChannels = av_get_channel_layout_nb_channels(m_MixingInputLayout);
+    tail.dwChannelMask = m_MixingInputLayout;
+
+    const size_t nBytes = nSamples * tail.wChannels * get_byte_per_sample(tail.sfFormat);
+    if (FAILED(tail.bBuffer->SetSize((DWORD)nBytes)))
+        return E_OUTOFMEMORY;
+    memset(tail.bBuffer->Ptr(), tail.sfFormat == SampleFormat_U8 ? 0x80 : 0, nBytes);
+
+    DbgLog((LOG_TRACE, 10, L"::DrainResampler(): %u samples of silence at %u Hz", nSamples, tail.dwSamplesPerSec));
+
+    HRESULT hr = PostProcess(&tail);
+    m_Resampler.Reset();
+
+    if (SUCCEEDED(hr))
+        hr = QueueOutput(tail);
+    return hr;
+}
+
+HRESULT CLAVAudio::PerformMixing(BufferDetails *buffer, DWORD dwMixingLayout, LAVAudioSampleFormat outputFormat,
+                                 DWORD dwOutputRate)
+{
+    if (!CAudioMixer::IsOutputFormatSupported(outputFormat))
+        return E_FAIL;
+
+    if (!m_Mixer.IsValid() || buffer->dwChannelMask != m_MixingInputLayout || m_bMixingSettingsChanged ||
+        m_dwRemixLayout != dwMixingLayout)
+    {
+        // only one mixer is active at a time, the avresample context is re-created when it is needed again
+        if (m_avrContext)
+        {
+            avresample_close(m_avrContext);
+            avresample_free(&m_avrContext);
+        }
+        m_bAVResampleFailed = FALSE;
+        m_bMixingSettingsChanged = FALSE;
+
+        m_MixingInputLayout = buffer->dwChannelMask;
+        m_dwRemixLayout = dwMixingLayout;
+
+        BOOL bNormalize = !!(m_settings.MixingFlags & LAV_MIXING_FLAG_NORMALIZE_MATRIX);
+        m_bMixingClipProtection = !bNormalize && (m_settings.MixingFlags & LAV_MIXING_FLAG_CLIP_PROTECTION);
+
+        // Create Matrix
+        int in_ch = buffer->wChannels;
+        int out_ch = av_get_channel_layout_nb_channels(dwMixingLayout);
+        double *matrix_dbl = (double *)av_mallocz(in_ch * out_ch * sizeof(*matrix_dbl));
+
+        const double center_mix_level = (double)m_settings.MixingCenterLevel / 10000.0;
+        const double surround_mix_level = (double)m_settings.MixingSurroundLevel / 10000.0;
+        const double lfe_mix_level =
+            (double)m_settings.MixingLFELevel / 10000.0 / (dwMixingLayout == AV_CH_LAYOUT_MONO ? 1.0 : M_SQRT1_2);
+        int ret = 0;
+        if (dwMixingLayout == buffer->dwChannelMask)
+        {
+            // only resampling, the channels pass through
+            for (int ch = 0; ch < in_ch; ch++)
+                matrix_dbl[ch * in_ch + ch] = 1.0;
+            m_bMixingClipProtection = FALSE;
+        }
+        else
+            ret = avresample_build_matrix(buffer->dwChannelMask, dwMixingLayout, center_mix_level, surround_mix_level,
+                                          lfe_mix_level, bNormalize, matrix_dbl, in_ch,
+                                          (AVMatrixEncoding)m_settings.MixingMode);
+        if (ret < 0 || !m_Mixer.SetMatrix(matrix_dbl, in_ch, in_ch, out_ch))
+        {
+            DbgLog((LOG_ERROR, 10, L"Building the mixing matrix failed, layout in: %x, out: %x", buffer->dwChannelMask,
+                    dwMixingLayout));
+            av_free(matrix_dbl);
+            m_Mixer.Reset();
+            return E_FAIL;
+        }
+        av_free(matrix_dbl);
+    }
+
+    // the sample formats are handled by every call
+    m_MixingInputFormat = buffer->sfFormat;
+    m_sfRemixFormat = outputFormat;
+
+    const unsigned nOutChannels = m_Mixer.GetOutChannels();
+
+    const BOOL bResample = (dwOutputRate != buffer->dwSamplesPerSec);
+    if (bResample && !m_Resampler.IsSetup(buffer->dwSamplesPerSec, dwOutputRate, nOutChannels) &&
+        !m_Resampler.Init(buffer->dwSamplesPerSec, dwOutputRate, nOutChannels))
+    {
+        DbgLog((LOG_ERROR, 10, L"Setting up the resampler failed, rate in: %u, out: %u", buffer->dwSamplesPerSec,
+                dwOutputRate));
+        return E_FAIL;
+    }
+
+    const unsigned nOutSamples = bResample ? m_Resampler.GetMaxOutputSamples(buffer->nSamples) : buffer->nSamples;
+
+    // mix into the spare buffer, which then trades places with the input buffer
+    if (!m_pMixingBuffer)
+        m_pMixingBuffer = new GrowableArray<BYTE>();
+    if (FAILED(m_pMixingBuffer->Allocate((nOutSamples * nOutChannels + LAV_MIXER_MAX_OUT_CHANNELS) * sizeof(float))))
+        return E_OUTOFMEMORY;
+
+    // when resampling, the mixer writes into the input of the resampler, which then filters into the spare buffer
+    float *pOut = (float *)m_pMixingBuffer->Ptr();
+    float *pMixed = bResample ? m_Resampler.GetInputBuffer(buffer->nSamples) : pOut;
+    if (!pMixed)
+        return E_OUTOFMEMORY;
+
+    m_Mixer.Mix(pMixed, buffer->bBuffer->Ptr(), buffer->nSamples, buffer->sfFormat);
+
+    if (m_bMixingClipProtection)
+        m_Mixer.ClipProtection(pMixed, buffer->nSamples * nOutChannels);
+
+    if (bResample)
+    {
+        // the filter holds back some samples for the next buffer, move the timestamp to the first output sample
+        if (buffer->rtStart != AV_NOPTS_VALUE)
+            buffer->rtStart += (REFERENCE_TIME)(m_Resampler.GetOutputOffset() * 10000000.0 / buffer->dwSamplesPerSec);
+
+        buffer->nSamples = m_Resampler.Resample(pOut, buffer->nSamples);
+        buffer->dwSamplesPerSec = dwOutputRate;
+    }
+
+    const DWORD dwOutCount = buffer->nSamples * nOutChannels;
+
+    if (m_sfRemixFormat != SampleFormat_FP32)
+        m_Mixer.Convert((BYTE *)pOut, pOut, buffer->nSamples, m_sfRemixFormat,
+                        m_sfRemixFormat == SampleFormat_16 && m_settings.SampleConvertDither);
+
+    std::swap(buffer->bBuffer, m_pMixingBuffer);
+    buffer->dwChannelMask = m_dwRemixLayout;
+    buffer->sfFormat = m_sfRemixFormat;
+    buffer->wBitsPerSample = get_byte_per_sample(m_sfRemixFormat) << 3;
+    buffer->wChannels = nOutChannels;
+    buffer->bBuffer->SetSize(dwOutCount * get_byte_per_sample(m_sfRemixFormat));
+
+    return S_OK;
+}
+
 HRESULT CLAVAudio::PerformAVRProcessing(BufferDetails *buffer)
 {
     int ret = 0;
@@ -484,14 +637,23 @@ HRESULT CLAVAudio::PerformAVRProcessing(BufferDetails *buffer)
     if (buffer->wChannels <= 2 && (m_settings.MixingFlags & LAV_MIXING_FLAG_UNTOUCHED_STEREO))
         dwMixingLayout = buffer->dwChannelMask;
 
-    LAVAudioSampleFormat outputFormat = (dwMixingLayout != buffer->dwChannelMask)
+    // Resampling is only done natively, together with mixing
+    const DWORD dwOutputRate =
+        GetTargetSampleRate(buffer->dwSamplesPerSec, av_get_channel_layout_nb_channels(dwMixingLayout));
+    const BOOL bResample = dwOutputRate != buffer->dwSamplesPerSec && !buffer->bPlanar &&
+                           CAudioMixer::IsFormatSupported(buffer->sfFormat) &&
+                           buffer->wChannels <= LAV_MIXER_MAX_IN_CHANNELS;
+
+    LAVAudioSampleFormat outputFormat = (dwMixingLayout != buffer->dwChannelMask || bResample)
                                             ? GetBestAvailableSampleFormat(SampleFormat_FP32)
                                             : GetBestAvailableSampleFormat(buffer->sfFormat);
 
     // Short Circuit some processing
-    if (dwMixingLayout == buffer->dwChannelMask && !buffer->bPlanar)
+    if (dwMixingLayout == buffer->dwChannelMask && !buffer->bPlanar && !bResample)
     {
-        if (buffer->sfFormat == SampleFormat_24 && outputFormat == SampleFormat_32)
+        if (buffer->sfFormat == outputFormat)
+            return S_OK;
+        else if (buffer->sfFormat == SampleFormat_24 && outputFormat == SampleFormat_32)
         {
             PadTo32(buffer);
             return S_OK;
@@ -504,6 +666,18 @@ HRESULT CLAVAudio::PerformAVRProcessing(BufferDetails *buffer)
         }
     }
 
+    // Mixing and sample format conversion are done natively, only planar input and 8-bit output are left to
+    // avresample
+    if (bResample || (!buffer->bPlanar && CAudioMixer::IsFormatSupported(buffer->sfFormat) &&
+                      CAudioMixer::IsOutputFormatSupported(outputFormat) &&
+                      buffer->wChannels <= LAV_MIXER_MAX_IN_CHANNELS &&
+                      av_get_channel_layout_nb_channels(dwMixingLayout) <= LAV_MIXER_MAX_OUT_CHANNELS))
+    {
+        if (SUCCEEDED(PerformMixing(buffer, dwMixingLayout, outputFormat,
+                                    bResample ? dwOutputRate : buffer->dwSamplesPerSec)))
+            return S_OK;
+    }
+
     // Sadly, we need to convert this, avresample has no 24-bit mode
     if (buffer->sfFormat == SampleFormat_24)
     {
@@ -516,6 +690,7 @@ HRESULT CLAVAudio::PerformAVRProcessing(BufferDetails *buffer)
     {
         m_bAVResampleFailed = FALSE;
         m_bMixingSettingsChanged = FALSE;
+        m_Mixer.Reset();
         if (m_avrContext)
         {
             avresample_close(m_avrContext);
@@ -628,6 +803,13 @@ setuperr:
 
 HRESULT CLAVAudio::PostProcess(BufferDetails *buffer)
 {
+    // The resampler is set up again for the new rate, the end of the old one goes first
+    if (buffer->dwSamplesPerSec != m_Resampler.GetInRate())
+        DrainResampler();
+
+    const LONGLONG llStart = CLAVAudioProcessingStats::Now();
+    m_Stats.AddSamples(LAVAudioStage_Decode, buffer->nSamples);
+
     int layout_channels = av_get_channel_layout_nb_channels(buffer->dwChannelMask);
 
     // Validate channel mask
@@ -672,8 +854,12 @@ HRESULT CLAVAudio::PostProcess(BufferDetails *buffer)
     DWORD dwMixingLayout = m_dwOverrideMixer ? m_dwOverrideMixer : m_settings.MixingLayout;
     BOOL bMixing = (m_settings.MixingEnabled || m_dwOverrideMixer) && buffer->dwChannelMask != dwMixingLayout;
     LAVAudioSampleFormat outputFormat = GetBestAvailableSampleFormat(buffer->sfFormat);
-    // Perform conversion to layout and sample format, if required
-    if (bMixing || outputFormat != buffer->sfFormat)
+    BOOL bResample =
+        GetTargetSampleRate(buffer->dwSamplesPerSec,
+                            bMixing ? av_get_channel_layout_nb_channels(dwMixingLayout) : buffer->wChannels) !=
+        buffer->dwSamplesPerSec;
+    // Perform conversion to layout, sample rate and sample format, if required
+    if (bMixing || bResample || outputFormat != buffer->sfFormat)
     {
         PerformAVRProcessing(buffer);
     }
@@ -736,16 +922,13 @@ HRESULT CLAVAudio::PostProcess(BufferDetails *buffer)
         }
     }
 
-    if (m_bVolumeStats)
-    {
-        UpdateVolumeStats(*buffer);
-    }
-
     // Truncate 24-in-32 to real 24
     if (buffer->sfFormat == SampleFormat_32 && buffer->wBitsPerSample && buffer->wBitsPerSample <= 24)
     {
         Truncate32Buffer(buffer);
     }
 
+    m_Stats.Add(LAVAudioStage_PostProcess, llStart, buffer->nSamples);
+
     return S_OK;
 }
@@ -0,0 +1,59 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVAudioSettings.h"
+#include "ProcessingCounter.h"
+
+// Processing time and sample count of the individual stages of the decoder
+// The stages run on the decoder thread in decode-ahead mode
+class CLAVAudioProcessingStats
+{
+  public:
+    static LONGLONG Now() { return CProcessingCounter::Now(); }
+
+    void Reset()
+    {
+        for (CProcessingCounter &stage : m_Stages)
+            stage.Reset();
+    }
+
+    // Adds the time since llStart (obtained from Now()) and nSamples to the stage
+    void Add(LAVAudioStage stage, LONGLONG llStart, unsigned nSamples) { m_Stages[stage].Add(llStart, nSamples); }
+    void AddTicks(LAVAudioStage stage, LONGLONG llTicks) { m_Stages[stage].AddTicks(llTicks); }
+    void AddSamples(LAVAudioStage stage, unsigned nSamples) { m_Stages[stage].AddCount(nSamples); }
+
+    // Raw ticks of the given stage and all stages after it
+    // The later stages run nested inside the earlier ones, this allows excluding them from the time of the outer one
+    LONGLONG GetTicksFrom(LAVAudioStage stage) const
+    {
+        LONGLONG llTicks = 0;
+        for (int i = stage; i < LAVAudioStage_NB; i++)
+            llTicks += m_Stages[i].GetTicks();
+        return llTicks;
+    }
+
+    ULONGLONG GetSamples(LAVAudioStage stage) const { return m_Stages[stage].GetCount(); }
+    // Time in 100ns units
+    REFERENCE_TIME GetTime(LAVAudioStage stage) const { return m_Stages[stage].GetTime(); }
+
+  private:
+    CProcessingCounter m_Stages[LAVAudioStage_NB];
+};
@@ -0,0 +1,253 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "Resampler.h"
+
+#include <emmintrin.h>
+
+// Taps per phase when upsampling
+// Downsampling moves the cutoff below the input Nyquist frequency, which needs proportionally more taps
+#define RESAMPLER_TAPS 32
+#define RESAMPLER_MAX_TAPS 128
+
+// Passband relative to the lower of both Nyquist frequencies
+#define RESAMPLER_CUTOFF 0.95
+
+static unsigned gcd(unsigned a, unsigned b)
+{
+    while (b)
+    {
+        const unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double sinc(double x)
+{
+    return fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+}
+
+// Blackman window over [-1, 1]
+static double blackman(double x)
+{
+    return fabs(x) >= 1.0 ? 0.0 : 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2.0 * M_PI * x);
+}
+
+// Filter kernels
+// Every kernel computes one output sample of all channels from nTaps input samples and their coefficients
+
+// Mono: 4 taps per vector, summed horizontally at the end
+struct ResampleKernelMono
+{
+    static __forceinline void Filter(float *pOut, const float *pIn, const float *pFilter, unsigned nTaps, unsigned)
+    {
+        __m128 acc = _mm_setzero_ps();
+        for (unsigned k = 0; k < nTaps; k += 4)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(pFilter + k), _mm_loadu_ps(pIn + k)));
+
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+        _mm_store_ss(pOut, acc);
+    }
+};
+
+// Stereo: 2 taps per vector, with every coefficient duplicated for both channels
+struct ResampleKernelStereo
+{
+    static __forceinline void Filter(float *pOut, const float *pIn, const float *pFilter, unsigned nTaps, unsigned)
+    {
+        __m128 acc = _mm_setzero_ps();
+        for (unsigned k = 0; k < nTaps; k += 2)
+        {
+            __m128 c = _mm_castpd_ps(_mm_load_sd((const double *)(pFilter + k)));
+            c = _mm_unpacklo_ps(c, c);
+            acc = _mm_add_ps(acc, _mm_mul_ps(c, _mm_loadu_ps(pIn + k * 2)));
+        }
+
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        _mm_storel_pi((__m64 *)pOut, acc);
+    }
+};
+
+// Multi-channel: one tap per step, with up to 4 channels in one vector and up to 8 in two
+// The full vectors are loaded and stored even if there are fewer channels, like in the mixer
+template <unsigned nVectors> struct ResampleKernelChannels
+{
+    static __forceinline void Filter(float *pOut, const float *pIn, const float *pFilter, unsigned nTaps,
+                                     unsigned nChannels)
+    {
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+        for (unsigned k = 0; k < nTaps; ++k)
+        {
+            const __m128 c = _mm_set1_ps(pFilter[k]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(c, _mm_loadu_ps(pIn)));
+            if (nVectors > 1)
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(c, _mm_loadu_ps(pIn + 4)));
+            pIn += nChannels;
+        }
+
+        _mm_storeu_ps(pOut, acc0);
+        if (nVectors > 1)
+            _mm_storeu_ps(pOut + 4, acc1);
+    }
+};
+
+bool CAudioResampler::Init(DWORD dwInRate, DWORD dwOutRate, unsigned nChannels)
+{
+    Close();
+
+    if (dwInRate == 0 || dwOutRate == 0 || nChannels == 0 || nChannels > LAV_RESAMPLER_MAX_CHANNELS)
+        return false;
+
+    const unsigned nGCD = gcd(dwInRate, dwOutRate);
+    m_nUp = dwOutRate / nGCD;
+    m_nDown = dwInRate / nGCD;
+    m_nPhases = min(m_nUp, (unsigned)LAV_RESAMPLER_MAX_PHASES);
+
+    const double dScale = min(1.0, (double)dwOutRate / dwInRate);
+    const double dCutoff = RESAMPLER_CUTOFF * dScale;
+
+    // the stereo kernel reads the coefficients in pairs, the mono kernel in groups of 4
+    m_nTaps = FFALIGN(min((unsigned)ceil(RESAMPLER_TAPS / dScale), (unsigned)RESAMPLER_MAX_TAPS), 4);
+
+    if (FAILED(m_Filter.Allocate(m_nPhases * m_nTaps)))
+        return false;
+
+    // the center of the filter is between tap m_nTaps / 2 - 1 and the next one, at the fraction of the phase
+    const double dHalfLength = m_nTaps / 2;
+    for (unsigned phase = 0; phase < m_nPhases; ++phase)
+    {
+        float *pCoeffs = m_Filter.Ptr() + phase * m_nTaps;
+        const double dFrac = (double)phase / m_nPhases;
+
+        double dSum = 0.0;
+        double dCoeffs[RESAMPLER_MAX_TAPS];
+        for (unsigned k = 0; k < m_nTaps; ++k)
+        {
+            const double t = (double)k - (dHalfLength - 1.0) - dFrac;
+            dCoeffs[k] = dCutoff * sinc(dCutoff * t) * blackman(t / dHalfLength);
+            dSum += dCoeffs[k];
+        }
+
+        // normalize every phase to unity gain, so the phases cannot modulate the signal
+        for (unsigned k = 0; k < m_nTaps; ++k)
+            pCoeffs[k] = (float)(dCoeffs[k] / dSum);
+    }
+
+    m_dwInRate = dwInRate;
+    m_dwOutRate = dwOutRate;
+    m_nChannels = nChannels;
+
+    Reset();
+
+    DbgLog((LOG_TRACE, 10, L"CAudioResampler::Init(): %u Hz -> %u Hz, %u channels, %u phases, %u taps", dwInRate,
+            dwOutRate, nChannels, m_nPhases, m_nTaps));
+    return true;
+}
+
+void CAudioResampler::Reset()
+{
+    if (!IsValid())
+        return;
+
+    // prime the history with silence, so the first output sample is centered on the first input sample
+    m_nBuffered = m_nTaps / 2 - 1;
+    m_nIndex = 0;
+    m_nFrac = 0;
+    m_bHasInput = false;
+
+    if (SUCCEEDED(m_Input.Allocate(m_nBuffered * m_nChannels + LAV_RESAMPLER_MAX_CHANNELS)))
+        memset(m_Input.Ptr(), 0, m_nBuffered * m_nChannels * sizeof(float));
+}
+
+float *CAudioResampler::GetInputBuffer(unsigned nSamples)
+{
+    ASSERT(IsValid());
+
+    if (FAILED(m_Input.Allocate((m_nBuffered + nSamples) * m_nChannels + LAV_RESAMPLER_MAX_CHANNELS)))
+        return nullptr;
+
+    return m_Input.Ptr() + m_nBuffered * m_nChannels;
+}
+
+unsigned CAudioResampler::GetMaxOutputSamples(unsigned nSamples) const
+{
+    return (unsigned)(((uint64_t)(m_nBuffered + nSamples) * m_nUp + m_nDown - 1) / m_nDown) + 1;
+}
+
+double CAudioResampler::GetOutputOffset() const
+{
+    return (double)m_nIndex + (m_nTaps / 2 - 1) + (double)m_nFrac / m_nUp - m_nBuffered;
+}
+
+template <class Kernel> float *CAudioResampler::ResampleLoop(float *pOut)
+{
+    const float *pInput = m_Input.Ptr();
+    const float *pFilter = m_Filter.Ptr();
+
+    while (m_nIndex + m_nTaps <= m_nBuffered)
+    {
+        const unsigned phase = (m_nPhases == m_nUp) ? m_nFrac : (unsigned)((uint64_t)m_nFrac * m_nPhases / m_nUp);
+        Kernel::Filter(pOut, pInput + m_nIndex * m_nChannels, pFilter + phase * m_nTaps, m_nTaps, m_nChannels);
+        pOut += m_nChannels;
+
+        m_nFrac += m_nDown;
+        m_nIndex += m_nFrac / m_nUp;
+        m_nFrac %= m_nUp;
+    }
+
+    return pOut;
+}
+
+unsigned CAudioResampler::Resample(float *pOut, unsigned nSamples)
+{
+    ASSERT(IsValid());
+
+    m_nBuffered += nSamples;
+    m_bHasInput |= (nSamples > 0);
+
+    float *pEnd = pOut;
+    switch (m_nChannels)
+    {
+    case 1: pEnd = ResampleLoop<ResampleKernelMono>(pOut); break;
+    case 2: pEnd = ResampleLoop<ResampleKernelStereo>(pOut); break;
+    case 3:
+    case 4: pEnd = ResampleLoop<ResampleKernelChannels<1>>(pOut); break;
+    default: pEnd = ResampleLoop<ResampleKernelChannels<2>>(pOut); break;
+    }
+
+    // keep the samples still needed for the next output as history
+    if (m_nIndex >= m_nBuffered)
+    {
+        // downsampling can skip past the end of the input
+        m_nIndex -= m_nBuffered;
+        m_nBuffered = 0;
+    }
+    else if (m_nIndex > 0)
+    {
+        m_nBuffered -= m_nIndex;
+        memmove(m_Input.Ptr(), m_Input.Ptr() + m_nIndex * m_nChannels, m_nBuffered * m_nChannels * sizeof(float));
+        m_nIndex = 0;
+    }
+
+    return (unsigned)((pEnd - pOut) / m_nChannels);
+}
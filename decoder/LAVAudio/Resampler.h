@@ -0,0 +1,88 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#define LAV_RESAMPLER_MAX_CHANNELS 8
+#define LAV_RESAMPLER_MAX_PHASES 1024
+
+// Polyphase windowed-sinc sample rate converter for interleaved float samples
+//
+// The input is written straight into the buffer of the resampler (see GetInputBuffer), behind the samples kept from
+// the previous call, so the mixer can produce it in place. Resample then filters it into the output in one pass.
+// Rate pairs that need more than LAV_RESAMPLER_MAX_PHASES filter phases use the closest phase below the position.
+class CAudioResampler
+{
+  public:
+    bool Init(DWORD dwInRate, DWORD dwOutRate, unsigned nChannels);
+    void Close() { m_nChannels = 0; }
+
+    // Drop the buffered samples, ie. after a seek
+    void Reset();
+
+    bool IsValid() const { return m_nChannels != 0; }
+    bool IsSetup(DWORD dwInRate, DWORD dwOutRate, unsigned nChannels) const
+    {
+        return IsValid() && m_dwInRate == dwInRate && m_dwOutRate == dwOutRate && m_nChannels == nChannels;
+    }
+    DWORD GetInRate() const { return m_dwInRate; }
+
+    // Number of silent input samples that push the samples held back by the filter out
+    // This is 0 if no input was resampled since the last Reset
+    unsigned GetDrainSamples() const { return (IsValid() && m_bHasInput) ? m_nTaps / 2 : 0; }
+
+    // Get room for nSamples input samples, which need to be written before calling Resample
+    // There is room for LAV_RESAMPLER_MAX_CHANNELS floats more, which may be overwritten
+    float *GetInputBuffer(unsigned nSamples);
+
+    // Upper bound of the number of output samples for nSamples input samples
+    unsigned GetMaxOutputSamples(unsigned nSamples) const;
+
+    // Position of the next output sample, in input samples relative to the first sample of the next input
+    // This is usually negative, since up to half the filter length of input is held back for the next call
+    double GetOutputOffset() const;
+
+    // Filter nSamples samples written into the input buffer into pOut, and return the number of output samples
+    // pOut needs room for LAV_RESAMPLER_MAX_CHANNELS floats more than the output, which are overwritten
+    unsigned Resample(float *pOut, unsigned nSamples);
+
+  private:
+    template <class Kernel> float *ResampleLoop(float *pOut);
+
+    DWORD m_dwInRate = 0;
+    DWORD m_dwOutRate = 0;
+    unsigned m_nChannels = 0;
+
+    // the output advances by nDown / nUp input samples per sample
+    unsigned m_nUp = 1;
+    unsigned m_nDown = 1;
+    unsigned m_nPhases = 1;
+    unsigned m_nTaps = 0;
+
+    // one row of m_nTaps coefficients per phase
+    GrowableArray<float> m_Filter;
+
+    // buffered input samples, the next output sample is computed from m_nTaps samples starting at m_nIndex,
+    // at phase m_nFrac / m_nUp between them
+    GrowableArray<float> m_Input;
+    unsigned m_nBuffered = 0;
+    unsigned m_nIndex = 0;
+    unsigned m_nFrac = 0;
+    bool m_bHasInput = false;
+};
@@ -0,0 +1,96 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "SyncScanner.h"
+
+#include <emmintrin.h>
+
+// first two bytes of DCA_MARKER_RAW_BE, DCA_MARKER_RAW_LE, DCA_MARKER_14B_BE and DCA_MARKER_14B_LE
+const SyncPattern SyncPatternsDTS[4] = {
+    {0x7F, 0xFF, 0xFE, 0xFF},
+    {0xFE, 0xFF, 0x7F, 0xFF},
+    {0x1F, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0x1F, 0xFF},
+};
+
+const SyncPattern SyncPatternsMPEGAudio[1] = {
+    {0xFF, 0xFF, 0xE0, 0xE0},
+};
+
+static __forceinline bool match_pattern(const SyncPattern &pattern, const uint8_t *p)
+{
+    return (p[0] & pattern.mask0) == pattern.value0 && (p[1] & pattern.mask1) == pattern.value1;
+}
+
+int CSyncScanner::Find(const uint8_t *pBuffer, int nEnd)
+{
+    int i = m_nPosition;
+
+    // 16 offsets at a time, every pattern is compared against the buffer and the buffer shifted by one byte
+    if (i + 16 <= nEnd)
+    {
+        __m128i value0[4], mask0[4], value1[4], mask1[4];
+        for (unsigned n = 0; n < m_nPatterns; n++)
+        {
+            value0[n] = _mm_set1_epi8((char)m_pPatterns[n].value0);
+            mask0[n] = _mm_set1_epi8((char)m_pPatterns[n].mask0);
+            value1[n] = _mm_set1_epi8((char)m_pPatterns[n].value1);
+            mask1[n] = _mm_set1_epi8((char)m_pPatterns[n].mask1);
+        }
+
+        for (; i + 16 <= nEnd; i += 16)
+        {
+            const __m128i b0 = _mm_loadu_si128((const __m128i *)(pBuffer + i));
+            const __m128i b1 = _mm_loadu_si128((const __m128i *)(pBuffer + i + 1));
+
+            __m128i match = _mm_setzero_si128();
+            for (unsigned n = 0; n < m_nPatterns; n++)
+            {
+                const __m128i m0 = _mm_cmpeq_epi8(_mm_and_si128(b0, mask0[n]), value0[n]);
+                const __m128i m1 = _mm_cmpeq_epi8(_mm_and_si128(b1, mask1[n]), value1[n]);
+                match = _mm_or_si128(match, _mm_and_si128(m0, m1));
+            }
+
+            const int mask = _mm_movemask_epi8(match);
+            if (mask)
+            {
+                unsigned long bit;
+                _BitScanForward(&bit, mask);
+                m_nPosition = i + (int)bit;
+                return m_nPosition;
+            }
+        }
+    }
+
+    for (; i < nEnd; i++)
+    {
+        for (unsigned n = 0; n < m_nPatterns; n++)
+        {
+            if (match_pattern(m_pPatterns[n], pBuffer + i))
+            {
+                m_nPosition = i;
+                return i;
+            }
+        }
+    }
+
+    m_nPosition = max(m_nPosition, nEnd);
+    return -1;
+}
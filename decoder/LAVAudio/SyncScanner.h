@@ -0,0 +1,61 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Two-byte prefix of a sync word, each byte is compared after applying its mask
+struct SyncPattern
+{
+    uint8_t value0, mask0;
+    uint8_t value1, mask1;
+};
+
+// DTS sync words (raw and 14-bit, both endians)
+extern const SyncPattern SyncPatternsDTS[4];
+// MPEG audio frame sync (11 bits)
+extern const SyncPattern SyncPatternsMPEGAudio[1];
+
+// Incremental search for sync word candidates in a buffer that is growing between calls
+//
+// The scanner remembers how far the buffer was searched, so data is only looked at once, no matter how often the
+// search is repeated while waiting for more data. It needs to be reset whenever data is removed from the buffer.
+class CSyncScanner
+{
+  public:
+    CSyncScanner(const SyncPattern *pPatterns, unsigned nPatterns) : m_pPatterns(pPatterns), m_nPatterns(nPatterns)
+    {
+        ASSERT(nPatterns <= 4);
+    }
+
+    void Reset() { m_nPosition = 0; }
+
+    int GetPosition() const { return m_nPosition; }
+    void SetPosition(int nPosition) { m_nPosition = nPosition; }
+
+    // Find the next offset at or after the current position which matches one of the patterns
+    // Only offsets before nEnd are considered, and the byte at nEnd must still be readable.
+    // The position is moved to the returned offset, or to nEnd if nothing was found (and -1 is returned)
+    int Find(const uint8_t *pBuffer, int nEnd);
+
+  private:
+    const SyncPattern *m_pPatterns = nullptr;
+    unsigned m_nPatterns = 0;
+
+    int m_nPosition = 0;
+};
@@ -0,0 +1,230 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "VolumeStats.h"
+
+#include <emmintrin.h>
+
+// Sample loaders
+// Every loader copies 4 samples from the source to the destination, and returns them as normalized floats
+
+struct VolumeLoaderU8
+{
+    static const unsigned SampleSize = 1;
+
+    static __forceinline __m128 Load4(BYTE *pDst, const BYTE *pSrc)
+    {
+        int32_t raw;
+        memcpy(&raw, pSrc, 4);
+        memcpy(pDst, &raw, 4);
+
+        const __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_cvtsi32_si128(raw);
+        v = _mm_unpacklo_epi8(v, zero);
+        v = _mm_unpacklo_epi16(v, zero);
+        v = _mm_sub_epi32(v, _mm_set1_epi32(128));
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / INT8_MAX));
+    }
+
+    static __forceinline float Load1(BYTE *pDst, const BYTE *pSrc)
+    {
+        *pDst = *pSrc;
+        return (float)(*pSrc + INT8_MIN) / INT8_MAX;
+    }
+};
+
+struct VolumeLoaderS16
+{
+    static const unsigned SampleSize = 2;
+
+    static __forceinline __m128 Load4(BYTE *pDst, const BYTE *pSrc)
+    {
+        __m128i v = _mm_loadl_epi64((const __m128i *)pSrc);
+        _mm_storel_epi64((__m128i *)pDst, v);
+
+        // sign-extend to 32-bit
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / INT16_MAX));
+    }
+
+    static __forceinline float Load1(BYTE *pDst, const BYTE *pSrc)
+    {
+        int16_t s;
+        memcpy(&s, pSrc, 2);
+        memcpy(pDst, &s, 2);
+        return (float)s / INT16_MAX;
+    }
+};
+
+struct VolumeLoaderS24
+{
+    static const unsigned SampleSize = 3;
+
+    static __forceinline int32_t Read24(const BYTE *p) { return (p[0] << 8) | (p[1] << 16) | (p[2] << 24); }
+
+    static __forceinline __m128 Load4(BYTE *pDst, const BYTE *pSrc)
+    {
+        memcpy(pDst, pSrc, 12);
+
+        // packed 24-bit samples do not line up with the vector lanes, assemble them left-justified in 32-bit
+        const __m128i v = _mm_setr_epi32(Read24(pSrc), Read24(pSrc + 3), Read24(pSrc + 6), Read24(pSrc + 9));
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / INT32_MAX));
+    }
+
+    static __forceinline float Load1(BYTE *pDst, const BYTE *pSrc)
+    {
+        memcpy(pDst, pSrc, 3);
+        return (float)Read24(pSrc) / INT32_MAX;
+    }
+};
+
+struct VolumeLoaderS32
+{
+    static const unsigned SampleSize = 4;
+
+    static __forceinline __m128 Load4(BYTE *pDst, const BYTE *pSrc)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *)pSrc);
+        _mm_storeu_si128((__m128i *)pDst, v);
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / INT32_MAX));
+    }
+
+    static __forceinline float Load1(BYTE *pDst, const BYTE *pSrc)
+    {
+        int32_t s;
+        memcpy(&s, pSrc, 4);
+        memcpy(pDst, &s, 4);
+        return (float)s / INT32_MAX;
+    }
+};
+
+struct VolumeLoaderFP32
+{
+    static const unsigned SampleSize = 4;
+
+    static __forceinline __m128 Load4(BYTE *pDst, const BYTE *pSrc)
+    {
+        const __m128 v = _mm_loadu_ps((const float *)pSrc);
+        _mm_storeu_ps((float *)pDst, v);
+        return v;
+    }
+
+    static __forceinline float Load1(BYTE *pDst, const BYTE *pSrc)
+    {
+        float f;
+        memcpy(&f, pSrc, 4);
+        memcpy(pDst, &f, 4);
+        return f;
+    }
+};
+
+// The samples of all channels are processed as one stream, 4 at a time
+// After lcm(nChannels, 4) samples, the channel pattern in the vector lanes repeats, so that many accumulators
+// are needed to keep the channels apart. They are only folded into the individual channels at the very end.
+#define VOLUME_MAX_VECTORS 7
+
+template <class Loader>
+static void copy_volume_stats(BYTE *pDst, const BYTE *pSrc, unsigned nSamples, unsigned nChannels,
+                              float *pSumSquares, float *pPeak)
+{
+    const unsigned nVectors = nChannels / (nChannels & 3 ? (nChannels & 1 ? 1 : 2) : 4);
+    const unsigned nBlock = nVectors * 4;
+    const size_t nTotal = (size_t)nSamples * nChannels;
+
+    const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    __m128 sum[VOLUME_MAX_VECTORS], peak[VOLUME_MAX_VECTORS];
+    for (unsigned v = 0; v < nVectors; ++v)
+    {
+        sum[v] = _mm_setzero_ps();
+        peak[v] = _mm_setzero_ps();
+    }
+
+    size_t i = 0;
+    for (; i + nBlock <= nTotal; i += nBlock)
+    {
+        for (unsigned v = 0; v < nVectors; ++v)
+        {
+            const size_t offset = (i + v * 4) * Loader::SampleSize;
+            const __m128 s = Loader::Load4(pDst + offset, pSrc + offset);
+            sum[v] = _mm_add_ps(sum[v], _mm_mul_ps(s, s));
+            peak[v] = _mm_max_ps(peak[v], _mm_and_ps(s, absmask));
+        }
+    }
+
+    for (unsigned ch = 0; ch < nChannels; ++ch)
+    {
+        pSumSquares[ch] = 0.0f;
+        pPeak[ch] = 0.0f;
+    }
+
+    // fold the vector lanes into their channels
+    for (unsigned v = 0; v < nVectors; ++v)
+    {
+        float fSum[4], fPeak[4];
+        _mm_storeu_ps(fSum, sum[v]);
+        _mm_storeu_ps(fPeak, peak[v]);
+        for (unsigned lane = 0; lane < 4; ++lane)
+        {
+            const unsigned ch = (v * 4 + lane) % nChannels;
+            pSumSquares[ch] += fSum[lane];
+            pPeak[ch] = max(pPeak[ch], fPeak[lane]);
+        }
+    }
+
+    // the blocks always end on a sample boundary, so the remainder starts at channel 0
+    for (unsigned ch = 0; i < nTotal; ++i)
+    {
+        const size_t offset = i * Loader::SampleSize;
+        const float s = Loader::Load1(pDst + offset, pSrc + offset);
+        pSumSquares[ch] += s * s;
+        pPeak[ch] = max(pPeak[ch], fabsf(s));
+        if (++ch == nChannels)
+            ch = 0;
+    }
+}
+
+bool lav_copy_volume_stats(BYTE *pDst, const BYTE *pSrc, unsigned nSamples, unsigned nChannels,
+                           LAVAudioSampleFormat sfFormat, float *pSumSquares, float *pPeak)
+{
+    if (nChannels == 0 || nChannels > LAV_VOLUME_STATS_CHANNELS)
+        return false;
+
+    switch (sfFormat)
+    {
+    case SampleFormat_U8:
+        copy_volume_stats<VolumeLoaderU8>(pDst, pSrc, nSamples, nChannels, pSumSquares, pPeak);
+        break;
+    case SampleFormat_16:
+        copy_volume_stats<VolumeLoaderS16>(pDst, pSrc, nSamples, nChannels, pSumSquares, pPeak);
+        break;
+    case SampleFormat_24:
+        copy_volume_stats<VolumeLoaderS24>(pDst, pSrc, nSamples, nChannels, pSumSquares, pPeak);
+        break;
+    case SampleFormat_32:
+        copy_volume_stats<VolumeLoaderS32>(pDst, pSrc, nSamples, nChannels, pSumSquares, pPeak);
+        break;
+    case SampleFormat_FP32:
+        copy_volume_stats<VolumeLoaderFP32>(pDst, pSrc, nSamples, nChannels, pSumSquares, pPeak);
+        break;
+    default: return false;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVAudioSettings.h"
+
+#define LAV_VOLUME_STATS_CHANNELS 8
+
+// Copy interleaved PCM samples from pSrc to pDst, and measure every channel in the same pass
+// pSumSquares receives the sum of the squared normalized samples, pPeak the highest absolute normalized sample
+// Returns false if the format or channel count is not supported, nothing is copied in that case
+bool lav_copy_volume_stats(BYTE *pDst, const BYTE *pSrc, unsigned nSamples, unsigned nChannels,
+                           LAVAudioSampleFormat sfFormat, float *pSumSquares, float *pPeak);
+
+// Snapshot of the current volume levels
+// Written by the streaming thread, and read by the UI without locking (sequence lock)
+// The streaming thread is the only writer, other threads can only request a reset
+class CVolumeSnapshot
+{
+  public:
+    void Publish(WORD wChannels, const float *pfAverage, const float *pfPeak)
+    {
+        // the new levels replace the old ones, which completes any pending reset
+        InterlockedExchange(&m_lResetPending, FALSE);
+
+        // an odd sequence marks a write in progress
+        InterlockedIncrement(&m_lSequence);
+
+        m_wChannels = min(wChannels, LAV_VOLUME_STATS_CHANNELS);
+        for (WORD ch = 0; ch < m_wChannels; ++ch)
+        {
+            m_fAverage[ch] = pfAverage[ch];
+            m_fPeak[ch] = pfPeak[ch];
+        }
+
+        InterlockedIncrement(&m_lSequence);
+    }
+
+    // Discard the current levels, readers see no data until the next Publish
+    void Reset() { InterlockedExchange(&m_lResetPending, TRUE); }
+
+    BOOL Read(WORD nChannel, float *pfAverage, float *pfPeak) const
+    {
+        for (;;)
+        {
+            const LONG lSequence = m_lSequence;
+            if (lSequence & 1)
+            {
+                YieldProcessor();
+                continue;
+            }
+            MemoryBarrier();
+
+            const BOOL bValid = nChannel < m_wChannels;
+            const float fAverage = bValid ? m_fAverage[nChannel] : 0.0f;
+            const float fPeak = bValid ? m_fPeak[nChannel] : 0.0f;
+
+            MemoryBarrier();
+            if (lSequence == m_lSequence)
+            {
+                if (m_lResetPending)
+                    return ReadEmpty(pfAverage, pfPeak);
+
+                if (pfAverage)
+                    *pfAverage = fAverage;
+                if (pfPeak)
+                    *pfPeak = fPeak;
+                return bValid;
+            }
+        }
+    }
+
+  private:
+    static BOOL ReadEmpty(float *pfAverage, float *pfPeak)
+    {
+        if (pfAverage)
+            *pfAverage = 0.0f;
+        if (pfPeak)
+            *pfPeak = 0.0f;
+        return FALSE;
+    }
+
+    volatile LONG m_lSequence = 0;
+    volatile LONG m_lResetPending = FALSE;
+
+    WORD m_wChannels = 0;
+    float m_fAverage[LAV_VOLUME_STATS_CHANNELS] = {0};
+    float m_fPeak[LAV_VOLUME_STATS_CHANNELS] = {0};
+};
@@ -0,0 +1,672 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Headless benchmark of the LAV Audio decoding and post-processing pipeline
+//
+// Usage: LAVAudioBench [seconds] [output sample rate] [decodeahead] [<file> ...]
+//
+// LAVAudio.ax is loaded from the working directory without registration. A stub source pin feeds it as fast as it is
+// accepted, and a stub renderer pin discards the output without a clock.
+// Without files, the source produces synthetic PCM, and every combination of channel layout, input format, output
+// format and mixing layout is run once, with the given seconds of audio (default 60).
+// Files are raw elementary streams (.ac3, .eac3, .dts, .aac with ADTS headers, .mp3 or .thd), which the source
+// delivers in fixed size packets for the parser of the decoder to split, and every file is run once for every
+// combination of output format and mixing layout.
+// Every run prints one line with the throughput and wall clock time of the whole run, and the cost of every stage
+// (see ILAVAudioStatus::GetProcessingStats) in TSC cycles per sample and as a share of the wall clock time. Stages
+// running on another thread (ie. with decodeahead) overlap, so their shares can add up to more than 100%.
+
+#include "stdafx.h"
+
+#include <intrin.h>
+#include <vector>
+
+// Initialize the GUIDs
+#include <InitGuid.h>
+
+#include "moreuuids.h"
+#include "LAVAudioSettings.h"
+#include "ProcessingCounter.h"
+
+// The base classes expect the factory template table of a filter DLL
+CFactoryTemplate g_Templates[1] = {};
+int g_cTemplates = 0;
+
+// {E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491}
+DEFINE_GUID(CLSID_LAVAudio, 0xe8e73b6b, 0x4cb3, 0x44a4, 0xbe, 0x99, 0x4f, 0x7b, 0xcb, 0x96, 0xe4, 0x91);
+
+#define BENCH_SAMPLE_RATE 48000
+#define BENCH_SAMPLES_PER_BUFFER 1024
+#define BENCH_PACKET_SIZE 8192
+
+struct BenchLayout
+{
+    const char *szName;
+    WORD nChannels;
+};
+
+struct BenchInputFormat
+{
+    const char *szName;
+    const GUID *pSubtype;
+    WORD wBitsPerSample;
+    BOOL bFloat;
+};
+
+struct BenchCodec
+{
+    const char *szName;
+    const wchar_t *szExtension;
+    const GUID *pSubtype;
+};
+
+struct BenchOutputFormat
+{
+    const char *szName;
+    LAVAudioSampleFormat sfFormat;
+};
+
+struct BenchMixing
+{
+    const char *szName;
+    DWORD dwLayout;
+};
+
+static const BenchLayout s_Layouts[] = {{"mono", 1}, {"stereo", 2}, {"5.1", 6}, {"7.1", 8}};
+
+// little-endian QuickTime PCM, which LAV Audio decodes with the plain PCM decoders
+static const BenchInputFormat s_InputFormats[] = {{"s16", &MEDIASUBTYPE_PCM_SOWT, 16, FALSE},
+                                                  {"s24", &MEDIASUBTYPE_PCM_IN24_le, 24, FALSE},
+                                                  {"s32", &MEDIASUBTYPE_PCM_IN32_le, 32, FALSE},
+                                                  {"flt", &MEDIASUBTYPE_PCM_FL32_le, 32, TRUE}};
+
+// elementary streams which the decoder parses itself
+static const BenchCodec s_Codecs[] = {{"ac3", L".ac3", &MEDIASUBTYPE_DOLBY_AC3},
+                                      {"eac3", L".eac3", &MEDIASUBTYPE_DOLBY_DDPLUS},
+                                      {"dts", L".dts", &MEDIASUBTYPE_DTS},
+                                      {"aac", L".aac", &MEDIASUBTYPE_MPEG_ADTS_AAC},
+                                      {"mp3", L".mp3", &MEDIASUBTYPE_MP3},
+                                      {"truehd", L".thd", &MEDIASUBTYPE_DOLBY_TRUEHD}};
+
+static const BenchOutputFormat s_OutputFormats[] = {
+    {"s16", SampleFormat_16}, {"s24", SampleFormat_24}, {"s32", SampleFormat_32}, {"flt", SampleFormat_FP32}};
+
+static const BenchMixing s_Mixing[] = {{"-", 0}, {"stereo", SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT}};
+
+static const LAVAudioSampleFormat s_AllSampleFormats[] = {SampleFormat_16, SampleFormat_24, SampleFormat_32,
+                                                          SampleFormat_U8, SampleFormat_FP32};
+
+// Either a synthetic PCM layout and format, or an elementary stream of a codec
+struct BenchConfig
+{
+    const BenchLayout *pLayout;
+    const BenchInputFormat *pInput;
+    const BenchCodec *pCodec;
+    const std::vector<BYTE> *pStream;
+    const BenchOutputFormat *pOutput;
+    const BenchMixing *pMixing;
+    DWORD dwOutputRate;
+    BOOL bDecodeAhead;
+    ULONGLONG ullSamples;
+};
+
+// Output pin of the stub source
+// Delivers the same buffer of sine tones, with continuous timestamps, until the configured length is reached
+class CBenchSourcePin : public CSourceStream
+{
+  public:
+    CBenchSourcePin(CSource *pFilter, const BenchConfig &config, HRESULT *phr);
+
+    HRESULT GetMediaType(CMediaType *pmt) override;
+    HRESULT DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *pRequest) override;
+    HRESULT FillBuffer(IMediaSample *pSample) override;
+
+    STDMETHODIMP Notify(IBaseFilter *pSender, Quality q) override { return E_NOTIMPL; }
+
+  private:
+    const BenchConfig m_Config;
+    const WORD m_nBlockAlign = 0;
+
+    std::vector<BYTE> m_Buffer;
+    ULONGLONG m_ullDelivered = 0;
+};
+
+CBenchSourcePin::CBenchSourcePin(CSource *pFilter, const BenchConfig &config, HRESULT *phr)
+    : CSourceStream(NAME("Bench Source Pin"), phr, pFilter, L"Output")
+    , m_Config(config)
+    , m_nBlockAlign(config.pLayout->nChannels * config.pInput->wBitsPerSample / 8)
+{
+    const WORD nChannels = m_Config.pLayout->nChannels;
+    m_Buffer.resize(BENCH_SAMPLES_PER_BUFFER * m_nBlockAlign);
+
+    // a different tone on every channel, at half scale
+    BYTE *pData = m_Buffer.data();
+    for (unsigned i = 0; i < BENCH_SAMPLES_PER_BUFFER; i++)
+    {
+        for (WORD ch = 0; ch < nChannels; ch++)
+        {
+            const double dValue = 0.5 * sin(2.0 * M_PI * 250.0 * (ch + 1) * i / BENCH_SAMPLE_RATE);
+            if (m_Config.pInput->bFloat)
+            {
+                *(float *)pData = (float)dValue;
+                pData += 4;
+            }
+            else
+            {
+                const int nValue = (int)(dValue * INT_MAX);
+                for (int b = 32 - m_Config.pInput->wBitsPerSample; b < 32; b += 8)
+                    *pData++ = (BYTE)(nValue >> b);
+            }
+        }
+    }
+}
+
+HRESULT CBenchSourcePin::GetMediaType(CMediaType *pmt)
+{
+    WAVEFORMATEX *wfe = (WAVEFORMATEX *)pmt->AllocFormatBuffer(sizeof(WAVEFORMATEX));
+    if (!wfe)
+        return E_OUTOFMEMORY;
+
+    memset(wfe, 0, sizeof(WAVEFORMATEX));
+    wfe->wFormatTag = m_Config.pInput->bFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    wfe->nChannels = m_Config.pLayout->nChannels;
+    wfe->nSamplesPerSec = BENCH_SAMPLE_RATE;
+    wfe->wBitsPerSample = m_Config.pInput->wBitsPerSample;
+    wfe->nBlockAlign = m_nBlockAlign;
+    wfe->nAvgBytesPerSec = wfe->nBlockAlign * wfe->nSamplesPerSec;
+
+    pmt->SetType(&MEDIATYPE_Audio);
+    pmt->SetSubtype(m_Config.pInput->pSubtype);
+    pmt->SetFormatType(&FORMAT_WaveFormatEx);
+    pmt->SetSampleSize(m_nBlockAlign);
+    return S_OK;
+}
+
+HRESULT CBenchSourcePin::DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *pRequest)
+{
+    pRequest->cBuffers = max(pRequest->cBuffers, 4);
+    pRequest->cbBuffer = max(pRequest->cbBuffer, (long)m_Buffer.size());
+
+    ALLOCATOR_PROPERTIES actual;
+    HRESULT hr = pAlloc->SetProperties(pRequest, &actual);
+    if (FAILED(hr))
+        return hr;
+
+    return (actual.cbBuffer < (long)m_Buffer.size()) ? E_FAIL : S_OK;
+}
+
+HRESULT CBenchSourcePin::FillBuffer(IMediaSample *pSample)
+{
+    if (m_ullDelivered >= m_Config.ullSamples)
+        return S_FALSE;
+
+    BYTE *pData = nullptr;
+    HRESULT hr = pSample->GetPointer(&pData);
+    if (FAILED(hr))
+        return hr;
+
+    const unsigned nSamples = (unsigned)min(m_Config.ullSamples - m_ullDelivered, BENCH_SAMPLES_PER_BUFFER);
+    memcpy(pData, m_Buffer.data(), nSamples * m_nBlockAlign);
+    pSample->SetActualDataLength(nSamples * m_nBlockAlign);
+
+    REFERENCE_TIME rtStart = (REFERENCE_TIME)(m_ullDelivered * 10000000 / BENCH_SAMPLE_RATE);
+    REFERENCE_TIME rtStop = (REFERENCE_TIME)((m_ullDelivered + nSamples) * 10000000 / BENCH_SAMPLE_RATE);
+    pSample->SetTime(&rtStart, &rtStop);
+    pSample->SetSyncPoint(TRUE);
+    pSample->SetDiscontinuity(m_ullDelivered == 0);
+
+    m_ullDelivered += nSamples;
+    return S_OK;
+}
+
+// Output pin of the stub source for elementary streams
+// Delivers the stream in packets of a fixed size, only the first one with a timestamp
+class CBenchPacketPin : public CSourceStream
+{
+  public:
+    CBenchPacketPin(CSource *pFilter, const BenchConfig &config, HRESULT *phr)
+        : CSourceStream(NAME("Bench Packet Pin"), phr, pFilter, L"Output")
+        , m_Config(config)
+    {
+    }
+
+    HRESULT GetMediaType(CMediaType *pmt) override;
+    HRESULT DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *pRequest) override;
+    HRESULT FillBuffer(IMediaSample *pSample) override;
+
+    STDMETHODIMP Notify(IBaseFilter *pSender, Quality q) override { return E_NOTIMPL; }
+
+  private:
+    const BenchConfig m_Config;
+    size_t m_nDelivered = 0;
+};
+
+HRESULT CBenchPacketPin::GetMediaType(CMediaType *pmt)
+{
+    // the decoder takes the channels and sample rate from the stream
+    WAVEFORMATEX *wfe = (WAVEFORMATEX *)pmt->AllocFormatBuffer(sizeof(WAVEFORMATEX));
+    if (!wfe)
+        return E_OUTOFMEMORY;
+
+    memset(wfe, 0, sizeof(WAVEFORMATEX));
+
+    pmt->SetType(&MEDIATYPE_Audio);
+    pmt->SetSubtype(m_Config.pCodec->pSubtype);
+    pmt->SetFormatType(&FORMAT_WaveFormatEx);
+    pmt->SetVariableSize();
+    return S_OK;
+}
+
+HRESULT CBenchPacketPin::DecideBufferSize(IMemAllocator *pAlloc, ALLOCATOR_PROPERTIES *pRequest)
+{
+    pRequest->cBuffers = max(pRequest->cBuffers, 4);
+    pRequest->cbBuffer = max(pRequest->cbBuffer, BENCH_PACKET_SIZE);
+
+    ALLOCATOR_PROPERTIES actual;
+    HRESULT hr = pAlloc->SetProperties(pRequest, &actual);
+    if (FAILED(hr))
+        return hr;
+
+    return (actual.cbBuffer < BENCH_PACKET_SIZE) ? E_FAIL : S_OK;
+}
+
+HRESULT CBenchPacketPin::FillBuffer(IMediaSample *pSample)
+{
+    const std::vector<BYTE> &stream = *m_Config.pStream;
+    if (m_nDelivered >= stream.size())
+        return S_FALSE;
+
+    BYTE *pData = nullptr;
+    HRESULT hr = pSample->GetPointer(&pData);
+    if (FAILED(hr))
+        return hr;
+
+    const size_t nBytes = min(stream.size() - m_nDelivered, (size_t)BENCH_PACKET_SIZE);
+    memcpy(pData, stream.data() + m_nDelivered, nBytes);
+    pSample->SetActualDataLength((long)nBytes);
+
+    // the decoder interpolates the timestamps of the following packets from the decoded samples
+    if (m_nDelivered == 0)
+    {
+        REFERENCE_TIME rtStart = 0;
+        pSample->SetTime(&rtStart, nullptr);
+    }
+    else
+        pSample->SetTime(nullptr, nullptr);
+    pSample->SetSyncPoint(TRUE);
+    pSample->SetDiscontinuity(m_nDelivered == 0);
+
+    m_nDelivered += nBytes;
+    return S_OK;
+}
+
+// Stub source filter, the pin is owned by the base class
+class CBenchSource : public CSource
+{
+  public:
+    CBenchSource(const BenchConfig &config, HRESULT *phr)
+        : CSource(NAME("Bench Source"), nullptr, GUID_NULL, phr)
+    {
+        if (config.pCodec)
+            new CBenchPacketPin(this, config, phr);
+        else
+            new CBenchSourcePin(this, config, phr);
+    }
+};
+
+// Stub renderer, accepts any PCM audio and discards it, counting the samples
+class CBenchRenderer : public CBaseRenderer
+{
+  public:
+    CBenchRenderer(HRESULT *phr)
+        : CBaseRenderer(GUID_NULL, NAME("Bench Renderer"), nullptr, phr)
+    {
+    }
+
+    HRESULT CheckMediaType(const CMediaType *pmt) override
+    {
+        return (pmt->majortype == MEDIATYPE_Audio && pmt->formattype == FORMAT_WaveFormatEx) ? S_OK : S_FALSE;
+    }
+
+    HRESULT SetMediaType(const CMediaType *pmt) override
+    {
+        m_nBlockAlign = ((const WAVEFORMATEX *)pmt->Format())->nBlockAlign;
+        m_nSampleRate = ((const WAVEFORMATEX *)pmt->Format())->nSamplesPerSec;
+        return CBaseRenderer::SetMediaType(pmt);
+    }
+
+    HRESULT DoRenderSample(IMediaSample *pSample) override
+    {
+        // dynamic format changes come with the sample
+        AM_MEDIA_TYPE *pmt = nullptr;
+        if (pSample->GetMediaType(&pmt) == S_OK && pmt)
+        {
+            if (pmt->formattype == FORMAT_WaveFormatEx && pmt->pbFormat)
+            {
+                m_nBlockAlign = ((const WAVEFORMATEX *)pmt->pbFormat)->nBlockAlign;
+                m_nSampleRate = ((const WAVEFORMATEX *)pmt->pbFormat)->nSamplesPerSec;
+            }
+            DeleteMediaType(pmt);
+        }
+
+        if (m_nBlockAlign && m_nSampleRate)
+        {
+            const long nSamples = pSample->GetActualDataLength() / m_nBlockAlign;
+            m_ullSamples += nSamples;
+            m_dSeconds += (double)nSamples / m_nSampleRate;
+        }
+        return S_OK;
+    }
+
+    ULONGLONG GetSamples() const { return m_ullSamples; }
+    double GetSeconds() const { return m_dSeconds; }
+    DWORD GetSampleRate() const { return m_nSampleRate; }
+
+  private:
+    WORD m_nBlockAlign = 0;
+    DWORD m_nSampleRate = 0;
+    ULONGLONG m_ullSamples = 0;
+    double m_dSeconds = 0.0;
+};
+
+static HRESULT GetFilterPin(IBaseFilter *pFilter, PIN_DIRECTION dir, IPin **ppPin)
+{
+    CComPtr<IEnumPins> pEnum;
+    HRESULT hr = pFilter->EnumPins(&pEnum);
+    if (FAILED(hr))
+        return hr;
+
+    CComPtr<IPin> pPin;
+    while (pEnum->Next(1, &pPin, nullptr) == S_OK)
+    {
+        PIN_DIRECTION pinDir;
+        if (SUCCEEDED(pPin->QueryDirection(&pinDir)) && pinDir == dir)
+        {
+            *ppPin = pPin.Detach();
+            return S_OK;
+        }
+        pPin.Release();
+    }
+    return VFW_E_NOT_FOUND;
+}
+
+static HRESULT ConfigureDecoder(IBaseFilter *pDecoder, const BenchConfig &config)
+{
+    CComQIPtr<ILAVAudioSettings> pSettings(pDecoder);
+    if (!pSettings)
+        return E_NOINTERFACE;
+
+    // runtime config, so the settings in the registry are neither used nor changed
+    HRESULT hr = pSettings->SetRuntimeConfig(TRUE);
+    if (FAILED(hr))
+        return hr;
+
+    for (LAVAudioSampleFormat sfFormat : s_AllSampleFormats)
+        pSettings->SetSampleFormat(sfFormat, sfFormat == config.pOutput->sfFormat);
+
+    pSettings->SetMixingEnabled(config.pMixing->dwLayout != 0);
+    if (config.pMixing->dwLayout)
+    {
+        pSettings->SetMixingLayout(config.pMixing->dwLayout);
+        pSettings->SetMixingFlags(0);
+    }
+    pSettings->SetOutputSampleRate(config.dwOutputRate);
+    pSettings->SetDecodeAhead(config.bDecodeAhead);
+    pSettings->SetTrayIcon(FALSE);
+
+    return S_OK;
+}
+
+// Print the source of the run, the layout and input format of synthetic PCM or the codec of an elementary stream
+static void PrintRunName(const BenchConfig &config)
+{
+    if (config.pCodec)
+        printf("%-12s", config.pCodec->szName);
+    else
+        printf("%-7s %-4s", config.pLayout->szName, config.pInput->szName);
+}
+
+// Build the graph for the configuration, run it to the end of the stream, and print the results
+static HRESULT RunBenchmark(IClassFactory *pFactory, const BenchConfig &config)
+{
+    HRESULT hr = S_OK;
+
+    CComPtr<IGraphBuilder> pGraph;
+    CComPtr<IBaseFilter> pSource, pDecoder, pRenderer;
+    CComPtr<IPin> pSourceOut, pDecoderIn, pDecoderOut, pRendererIn;
+
+    CBenchRenderer *pBenchRenderer = new CBenchRenderer(&hr);
+    pRenderer = pBenchRenderer;
+    if (FAILED(hr))
+        return hr;
+
+    pSource = new CBenchSource(config, &hr);
+    if (FAILED(hr))
+        return hr;
+
+    if (FAILED(hr = pGraph.CoCreateInstance(CLSID_FilterGraph)) ||
+        FAILED(hr = pFactory->CreateInstance(nullptr, IID_PPV_ARGS(&pDecoder))) ||
+        FAILED(hr = ConfigureDecoder(pDecoder, config)))
+        return hr;
+
+    if (FAILED(hr = pGraph->AddFilter(pSource, L"Source")) || FAILED(hr = pGraph->AddFilter(pDecoder, L"Decoder")) ||
+        FAILED(hr = pGraph->AddFilter(pRenderer, L"Renderer")))
+        return hr;
+
+    if (FAILED(hr = GetFilterPin(pSource, PINDIR_OUTPUT, &pSourceOut)) ||
+        FAILED(hr = GetFilterPin(pDecoder, PINDIR_INPUT, &pDecoderIn)) ||
+        FAILED(hr = GetFilterPin(pDecoder, PINDIR_OUTPUT, &pDecoderOut)) ||
+        FAILED(hr = GetFilterPin(pRenderer, PINDIR_INPUT, &pRendererIn)))
+        return hr;
+
+    if (FAILED(hr = pGraph->ConnectDirect(pSourceOut, pDecoderIn, nullptr)) ||
+        FAILED(hr = pGraph->ConnectDirect(pDecoderOut, pRendererIn, nullptr)))
+        return hr;
+
+    // without a clock, the renderer consumes every sample right away
+    CComQIPtr<IMediaFilter> pMediaFilter(pGraph);
+    CComQIPtr<IMediaControl> pControl(pGraph);
+    CComQIPtr<IMediaEvent> pEvent(pGraph);
+    CComQIPtr<ILAVAudioStatus> pStatus(pDecoder);
+    if (!pMediaFilter || !pControl || !pEvent || !pStatus)
+        return E_NOINTERFACE;
+
+    if (FAILED(hr = pMediaFilter->SetSyncSource(nullptr)))
+        return hr;
+
+    const LONGLONG llStart = CProcessingCounter::Now();
+    const ULONGLONG ullTscStart = __rdtsc();
+    if (FAILED(hr = pControl->Run()))
+        return hr;
+
+    long lEventCode = 0;
+    hr = pEvent->WaitForCompletion(INFINITE, &lEventCode);
+    const ULONGLONG ullTscElapsed = __rdtsc() - ullTscStart;
+    const REFERENCE_TIME rtElapsed = CProcessingCounter::TicksToTime(CProcessingCounter::Now() - llStart);
+
+    // the statistics are reset when streaming starts again, so read them before stopping
+    ULONGLONG ullStageSamples[LAVAudioStage_NB] = {0};
+    REFERENCE_TIME rtStageTime[LAVAudioStage_NB] = {0};
+    for (int i = 0; i < LAVAudioStage_NB; i++)
+        pStatus->GetProcessingStats((LAVAudioStage)i, &ullStageSamples[i], &rtStageTime[i]);
+
+    pControl->Stop();
+
+    if (FAILED(hr) || lEventCode != EC_COMPLETE)
+        return FAILED(hr) ? hr : E_FAIL;
+
+    // the samples going into the decoder, which are only known after decoding for elementary streams
+    const ULONGLONG ullSamples = config.pCodec ? ullStageSamples[LAVAudioStage_Decode] : config.ullSamples;
+
+    PrintRunName(config);
+    printf(" %-4s %-7s %6u %10.2f %8.1f %9.1f", config.pOutput->szName, config.pMixing->szName,
+           pBenchRenderer->GetSampleRate(), rtElapsed ? ullSamples * 10.0 / rtElapsed : 0.0,
+           rtElapsed ? pBenchRenderer->GetSeconds() * 10000000.0 / rtElapsed : 0.0, rtElapsed / 10000.0);
+
+    // TSC cycles per sample and share of the wall clock of every stage, with the TSC rate measured over the run
+    const double dCyclesPerTime = rtElapsed ? (double)ullTscElapsed / rtElapsed : 0.0;
+    for (int i = 0; i < LAVAudioStage_NB; i++)
+        printf(" %8.1f %5.1f%%", ullStageSamples[i] ? rtStageTime[i] * dCyclesPerTime / ullStageSamples[i] : 0.0,
+               rtElapsed ? rtStageTime[i] * 100.0 / rtElapsed : 0.0);
+    printf(" %12I64u\n", pBenchRenderer->GetSamples());
+
+    return S_OK;
+}
+
+// Find the codec of an elementary stream by the extension of the file name
+static const BenchCodec *FindCodec(const wchar_t *szFile)
+{
+    const wchar_t *szExtension = wcsrchr(szFile, L'.');
+    if (!szExtension)
+        return nullptr;
+
+    for (const BenchCodec &codec : s_Codecs)
+    {
+        if (_wcsicmp(szExtension, codec.szExtension) == 0)
+            return &codec;
+    }
+    return nullptr;
+}
+
+static HRESULT ReadStream(const wchar_t *szFile, std::vector<BYTE> &stream)
+{
+    FILE *pFile = _wfopen(szFile, L"rb");
+    if (!pFile)
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+    BYTE buffer[65536];
+    size_t nRead = 0;
+    while ((nRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+        stream.insert(stream.end(), buffer, buffer + nRead);
+    fclose(pFile);
+
+    return stream.empty() ? E_FAIL : S_OK;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+    // numbers are the seconds and the output sample rate, in that order, everything else is an option or a file
+    int nSeconds = 60;
+    DWORD dwOutputRate = 0;
+    BOOL bDecodeAhead = FALSE;
+    int nNumbers = 0;
+    std::vector<const wchar_t *> files;
+    for (int i = 1; i < argc; i++)
+    {
+        if (_wcsicmp(argv[i], L"decodeahead") == 0)
+            bDecodeAhead = TRUE;
+        else if (argv[i][0] && wcsspn(argv[i], L"0123456789") == wcslen(argv[i]) && nNumbers < 2)
+        {
+            if (nNumbers++ == 0)
+                nSeconds = _wtoi(argv[i]);
+            else
+                dwOutputRate = (DWORD)_wtoi(argv[i]);
+        }
+        else if (FindCodec(argv[i]))
+            files.push_back(argv[i]);
+        else
+        {
+            nSeconds = 0;
+            break;
+        }
+    }
+
+    if (nSeconds <= 0)
+    {
+        fwprintf(stderr, L"Usage: %s [seconds] [output sample rate] [decodeahead] [<file> ...]\n", argv[0]);
+        fwprintf(stderr, L"Files are elementary streams: .ac3, .eac3, .dts, .aac (ADTS), .mp3 or .thd\n");
+        return 1;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+        return 1;
+
+    int ret = 1;
+    HMODULE hDecoder = LoadLibrary(L"LAVAudio.ax");
+    typedef HRESULT(STDAPICALLTYPE * PFN_DLLGETCLASSOBJECT)(REFCLSID, REFIID, LPVOID *);
+    PFN_DLLGETCLASSOBJECT pfnGetClassObject =
+        hDecoder ? (PFN_DLLGETCLASSOBJECT)GetProcAddress(hDecoder, "DllGetClassObject") : nullptr;
+
+    CComPtr<IClassFactory> pFactory;
+    if (!pfnGetClassObject || FAILED(pfnGetClassObject(CLSID_LAVAudio, IID_PPV_ARGS(&pFactory))))
+    {
+        fwprintf(stderr, L"LAVAudio.ax could not be loaded from the working directory\n");
+        goto done;
+    }
+
+    printf("%-12s %-4s %-7s %6s %10s %8s %9s %8s %6s %8s %6s %8s %6s %8s %6s %12s\n", "source", "out", "mix", "rate",
+           "Msamples/s", "realtime", "wall ms", "decode", "", "postproc", "", "queue", "", "deliver", "",
+           "out samples");
+
+    if (files.empty())
+    {
+        const ULONGLONG ullSamples = (ULONGLONG)nSeconds * BENCH_SAMPLE_RATE;
+        for (const BenchLayout &layout : s_Layouts)
+        {
+            for (const BenchInputFormat &input : s_InputFormats)
+            {
+                for (const BenchOutputFormat &output : s_OutputFormats)
+                {
+                    for (const BenchMixing &mixing : s_Mixing)
+                    {
+                        const BenchConfig config = {&layout,      &input,       nullptr, nullptr, &output, &mixing,
+                                                    dwOutputRate, bDecodeAhead, ullSamples};
+                        HRESULT hr = RunBenchmark(pFactory, config);
+                        if (FAILED(hr))
+                            printf("%-7s %-4s %-4s %-7s failed (0x%08x)\n", layout.szName, input.szName,
+                                   output.szName, mixing.szName, hr);
+                    }
+                }
+            }
+        }
+    }
+
+    for (const wchar_t *szFile : files)
+    {
+        std::vector<BYTE> stream;
+        HRESULT hr = ReadStream(szFile, stream);
+        if (FAILED(hr))
+        {
+            wprintf(L"%s could not be read (0x%08x)\n", szFile, hr);
+            continue;
+        }
+
+        wprintf(L"%s\n", szFile);
+        const BenchCodec *pCodec = FindCodec(szFile);
+        for (const BenchOutputFormat &output : s_OutputFormats)
+        {
+            for (const BenchMixing &mixing : s_Mixing)
+            {
+                const BenchConfig config = {nullptr, nullptr,      pCodec,       &stream, &output,
+                                            &mixing, dwOutputRate, bDecodeAhead, 0};
+                hr = RunBenchmark(pFactory, config);
+                if (FAILED(hr))
+                    printf("%-12s %-4s %-7s failed (0x%08x)\n", pCodec->szName, output.szName, mixing.szName, hr);
+            }
+        }
+    }
+    ret = 0;
+
+done:
+    pFactory.Release();
+    if (hDecoder)
+        FreeLibrary(hDecoder);
+    CoUninitialize();
+    return ret;
+}
@@ -0,0 +1,362 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "Deinterlacer.h"
+#include "LAVFramePool.h"
+
+// Slice threading only pays off if every thread gets a reasonable amount of lines to work on
+#define DEINT_PIXELS_PER_THREAD (128 * 1024)
+
+static AVPixelFormat deint_ff_pixfmt(LAVPixelFormat format)
+{
+    switch (format)
+    {
+    case LAVPixFmt_YUV420: return AV_PIX_FMT_YUV420P;
+    case LAVPixFmt_YUV422: return AV_PIX_FMT_YUV422P;
+    case LAVPixFmt_NV12: return AV_PIX_FMT_NV12;
+    case LAVPixFmt_NV21: return AV_PIX_FMT_NV21;
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+static LAVPixelFormat deint_lav_pixfmt(int format)
+{
+    switch (format)
+    {
+    case AV_PIX_FMT_YUV420P: return LAVPixFmt_YUV420;
+    case AV_PIX_FMT_YUV422P: return LAVPixFmt_YUV422;
+    case AV_PIX_FMT_NV21: return LAVPixFmt_NV21;
+    }
+    return LAVPixFmt_NV12;
+}
+
+static int deint_thread_count(int width, int height)
+{
+    return av_clip((width * height) / DEINT_PIXELS_PER_THREAD, 1, av_cpu_count());
+}
+
+static void lav_free_lavframe(void *opaque, uint8_t *data)
+{
+    LAVFrame *frame = (LAVFrame *)opaque;
+    FreeLAVFrameBuffers(frame);
+    CLAVFramePool::Get().FreeFrame(frame);
+}
+
+static void lav_unref_frame(void *opaque, uint8_t *data)
+{
+    AVBufferRef *buf = (AVBufferRef *)opaque;
+    av_buffer_unref(&buf);
+}
+
+static void avfilter_free_lav_buffer(LAVFrame *pFrame)
+{
+    CLAVFramePool::Get().FreeAVFrame((AVFrame *)pFrame->priv_data);
+    pFrame->priv_data = nullptr;
+}
+
+CLAVDeinterlacer::CLAVDeinterlacer()
+{
+    m_pInFrame = av_frame_alloc();
+}
+
+CLAVDeinterlacer::~CLAVDeinterlacer()
+{
+    Close();
+    av_frame_free(&m_pInFrame);
+}
+
+BOOL CLAVDeinterlacer::IsFormatSupported(LAVPixelFormat format, LAVSWDeintModes mode)
+{
+    if ((mode == SWDeintMode_YADIF || mode == SWDeintMode_BWDIF) && CLAVYadif::IsFormatSupported(format))
+        return TRUE;
+
+    return deint_ff_pixfmt(format) != AV_PIX_FMT_NONE;
+}
+
+BOOL CLAVDeinterlacer::IsConfigured(LAVPixelFormat format, int width, int height, LAVSWDeintModes mode,
+                                    LAVDeintOutput output) const
+{
+    return IsOpen() && format == m_Format && width == m_Width && height == m_Height && mode == m_Mode &&
+           output == m_Output;
+}
+
+HRESULT CLAVDeinterlacer::Open(LAVPixelFormat format, int width, int height, AVRational aspect_ratio,
+                               LAVSWDeintModes mode, LAVDeintOutput output)
+{
+    const BOOL bNative =
+        (mode == SWDeintMode_YADIF || mode == SWDeintMode_BWDIF) && CLAVYadif::IsFormatSupported(format);
+
+    // the native deinterlacer holds nothing tied to the frame size, so it is reset instead of re-created
+    if (!bNative || !m_pYadif)
+        Close();
+
+    const int threads = deint_thread_count(width, height);
+    HRESULT hr = S_OK;
+
+    if (bNative)
+    {
+        DbgLog((LOG_TRACE, 10, L"CLAVDeinterlacer::Open(): Initializing %s for %dx%d using %d threads",
+                mode == SWDeintMode_BWDIF ? L"BWDIF" : L"YADIF", width, height, threads));
+        if (m_pYadif)
+            m_pYadif->Reset(format, output == DeintOutput_FramePerField, threads, mode == SWDeintMode_BWDIF);
+        else
+            m_pYadif = new CLAVYadif(format, output == DeintOutput_FramePerField, threads, mode == SWDeintMode_BWDIF);
+    }
+    else
+    {
+        char filter[128];
+        if (mode == SWDeintMode_YADIF)
+            _snprintf_s(filter, sizeof(filter), "yadif=mode=%s:parity=auto:deint=interlaced",
+                        (output == DeintOutput_FramePerField) ? "send_field" : "send_frame");
+        else if (mode == SWDeintMode_BWDIF)
+            _snprintf_s(filter, sizeof(filter), "bwdif=mode=%s:parity=auto:deint=interlaced",
+                        (output == DeintOutput_FramePerField) ? "send_field" : "send_frame");
+        else if (mode == SWDeintMode_W3FDIF_Simple)
+            _snprintf_s(filter, sizeof(filter), "w3fdif=filter=simple:deint=interlaced");
+        else if (mode == SWDeintMode_W3FDIF_Complex)
+            _snprintf_s(filter, sizeof(filter), "w3fdif=filter=complex:deint=interlaced");
+        else
+            return E_INVALIDARG;
+
+        hr = OpenGraph(format, width, height, aspect_ratio, filter, threads);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_Format = format;
+        m_Width = width;
+        m_Height = height;
+        m_Mode = mode;
+        m_Output = output;
+    }
+    return hr;
+}
+
+HRESULT CLAVDeinterlacer::OpenGraph(LAVPixelFormat format, int width, int height, AVRational aspect_ratio,
+                                    const char *filter, int threads)
+{
+    const AVPixelFormat ff_pixfmt = deint_ff_pixfmt(format);
+    if (ff_pixfmt == AV_PIX_FMT_NONE)
+        return E_INVALIDARG;
+
+    DbgLog((LOG_TRACE, 10, L"CLAVDeinterlacer::OpenGraph(): Initializing %S for %dx%d using %d threads", filter, width,
+            height, threads));
+
+    char args[512];
+    enum AVPixelFormat pix_fmts[3];
+
+    if (ff_pixfmt == AV_PIX_FMT_NV12 || ff_pixfmt == AV_PIX_FMT_NV21)
+    {
+        pix_fmts[0] = ff_pixfmt;
+        pix_fmts[1] = AV_PIX_FMT_YUV420P;
+    }
+    else
+    {
+        pix_fmts[0] = ff_pixfmt;
+        pix_fmts[1] = AV_PIX_FMT_NONE;
+    }
+    pix_fmts[2] = AV_PIX_FMT_NONE;
+
+    const AVFilter *buffersrc = avfilter_get_by_name("buffer");
+    const AVFilter *buffersink = avfilter_get_by_name("buffersink");
+    AVFilterInOut *outputs = avfilter_inout_alloc();
+    AVFilterInOut *inputs = avfilter_inout_alloc();
+    int ret = 0;
+
+    m_pGraph = avfilter_graph_alloc();
+
+    av_opt_set(m_pGraph, "thread_type", "slice", AV_OPT_SEARCH_CHILDREN);
+    av_opt_set_int(m_pGraph, "threads", threads, AV_OPT_SEARCH_CHILDREN);
+
+    // 0/0 is not a valid value for avfilter, make sure it doesn't happen
+    if (aspect_ratio.num == 0 || aspect_ratio.den == 0)
+        aspect_ratio = {0, 1};
+
+    _snprintf_s(args, sizeof(args), "video_size=%dx%d:pix_fmt=%s:time_base=1/10000000:pixel_aspect=%d/%d", width,
+                height, av_get_pix_fmt_name(ff_pixfmt), aspect_ratio.num, aspect_ratio.den);
+    ret = avfilter_graph_create_filter(&m_pBufferSrc, buffersrc, "in", args, nullptr, m_pGraph);
+    if (ret < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"-> Creating the input buffer filter failed with code %d", ret));
+        goto fail;
+    }
+
+    ret = avfilter_graph_create_filter(&m_pBufferSink, buffersink, "out", nullptr, nullptr, m_pGraph);
+    if (ret < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"-> Creating the buffer sink filter failed with code %d", ret));
+        goto fail;
+    }
+
+    /* set allowed pixfmts on the output */
+    av_opt_set_int_list(m_pBufferSink->priv, "pix_fmts", pix_fmts, AV_PIX_FMT_NONE, 0);
+
+    /* Endpoints for the filter graph. */
+    outputs->name = av_strdup("in");
+    outputs->filter_ctx = m_pBufferSrc;
+    outputs->pad_idx = 0;
+    outputs->next = nullptr;
+
+    inputs->name = av_strdup("out");
+    inputs->filter_ctx = m_pBufferSink;
+    inputs->pad_idx = 0;
+    inputs->next = nullptr;
+
+    if ((ret = avfilter_graph_parse_ptr(m_pGraph, filter, &inputs, &outputs, nullptr)) < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"-> Parsing the graph failed with code %d", ret));
+        goto fail;
+    }
+
+    if ((ret = avfilter_graph_config(m_pGraph, nullptr)) < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"-> Configuring the graph failed with code %d", ret));
+        goto fail;
+    }
+
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+
+    return S_OK;
+
+fail:
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    Close();
+    return E_FAIL;
+}
+
+void CLAVDeinterlacer::Close()
+{
+    SAFE_DELETE(m_pYadif);
+
+    // the graph owns all filters
+    avfilter_graph_free(&m_pGraph);
+    m_pBufferSrc = nullptr;
+    m_pBufferSink = nullptr;
+
+    m_Format = LAVPixFmt_None;
+    m_Width = m_Height = 0;
+    m_Mode = SWDeintMode_None;
+}
+
+HRESULT CLAVDeinterlacer::SendFrame(LAVFrame *pFrame, BOOL bRefcounted)
+{
+    if (m_pYadif)
+        return m_pYadif->SendFrame(pFrame, bRefcounted);
+
+    if (!m_pGraph)
+        return E_UNEXPECTED;
+
+    AVFrame *in_frame = m_pInFrame;
+    for (int i = 0; i < 4; i++)
+    {
+        in_frame->data[i] = pFrame->data[i];
+        in_frame->linesize[i] = (int)pFrame->stride[i];
+    }
+
+    in_frame->width = pFrame->width;
+    in_frame->height = pFrame->height;
+    in_frame->format = deint_ff_pixfmt(pFrame->format);
+    in_frame->pts = pFrame->rtStart;
+    in_frame->interlaced_frame = pFrame->interlaced;
+    in_frame->top_field_first = pFrame->tff;
+    in_frame->sample_aspect_ratio = pFrame->aspect_ratio;
+
+    if (bRefcounted)
+    {
+        AVBufferRef *pFrameBuf = av_buffer_create(nullptr, 0, lav_free_lavframe, pFrame, 0);
+        const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)in_frame->format);
+        int planes =
+            (in_frame->format == AV_PIX_FMT_NV12 || in_frame->format == AV_PIX_FMT_NV21) ? 2 : desc->nb_components;
+
+        for (int i = 0; i < planes; i++)
+        {
+            int h_shift = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+            int plane_size = (in_frame->height >> h_shift) * in_frame->linesize[i];
+
+            AVBufferRef *planeRef = av_buffer_ref(pFrameBuf);
+            in_frame->buf[i] =
+                av_buffer_create(in_frame->data[i], plane_size, lav_unref_frame, planeRef, AV_BUFFER_FLAG_READONLY);
+        }
+        av_buffer_unref(&pFrameBuf);
+    }
+
+    // the buffer source takes over the references of a refcounted frame, and copies the data otherwise
+    int ret = av_buffersrc_add_frame(m_pBufferSrc, in_frame);
+    av_frame_unref(in_frame);
+
+    if (ret < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"CLAVDeinterlacer::SendFrame(): Adding the frame failed with code %d", ret));
+        return E_FAIL;
+    }
+    return S_OK;
+}
+
+HRESULT CLAVDeinterlacer::SendEOF()
+{
+    if (m_pYadif)
+        return m_pYadif->SendEOF();
+
+    if (!m_pGraph)
+        return E_UNEXPECTED;
+
+    return av_buffersrc_add_frame(m_pBufferSrc, nullptr) < 0 ? E_FAIL : S_OK;
+}
+
+HRESULT CLAVDeinterlacer::ReceiveFrame(LAVFrame *pFrame)
+{
+    if (m_pYadif)
+        return m_pYadif->ReceiveFrame(pFrame);
+
+    if (!m_pGraph)
+        return S_FALSE;
+
+    AVFrame *out_frame = CLAVFramePool::Get().AllocAVFrame();
+    if (!out_frame)
+        return E_OUTOFMEMORY;
+
+    if (av_buffersink_get_frame(m_pBufferSink, out_frame) < 0)
+    {
+        CLAVFramePool::Get().FreeAVFrame(out_frame);
+        return S_FALSE;
+    }
+
+    pFrame->format = deint_lav_pixfmt(out_frame->format);
+    pFrame->width = out_frame->width;
+    pFrame->height = out_frame->height;
+    pFrame->aspect_ratio = out_frame->sample_aspect_ratio;
+    pFrame->tff = out_frame->top_field_first;
+
+    AVRational time_base = av_buffersink_get_time_base(m_pBufferSink);
+    pFrame->rtStart = av_rescale(out_frame->pts, time_base.num * 10000000LL, time_base.den);
+
+    for (int i = 0; i < 4; i++)
+    {
+        pFrame->data[i] = out_frame->data[i];
+        pFrame->stride[i] = out_frame->linesize[i];
+    }
+
+    pFrame->destruct = avfilter_free_lav_buffer;
+    pFrame->priv_data = out_frame;
+
+    return S_OK;
+}
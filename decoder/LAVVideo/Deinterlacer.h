@@ -0,0 +1,77 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "decoders/ILAVDecoder.h"
+#include "LAVVideoSettings.h"
+#include "Yadif.h"
+
+// Software deinterlacer
+//
+// YADIF and BWDIF are implemented natively, the other modes use the avfilter deinterlacing filters.
+// The filter is kept across frames, and only re-created when the input format, the frame size or the mode changes.
+// The native deinterlacer is reset for the new configuration instead.
+// Output frames of avfilter are handed out as LAVFrames, which keep their AVFrame from the frame pool.
+class CLAVDeinterlacer
+{
+  public:
+    CLAVDeinterlacer();
+    ~CLAVDeinterlacer();
+
+    static BOOL IsFormatSupported(LAVPixelFormat format, LAVSWDeintModes mode);
+
+    // Check if the deinterlacer is configured for the given input and mode
+    BOOL IsConfigured(LAVPixelFormat format, int width, int height, LAVSWDeintModes mode, LAVDeintOutput output) const;
+    BOOL IsOpen() const { return m_pGraph != nullptr || m_pYadif != nullptr; }
+
+    // Create the deinterlacer for the given input
+    HRESULT Open(LAVPixelFormat format, int width, int height, AVRational aspect_ratio, LAVSWDeintModes mode,
+                 LAVDeintOutput output);
+    void Close();
+
+    // Send a frame into the graph
+    // If bRefcounted is set, the graph takes ownership of the frame and releases it when its done, otherwise the
+    // frame data is copied and the caller keeps ownership
+    HRESULT SendFrame(LAVFrame *pFrame, BOOL bRefcounted);
+    // Signal the end of the stream, so that the filter outputs the frames it is still holding
+    // The graph needs to be re-opened after this
+    HRESULT SendEOF();
+    // Retrieve the next output frame, returns S_FALSE if no frame is available
+    // Format, size, aspect ratio, field order, start time and the image are filled in, the rest is left untouched
+    HRESULT ReceiveFrame(LAVFrame *pFrame);
+
+  private:
+    HRESULT OpenGraph(LAVPixelFormat format, int width, int height, AVRational aspect_ratio, const char *filter,
+                      int threads);
+
+    CLAVYadif *m_pYadif = nullptr;
+
+    AVFilterGraph *m_pGraph = nullptr;
+    AVFilterContext *m_pBufferSrc = nullptr;
+    AVFilterContext *m_pBufferSink = nullptr;
+
+    LAVPixelFormat m_Format = LAVPixFmt_None;
+    int m_Width = 0;
+    int m_Height = 0;
+    LAVSWDeintModes m_Mode = SWDeintMode_None;
+    LAVDeintOutput m_Output = DeintOutput_FramePerField;
+
+    AVFrame *m_pInFrame = nullptr;
+};
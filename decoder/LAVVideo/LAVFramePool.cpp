@@ -0,0 +1,336 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVFramePool.h"
+#include "decoders/ILAVDecoder.h"
+
+// Every buffer is preceded by a header with the size of its allocation, so it can be put into the right size class,
+// and the instance that owns it
+#define POOL_BUFFER_HEADER 64
+#define POOL_MAX_FRAMES 64
+
+struct PoolBufferHeader
+{
+    size_t sizeClass;
+    const void *pOwner;
+};
+static_assert(sizeof(PoolBufferHeader) <= POOL_BUFFER_HEADER, "pool buffer header too large");
+
+static PoolBufferHeader *pool_buffer_header(BYTE *pBuffer)
+{
+    return (PoolBufferHeader *)(pBuffer - POOL_BUFFER_HEADER);
+}
+
+static size_t pool_size_class(size_t size)
+{
+    if (size <= 4096)
+        return FFALIGN(size, 64);
+    else if (size <= 1024 * 1024)
+        return FFALIGN(size, 4096);
+    return FFALIGN(size, 65536);
+}
+
+thread_local const void *CLAVFramePool::s_pThreadClient = nullptr;
+
+CLAVFramePool &CLAVFramePool::Get()
+{
+    static CLAVFramePool pool;
+    return pool;
+}
+
+CLAVFramePool::~CLAVFramePool()
+{
+    FlushLocked();
+}
+
+CLAVFramePool::ClientState *CLAVFramePool::FindClientLocked(const void *&pClient)
+{
+    if (pClient)
+    {
+        auto it = m_Clients.find(pClient);
+        if (it != m_Clients.end())
+            return &it->second;
+    }
+
+    pClient = nullptr;
+    return &m_Unowned;
+}
+
+BYTE *CLAVFramePool::AllocBuffer(size_t size)
+{
+    const size_t sizeClass = pool_size_class(size);
+    const void *pOwner = s_pThreadClient;
+
+    {
+        CAutoLock lock(&m_csPool);
+        ClientState *pState = FindClientLocked(pOwner);
+
+        auto it = m_Buffers.find(sizeClass);
+        if (it != m_Buffers.end() && !it->second.empty())
+        {
+            BYTE *pBuffer = it->second.back();
+            it->second.pop_back();
+
+            // the buffer changes hands to the requesting instance
+            PoolBufferHeader *pHeader = pool_buffer_header(pBuffer);
+            FindClientLocked(pHeader->pOwner)->cachedSize -= sizeClass;
+            pHeader->pOwner = pOwner;
+
+            m_CachedSize -= sizeClass;
+            pState->nHits++;
+            return pBuffer;
+        }
+        pState->nMisses++;
+    }
+
+    BYTE *pMem = (BYTE *)_aligned_malloc(sizeClass + POOL_BUFFER_HEADER, 64);
+    if (!pMem)
+    {
+        // drop the cached memory of all instances and try again
+        {
+            CAutoLock lock(&m_csPool);
+            FlushLocked();
+        }
+        pMem = (BYTE *)_aligned_malloc(sizeClass + POOL_BUFFER_HEADER, 64);
+        if (!pMem)
+            return nullptr;
+    }
+
+    PoolBufferHeader *pHeader = (PoolBufferHeader *)pMem;
+    pHeader->sizeClass = sizeClass;
+    pHeader->pOwner = pOwner;
+    return pMem + POOL_BUFFER_HEADER;
+}
+
+void CLAVFramePool::FreeBuffer(BYTE *pBuffer)
+{
+    if (!pBuffer)
+        return;
+
+    PoolBufferHeader *pHeader = pool_buffer_header(pBuffer);
+    const size_t sizeClass = pHeader->sizeClass;
+
+    {
+        CAutoLock lock(&m_csPool);
+
+        // buffers of an instance that already unregistered are kept as unowned
+        ClientState *pState = FindClientLocked(pHeader->pOwner);
+        if (pState->cachedSize + sizeClass <= pState->maxCachedSize)
+        {
+            m_Buffers[sizeClass].push_back(pBuffer);
+            pState->cachedSize += sizeClass;
+            m_CachedSize += sizeClass;
+            return;
+        }
+    }
+
+    _aligned_free(pHeader);
+}
+
+LAVFrame *CLAVFramePool::AllocFrame()
+{
+    {
+        CAutoLock lock(&m_csPool);
+        if (!m_Frames.empty())
+        {
+            LAVFrame *pFrame = m_Frames.back();
+            m_Frames.pop_back();
+            return pFrame;
+        }
+    }
+
+    return (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+}
+
+void CLAVFramePool::FreeFrame(LAVFrame *pFrame)
+{
+    if (!pFrame)
+        return;
+
+    {
+        CAutoLock lock(&m_csPool);
+        if (m_MaxCachedSize > 0 && m_Frames.size() < POOL_MAX_FRAMES)
+        {
+            m_Frames.push_back(pFrame);
+            return;
+        }
+    }
+
+    CoTaskMemFree(pFrame);
+}
+
+AVFrame *CLAVFramePool::AllocAVFrame()
+{
+    {
+        CAutoLock lock(&m_csPool);
+        if (!m_AVFrames.empty())
+        {
+            AVFrame *pFrame = m_AVFrames.back();
+            m_AVFrames.pop_back();
+            return pFrame;
+        }
+    }
+
+    return av_frame_alloc();
+}
+
+void CLAVFramePool::FreeAVFrame(AVFrame *pFrame)
+{
+    if (!pFrame)
+        return;
+
+    av_frame_unref(pFrame);
+
+    {
+        CAutoLock lock(&m_csPool);
+        if (m_MaxCachedSize > 0 && m_AVFrames.size() < POOL_MAX_FRAMES)
+        {
+            m_AVFrames.push_back(pFrame);
+            return;
+        }
+    }
+
+    av_frame_free(&pFrame);
+}
+
+void CLAVFramePool::Flush(const void *pClient)
+{
+    CAutoLock lock(&m_csPool);
+    if (m_Clients.count(pClient))
+        FlushClientLocked(pClient);
+}
+
+void CLAVFramePool::FlushClientLocked(const void *pClient)
+{
+    ClientState *pState = FindClientLocked(pClient);
+    if (pState->cachedSize == 0)
+        return;
+
+    DbgLog((LOG_TRACE, 10, L"CLAVFramePool::Flush(): Releasing %Iu KB of cached buffers", pState->cachedSize / 1024));
+
+    for (auto it = m_Buffers.begin(); it != m_Buffers.end();)
+    {
+        std::vector<BYTE *> &buffers = it->second;
+        for (size_t i = 0; i < buffers.size();)
+        {
+            PoolBufferHeader *pHeader = pool_buffer_header(buffers[i]);
+            if (pHeader->pOwner == pClient)
+            {
+                m_CachedSize -= pHeader->sizeClass;
+                _aligned_free(pHeader);
+                buffers[i] = buffers.back();
+                buffers.pop_back();
+            }
+            else
+                i++;
+        }
+
+        if (buffers.empty())
+            it = m_Buffers.erase(it);
+        else
+            ++it;
+    }
+    pState->cachedSize = 0;
+}
+
+void CLAVFramePool::FlushLocked()
+{
+    if (m_CachedSize)
+        DbgLog((LOG_TRACE, 10, L"CLAVFramePool::Flush(): Releasing %Iu KB of cached buffers", m_CachedSize / 1024));
+
+    for (auto &sizeClass : m_Buffers)
+    {
+        for (BYTE *pBuffer : sizeClass.second)
+            _aligned_free(pBuffer - POOL_BUFFER_HEADER);
+    }
+    m_Buffers.clear();
+    m_CachedSize = 0;
+
+    for (auto &client : m_Clients)
+        client.second.cachedSize = 0;
+    m_Unowned.cachedSize = 0;
+
+    for (LAVFrame *pFrame : m_Frames)
+        CoTaskMemFree(pFrame);
+    m_Frames.clear();
+
+    for (AVFrame *pFrame : m_AVFrames)
+        av_frame_free(&pFrame);
+    m_AVFrames.clear();
+}
+
+void CLAVFramePool::AddClient(const void *pClient, size_t maxCachedSize)
+{
+    CAutoLock lock(&m_csPool);
+    ClientState &state = m_Clients[pClient];
+    state.maxCachedSize = maxCachedSize;
+    if (state.cachedSize > maxCachedSize)
+        FlushClientLocked(pClient);
+
+    UpdateMaxCachedSizeLocked();
+}
+
+void CLAVFramePool::RemoveClient(const void *pClient)
+{
+    CAutoLock lock(&m_csPool);
+    if (m_Clients.count(pClient) == 0)
+        return;
+
+    FlushClientLocked(pClient);
+    m_Clients.erase(pClient);
+
+    if (m_Clients.empty())
+    {
+        m_MaxCachedSize = 0;
+        FlushLocked();
+    }
+    else
+        UpdateMaxCachedSizeLocked();
+}
+
+void CLAVFramePool::UpdateMaxCachedSizeLocked()
+{
+    m_MaxCachedSize = 0;
+    for (auto &client : m_Clients)
+    {
+        if (client.second.maxCachedSize > m_MaxCachedSize)
+            m_MaxCachedSize = client.second.maxCachedSize;
+    }
+
+    m_Unowned.maxCachedSize = m_MaxCachedSize;
+    if (m_MaxCachedSize == 0)
+        FlushLocked();
+    else if (m_Unowned.cachedSize > m_MaxCachedSize)
+        FlushClientLocked(nullptr);
+}
+
+void CLAVFramePool::GetStats(const void *pClient, ULONGLONG *pHits, ULONGLONG *pMisses, size_t *pCachedSize)
+{
+    CAutoLock lock(&m_csPool);
+
+    auto it = m_Clients.find(pClient);
+    const ClientState state = (it != m_Clients.end()) ? it->second : ClientState();
+    if (pHits)
+        *pHits = state.nHits;
+    if (pMisses)
+        *pMisses = state.nMisses;
+    if (pCachedSize)
+        *pCachedSize = state.cachedSize;
+}
@@ -0,0 +1,108 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#define LAV_FRAME_POOL_DEFAULT_SIZE 256 // MB
+
+struct LAVFrame;
+struct AVFrame;
+
+// Pool of recycled frame memory, shared by all decoder instances
+//
+// Frame structs, plane buffers and side data blocks are returned to the pool when a frame is released, and handed out
+// again for the next frame of the same size class, instead of going through the heap for every frame.
+// The pool is thread-safe, as frames are released from various threads (ie. by the filter graph).
+//
+// Every buffer is owned by the decoder instance that requested it last, which is the instance registered for the
+// requesting thread with SetThreadClient. Released buffers are only kept up to the size limit of their owner, and
+// flushes and statistics only cover the buffers of one instance. Buffers requested on threads without an instance
+// are kept up to the largest limit of all registered instances.
+// Cached memory is released when the last instance unregisters.
+class CLAVFramePool
+{
+  public:
+    static CLAVFramePool &Get();
+
+    // Set the instance that buffer requests of the calling thread are accounted to, nullptr to clear it
+    static void SetThreadClient(const void *pClient) { s_pThreadClient = pClient; }
+
+    // Allocate a buffer of at least the given size, aligned to 64 bytes
+    BYTE *AllocBuffer(size_t size);
+    // Return a buffer to the pool, only buffers from AllocBuffer are allowed
+    void FreeBuffer(BYTE *pBuffer);
+
+    // Allocate an un-initialized frame struct
+    // Frame structs are allocated with CoTaskMemAlloc, and can also be free'd with CoTaskMemFree
+    LAVFrame *AllocFrame();
+    void FreeFrame(LAVFrame *pFrame);
+
+    // Allocate an empty AVFrame, ie. to hold the references of a frame produced by avfilter
+    AVFrame *AllocAVFrame();
+    // Unreference the frame and return it to the pool
+    void FreeAVFrame(AVFrame *pFrame);
+
+    // Release the cached buffers owned by an instance, ie. after a format change made its cached sizes obsolete
+    void Flush(const void *pClient);
+
+    // Register an instance, or update its limit of memory kept in the pool, in bytes. 0 disables pooling for it.
+    void AddClient(const void *pClient, size_t maxCachedSize);
+    // Unregister an instance and release its cached buffers, the last one to leave releases all cached memory
+    void RemoveClient(const void *pClient);
+
+    // Get the buffer requests of an instance that could (or could not) be served from the pool, and the size of the
+    // cached buffers it owns
+    void GetStats(const void *pClient, ULONGLONG *pHits, ULONGLONG *pMisses, size_t *pCachedSize);
+
+  private:
+    struct ClientState
+    {
+        size_t maxCachedSize = 0;
+        size_t cachedSize = 0;
+        ULONGLONG nHits = 0;
+        ULONGLONG nMisses = 0;
+    };
+
+    CLAVFramePool() = default;
+    ~CLAVFramePool();
+
+    // Look up a registered instance, unknown instances are reset to nullptr and share the unowned state
+    ClientState *FindClientLocked(const void *&pClient);
+
+    void FlushLocked();
+    void FlushClientLocked(const void *pClient);
+    void UpdateMaxCachedSizeLocked();
+
+    static thread_local const void *s_pThreadClient;
+
+    CCritSec m_csPool;
+
+    std::map<const void *, ClientState> m_Clients; // limit and statistics of every registered instance
+    ClientState m_Unowned;                          // buffers requested without a registered instance
+
+    std::map<size_t, std::vector<BYTE *>> m_Buffers; // cached buffers by size class
+    std::vector<LAVFrame *> m_Frames;                // cached frame structs
+    std::vector<AVFrame *> m_AVFrames;               // cached empty AVFrames
+
+    size_t m_CachedSize = 0;
+    size_t m_MaxCachedSize = 0;
+};
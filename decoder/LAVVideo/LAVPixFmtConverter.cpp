@@ -83,6 +83,7 @@ static LAV_INOUT_PIXFMT_MAP lav_pixfmt_map[] = {
   // 4:2:0
   { LAVPixFmt_YUV420, 8,    { PIXOUT_420_8, PIXOUT_420_10, PIXOUT_420_16, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
   { LAVPixFmt_NV12,   8,    { PIXOUT_420_8, PIXOUT_420_10, PIXOUT_420_16, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
+  { LAVPixFmt_NV21,   8,    { PIXOUT_420_8, PIXOUT_420_10, PIXOUT_420_16, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
   { LAVPixFmt_P016,   10,   { PIXOUT_420_10, PIXOUT_420_16, PIXOUT_420_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
   { LAVPixFmt_P016,   16,   { PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
 
@@ -92,6 +93,7 @@ static LAV_INOUT_PIXFMT_MAP lav_pixfmt_map[] = {
   // 4:2:2
   { LAVPixFmt_YUV422, 8,    { PIXOUT_422_8, PIXOUT_422_10, PIXOUT_422_16, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
   { LAVPixFmt_YUY2,   8,    { PIXOUT_422_8, PIXOUT_422_10, PIXOUT_422_16, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
+  { LAVPixFmt_UYVY,   8,    { LAVOutPixFmt_UYVY, LAVOutPixFmt_YUY2, LAVOutPixFmt_YV16, PIXOUT_422_10, PIXOUT_422_16, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
 
   { LAVPixFmt_YUV422bX, 10, { PIXOUT_422_10, PIXOUT_422_16, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
   { LAVPixFmt_YUV422bX, 16, { PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
@@ -107,6 +109,9 @@ static LAV_INOUT_PIXFMT_MAP lav_pixfmt_map[] = {
   { LAVPixFmt_ARGB32, 8,    { PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
   { LAVPixFmt_RGB48,  8,    { PIXOUT_RGB_16, PIXOUT_RGB_8, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
 
+  { LAVPixFmt_GBRP,    8,   { PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
+  { LAVPixFmt_GBRPbX, 16,   { PIXOUT_RGB_16, PIXOUT_RGB_8, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8 } },
+
   { LAVPixFmt_DXVA2,  8,    { PIXOUT_420_8, PIXOUT_420_10, PIXOUT_420_16, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8, PIXOUT_RGB_16 } },
   { LAVPixFmt_DXVA2, 10,    { PIXOUT_420_10, PIXOUT_420_16, PIXOUT_420_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
   { LAVPixFmt_DXVA2, 16,    { PIXOUT_420_16, PIXOUT_420_10, PIXOUT_420_8, PIXOUT_422_16, PIXOUT_422_10, PIXOUT_422_8, PIXOUT_RGB_8, PIXOUT_RGB_16, PIXOUT_444_16, PIXOUT_444_10, PIXOUT_444_8 } },
@@ -371,6 +376,8 @@ void CLAVPixFmtConverter::SelectConvertFunction()
              (m_OutputPixFmt == LAVOutPixFmt_RGB24 && m_InputPixFmt == LAVPixFmt_RGB24) ||
              (m_OutputPixFmt == LAVOutPixFmt_RGB48 && m_InputPixFmt == LAVPixFmt_RGB48) ||
              (m_OutputPixFmt == LAVOutPixFmt_NV12 && m_InputPixFmt == LAVPixFmt_NV12) ||
+             (m_OutputPixFmt == LAVOutPixFmt_YUY2 && m_InputPixFmt == LAVPixFmt_YUY2) ||
+             (m_OutputPixFmt == LAVOutPixFmt_UYVY && m_InputPixFmt == LAVPixFmt_UYVY) ||
              ((m_OutputPixFmt == LAVOutPixFmt_P010 || m_OutputPixFmt == LAVOutPixFmt_P016) &&
               m_InputPixFmt == LAVPixFmt_P016))
     {
@@ -439,7 +446,8 @@ void CLAVPixFmtConverter::SelectConvertFunction()
                  (m_InputPixFmt == LAVPixFmt_YUV420 || m_InputPixFmt == LAVPixFmt_YUV420bX ||
                   m_InputPixFmt == LAVPixFmt_YUV422 || m_InputPixFmt == LAVPixFmt_YUV422bX ||
                   m_InputPixFmt == LAVPixFmt_YUV444 || m_InputPixFmt == LAVPixFmt_YUV444bX ||
-                  m_InputPixFmt == LAVPixFmt_NV12 || m_InputPixFmt == LAVPixFmt_P016))
+                  m_InputPixFmt == LAVPixFmt_NV12 || m_InputPixFmt == LAVPixFmt_NV21 ||
+                  m_InputPixFmt == LAVPixFmt_P016))
         {
             convert = &CLAVPixFmtConverter::convert_yuv_rgb;
             if (m_OutputPixFmt == LAVOutPixFmt_RGB32)
@@ -448,14 +456,22 @@ void CLAVPixFmtConverter::SelectConvertFunction()
             }
             m_bRGBConverter = TRUE;
         }
-        else if (m_OutputPixFmt == LAVOutPixFmt_YV12 && m_InputPixFmt == LAVPixFmt_NV12)
+        else if (m_OutputPixFmt == LAVOutPixFmt_YV12 &&
+                 (m_InputPixFmt == LAVPixFmt_NV12 || m_InputPixFmt == LAVPixFmt_NV21))
         {
             convert = &CLAVPixFmtConverter::convert_nv12_yv12;
             m_RequiredAlignment = 32;
         }
+        else if ((m_OutputPixFmt == LAVOutPixFmt_NV12 && m_InputPixFmt == LAVPixFmt_NV21) ||
+                 (m_OutputPixFmt == LAVOutPixFmt_UYVY && m_InputPixFmt == LAVPixFmt_YUY2) ||
+                 (m_OutputPixFmt == LAVOutPixFmt_YUY2 && m_InputPixFmt == LAVPixFmt_UYVY))
+        {
+            convert = &CLAVPixFmtConverter::convert_swap_uv;
+            m_RequiredAlignment = 32;
+        }
         else if ((m_OutputPixFmt == LAVOutPixFmt_YUY2 || m_OutputPixFmt == LAVOutPixFmt_UYVY) &&
                  (m_InputPixFmt == LAVPixFmt_YUV420 || m_InputPixFmt == LAVPixFmt_NV12 ||
-                  m_InputPixFmt == LAVPixFmt_YUV420bX) &&
+                  m_InputPixFmt == LAVPixFmt_NV21 || m_InputPixFmt == LAVPixFmt_YUV420bX) &&
                  m_InBpp <= 14)
         {
             if (m_OutputPixFmt == LAVOutPixFmt_YUY2)
@@ -501,6 +517,27 @@ void CLAVPixFmtConverter::SelectConvertFunction()
         {
             convert = &CLAVPixFmtConverter::convert_p010_nv12_sse2;
         }
+        else if ((m_InputPixFmt == LAVPixFmt_GBRP || m_InputPixFmt == LAVPixFmt_GBRPbX) && OUTPUT_RGB)
+        {
+            if (m_InputPixFmt == LAVPixFmt_GBRPbX)
+            {
+                if (m_OutputPixFmt == LAVOutPixFmt_RGB32)
+                    convert = &CLAVPixFmtConverter::convert_gbrp_rgb<1, 1>;
+                else
+                    convert = &CLAVPixFmtConverter::convert_gbrp_rgb<1, 0>;
+            }
+            else
+            {
+                if (m_OutputPixFmt == LAVOutPixFmt_RGB32)
+                    convert = &CLAVPixFmtConverter::convert_gbrp_rgb<0, 1>;
+                else
+                    convert = &CLAVPixFmtConverter::convert_gbrp_rgb<0, 0>;
+            }
+        }
+        else if (m_InputPixFmt == LAVPixFmt_GBRPbX && m_OutputPixFmt == LAVOutPixFmt_RGB48)
+        {
+            convert = &CLAVPixFmtConverter::convert_gbrp_rgb48;
+        }
     }
 
     if (convert == nullptr)
@@ -180,6 +180,7 @@ class CLAVPixFmtConverter
     DECLARE_CONV_FUNC(convert_yuv420_nv12);
     DECLARE_CONV_FUNC(convert_yuv_yv);
     DECLARE_CONV_FUNC(convert_nv12_yv12);
+    DECLARE_CONV_FUNC(convert_swap_uv);
     DECLARE_CONV_FUNC(convert_p010_nv12_sse2);
     template <int uyvy> DECLARE_CONV_FUNC(convert_yuv420_yuy2);
     template <int uyvy> DECLARE_CONV_FUNC(convert_yuv422_yuy2_uyvy);
@@ -188,6 +189,8 @@ class CLAVPixFmtConverter
 
     DECLARE_CONV_FUNC(convert_rgb48_rgb32_ssse3);
     template <int out32> DECLARE_CONV_FUNC(convert_rgb48_rgb);
+    template <int hbd, int out32> DECLARE_CONV_FUNC(convert_gbrp_rgb);
+    DECLARE_CONV_FUNC(convert_gbrp_rgb48);
 
     DECLARE_CONV_FUNC(plane_copy_direct_sse4);
     DECLARE_CONV_FUNC(convert_nv12_yv12_direct_sse4);
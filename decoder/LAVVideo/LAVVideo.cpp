@@ -59,6 +59,9 @@ CLAVVideo::CLAVVideo(LPUNKNOWN pUnk, HRESULT *phr)
     memset(&m_FilterPrevFrame, 0, sizeof(m_FilterPrevFrame));
     memset(&m_SideData, 0, sizeof(m_SideData));
 
+    // no output thread is running yet, so there is nothing to wait for
+    m_evOutputIdle.Set();
+
     LoadSettings();
 
     m_PixFmtConverter.SetSettings(this);
@@ -74,13 +77,14 @@ CLAVVideo::~CLAVVideo()
 {
     SAFE_DELETE(m_pTrayIcon);
 
+    StopOutputThread();
+
     ReleaseLastSequenceFrame();
     m_Decoder.Close();
 
-    if (m_pFilterGraph)
-        avfilter_graph_free(&m_pFilterGraph);
-    m_pFilterBufferSrc = nullptr;
-    m_pFilterBufferSink = nullptr;
+    m_Deinterlacer.Close();
+
+    CLAVFramePool::Get().RemoveClient(this);
 
     if (m_SubtitleConsumer)
         m_SubtitleConsumer->DisconnectProvider();
@@ -173,6 +177,8 @@ HRESULT CLAVVideo::LoadDefaults()
 
     m_settings.bH264MVCOverride = TRUE;
     m_settings.bCCOutputPinEnabled = FALSE;
+    m_settings.FramePoolSize = LAV_FRAME_POOL_DEFAULT_SIZE;
+    m_settings.PipelinedOutput = FALSE;
 
     return S_OK;
 }
@@ -249,6 +255,10 @@ HRESULT CLAVVideo::ReadSettings(HKEY rootKey)
         if (SUCCEEDED(hr))
             m_settings.DitherMode = dwVal;
 
+        dwVal = reg.ReadDWORD(L"FramePoolSize", hr);
+        if (SUCCEEDED(hr))
+            m_settings.FramePoolSize = dwVal;
+
         bFlag = reg.ReadBOOL(L"DVDVideo", hr);
         if (SUCCEEDED(hr))
             m_settings.bDVDVideo = bFlag;
@@ -256,6 +266,10 @@ HRESULT CLAVVideo::ReadSettings(HKEY rootKey)
         bFlag = reg.ReadBOOL(L"MSWMV9DMO", hr);
         if (SUCCEEDED(hr))
             m_settings.bMSWMV9DMO = bFlag;
+
+        bFlag = reg.ReadBOOL(L"PipelinedOutput", hr);
+        if (SUCCEEDED(hr))
+            m_settings.PipelinedOutput = bFlag;
     }
 
     CRegistry regF = CRegistry(rootKey, LAVC_VIDEO_REGISTRY_KEY_FORMATS, hr, TRUE);
@@ -423,6 +437,8 @@ HRESULT CLAVVideo::SaveSettings()
         reg.WriteDWORD(L"SWDeintMode", m_settings.SWDeintMode);
         reg.WriteDWORD(L"SWDeintOutput", m_settings.SWDeintOutput);
         reg.WriteDWORD(L"DitherMode", m_settings.DitherMode);
+        reg.WriteDWORD(L"FramePoolSize", m_settings.FramePoolSize);
+        reg.WriteBOOL(L"PipelinedOutput", m_settings.PipelinedOutput);
 
         reg.DeleteKey(L"DeintAggressive");
         reg.DeleteKey(L"DeintForce");
@@ -631,7 +647,8 @@ HRESULT CLAVVideo::GetMediaType(int iPosition, CMediaType *pMediaType)
     if (m_Decoder.IsInterlaced(FALSE) && m_settings.DeintMode != DeintMode_Disable)
     {
         BOOL bFramePerField =
-            (m_settings.SWDeintMode == SWDeintMode_YADIF && m_settings.SWDeintOutput == DeintOutput_FramePerField) ||
+            ((m_settings.SWDeintMode == SWDeintMode_YADIF || m_settings.SWDeintMode == SWDeintMode_BWDIF) &&
+             m_settings.SWDeintOutput == DeintOutput_FramePerField) ||
             m_settings.SWDeintMode == SWDeintMode_W3FDIF_Simple || m_settings.SWDeintMode == SWDeintMode_W3FDIF_Complex;
         if (bFramePerField)
             rtAvgTime /= 2;
@@ -658,6 +675,10 @@ HRESULT CLAVVideo::CreateDecoder(const CMediaType *pmt)
     DbgLog((LOG_TRACE, 10, L"::CreateDecoder(): Creating new decoder..."));
     HRESULT hr = S_OK;
 
+    // Buffers cached for the previous format are unlikely to fit the new one
+    CLAVFramePool::Get().AddClient(this, (size_t)m_settings.FramePoolSize * 1024 * 1024);
+    CLAVFramePool::Get().Flush(this);
+
     AVCodecID codec = FindCodecId(pmt);
     if (codec == AV_CODEC_ID_NONE)
     {
@@ -741,6 +762,19 @@ HRESULT CLAVVideo::CreateDecoder(const CMediaType *pmt)
         SafeRelease(&pPinSideData);
     }
 
+    if (m_SideData.Mastering.has_luminance || m_SideData.Mastering.has_primaries)
+    {
+        processFFHDRData(&m_SideData.HDR, &m_SideData.Mastering);
+        m_SideData.bHDR = TRUE;
+    }
+
+    if (m_SideData.ContentLight.MaxCLL && m_SideData.ContentLight.MaxFALL)
+    {
+        m_SideData.HDRContentLight.MaxCLL = m_SideData.ContentLight.MaxCLL;
+        m_SideData.HDRContentLight.MaxFALL = m_SideData.ContentLight.MaxFALL;
+        m_SideData.bHDRContentLight = TRUE;
+    }
+
     m_dwDecodeFlags = 0;
 
     LPWSTR pszExtension = GetFileExtension();
@@ -828,7 +862,7 @@ HRESULT CLAVVideo::CreateDecoder(const CMediaType *pmt)
     if (m_PixFmtConverter.SetInputFmt(pix, bpp) && m_pOutput->IsConnected())
         m_bForceFormatNegotiation = TRUE;
 
-    if (pix == LAVPixFmt_YUV420 || pix == LAVPixFmt_YUV422 || pix == LAVPixFmt_NV12)
+    if (CLAVDeinterlacer::IsFormatSupported(pix, (LAVSWDeintModes)m_settings.SWDeintMode))
         m_filterPixFmt = pix;
 
     if (m_settings.bCCOutputPinEnabled && !bDVDPlayback &&
@@ -872,6 +906,9 @@ HRESULT CLAVVideo::SetMediaType(PIN_DIRECTION dir, const CMediaType *pmt)
     DbgLog((LOG_TRACE, 5, L"SetMediaType -- %S", dir == PINDIR_INPUT ? "in" : "out"));
     if (dir == PINDIR_INPUT)
     {
+        // frames still queued for output belong to the old format
+        WaitForOutputIdle();
+
         hr = CreateDecoder(pmt);
         if (FAILED(hr))
         {
@@ -890,9 +927,11 @@ HRESULT CLAVVideo::EndOfStream()
 {
     DbgLog((LOG_TRACE, 1, L"EndOfStream, flushing decoder"));
     CAutoLock cAutoLock(&m_csReceive);
+    CLAVFramePool::SetThreadClient(this);
 
     m_Decoder.EndOfStream();
     Filter(GetFlushFrame());
+    WaitForOutputIdle();
 
     if (m_pCCOutputPin)
         m_pCCOutputPin->DeliverEndOfStream();
@@ -908,6 +947,7 @@ HRESULT CLAVVideo::EndOfSegment()
 
     m_Decoder.EndOfStream();
     Filter(GetFlushFrame());
+    WaitForOutputIdle();
 
     // Forward the EndOfSegment call downstream
     if (m_pOutput != NULL && m_pOutput->IsConnected())
@@ -929,6 +969,7 @@ HRESULT CLAVVideo::BeginFlush()
 {
     DbgLog((LOG_TRACE, 1, L"::BeginFlush"));
     m_bFlushing = TRUE;
+    ClearOutputQueue();
 
     if (m_pCCOutputPin)
         m_pCCOutputPin->DeliverBeginFlush();
@@ -941,6 +982,13 @@ HRESULT CLAVVideo::EndFlush()
     DbgLog((LOG_TRACE, 1, L"::EndFlush"));
     CAutoLock cAutoLock(&m_csReceive);
 
+    // the output thread may still be finishing a frame it picked up before the flush started
+    WaitForOutputIdle();
+    {
+        CAutoLock lock(&m_csOutputQueue);
+        m_hrOutputThread = S_OK;
+    }
+
     ReleaseLastSequenceFrame();
 
     if (m_dwDecodeFlags & LAV_VIDEO_DEC_FLAG_DVD)
@@ -979,14 +1027,14 @@ HRESULT CLAVVideo::ReleaseLastSequenceFrame()
 HRESULT CLAVVideo::PerformFlush()
 {
     CAutoLock cAutoLock(&m_csReceive);
+    WaitForOutputIdle();
 
     ReleaseLastSequenceFrame();
     m_Decoder.Flush();
 
     m_bInDVDMenu = FALSE;
 
-    if (m_pFilterGraph)
-        avfilter_graph_free(&m_pFilterGraph);
+    m_Deinterlacer.Close();
 
     m_rtPrevStart = m_rtPrevStop = 0;
     memset(&m_FilterPrevFrame, 0, sizeof(m_FilterPrevFrame));
@@ -1044,8 +1092,7 @@ HRESULT CLAVVideo::BreakConnect(PIN_DIRECTION dir)
     DbgLog((LOG_TRACE, 10, L"::BreakConnect"));
     if (dir == PINDIR_INPUT)
     {
-        if (m_pFilterGraph)
-            avfilter_graph_free(&m_pFilterGraph);
+        m_Deinterlacer.Close();
 
         m_Decoder.Close();
         m_X264Build = -1;
@@ -1181,6 +1228,12 @@ HRESULT CLAVVideo::StartStreaming()
         }
     }
 
+    m_Stats.Reset();
+    CLAVFramePool::Get().GetStats(this, nullptr, &m_ullPoolMissesStart, nullptr);
+
+    if (m_settings.PipelinedOutput)
+        StartOutputThread();
+
     return S_OK;
 }
 
@@ -1420,6 +1473,8 @@ HRESULT CLAVVideo::ReconnectOutput(int width, int height, AVRational ar, DXVA2_E
     if (bNeedReconnect)
     {
         DbgLog((LOG_TRACE, 10, L"::ReconnectOutput(): Performing reconnect"));
+        CLAVFramePool::Get().Flush(this);
+
         BITMAPINFOHEADER *pBIH = nullptr;
         if (mt.formattype == FORMAT_VideoInfo)
         {
@@ -1683,6 +1738,9 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
     CAutoLock cAutoLock(&m_csReceive);
     HRESULT hr = S_OK;
 
+    // frame buffers requested by the decoder on this thread belong to this instance
+    CLAVFramePool::SetThreadClient(this);
+
     AM_SAMPLE2_PROPERTIES const *pProps = m_pInput->SampleProps();
     if (pProps->dwStreamId != AM_STREAM_MEDIA)
     {
@@ -1715,7 +1773,13 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
         return S_OK;
     }
 
+    // the frames delivered from within the decoder are accounted to their own stages
+    const LONGLONG llStart = CLAVProcessingStats::Now();
+    const LONGLONG llCallbackTicks = m_llCallbackTicks;
+
     hr = m_Decoder.Decode(pIn);
+
+    m_Stats.AddTicks(LAVStage_Decode, CLAVProcessingStats::Now() - llStart - (m_llCallbackTicks - llCallbackTicks));
     if (FAILED(hr))
         return hr;
 
@@ -1730,7 +1794,7 @@ STDMETHODIMP CLAVVideo::AllocateFrame(LAVFrame **ppFrame)
 {
     CheckPointer(ppFrame, E_POINTER);
 
-    *ppFrame = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+    *ppFrame = CLAVFramePool::Get().AllocFrame();
     if (!*ppFrame)
     {
         return E_OUTOFMEMORY;
@@ -1758,7 +1822,8 @@ STDMETHODIMP CLAVVideo::ReleaseFrame(LAVFrame **ppFrame)
     if (*ppFrame)
     {
         FreeLAVFrameBuffers(*ppFrame);
-        SAFE_CO_FREE(*ppFrame);
+        CLAVFramePool::Get().FreeFrame(*ppFrame);
+        *ppFrame = nullptr;
     }
     return S_OK;
 }
@@ -1833,6 +1898,8 @@ STDMETHODIMP_(LAVFrame *) CLAVVideo::GetFlushFrame()
 
 STDMETHODIMP CLAVVideo::Deliver(LAVFrame *pFrame)
 {
+    CLAVScopedTicks callbackTicks(m_llCallbackTicks);
+
     // Out-of-sequence flush event to get all frames delivered,
     // only triggered by decoders when they are already "empty"
     // so no need to flush the decoder here
@@ -1851,6 +1918,9 @@ STDMETHODIMP CLAVVideo::Deliver(LAVFrame *pFrame)
         return S_FALSE;
     }
 
+    if (!(pFrame->flags & LAV_FRAME_FLAG_REDRAW))
+        m_Stats.AddFrame(LAVStage_Decode);
+
     if (pFrame->rtStart == AV_NOPTS_VALUE)
     {
         pFrame->rtStart = m_rtPrevStop;
@@ -1917,7 +1987,48 @@ STDMETHODIMP CLAVVideo::Deliver(LAVFrame *pFrame)
     return S_OK;
 }
 
-HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
+// Get the format used to blend subtitles into the converted output, or LAVPixFmt_None if blending into the output is
+// not supported
+static LAVPixelFormat GetOutputBlendPixFmt(LAVOutPixFmts outPixFmt)
+{
+    switch (outPixFmt)
+    {
+    case LAVOutPixFmt_RGB32: return LAVPixFmt_RGB32;
+    case LAVOutPixFmt_RGB24: return LAVPixFmt_RGB24;
+    case LAVOutPixFmt_NV12: return LAVPixFmt_NV12;
+    case LAVOutPixFmt_P010:
+    case LAVOutPixFmt_P016: return LAVPixFmt_P016;
+    case LAVOutPixFmt_YV12: return LAVPixFmt_YUV420;
+    case LAVOutPixFmt_YV16: return LAVPixFmt_YUV422;
+    case LAVOutPixFmt_YV24: return LAVPixFmt_YUV444;
+    }
+    return LAVPixFmt_None;
+}
+
+HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame, BOOL bOwnedBuffers)
+{
+    BOOL bOutputThreadActive;
+    {
+        CAutoLock lock(&m_csOutputQueue);
+        bOutputThreadActive = m_bOutputThreadActive;
+    }
+
+    // Hardware surfaces, direct frames and buffers the decoder re-uses on its next call need to be processed before
+    // returning to the decoder, everything else can be converted and delivered on the output thread
+    // QueueOutputFrame re-checks the state under the lock and falls back to synchronous processing
+    if (bOutputThreadActive && pFrame->format != LAVPixFmt_DXVA2 && pFrame->format != LAVPixFmt_D3D11 &&
+        !pFrame->direct && !(pFrame->flags & LAV_FRAME_FLAG_REDRAW) &&
+        (bOwnedBuffers || m_Decoder.HasThreadSafeBuffers() == S_OK))
+    {
+        return QueueOutputFrame(pFrame);
+    }
+
+    // keep the output in order with the frames already queued
+    WaitForOutputIdle();
+    return ProcessOutputFrame(pFrame);
+}
+
+HRESULT CLAVVideo::ProcessOutputFrame(LAVFrame *pFrame)
 {
     HRESULT hr = S_OK;
 
@@ -2011,59 +2122,47 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         return S_FALSE;
     }
 
-    // Process stream-level sidedata and attach it to the frame if necessary
+    // Process stream-level sidedata
     if (m_SideData.Mastering.has_colorspace)
     {
         fillDXVAExtFormat(pFrame->ext_format, m_SideData.Mastering.color_range - 1,
                           m_SideData.Mastering.color_primaries, m_SideData.Mastering.colorspace,
                           m_SideData.Mastering.color_trc, m_SideData.Mastering.chroma_location, false);
     }
-    if (m_SideData.Mastering.has_luminance || m_SideData.Mastering.has_primaries)
-    {
-        MediaSideDataHDR *hdr = nullptr;
 
-        // Check if HDR data already exists
-        if (pFrame->side_data && pFrame->side_data_count)
+    // Merge the stream-level HDR metadata into the metadata of the frame, if it has its own
+    // Otherwise the cached stream-level data is attached to the output sample directly
+    BOOL bFrameHDR = FALSE, bFrameHDRContentLight = FALSE;
+    if ((m_SideData.bHDR || m_SideData.bHDRContentLight) && pFrame->side_data_count)
+    {
+        for (int i = 0; i < pFrame->side_data_count; i++)
         {
-            for (int i = 0; i < pFrame->side_data_count; i++)
+            if (m_SideData.bHDR && pFrame->side_data[i].guidType == IID_MediaSideDataHDR)
             {
-                if (pFrame->side_data[i].guidType == IID_MediaSideDataHDR)
+                MediaSideDataHDR *hdr = (MediaSideDataHDR *)pFrame->side_data[i].data;
+                if (m_SideData.Mastering.has_primaries)
                 {
-                    hdr = (MediaSideDataHDR *)pFrame->side_data[i].data;
-                    break;
+                    memcpy(hdr->display_primaries_x, m_SideData.HDR.display_primaries_x,
+                           sizeof(hdr->display_primaries_x));
+                    memcpy(hdr->display_primaries_y, m_SideData.HDR.display_primaries_y,
+                           sizeof(hdr->display_primaries_y));
+                    hdr->white_point_x = m_SideData.HDR.white_point_x;
+                    hdr->white_point_y = m_SideData.HDR.white_point_y;
                 }
-            }
-        }
-
-        if (hdr == nullptr)
-            hdr = (MediaSideDataHDR *)AddLAVFrameSideData(pFrame, IID_MediaSideDataHDR, sizeof(MediaSideDataHDR));
-
-        processFFHDRData(hdr, &m_SideData.Mastering);
-    }
-
-    if (m_SideData.ContentLight.MaxCLL && m_SideData.ContentLight.MaxFALL)
-    {
-        MediaSideDataHDRContentLightLevel *hdr = nullptr;
-
-        // Check if data already exists
-        if (pFrame->side_data && pFrame->side_data_count)
-        {
-            for (int i = 0; i < pFrame->side_data_count; i++)
-            {
-                if (pFrame->side_data[i].guidType == IID_MediaSideDataHDRContentLightLevel)
+                if (m_SideData.Mastering.has_luminance)
                 {
-                    hdr = (MediaSideDataHDRContentLightLevel *)pFrame->side_data[i].data;
-                    break;
+                    hdr->max_display_mastering_luminance = m_SideData.HDR.max_display_mastering_luminance;
+                    hdr->min_display_mastering_luminance = m_SideData.HDR.min_display_mastering_luminance;
                 }
+                bFrameHDR = TRUE;
+            }
+            else if (m_SideData.bHDRContentLight &&
+                     pFrame->side_data[i].guidType == IID_MediaSideDataHDRContentLightLevel)
+            {
+                *(MediaSideDataHDRContentLightLevel *)pFrame->side_data[i].data = m_SideData.HDRContentLight;
+                bFrameHDRContentLight = TRUE;
             }
         }
-
-        if (hdr == nullptr)
-            hdr = (MediaSideDataHDRContentLightLevel *)AddLAVFrameSideData(
-                pFrame, IID_MediaSideDataHDRContentLightLevel, sizeof(MediaSideDataHDRContentLightLevel));
-
-        hdr->MaxCLL = m_SideData.ContentLight.MaxCLL;
-        hdr->MaxFALL = m_SideData.ContentLight.MaxFALL;
     }
 
     // Collect width/height
@@ -2106,15 +2205,23 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     }
 
     // Check if we are doing RGB output
-    BOOL bRGBOut = (m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB24 ||
-                    m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB32);
-    // And blend subtitles if we're on YUV output before blending (because the output YUV formats are more complicated
-    // to handle)
+    const LAVOutPixFmts outPixFmt = m_PixFmtConverter.GetOutputPixFmt();
+    BOOL bRGBOut = (outPixFmt == LAVOutPixFmt_RGB24 || outPixFmt == LAVOutPixFmt_RGB32);
+
+    // Subtitles are blended after the conversion on RGB output, for improved quality, and on planar YUV output if the
+    // frame buffers are not writable, which avoids copying the entire frame just for blending
+    // Otherwise blend before the conversion (because the other output YUV formats are more complicated to handle)
+    BOOL bBlendAfterConversion = bRGBOut;
+    if (!bBlendAfterConversion && !(pFrame->flags & LAV_FRAME_FLAG_BUFFER_MODIFY) &&
+        pFrame->format != LAVPixFmt_DXVA2 && pFrame->format != LAVPixFmt_D3D11)
+        bBlendAfterConversion = GetOutputBlendPixFmt(outPixFmt) != LAVPixFmt_None;
+
+    LONGLONG llStageStart = CLAVProcessingStats::Now();
     if (m_SubtitleConsumer && m_SubtitleConsumer->HasProvider())
     {
         m_SubtitleConsumer->SetVideoSize(width, height);
         m_SubtitleConsumer->RequestFrame(pFrame->rtStart, pFrame->rtStop);
-        if (!bRGBOut)
+        if (!bBlendAfterConversion)
         {
             if (pFrame->direct)
             {
@@ -2127,6 +2234,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             }
             m_SubtitleConsumer->ProcessFrame(pFrame);
         }
+        m_Stats.Add(LAVStage_Subtitles, llStageStart);
     }
 
     // Grab a media sample, and start assembling the data for it.
@@ -2149,6 +2257,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     }
     else
     {
+        llStageStart = CLAVProcessingStats::Now();
         if (FAILED(hr = GetDeliveryBuffer(&pSampleOut, width, height, pFrame->aspect_ratio, pFrame->ext_format,
                                           avgDuration)) ||
             FAILED(hr = pSampleOut->GetPointer(&pDataOut)) || pDataOut == nullptr)
@@ -2157,6 +2266,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             ReleaseFrame(&pFrame);
             return hr;
         }
+        m_Stats.AddTicks(LAVStage_Deliver, CLAVProcessingStats::Now() - llStageStart);
     }
 
     CMediaType &mt = m_pOutput->CurrentMediaType();
@@ -2164,7 +2274,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     videoFormatTypeHandler(mt.Format(), mt.FormatType(), &pBIH);
 
     // Set side data on the media sample
-    if (pFrame->side_data_count)
+    if (pFrame->side_data_count || m_SideData.bHDR || m_SideData.bHDRContentLight)
     {
         IMediaSideData *pMediaSideData = nullptr;
         if (SUCCEEDED(hr = pSampleOut->QueryInterface(&pMediaSideData)))
@@ -2176,6 +2286,14 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
                                                 pFrame->side_data[i].size);
             }
 
+            if (m_SideData.bHDR && !bFrameHDR)
+                pMediaSideData->SetSideData(IID_MediaSideDataHDR, (const BYTE *)&m_SideData.HDR,
+                                            sizeof(m_SideData.HDR));
+            if (m_SideData.bHDRContentLight && !bFrameHDRContentLight)
+                pMediaSideData->SetSideData(IID_MediaSideDataHDRContentLightLevel,
+                                            (const BYTE *)&m_SideData.HDRContentLight,
+                                            sizeof(m_SideData.HDRContentLight));
+
             SafeRelease(&pMediaSideData);
         }
 
@@ -2205,6 +2323,8 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         }
         pSampleOut->SetActualDataLength(required);
 
+        llStageStart = CLAVProcessingStats::Now();
+
 #if defined(DEBUG) && DEBUG_PIXELCONV_TIMINGS
         LARGE_INTEGER frequency, start, end;
         QueryPerformanceFrequency(&frequency);
@@ -2246,34 +2366,47 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             }
         }
 
+        m_Stats.Add(LAVStage_Convert, llStageStart);
+
         // Once we're done with the old frame, release its buffers
         // This does not release the frame yet, just free its buffers
         FreeLAVFrameBuffers(pFrame);
 
-        // .. and if we do RGB conversion, blend after the conversion, for improved quality
-        if (bRGBOut && m_SubtitleConsumer && m_SubtitleConsumer->HasProvider())
+        // .. and blend subtitles into the output, if we didn't before the conversion
+        if (bBlendAfterConversion && m_SubtitleConsumer && m_SubtitleConsumer->HasProvider())
         {
-            int strideBytes = pBIH->biWidth;
-            LAVPixelFormat pixFmt;
-            if (m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB32)
+            llStageStart = CLAVProcessingStats::Now();
+
+            const LAVOutPixFmtDesc &desc = lav_pixfmt_desc[outPixFmt];
+            const ptrdiff_t byteStride = pBIH->biWidth * desc.codedbytes;
+            const int planeHeight = abs(pBIH->biHeight);
+
+            // We need to supply a LAV Frame to the subtitle API
+            // So update it with the layout of the output buffer
+            memset(pFrame->data, 0, sizeof(pFrame->data));
+            memset(pFrame->stride, 0, sizeof(pFrame->stride));
+            pFrame->data[0] = pDataOut;
+            pFrame->stride[0] = byteStride;
+            for (int i = 1; i < desc.planes; i++)
             {
-                pixFmt = LAVPixFmt_RGB32;
-                strideBytes *= 4;
+                pFrame->data[i] = pFrame->data[i - 1] + pFrame->stride[i - 1] * (planeHeight / desc.planeHeight[i - 1]);
+                pFrame->stride[i] = byteStride / desc.planeWidth[i];
             }
-            else
+
+            // YV12/YV16/YV24 store the V plane first
+            if (outPixFmt == LAVOutPixFmt_YV12 || outPixFmt == LAVOutPixFmt_YV16 || outPixFmt == LAVOutPixFmt_YV24)
             {
-                pixFmt = LAVPixFmt_RGB24;
-                strideBytes *= 3;
+                BYTE *tmp = pFrame->data[1];
+                pFrame->data[1] = pFrame->data[2];
+                pFrame->data[2] = tmp;
             }
 
-            // We need to supply a LAV Frame to the subtitle API
-            // So update it with the appropriate settings
-            pFrame->data[0] = pDataOut;
-            pFrame->stride[0] = strideBytes;
-            pFrame->format = pixFmt;
-            pFrame->bpp = 8;
+            pFrame->format = GetOutputBlendPixFmt(outPixFmt);
+            pFrame->bpp = (pFrame->format == LAVPixFmt_P016) ? 16 : 8;
             pFrame->flags |= LAV_FRAME_FLAG_BUFFER_MODIFY;
             m_SubtitleConsumer->ProcessFrame(pFrame);
+
+            m_Stats.Add(LAVStage_Subtitles, llStageStart);
         }
 
         if ((mt.subtype == MEDIASUBTYPE_RGB32 || mt.subtype == MEDIASUBTYPE_RGB24) && pBIH->biHeight > 0)
@@ -2323,7 +2456,9 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     // Release frame before delivery, so it can be re-used by the decoder (if required)
     ReleaseFrame(&pFrame);
 
+    llStageStart = CLAVProcessingStats::Now();
     hr = m_pOutput->Deliver(pSampleOut);
+    m_Stats.Add(LAVStage_Deliver, llStageStart);
     if (FAILED(hr))
     {
         DbgLog((LOG_ERROR, 10, L"::Decode(): Deliver failed with hr: %x", hr));
@@ -2382,7 +2517,8 @@ HRESULT CLAVVideo::RedrawStillImage()
     {
         CAutoLock lock(&m_csReceive);
         // Since a delivery call can clear the stored sequence frame, we need a second check here
-        // Because only after we obtained the receive lock, we are in charge..
+        // Because only after we obtained the receive lock, and the output thread finished, we are in charge..
+        WaitForOutputIdle();
         if (!m_pLastSequenceFrame)
             return S_FALSE;
 
@@ -2931,7 +3067,83 @@ STDMETHODIMP CLAVVideo::SetEnableCCOutputPin(BOOL bEnabled)
     return S_OK;
 }
 
+STDMETHODIMP CLAVVideo::SetFramePoolSize(DWORD dwSizeMB)
+{
+    m_settings.FramePoolSize = dwSizeMB;
+    CLAVFramePool::Get().AddClient(this, (size_t)dwSizeMB * 1024 * 1024);
+    return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVVideo::GetFramePoolSize()
+{
+    return m_settings.FramePoolSize;
+}
+
+STDMETHODIMP_(BOOL) CLAVVideo::GetPipelinedOutput()
+{
+    return m_settings.PipelinedOutput;
+}
+
+STDMETHODIMP CLAVVideo::SetPipelinedOutput(BOOL bPipelined)
+{
+    m_settings.PipelinedOutput = bPipelined;
+    return SaveSettings();
+}
+
 STDMETHODIMP CLAVVideo::GetHWAccelActiveDevice(BSTR *pstrDeviceName)
 {
     return m_Decoder.GetHWAccelActiveDevice(pstrDeviceName);
 }
+
+STDMETHODIMP CLAVVideo::GetFramePoolStats(ULONGLONG *pHits, ULONGLONG *pMisses, DWORD *pdwCachedKB)
+{
+    CheckPointer(pHits, E_POINTER);
+    CheckPointer(pMisses, E_POINTER);
+
+    size_t cached = 0;
+    CLAVFramePool::Get().GetStats(this, pHits, pMisses, &cached);
+    if (pdwCachedKB)
+        *pdwCachedKB = (DWORD)(cached / 1024);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::GetProcessingStats(LAVVideoStage stage, ULONGLONG *pCount, REFERENCE_TIME *prtTime)
+{
+    if (stage < 0 || stage >= LAVStage_NB)
+        return E_INVALIDARG;
+
+    if (pCount)
+        *pCount = m_Stats.GetCount(stage);
+    if (prtTime)
+        *prtTime = m_Stats.GetTime(stage);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::GetFramePoolMisses(ULONGLONG *pMisses)
+{
+    CheckPointer(pMisses, E_POINTER);
+
+    ULONGLONG misses = 0;
+    CLAVFramePool::Get().GetStats(this, nullptr, &misses, nullptr);
+    *pMisses = misses - m_ullPoolMissesStart;
+    return S_OK;
+}
+
+void CLAVVideo::LogProcessingStats()
+{
+#ifdef DEBUG
+    static const WCHAR *stageNames[LAVStage_NB] = {L"Decode", L"Deinterlace", L"Convert", L"Subtitles", L"Deliver"};
+    for (int i = 0; i < LAVStage_NB; i++)
+    {
+        const ULONGLONG count = m_Stats.GetCount((LAVVideoStage)i);
+        const REFERENCE_TIME rtTime = m_Stats.GetTime((LAVVideoStage)i);
+        if (count)
+            DbgLog((LOG_TRACE, 10, L"CLAVVideo::LogProcessingStats(): %s: %I64u frames, %.3f ms/frame", stageNames[i],
+                    count, rtTime / 10000.0 / count));
+    }
+
+    ULONGLONG misses = 0;
+    GetFramePoolMisses(&misses);
+    DbgLog((LOG_TRACE, 10, L"CLAVVideo::LogProcessingStats(): %I64u frame pool misses", misses));
+#endif
+}
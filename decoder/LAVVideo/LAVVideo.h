@@ -26,6 +26,9 @@
 #include "LAVPixFmtConverter.h"
 #include "LAVVideoSettings.h"
 #include "FloatingAverage.h"
+#include "LAVFramePool.h"
+#include "Deinterlacer.h"
+#include "ProcessingStats.h"
 
 #include "ISpecifyPropertyPages2.h"
 #include "SynchronizedQueue.h"
@@ -38,6 +41,8 @@
 #include "BaseTrayIcon.h"
 #include "IMediaSideData.h"
 
+#include <deque>
+
 extern "C"
 {
 #include "libavutil/mastering_display_metadata.h"
@@ -53,6 +58,9 @@ extern "C"
 #define DEBUG_FRAME_TIMINGS 0
 #define DEBUG_PIXELCONV_TIMINGS 0
 
+// Number of decoded frames queued for the output thread in pipelined mode
+#define PIPELINED_OUTPUT_QUEUE 3
+
 typedef struct
 {
     REFERENCE_TIME rtStart;
@@ -66,6 +74,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     , public ILAVVideoStatus
     , public ILAVVideoCallback
     , public IPropertyBag
+    , protected CAMThread
 {
   public:
     CLAVVideo(LPUNKNOWN pUnk, HRESULT *phr);
@@ -149,9 +158,18 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
 
     STDMETHODIMP SetEnableCCOutputPin(BOOL bEnabled);
 
+    STDMETHODIMP SetFramePoolSize(DWORD dwSizeMB);
+    STDMETHODIMP_(DWORD) GetFramePoolSize();
+
+    STDMETHODIMP_(BOOL) GetPipelinedOutput();
+    STDMETHODIMP SetPipelinedOutput(BOOL bPipelined);
+
     // ILAVVideoStatus
     STDMETHODIMP_(const WCHAR *) GetActiveDecoderName() { return m_Decoder.GetDecoderName(); }
     STDMETHODIMP GetHWAccelActiveDevice(BSTR *pstrDeviceName);
+    STDMETHODIMP GetFramePoolStats(ULONGLONG *pHits, ULONGLONG *pMisses, DWORD *pdwCachedKB);
+    STDMETHODIMP GetProcessingStats(LAVVideoStage stage, ULONGLONG *pCount, REFERENCE_TIME *prtTime);
+    STDMETHODIMP GetFramePoolMisses(ULONGLONG *pMisses);
 
     // CTransformFilter
     STDMETHODIMP Stop();
@@ -173,6 +191,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     HRESULT CompleteConnect(PIN_DIRECTION dir, IPin *pReceivePin);
 
     HRESULT StartStreaming();
+    HRESULT StopStreaming();
 
     int GetPinCount();
     CBasePin *GetPin(int n);
@@ -262,7 +281,9 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     HRESULT DeDirectFrame(LAVFrame *pFrame, bool bDisableDirectMode = true);
 
     HRESULT Filter(LAVFrame *pFrame);
-    HRESULT DeliverToRenderer(LAVFrame *pFrame);
+    HRESULT DeliverDeinterlacedFrames(const LAVFrame *pRefFrame);
+    HRESULT DeliverToRenderer(LAVFrame *pFrame, BOOL bOwnedBuffers = FALSE);
+    HRESULT ProcessOutputFrame(LAVFrame *pFrame);
 
     HRESULT PerformFlush();
     HRESULT ReleaseLastSequenceFrame();
@@ -275,6 +296,21 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
         return S_OK;
     }
 
+    // Pipelined output
+    enum
+    {
+        CMD_EXIT
+    };
+    DWORD ThreadProc();
+
+    HRESULT StartOutputThread();
+    HRESULT StopOutputThread();
+    HRESULT QueueOutputFrame(LAVFrame *pFrame);
+    void ClearOutputQueue();
+    void WaitForOutputIdle();
+
+    void LogProcessingStats();
+
   private:
     friend class CVideoInputPin;
     friend class CVideoOutputPin;
@@ -305,13 +341,8 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
 
     BOOL m_bInDVDMenu = FALSE;
 
-    AVFilterGraph *m_pFilterGraph = nullptr;
-    AVFilterContext *m_pFilterBufferSrc = nullptr;
-    AVFilterContext *m_pFilterBufferSink = nullptr;
-
+    CLAVDeinterlacer m_Deinterlacer;
     LAVPixelFormat m_filterPixFmt = LAVPixFmt_None;
-    int m_filterWidth = 0;
-    int m_filterHeight = 0;
     LAVFrame m_FilterPrevFrame;
 
     BOOL m_LAVPinInfoValid = FALSE;
@@ -322,6 +353,12 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     {
         AVMasteringDisplayMetadata Mastering;
         AVContentLightMetadata ContentLight;
+
+        // Translated once per stream, and attached to every output sample
+        BOOL bHDR;
+        MediaSideDataHDR HDR;
+        BOOL bHDRContentLight;
+        MediaSideDataHDRContentLightLevel HDRContentLight;
     } m_SideData;
 
     CLAVVideoSubtitleInputPin *m_pSubtitleInput = nullptr;
@@ -333,6 +370,20 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
 
     AM_SimpleRateChange m_DVDRate = AM_SimpleRateChange{AV_NOPTS_VALUE, 10000};
 
+    // Pipelined output
+    CCritSec m_csOutputQueue;
+    std::deque<LAVFrame *> m_OutputQueue;
+    BOOL m_bOutputThreadActive = FALSE;
+    BOOL m_bOutputThreadBusy = FALSE;
+    CAMEvent m_evOutputAvailable{TRUE};
+    CAMEvent m_evOutputSpace;
+    CAMEvent m_evOutputIdle{TRUE};
+    HRESULT m_hrOutputThread = S_OK;
+
+    CLAVProcessingStats m_Stats;
+    LONGLONG m_llCallbackTicks = 0;
+    ULONGLONG m_ullPoolMissesStart = 0;
+
     BOOL m_bRuntimeConfig = FALSE;
     struct VideoSettings
     {
@@ -361,6 +412,8 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
         DWORD HWAccelDeviceD3D11Desc;
         BOOL bH264MVCOverride;
         BOOL bCCOutputPinEnabled;
+        DWORD FramePoolSize;
+        BOOL PipelinedOutput;
     } m_settings;
 
     DWORD m_dwGPUDeviceIndex = DWORD_MAX;
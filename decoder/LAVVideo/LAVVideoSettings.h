@@ -141,6 +141,7 @@ typedef enum LAVSWDeintModes
     SWDeintMode_YADIF,
     SWDeintMode_W3FDIF_Simple,
     SWDeintMode_W3FDIF_Complex,
+    SWDeintMode_BWDIF,
 } LAVSWDeintModes;
 
 // Deinterlacing processing mode
@@ -205,6 +206,17 @@ typedef enum LAVDitherMode
     LAVDither_Random
 } LAVDitherMode;
 
+// Processing stages reported by ILAVVideoStatus::GetProcessingStats
+typedef enum LAVVideoStage
+{
+    LAVStage_Decode,      // decoding, excluding the stages below if they run on the decoding thread
+    LAVStage_Deinterlace, // software deinterlacing
+    LAVStage_Convert,     // pixel format conversion into the output buffer
+    LAVStage_Subtitles,   // rendering and blending of subtitles, including waiting for the subtitle provider
+    LAVStage_Deliver,     // delivery to the downstream filter, including waiting for output buffers
+    LAVStage_NB
+} LAVVideoStage;
+
 // LAV Video configuration interface
 interface __declspec(uuid("FA40D6E9-4D38-4761-ADD2-71A9EC5FD32F")) ILAVVideoSettings : public IUnknown
 {
@@ -400,6 +412,17 @@ interface __declspec(uuid("FA40D6E9-4D38-4761-ADD2-71A9EC5FD32F")) ILAVVideoSett
 
     //  Enable the creation of the Closed Caption output pin
     STDMETHOD(SetEnableCCOutputPin)(BOOL bEnabled) = 0;
+
+    // Set the maximum amount of memory (in MB) kept for re-use by decoded frames
+    // The pool is shared by all instances of the decoder, every instance keeps at most this much memory in it.
+    // 0 disables re-using frame memory for this instance.
+    STDMETHOD(SetFramePoolSize)(DWORD dwSizeMB) = 0;
+    STDMETHOD_(DWORD, GetFramePoolSize)() = 0;
+
+    // Pipelined output: convert and deliver the decoded frames on a separate thread, overlapped with decoding
+    // Changes take effect the next time playback is started
+    STDMETHOD_(BOOL, GetPipelinedOutput)() = 0;
+    STDMETHOD(SetPipelinedOutput)(BOOL bPipelined) = 0;
 };
 
 // LAV Video status interface
@@ -410,4 +433,18 @@ interface __declspec(uuid("1CC2385F-36FA-41B1-9942-5024CE0235DC")) ILAVVideoStat
 
     // Get the name of the currently active hwaccel device
     STDMETHOD(GetHWAccelActiveDevice)(BSTR * pstrDeviceName) = 0;
+
+    // Get the statistics of this instance in the frame memory pool
+    // Hits and misses count the buffer requests that could (or could not) be served from the pool, and
+    // pdwCachedKB (optional) receives the amount of memory currently held by the pool for this instance
+    STDMETHOD(GetFramePoolStats)(ULONGLONG * pHits, ULONGLONG * pMisses, DWORD * pdwCachedKB) = 0;
+
+    // Get the processing statistics of a stage since streaming was started
+    // pCount receives the number of frames processed by the stage, prtTime the time spent in it (in 100ns units)
+    // Together with the frame pool statistics, this allows measuring the decoding throughput without a renderer
+    STDMETHOD(GetProcessingStats)(LAVVideoStage stage, ULONGLONG * pCount, REFERENCE_TIME * prtTime) = 0;
+
+    // Get the number of frame buffer requests of this instance since streaming was started that could not be served
+    // from the frame pool, and were allocated from the heap instead
+    STDMETHOD(GetFramePoolMisses)(ULONGLONG * pMisses) = 0;
 };
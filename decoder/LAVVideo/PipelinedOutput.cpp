@@ -0,0 +1,207 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVVideo.h"
+
+// Pipelined output
+//
+// Decoded frames are queued by DeliverToRenderer() and processed on a dedicated output thread, which performs the pixel
+// format conversion, subtitle blending and the delivery downstream, while the streaming thread already decodes the
+// next frame. The streaming thread only blocks when the queue is full.
+//
+// Frames which cannot outlive the decoder call (hardware surfaces, direct frames, buffers the decoder re-uses) are
+// processed synchronously after the queue ran empty, and so are stream events (end of stream, new segment, format
+// changes), which keeps them in order with the data.
+
+HRESULT CLAVVideo::StopStreaming()
+{
+    StopOutputThread();
+    LogProcessingStats();
+    return __super::StopStreaming();
+}
+
+HRESULT CLAVVideo::StartOutputThread()
+{
+    CAutoLock lock(&m_csOutputQueue);
+    if (m_bOutputThreadActive)
+        return S_FALSE;
+
+    DbgLog((LOG_TRACE, 10, L"CLAVVideo::StartOutputThread(): Starting pipelined output"));
+
+    m_hrOutputThread = S_OK;
+    m_bOutputThreadBusy = FALSE;
+    m_evOutputAvailable.Reset();
+    m_evOutputIdle.Set();
+
+    if (!Create())
+    {
+        DbgLog((LOG_ERROR, 10, L"CLAVVideo::StartOutputThread(): Failed to create the output thread"));
+        return E_FAIL;
+    }
+
+    m_bOutputThreadActive = TRUE;
+    return S_OK;
+}
+
+HRESULT CLAVVideo::StopOutputThread()
+{
+    {
+        CAutoLock lock(&m_csOutputQueue);
+        if (!m_bOutputThreadActive)
+            return S_FALSE;
+        m_bOutputThreadActive = FALSE;
+    }
+
+    ClearOutputQueue();
+
+    CAMThread::CallWorker(CMD_EXIT);
+    CAMThread::Close();
+
+    m_evOutputIdle.Set();
+    return S_OK;
+}
+
+HRESULT CLAVVideo::QueueOutputFrame(LAVFrame *pFrame)
+{
+    for (;;)
+    {
+        {
+            CAutoLock lock(&m_csOutputQueue);
+            if (!m_bOutputThreadActive)
+                break;
+
+            if (m_bFlushing)
+            {
+                ReleaseFrame(&pFrame);
+                return S_FALSE;
+            }
+
+            // report errors of the output thread back upstream
+            if (FAILED(m_hrOutputThread))
+            {
+                ReleaseFrame(&pFrame);
+                m_hrDeliver = m_hrOutputThread;
+                return m_hrOutputThread;
+            }
+
+            if (m_OutputQueue.size() < PIPELINED_OUTPUT_QUEUE)
+            {
+                m_OutputQueue.push_back(pFrame);
+
+                m_evOutputIdle.Reset();
+                m_evOutputAvailable.Set();
+                return S_OK;
+            }
+        }
+
+        // wait for the output thread to make room in the queue
+        m_evOutputSpace.Wait();
+    }
+
+    // the output thread was shut down, process synchronously
+    return ProcessOutputFrame(pFrame);
+}
+
+void CLAVVideo::ClearOutputQueue()
+{
+    CAutoLock lock(&m_csOutputQueue);
+
+    if (!m_OutputQueue.empty())
+        DbgLog((LOG_TRACE, 10, L"CLAVVideo::ClearOutputQueue(): Dropping %d queued frames", m_OutputQueue.size()));
+
+    for (LAVFrame *pFrame : m_OutputQueue)
+        ReleaseFrame(&pFrame);
+    m_OutputQueue.clear();
+
+    m_evOutputAvailable.Reset();
+    if (!m_bOutputThreadBusy)
+        m_evOutputIdle.Set();
+
+    // release a blocked delivery call
+    m_evOutputSpace.Set();
+}
+
+void CLAVVideo::WaitForOutputIdle()
+{
+    {
+        CAutoLock lock(&m_csOutputQueue);
+        if (!m_bOutputThreadActive)
+            return;
+    }
+
+    // the event is signalled again once the queue is empty and the output thread is done with its frame, or when the
+    // thread is stopped
+    m_evOutputIdle.Wait();
+}
+
+DWORD CLAVVideo::ThreadProc()
+{
+    SetThreadName(-1, "LAVVideo Output");
+    CLAVFramePool::SetThreadClient(this);
+
+    HANDLE hWait[2] = {GetRequestHandle(), m_evOutputAvailable};
+
+    for (;;)
+    {
+        DWORD dwWait = WaitForMultipleObjects(countof(hWait), hWait, FALSE, INFINITE);
+        if (dwWait == WAIT_OBJECT_0)
+        {
+            DWORD cmd = GetRequest();
+            Reply(S_OK);
+            ASSERT(cmd == CMD_EXIT);
+            return 0;
+        }
+
+        LAVFrame *pFrame = nullptr;
+        {
+            CAutoLock lock(&m_csOutputQueue);
+            if (!m_OutputQueue.empty())
+            {
+                pFrame = m_OutputQueue.front();
+                m_OutputQueue.pop_front();
+                m_bOutputThreadBusy = TRUE;
+                m_evOutputSpace.Set();
+            }
+
+            if (m_OutputQueue.empty())
+                m_evOutputAvailable.Reset();
+        }
+
+        if (!pFrame)
+            continue;
+
+        HRESULT hr = ProcessOutputFrame(pFrame);
+
+        {
+            CAutoLock lock(&m_csOutputQueue);
+            if (FAILED(hr) && !m_bFlushing && SUCCEEDED(m_hrOutputThread))
+            {
+                DbgLog((LOG_TRACE, 10, L"CLAVVideo::ThreadProc(): Processing failed, hr: %0#.8x", hr));
+                m_hrOutputThread = hr;
+            }
+
+            m_bOutputThreadBusy = FALSE;
+            if (m_OutputQueue.empty())
+                m_evOutputIdle.Set();
+        }
+    }
+
+    return 0;
+}
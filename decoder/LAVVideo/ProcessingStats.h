@@ -0,0 +1,65 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVVideoSettings.h"
+#include "ProcessingCounter.h"
+
+// Processing time and frame count of the individual stages of the decoder
+// The stages can run on different threads (see pipelined output)
+class CLAVProcessingStats
+{
+  public:
+    static LONGLONG Now() { return CProcessingCounter::Now(); }
+
+    void Reset()
+    {
+        for (CProcessingCounter &stage : m_Stages)
+            stage.Reset();
+    }
+
+    // Adds the time since llStart (obtained from Now()) and one frame to the stage, and returns the current time
+    LONGLONG Add(LAVVideoStage stage, LONGLONG llStart) { return m_Stages[stage].Add(llStart); }
+    void AddTicks(LAVVideoStage stage, LONGLONG llTicks) { m_Stages[stage].AddTicks(llTicks); }
+    void AddFrame(LAVVideoStage stage) { m_Stages[stage].AddCount(); }
+
+    ULONGLONG GetCount(LAVVideoStage stage) const { return m_Stages[stage].GetCount(); }
+    // Time in 100ns units
+    REFERENCE_TIME GetTime(LAVVideoStage stage) const { return m_Stages[stage].GetTime(); }
+
+  private:
+    CProcessingCounter m_Stages[LAVStage_NB];
+};
+
+// Accumulates the time between its construction and destruction into a counter
+class CLAVScopedTicks
+{
+  public:
+    CLAVScopedTicks(LONGLONG &llTicks)
+        : m_llTicks(llTicks)
+        , m_llStart(CLAVProcessingStats::Now())
+    {
+    }
+    ~CLAVScopedTicks() { m_llTicks += CLAVProcessingStats::Now() - m_llStart; }
+
+  private:
+    LONGLONG &m_llTicks;
+    const LONGLONG m_llStart;
+};
@@ -256,10 +256,12 @@ HRESULT CLAVVideoSettingsProp::OnActivate()
     WCHAR swdeintYADIF[] = L"YADIF";
     WCHAR swdeintW3FDIFS[] = L"Weston Three Field (Simple)";
     WCHAR swdeintW3FDIFC[] = L"Weston Three Field (Complex)";
+    WCHAR swdeintBWDIF[] = L"BWDIF (Bob Weaver)";
     SendDlgItemMessage(m_Dlg, IDC_SWDEINT_MODE, CB_ADDSTRING, 0, (LPARAM)swdeintNone);
     SendDlgItemMessage(m_Dlg, IDC_SWDEINT_MODE, CB_ADDSTRING, 0, (LPARAM)swdeintYADIF);
     SendDlgItemMessage(m_Dlg, IDC_SWDEINT_MODE, CB_ADDSTRING, 0, (LPARAM)swdeintW3FDIFS);
     SendDlgItemMessage(m_Dlg, IDC_SWDEINT_MODE, CB_ADDSTRING, 0, (LPARAM)swdeintW3FDIFC);
+    SendDlgItemMessage(m_Dlg, IDC_SWDEINT_MODE, CB_ADDSTRING, 0, (LPARAM)swdeintBWDIF);
 
     addHint(IDC_HWACCEL_MPEG4, L"EXPERIMENTAL! The MPEG4-ASP decoder is known to be unstable! Use at your own peril!");
     addHint(IDC_HWACCEL_CUVID_DXVA, L"Enable DXVA video processing for CUVID decoding, enables hybrid decoding and can "
@@ -482,10 +484,11 @@ HRESULT CLAVVideoSettingsProp::UpdateHWOptions()
 HRESULT CLAVVideoSettingsProp::UpdateYADIFOptions()
 {
     DWORD dwVal = (DWORD)SendDlgItemMessage(m_Dlg, IDC_SWDEINT_MODE, CB_GETCURSEL, 0, 0);
+    const BOOL bOutputMode = (dwVal == SWDeintMode_YADIF || dwVal == SWDeintMode_BWDIF);
 
-    EnableWindow(GetDlgItem(m_Dlg, IDC_LBL_SWDEINT_MODE), (dwVal == SWDeintMode_YADIF));
-    EnableWindow(GetDlgItem(m_Dlg, IDC_SWDEINT_OUT_FILM), (dwVal == SWDeintMode_YADIF));
-    EnableWindow(GetDlgItem(m_Dlg, IDC_SWDEINT_OUT_VIDEO), (dwVal == SWDeintMode_YADIF));
+    EnableWindow(GetDlgItem(m_Dlg, IDC_LBL_SWDEINT_MODE), bOutputMode);
+    EnableWindow(GetDlgItem(m_Dlg, IDC_SWDEINT_OUT_FILM), bOutputMode);
+    EnableWindow(GetDlgItem(m_Dlg, IDC_SWDEINT_OUT_VIDEO), bOutputMode);
 
     return S_OK;
 }
@@ -0,0 +1,863 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "Yadif.h"
+#include "LAVFramePool.h"
+
+#include <immintrin.h>
+#include <ppl.h>
+#include <type_traits>
+
+// Source lines to interpolate one line from
+// m and p are the lines above and below the interpolated line, prev2 and next2 are the frames with the same parity
+// as the interpolated line. The 2m and 2p lines are only needed for the spatial interlacing check, the lines further
+// away only for bwdif.
+template <typename T> struct YadifLines
+{
+    const T *prev_m, *prev_p;
+    const T *cur_m, *cur_p;
+    const T *next_m, *next_p;
+    const T *prev2, *next2;
+    const T *prev2_2m, *prev2_2p;
+    const T *next2_2m, *next2_2p;
+    const T *cur_m3, *cur_p3;
+    const T *prev2_4m, *prev2_4p;
+    const T *next2_4m, *next2_4p;
+};
+
+template <typename T> using YadifLineFunc = void (*)(T *dst, const YadifLines<T> &l, ptrdiff_t start, ptrdiff_t end,
+                                                     BOOL bCheck);
+
+// Score of the edge direction j, comparing the lines above and below the pixel at an angle
+template <typename T, int step> static __forceinline int yadif_score(const T *m, const T *p, int j)
+{
+    return abs(m[(j - 1) * step] - p[(-j - 1) * step]) + abs(m[j * step] - p[-j * step]) +
+           abs(m[(j + 1) * step] - p[(1 - j) * step]);
+}
+
+// step is the distance between two pixels of the same component, ie. 2 for the interleaved chroma of NV12
+template <typename T, int step, bool spatial>
+static void yadif_line_c(T *dst, const YadifLines<T> &l, ptrdiff_t start, ptrdiff_t end, BOOL bCheck)
+{
+    for (ptrdiff_t x = start; x < end; x++)
+    {
+        const int c = l.cur_m[x];
+        const int e = l.cur_p[x];
+        const int d = (l.prev2[x] + l.next2[x]) >> 1;
+        const int temporal_diff0 = abs(l.prev2[x] - l.next2[x]);
+        const int temporal_diff1 = (abs(l.prev_m[x] - c) + abs(l.prev_p[x] - e)) >> 1;
+        const int temporal_diff2 = (abs(l.next_m[x] - c) + abs(l.next_p[x] - e)) >> 1;
+        int diff = max(max(temporal_diff0 >> 1, temporal_diff1), temporal_diff2);
+        int spatial_pred = (c + e) >> 1;
+
+        if (spatial)
+        {
+            const T *m = l.cur_m + x;
+            const T *p = l.cur_p + x;
+            int spatial_score = abs(m[-step] - p[-step]) + abs(c - e) + abs(m[step] - p[step]) - 1;
+
+            int score = yadif_score<T, step>(m, p, -1);
+            if (score < spatial_score)
+            {
+                spatial_score = score;
+                spatial_pred = (m[-step] + p[step]) >> 1;
+                score = yadif_score<T, step>(m, p, -2);
+                if (score < spatial_score)
+                {
+                    spatial_score = score;
+                    spatial_pred = (m[-2 * step] + p[2 * step]) >> 1;
+                }
+            }
+            score = yadif_score<T, step>(m, p, 1);
+            if (score < spatial_score)
+            {
+                spatial_score = score;
+                spatial_pred = (m[step] + p[-step]) >> 1;
+                score = yadif_score<T, step>(m, p, 2);
+                if (score < spatial_score)
+                {
+                    spatial_score = score;
+                    spatial_pred = (m[2 * step] + p[-2 * step]) >> 1;
+                }
+            }
+        }
+
+        // spatial interlacing check
+        if (bCheck)
+        {
+            const int b = (l.prev2_2m[x] + l.next2_2m[x]) >> 1;
+            const int f = (l.prev2_2p[x] + l.next2_2p[x]) >> 1;
+            const int dmax = max(max(d - e, d - c), min(b - c, f - e));
+            const int dmin = min(min(d - e, d - c), max(b - c, f - e));
+            diff = max(max(diff, dmin), -dmax);
+        }
+
+        if (spatial_pred > d + diff)
+            spatial_pred = d + diff;
+        else if (spatial_pred < d - diff)
+            spatial_pred = d - diff;
+
+        dst[x] = (T)spatial_pred;
+    }
+}
+
+// SIMD operations on pixels widened to 16 or 32-bit lanes
+// The 8-bit yadif kernels work in 16-bit lanes. The 16-bit yadif kernels and all bwdif kernels, whose filter
+// coefficients need more precision, work in 32-bit lanes.
+
+struct SIMDOpsSSE2_16
+{
+    typedef uint8_t Pixel;
+    typedef __m128i V;
+    static const int N = 8;
+
+    static __forceinline V load(const uint8_t *p)
+    {
+        return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+    }
+    static __forceinline void store(uint8_t *p, V v) { _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(v, v)); }
+
+    static __forceinline V set1(int v) { return _mm_set1_epi16((short)v); }
+    static __forceinline V add(V a, V b) { return _mm_add_epi16(a, b); }
+    static __forceinline V sub(V a, V b) { return _mm_sub_epi16(a, b); }
+    static __forceinline V half(V a) { return _mm_srli_epi16(a, 1); }
+    static __forceinline V avg(V a, V b) { return _mm_srli_epi16(_mm_add_epi16(a, b), 1); }
+    static __forceinline V absdiff(V a, V b) { return _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a)); }
+    static __forceinline V max(V a, V b) { return _mm_max_epi16(a, b); }
+    static __forceinline V min(V a, V b) { return _mm_min_epi16(a, b); }
+    static __forceinline V cmpgt(V a, V b) { return _mm_cmpgt_epi16(a, b); }
+    static __forceinline V blend(V mask, V a, V b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+    static __forceinline V and_(V a, V b) { return _mm_and_si128(a, b); }
+};
+
+template <typename T> struct SIMDOpsSSE2_32
+{
+    typedef T Pixel;
+    typedef __m128i V;
+    static const int N = 4;
+
+    static __forceinline V load(const T *p)
+    {
+        if (sizeof(T) == 1)
+        {
+            const __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(AV_RN32(p)), _mm_setzero_si128());
+            return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+        }
+        return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+    }
+    static __forceinline void store(T *p, V v)
+    {
+        if (sizeof(T) == 1)
+        {
+            v = _mm_packs_epi32(v, v);
+            AV_WN32(p, _mm_cvtsi128_si32(_mm_packus_epi16(v, v)));
+        }
+        else
+        {
+            // there is no unsigned 32-bit pack in SSE2, so the values are moved into the signed range for it
+            v = _mm_packs_epi32(_mm_sub_epi32(v, _mm_set1_epi32(0x8000)), _mm_setzero_si128());
+            _mm_storel_epi64((__m128i *)p, _mm_xor_si128(v, _mm_set1_epi16((short)0x8000)));
+        }
+    }
+
+    static __forceinline V set1(int v) { return _mm_set1_epi32(v); }
+    static __forceinline V add(V a, V b) { return _mm_add_epi32(a, b); }
+    static __forceinline V sub(V a, V b) { return _mm_sub_epi32(a, b); }
+    static __forceinline V half(V a) { return _mm_srli_epi32(a, 1); }
+    static __forceinline V avg(V a, V b) { return _mm_srli_epi32(_mm_add_epi32(a, b), 1); }
+    static __forceinline V cmpgt(V a, V b) { return _mm_cmpgt_epi32(a, b); }
+    static __forceinline V blend(V mask, V a, V b)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+    static __forceinline V and_(V a, V b) { return _mm_and_si128(a, b); }
+    static __forceinline V max(V a, V b) { return blend(_mm_cmpgt_epi32(a, b), a, b); }
+    static __forceinline V min(V a, V b) { return blend(_mm_cmpgt_epi32(a, b), b, a); }
+    static __forceinline V absdiff(V a, V b)
+    {
+        const V d = _mm_sub_epi32(a, b);
+        const V sign = _mm_srai_epi32(d, 31);
+        return _mm_sub_epi32(_mm_xor_si128(d, sign), sign);
+    }
+    // low 32 bits of the product, built from the two 32x32->64-bit multiplies of SSE2
+    static __forceinline V mul(V a, V b)
+    {
+        const V even = _mm_mul_epu32(a, b);
+        const V odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+    template <int n> static __forceinline V srai(V a) { return _mm_srai_epi32(a, n); }
+};
+
+struct SIMDOpsAVX2_16
+{
+    typedef uint8_t Pixel;
+    typedef __m256i V;
+    static const int N = 16;
+
+    static __forceinline V load(const uint8_t *p) { return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p)); }
+    static __forceinline void store(uint8_t *p, V v)
+    {
+        _mm_storeu_si128((__m128i *)p, _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+    }
+
+    static __forceinline V set1(int v) { return _mm256_set1_epi16((short)v); }
+    static __forceinline V add(V a, V b) { return _mm256_add_epi16(a, b); }
+    static __forceinline V sub(V a, V b) { return _mm256_sub_epi16(a, b); }
+    static __forceinline V half(V a) { return _mm256_srli_epi16(a, 1); }
+    static __forceinline V avg(V a, V b) { return _mm256_srli_epi16(_mm256_add_epi16(a, b), 1); }
+    static __forceinline V absdiff(V a, V b) { return _mm256_abs_epi16(_mm256_sub_epi16(a, b)); }
+    static __forceinline V max(V a, V b) { return _mm256_max_epi16(a, b); }
+    static __forceinline V min(V a, V b) { return _mm256_min_epi16(a, b); }
+    static __forceinline V cmpgt(V a, V b) { return _mm256_cmpgt_epi16(a, b); }
+    static __forceinline V blend(V mask, V a, V b) { return _mm256_blendv_epi8(b, a, mask); }
+    static __forceinline V and_(V a, V b) { return _mm256_and_si256(a, b); }
+};
+
+template <typename T> struct SIMDOpsAVX2_32
+{
+    typedef T Pixel;
+    typedef __m256i V;
+    static const int N = 8;
+
+    static __forceinline V load(const T *p)
+    {
+        if (sizeof(T) == 1)
+            return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)p));
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)p));
+    }
+    static __forceinline void store(T *p, V v)
+    {
+        const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        if (sizeof(T) == 1)
+            _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(packed, packed));
+        else
+            _mm_storeu_si128((__m128i *)p, packed);
+    }
+
+    static __forceinline V set1(int v) { return _mm256_set1_epi32(v); }
+    static __forceinline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+    static __forceinline V sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+    static __forceinline V half(V a) { return _mm256_srli_epi32(a, 1); }
+    static __forceinline V avg(V a, V b) { return _mm256_srli_epi32(_mm256_add_epi32(a, b), 1); }
+    static __forceinline V absdiff(V a, V b) { return _mm256_abs_epi32(_mm256_sub_epi32(a, b)); }
+    static __forceinline V max(V a, V b) { return _mm256_max_epi32(a, b); }
+    static __forceinline V min(V a, V b) { return _mm256_min_epi32(a, b); }
+    static __forceinline V cmpgt(V a, V b) { return _mm256_cmpgt_epi32(a, b); }
+    static __forceinline V blend(V mask, V a, V b) { return _mm256_blendv_epi8(b, a, mask); }
+    static __forceinline V and_(V a, V b) { return _mm256_and_si256(a, b); }
+    static __forceinline V mul(V a, V b) { return _mm256_mullo_epi32(a, b); }
+    template <int n> static __forceinline V srai(V a) { return _mm256_srai_epi32(a, n); }
+};
+
+template <class Ops, int step>
+static __forceinline typename Ops::V yadif_score_simd(const typename Ops::Pixel *m, const typename Ops::Pixel *p, int j)
+{
+    return Ops::add(Ops::add(Ops::absdiff(Ops::load(m + (j - 1) * step), Ops::load(p + (-j - 1) * step)),
+                             Ops::absdiff(Ops::load(m + j * step), Ops::load(p - j * step))),
+                    Ops::absdiff(Ops::load(m + (j + 1) * step), Ops::load(p + (1 - j) * step)));
+}
+
+// Ops::N pixels at a time, bit-exact with the C version
+template <class Ops, int step>
+static void yadif_line_simd(typename Ops::Pixel *dst, const YadifLines<typename Ops::Pixel> &l, ptrdiff_t start,
+                            ptrdiff_t end, BOOL bCheck)
+{
+    typedef typename Ops::Pixel T;
+    typedef typename Ops::V V;
+    const V one = Ops::set1(1);
+    const V zero = Ops::set1(0);
+
+    ptrdiff_t x = start;
+    for (; x + Ops::N <= end; x += Ops::N)
+    {
+        const T *m = l.cur_m + x;
+        const T *p = l.cur_p + x;
+
+        const V c = Ops::load(m);
+        const V e = Ops::load(p);
+        const V prev2 = Ops::load(l.prev2 + x);
+        const V next2 = Ops::load(l.next2 + x);
+        const V d = Ops::avg(prev2, next2);
+
+        const V temporal_diff0 = Ops::absdiff(prev2, next2);
+        const V temporal_diff1 =
+            Ops::avg(Ops::absdiff(Ops::load(l.prev_m + x), c), Ops::absdiff(Ops::load(l.prev_p + x), e));
+        const V temporal_diff2 =
+            Ops::avg(Ops::absdiff(Ops::load(l.next_m + x), c), Ops::absdiff(Ops::load(l.next_p + x), e));
+        V diff = Ops::max(Ops::max(Ops::half(temporal_diff0), temporal_diff1), temporal_diff2);
+
+        // the score starts out at -1 at worst, so the comparisons need to be signed
+        V spatial_pred = Ops::avg(c, e);
+        V spatial_score = Ops::add(Ops::absdiff(Ops::load(m - step), Ops::load(p - step)),
+                                   Ops::absdiff(Ops::load(m + step), Ops::load(p + step)));
+        spatial_score = Ops::sub(Ops::add(spatial_score, Ops::absdiff(c, e)), one);
+
+        // the second check of every direction only applies where the first one improved the score
+        V score = yadif_score_simd<Ops, step>(m, p, -1);
+        V mask = Ops::cmpgt(spatial_score, score);
+        spatial_score = Ops::min(score, spatial_score);
+        spatial_pred = Ops::blend(mask, Ops::avg(Ops::load(m - step), Ops::load(p + step)), spatial_pred);
+
+        score = yadif_score_simd<Ops, step>(m, p, -2);
+        mask = Ops::and_(mask, Ops::cmpgt(spatial_score, score));
+        spatial_score = Ops::blend(mask, score, spatial_score);
+        spatial_pred = Ops::blend(mask, Ops::avg(Ops::load(m - 2 * step), Ops::load(p + 2 * step)), spatial_pred);
+
+        score = yadif_score_simd<Ops, step>(m, p, 1);
+        mask = Ops::cmpgt(spatial_score, score);
+        spatial_score = Ops::min(score, spatial_score);
+        spatial_pred = Ops::blend(mask, Ops::avg(Ops::load(m + step), Ops::load(p - step)), spatial_pred);
+
+        score = yadif_score_simd<Ops, step>(m, p, 2);
+        mask = Ops::and_(mask, Ops::cmpgt(spatial_score, score));
+        spatial_pred = Ops::blend(mask, Ops::avg(Ops::load(m + 2 * step), Ops::load(p - 2 * step)), spatial_pred);
+
+        if (bCheck)
+        {
+            const V b = Ops::avg(Ops::load(l.prev2_2m + x), Ops::load(l.next2_2m + x));
+            const V f = Ops::avg(Ops::load(l.prev2_2p + x), Ops::load(l.next2_2p + x));
+            const V de = Ops::sub(d, e);
+            const V dc = Ops::sub(d, c);
+            const V bc = Ops::sub(b, c);
+            const V fe = Ops::sub(f, e);
+            const V dmax = Ops::max(Ops::max(de, dc), Ops::min(bc, fe));
+            const V dmin = Ops::min(Ops::min(de, dc), Ops::max(bc, fe));
+            diff = Ops::max(Ops::max(diff, dmin), Ops::sub(zero, dmax));
+        }
+
+        spatial_pred = Ops::min(Ops::max(spatial_pred, Ops::sub(d, diff)), Ops::add(d, diff));
+        Ops::store(dst + x, spatial_pred);
+    }
+
+    // remaining pixels
+    yadif_line_c<T, step, true>(dst, l, x, end, bCheck);
+}
+
+// CPU specific kernel selection
+// 8-bit pixels fit into 16-bit lanes for yadif, 16-bit pixels need 32-bit lanes
+template <typename T> using YadifOpsSSE2 = std::conditional_t<sizeof(T) == 1, SIMDOpsSSE2_16, SIMDOpsSSE2_32<T>>;
+template <typename T> using YadifOpsAVX2 = std::conditional_t<sizeof(T) == 1, SIMDOpsAVX2_16, SIMDOpsAVX2_32<T>>;
+
+template <typename T, int step> static YadifLineFunc<T> yadif_line_func(int flags)
+{
+    if (flags & AV_CPU_FLAG_AVX2)
+        return yadif_line_simd<YadifOpsAVX2<T>, step>;
+    if (flags & AV_CPU_FLAG_SSE2)
+        return yadif_line_simd<YadifOpsSSE2<T>, step>;
+    return yadif_line_c<T, step, true>;
+}
+
+// Filter coefficients of the bwdif filter in libavfilter, in 13-bit fixed point
+static const int bwdif_coef_lf[2] = {4309, 213};
+static const int bwdif_coef_hf[3] = {5570, 3801, 1016};
+static const int bwdif_coef_sp[2] = {5077, 981};
+
+template <typename T>
+using BwdifLineFunc = void (*)(T *dst, const YadifLines<T> &l, ptrdiff_t start, ptrdiff_t end, BOOL bCheck,
+                               int clip_max);
+
+// With bFull, the lines are interpolated from the four lines above and below the pixel (the "Bob Weaver" filter),
+// otherwise, ie. close to the picture edges, the average of the lines above and below is used like in yadif.
+template <typename T, bool bFull>
+static void bwdif_line_c(T *dst, const YadifLines<T> &l, ptrdiff_t start, ptrdiff_t end, BOOL bCheck, int clip_max)
+{
+    for (ptrdiff_t x = start; x < end; x++)
+    {
+        const int c = l.cur_m[x];
+        const int e = l.cur_p[x];
+        const int d = (l.prev2[x] + l.next2[x]) >> 1;
+        const int temporal_diff0 = abs(l.prev2[x] - l.next2[x]);
+        const int temporal_diff1 = (abs(l.prev_m[x] - c) + abs(l.prev_p[x] - e)) >> 1;
+        const int temporal_diff2 = (abs(l.next_m[x] - c) + abs(l.next_p[x] - e)) >> 1;
+        int diff = max(max(temporal_diff0 >> 1, temporal_diff1), temporal_diff2);
+
+        // static pixels are weaved
+        if (!diff)
+        {
+            dst[x] = (T)d;
+            continue;
+        }
+
+        // spatial interlacing check
+        if (bFull || bCheck)
+        {
+            const int b = ((l.prev2_2m[x] + l.next2_2m[x]) >> 1) - c;
+            const int f = ((l.prev2_2p[x] + l.next2_2p[x]) >> 1) - e;
+            const int dmax = max(max(d - e, d - c), min(b, f));
+            const int dmin = min(min(d - e, d - c), max(b, f));
+            diff = max(max(diff, dmin), -dmax);
+        }
+
+        int interpol;
+        if (!bFull)
+            interpol = (c + e) >> 1;
+        else if (abs(c - e) > temporal_diff0)
+            interpol = (((bwdif_coef_hf[0] * (l.prev2[x] + l.next2[x]) -
+                          bwdif_coef_hf[1] * (l.prev2_2m[x] + l.next2_2m[x] + l.prev2_2p[x] + l.next2_2p[x]) +
+                          bwdif_coef_hf[2] * (l.prev2_4m[x] + l.next2_4m[x] + l.prev2_4p[x] + l.next2_4p[x])) >>
+                         2) +
+                        bwdif_coef_lf[0] * (c + e) - bwdif_coef_lf[1] * (l.cur_m3[x] + l.cur_p3[x])) >>
+                       13;
+        else
+            interpol = (bwdif_coef_sp[0] * (c + e) - bwdif_coef_sp[1] * (l.cur_m3[x] + l.cur_p3[x])) >> 13;
+
+        if (interpol > d + diff)
+            interpol = d + diff;
+        else if (interpol < d - diff)
+            interpol = d - diff;
+
+        dst[x] = (T)av_clip(interpol, 0, clip_max);
+    }
+}
+
+// Spatial interpolation only, used when there are no neighbouring frames
+template <typename T>
+static void bwdif_intra_c(T *dst, const YadifLines<T> &l, ptrdiff_t start, ptrdiff_t end, int clip_max)
+{
+    for (ptrdiff_t x = start; x < end; x++)
+    {
+        const int interpol = (bwdif_coef_sp[0] * (l.cur_m[x] + l.cur_p[x]) -
+                              bwdif_coef_sp[1] * (l.cur_m3[x] + l.cur_p3[x])) >>
+                             13;
+        dst[x] = (T)av_clip(interpol, 0, clip_max);
+    }
+}
+
+// Ops::N pixels at a time, in 32-bit precision, bit-exact with the C version
+template <class Ops>
+static void bwdif_line_simd(typename Ops::Pixel *dst, const YadifLines<typename Ops::Pixel> &l, ptrdiff_t start,
+                            ptrdiff_t end, BOOL bCheck, int clip_max)
+{
+    typedef typename Ops::Pixel T;
+    typedef typename Ops::V V;
+    const V zero = Ops::set1(0);
+    const V vclip_max = Ops::set1(clip_max);
+    const V lf0 = Ops::set1(bwdif_coef_lf[0]), lf1 = Ops::set1(bwdif_coef_lf[1]);
+    const V hf0 = Ops::set1(bwdif_coef_hf[0]), hf1 = Ops::set1(bwdif_coef_hf[1]), hf2 = Ops::set1(bwdif_coef_hf[2]);
+    const V sp0 = Ops::set1(bwdif_coef_sp[0]), sp1 = Ops::set1(bwdif_coef_sp[1]);
+
+    ptrdiff_t x = start;
+    for (; x + Ops::N <= end; x += Ops::N)
+    {
+        const V c = Ops::load(l.cur_m + x);
+        const V e = Ops::load(l.cur_p + x);
+        const V prev2 = Ops::load(l.prev2 + x);
+        const V next2 = Ops::load(l.next2 + x);
+        const V d = Ops::avg(prev2, next2);
+
+        const V temporal_diff0 = Ops::absdiff(prev2, next2);
+        const V temporal_diff1 =
+            Ops::avg(Ops::absdiff(Ops::load(l.prev_m + x), c), Ops::absdiff(Ops::load(l.prev_p + x), e));
+        const V temporal_diff2 =
+            Ops::avg(Ops::absdiff(Ops::load(l.next_m + x), c), Ops::absdiff(Ops::load(l.next_p + x), e));
+        const V temporal_diff = Ops::max(Ops::max(Ops::half(temporal_diff0), temporal_diff1), temporal_diff2);
+
+        const V prev2_2m = Ops::load(l.prev2_2m + x), next2_2m = Ops::load(l.next2_2m + x);
+        const V prev2_2p = Ops::load(l.prev2_2p + x), next2_2p = Ops::load(l.next2_2p + x);
+        const V b = Ops::sub(Ops::avg(prev2_2m, next2_2m), c);
+        const V f = Ops::sub(Ops::avg(prev2_2p, next2_2p), e);
+        const V de = Ops::sub(d, e);
+        const V dc = Ops::sub(d, c);
+        const V dmax = Ops::max(Ops::max(de, dc), Ops::min(b, f));
+        const V dmin = Ops::min(Ops::min(de, dc), Ops::max(b, f));
+        const V diff = Ops::max(Ops::max(temporal_diff, dmin), Ops::sub(zero, dmax));
+
+        const V ce = Ops::add(c, e);
+        const V cur3 = Ops::add(Ops::load(l.cur_m3 + x), Ops::load(l.cur_p3 + x));
+        const V refs2 = Ops::add(Ops::add(prev2_2m, next2_2m), Ops::add(prev2_2p, next2_2p));
+        const V refs4 = Ops::add(Ops::add(Ops::load(l.prev2_4m + x), Ops::load(l.next2_4m + x)),
+                                 Ops::add(Ops::load(l.prev2_4p + x), Ops::load(l.next2_4p + x)));
+
+        V interpol_hf = Ops::sub(Ops::mul(hf0, Ops::add(prev2, next2)), Ops::mul(hf1, refs2));
+        interpol_hf = Ops::template srai<2>(Ops::add(interpol_hf, Ops::mul(hf2, refs4)));
+        interpol_hf = Ops::template srai<13>(Ops::sub(Ops::add(interpol_hf, Ops::mul(lf0, ce)), Ops::mul(lf1, cur3)));
+        const V interpol_sp = Ops::template srai<13>(Ops::sub(Ops::mul(sp0, ce), Ops::mul(sp1, cur3)));
+
+        V interpol = Ops::blend(Ops::cmpgt(Ops::absdiff(c, e), temporal_diff0), interpol_hf, interpol_sp);
+        interpol = Ops::min(Ops::max(interpol, Ops::sub(d, diff)), Ops::add(d, diff));
+        interpol = Ops::min(Ops::max(interpol, zero), vclip_max);
+
+        Ops::store(dst + x, Ops::blend(Ops::cmpgt(temporal_diff, zero), interpol, d));
+    }
+
+    // remaining pixels
+    bwdif_line_c<T, true>(dst, l, x, end, bCheck, clip_max);
+}
+
+template <typename T> static BwdifLineFunc<T> bwdif_line_func(int flags)
+{
+    if (flags & AV_CPU_FLAG_AVX2)
+        return bwdif_line_simd<SIMDOpsAVX2_32<T>>;
+    if (flags & AV_CPU_FLAG_SSE2)
+        return bwdif_line_simd<SIMDOpsSSE2_32<T>>;
+    return bwdif_line_c<T, true>;
+}
+
+// Interpolate a range of lines of one plane, and copy the lines of the kept field
+// The edge-directed interpolation needs 3 pixels on either side, the outermost pixels only use the vertical neighbours
+template <typename T, int step>
+static void yadif_filter_plane(LAVFrame *pOut, const LAVFrame *prev, const LAVFrame *cur, const LAVFrame *next,
+                               int plane, ptrdiff_t width, ptrdiff_t height, ptrdiff_t y0, ptrdiff_t y1, int parity,
+                               int tff, YadifLineFunc<T> filter_line)
+{
+    const LAVFrame *prev2 = (parity ^ tff) ? prev : cur;
+    const LAVFrame *next2 = (parity ^ tff) ? cur : next;
+
+#define YADIF_LINE(frame, line) ((const T *)(frame->data[plane] + (line)*frame->stride[plane]))
+
+    for (ptrdiff_t y = y0; y < y1; y++)
+    {
+        T *dst = (T *)(pOut->data[plane] + y * pOut->stride[plane]);
+        if ((y ^ parity) & 1)
+        {
+            // the lines above and below are mirrored at the picture edges
+            const ptrdiff_t ym = y ? y - 1 : y + 1;
+            const ptrdiff_t yp = y + 1 < height ? y + 1 : y - 1;
+            const BOOL bCheck = !(y == 1 || y + 2 == height);
+
+            YadifLines<T> l;
+            l.prev_m = YADIF_LINE(prev, ym);
+            l.prev_p = YADIF_LINE(prev, yp);
+            l.cur_m = YADIF_LINE(cur, ym);
+            l.cur_p = YADIF_LINE(cur, yp);
+            l.next_m = YADIF_LINE(next, ym);
+            l.next_p = YADIF_LINE(next, yp);
+            l.prev2 = YADIF_LINE(prev2, y);
+            l.next2 = YADIF_LINE(next2, y);
+            l.prev2_2m = bCheck ? YADIF_LINE(prev2, 2 * ym - y) : nullptr;
+            l.prev2_2p = bCheck ? YADIF_LINE(prev2, 2 * yp - y) : nullptr;
+            l.next2_2m = bCheck ? YADIF_LINE(next2, 2 * ym - y) : nullptr;
+            l.next2_2p = bCheck ? YADIF_LINE(next2, 2 * yp - y) : nullptr;
+
+            if (width >= 6 * step)
+            {
+                yadif_line_c<T, step, false>(dst, l, 0, 3 * step, bCheck);
+                filter_line(dst, l, 3 * step, width - 3 * step, bCheck);
+                yadif_line_c<T, step, false>(dst, l, width - 3 * step, width, bCheck);
+            }
+            else
+            {
+                yadif_line_c<T, step, false>(dst, l, 0, width, bCheck);
+            }
+        }
+        else
+        {
+            memcpy(dst, YADIF_LINE(cur, y), width * sizeof(T));
+        }
+    }
+
+#undef YADIF_LINE
+}
+
+// Interpolate a range of lines of one plane with bwdif
+// The filter is purely vertical, so interleaved chroma needs no special handling. Without neighbouring frames, ie. at
+// the start and the end of the stream, only the current field is used.
+template <typename T>
+static void bwdif_filter_plane(LAVFrame *pOut, const LAVFrame *prev, const LAVFrame *cur, const LAVFrame *next,
+                               int plane, ptrdiff_t width, ptrdiff_t height, ptrdiff_t y0, ptrdiff_t y1, int parity,
+                               int tff, BOOL bIntra, int clip_max, BwdifLineFunc<T> filter_line)
+{
+    const LAVFrame *prev2 = (parity ^ tff) ? prev : cur;
+    const LAVFrame *next2 = (parity ^ tff) ? cur : next;
+
+#define BWDIF_LINE(frame, line) ((const T *)(frame->data[plane] + (line)*frame->stride[plane]))
+
+    for (ptrdiff_t y = y0; y < y1; y++)
+    {
+        T *dst = (T *)(pOut->data[plane] + y * pOut->stride[plane]);
+        if ((y ^ parity) & 1)
+        {
+            // the lines above and below are mirrored at the picture edges
+            const ptrdiff_t ym = y ? y - 1 : y + 1;
+            const ptrdiff_t yp = y + 1 < height ? y + 1 : y - 1;
+
+            YadifLines<T> l = {};
+            l.cur_m = BWDIF_LINE(cur, ym);
+            l.cur_p = BWDIF_LINE(cur, yp);
+
+            if (bIntra)
+            {
+                l.cur_m3 = BWDIF_LINE(cur, y > 2 ? y - 3 : yp);
+                l.cur_p3 = BWDIF_LINE(cur, y + 3 < height ? y + 3 : ym);
+                bwdif_intra_c<T>(dst, l, 0, width, clip_max);
+                continue;
+            }
+
+            l.prev_m = BWDIF_LINE(prev, ym);
+            l.prev_p = BWDIF_LINE(prev, yp);
+            l.next_m = BWDIF_LINE(next, ym);
+            l.next_p = BWDIF_LINE(next, yp);
+            l.prev2 = BWDIF_LINE(prev2, y);
+            l.next2 = BWDIF_LINE(next2, y);
+
+            const BOOL bCheck = y >= 2 && y + 3 <= height;
+            if (bCheck)
+            {
+                l.prev2_2m = BWDIF_LINE(prev2, y - 2);
+                l.prev2_2p = BWDIF_LINE(prev2, y + 2);
+                l.next2_2m = BWDIF_LINE(next2, y - 2);
+                l.next2_2p = BWDIF_LINE(next2, y + 2);
+            }
+
+            if (y >= 4 && y + 5 <= height)
+            {
+                l.cur_m3 = BWDIF_LINE(cur, y - 3);
+                l.cur_p3 = BWDIF_LINE(cur, y + 3);
+                l.prev2_4m = BWDIF_LINE(prev2, y - 4);
+                l.prev2_4p = BWDIF_LINE(prev2, y + 4);
+                l.next2_4m = BWDIF_LINE(next2, y - 4);
+                l.next2_4p = BWDIF_LINE(next2, y + 4);
+                filter_line(dst, l, 0, width, bCheck, clip_max);
+            }
+            else
+            {
+                bwdif_line_c<T, false>(dst, l, 0, width, bCheck, clip_max);
+            }
+        }
+        else
+        {
+            memcpy(dst, BWDIF_LINE(cur, y), width * sizeof(T));
+        }
+    }
+
+#undef BWDIF_LINE
+}
+
+CLAVYadif::CLAVYadif(LAVPixelFormat format, BOOL bFieldOutput, int nThreads, BOOL bBwdif)
+    : m_Format(format)
+    , m_bFieldOutput(bFieldOutput)
+    , m_nThreads(max(nThreads, 1))
+    , m_bBwdif(bBwdif)
+{
+}
+
+CLAVYadif::~CLAVYadif()
+{
+    ReleaseFrames();
+}
+
+BOOL CLAVYadif::IsFormatSupported(LAVPixelFormat format)
+{
+    return format == LAVPixFmt_YUV420 || format == LAVPixFmt_YUV420bX || format == LAVPixFmt_YUV422 ||
+           format == LAVPixFmt_YUV422bX || format == LAVPixFmt_NV12 || format == LAVPixFmt_NV21 ||
+           format == LAVPixFmt_P016;
+}
+
+void CLAVYadif::Reset(LAVPixelFormat format, BOOL bFieldOutput, int nThreads, BOOL bBwdif)
+{
+    ReleaseFrames();
+
+    m_Format = format;
+    m_bFieldOutput = bFieldOutput;
+    m_nThreads = max(nThreads, 1);
+    m_bBwdif = bBwdif;
+    m_rtNext = AV_NOPTS_VALUE;
+    m_bEOF = FALSE;
+}
+
+static void yadif_release_frame(LAVFrame *pFrame)
+{
+    FreeLAVFrameBuffers(pFrame);
+    CLAVFramePool::Get().FreeFrame(pFrame);
+}
+
+void CLAVYadif::ReleaseFrames()
+{
+    if (m_pPrev && m_pPrev != m_pCur && m_pPrev != m_pNext)
+        yadif_release_frame(m_pPrev);
+    if (m_pCur && m_pCur != m_pNext)
+        yadif_release_frame(m_pCur);
+    if (m_pNext)
+        yadif_release_frame(m_pNext);
+
+    m_pPrev = m_pCur = m_pNext = nullptr;
+    m_nOutputs = m_nNextOutput = 0;
+}
+
+void CLAVYadif::PushFrame(LAVFrame *pFrame)
+{
+    LAVFrame *pOld = m_pPrev;
+    m_pPrev = m_pCur;
+    m_pCur = m_pNext;
+    m_pNext = pFrame;
+
+    if (pOld && pOld != m_pPrev && pOld != m_pCur && pOld != m_pNext)
+        yadif_release_frame(pOld);
+
+    m_rtNext = m_pNext->rtStart;
+    m_nNextOutput = 0;
+    m_nOutputs = m_pCur ? ((m_bFieldOutput && m_pCur->interlaced) ? 2 : 1) : 0;
+}
+
+HRESULT CLAVYadif::SendFrame(LAVFrame *pFrame, BOOL bRefcounted)
+{
+    if (m_bEOF)
+        return E_UNEXPECTED;
+
+    if (!bRefcounted)
+    {
+        LAVFrame *pCopy = nullptr;
+        HRESULT hr = CopyLAVFrame(pFrame, &pCopy);
+        if (FAILED(hr))
+        {
+            if (pCopy)
+                yadif_release_frame(pCopy);
+            return hr;
+        }
+        pFrame = pCopy;
+    }
+
+    PushFrame(pFrame);
+    return S_OK;
+}
+
+HRESULT CLAVYadif::SendEOF()
+{
+    if (m_bEOF || !m_pNext)
+        return S_OK;
+    m_bEOF = TRUE;
+
+    // extrapolate the start of the following frame from the last frame distance
+    REFERENCE_TIME rtNext = m_pNext->rtStop;
+    if (m_pCur && m_pCur->rtStart != AV_NOPTS_VALUE && m_pNext->rtStart != AV_NOPTS_VALUE)
+        rtNext = 2 * m_pNext->rtStart - m_pCur->rtStart;
+
+    // the last frame serves as its own successor
+    PushFrame(m_pNext);
+    m_rtNext = rtNext;
+
+    return S_OK;
+}
+
+HRESULT CLAVYadif::ReceiveFrame(LAVFrame *pFrame)
+{
+    if (m_nNextOutput >= m_nOutputs)
+        return S_FALSE;
+
+    const int field = m_nNextOutput++;
+
+    pFrame->format = m_Format;
+    pFrame->bpp = m_pCur->bpp;
+    pFrame->width = m_pCur->width;
+    pFrame->height = m_pCur->height;
+    pFrame->aspect_ratio = m_pCur->aspect_ratio;
+    pFrame->tff = m_pCur->tff;
+    pFrame->interlaced = 0;
+
+    pFrame->rtStart = m_pCur->rtStart;
+    if (field == 1 && m_pCur->rtStart != AV_NOPTS_VALUE && m_rtNext != AV_NOPTS_VALUE)
+        pFrame->rtStart = (m_pCur->rtStart + m_rtNext) / 2;
+
+    HRESULT hr = AllocLAVFrameBuffers(pFrame);
+    if (FAILED(hr))
+        return hr;
+
+    // frames not flagged as interlaced are passed through
+    if (!m_pCur->interlaced)
+        return CopyFrame(pFrame);
+
+    // the first field keeps the lines of the top field in tff content, the second field those of the bottom field
+    const int tff = m_pCur->tff ? 1 : 0;
+    return FilterFrame(pFrame, tff ^ !field, tff);
+}
+
+HRESULT CLAVYadif::CopyFrame(LAVFrame *pOut)
+{
+    LAVPixFmtDesc desc = getPixelFormatDesc(m_Format);
+    for (int plane = 0; plane < desc.planes; plane++)
+    {
+        const size_t linesize = (m_pCur->width / desc.planeWidth[plane]) * desc.codedbytes;
+        const int height = m_pCur->height / desc.planeHeight[plane];
+        for (int y = 0; y < height; y++)
+            memcpy(pOut->data[plane] + y * pOut->stride[plane], m_pCur->data[plane] + y * m_pCur->stride[plane],
+                   linesize);
+    }
+    return S_OK;
+}
+
+HRESULT CLAVYadif::FilterFrame(LAVFrame *pOut, int parity, int tff)
+{
+    const LAVPixFmtDesc desc = getPixelFormatDesc(m_Format);
+    const LAVFrame *prev = m_pPrev ? m_pPrev : m_pCur;
+    const LAVFrame *cur = m_pCur;
+    const LAVFrame *next = m_pNext;
+
+    // the chroma of NV12, NV21 and P016 is interleaved, so the neighbouring pixels of the same component are 2 apart
+    const BOOL bSemiPlanar = (m_Format == LAVPixFmt_NV12 || m_Format == LAVPixFmt_NV21 || m_Format == LAVPixFmt_P016);
+    const int flags = av_get_cpu_flags();
+
+    // bwdif clips its interpolation to the valid range, P016 holds P010 data in the high bits
+    const int clip_max = desc.codedbytes == 1 ? 255 : (m_Format == LAVPixFmt_P016 ? 65535 : (1 << cur->bpp) - 1);
+    const BOOL bIntra = !m_pPrev || m_pNext == m_pCur;
+
+    // planes too small to interpolate are copied
+    if (cur->height / desc.planeHeight[desc.planes - 1] < 3)
+        return CopyFrame(pOut);
+
+    auto filter_slice = [&](int slice) {
+        for (int plane = 0; plane < desc.planes; plane++)
+        {
+            const ptrdiff_t width = cur->width / desc.planeWidth[plane];
+            const ptrdiff_t height = cur->height / desc.planeHeight[plane];
+            const ptrdiff_t y0 = height * slice / m_nThreads;
+            const ptrdiff_t y1 = height * (slice + 1) / m_nThreads;
+
+            if (m_bBwdif)
+            {
+                if (desc.codedbytes == 1)
+                    bwdif_filter_plane<uint8_t>(pOut, prev, cur, next, plane, width, height, y0, y1, parity, tff,
+                                                bIntra, clip_max, bwdif_line_func<uint8_t>(flags));
+                else
+                    bwdif_filter_plane<uint16_t>(pOut, prev, cur, next, plane, width, height, y0, y1, parity, tff,
+                                                 bIntra, clip_max, bwdif_line_func<uint16_t>(flags));
+            }
+            else if (desc.codedbytes == 1)
+            {
+                if (bSemiPlanar && plane == 1)
+                    yadif_filter_plane<uint8_t, 2>(pOut, prev, cur, next, plane, width, height, y0, y1, parity, tff,
+                                                   yadif_line_func<uint8_t, 2>(flags));
+                else
+                    yadif_filter_plane<uint8_t, 1>(pOut, prev, cur, next, plane, width, height, y0, y1, parity, tff,
+                                                   yadif_line_func<uint8_t, 1>(flags));
+            }
+            else
+            {
+                if (bSemiPlanar && plane == 1)
+                    yadif_filter_plane<uint16_t, 2>(pOut, prev, cur, next, plane, width, height, y0, y1, parity,
+                                                    tff, yadif_line_func<uint16_t, 2>(flags));
+                else
+                    yadif_filter_plane<uint16_t, 1>(pOut, prev, cur, next, plane, width, height, y0, y1, parity,
+                                                    tff, yadif_line_func<uint16_t, 1>(flags));
+            }
+        }
+    };
+
+    if (m_nThreads <= 1)
+        filter_slice(0);
+    else
+        Concurrency::parallel_for(0, m_nThreads, filter_slice);
+
+    return S_OK;
+}
@@ -0,0 +1,70 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "decoders/ILAVDecoder.h"
+
+// Native implementation of the yadif and bwdif deinterlacers
+//
+// The algorithms follow the yadif and bwdif filters in libavfilter, but work directly on the planes of LAVFrames,
+// including the semi-planar NV12 and P010/P016 formats. Input frames are kept until they are no longer needed as a
+// reference, the output is delayed by one frame.
+class CLAVYadif
+{
+  public:
+    CLAVYadif(LAVPixelFormat format, BOOL bFieldOutput, int nThreads, BOOL bBwdif = FALSE);
+    ~CLAVYadif();
+
+    static BOOL IsFormatSupported(LAVPixelFormat format);
+
+    // Release all frames and change the configuration, ie. for a new frame size
+    void Reset(LAVPixelFormat format, BOOL bFieldOutput, int nThreads, BOOL bBwdif);
+
+    // Send a frame, see CLAVDeinterlacer::SendFrame
+    HRESULT SendFrame(LAVFrame *pFrame, BOOL bRefcounted);
+    // Signal the end of the stream, the last frame will be output
+    HRESULT SendEOF();
+    // Retrieve the next output frame, returns S_FALSE if no frame is available
+    HRESULT ReceiveFrame(LAVFrame *pFrame);
+
+  private:
+    void PushFrame(LAVFrame *pFrame);
+    void ReleaseFrames();
+
+    HRESULT FilterFrame(LAVFrame *pOut, int parity, int tff);
+    HRESULT CopyFrame(LAVFrame *pOut);
+
+    LAVPixelFormat m_Format = LAVPixFmt_None;
+    BOOL m_bFieldOutput = FALSE;
+    int m_nThreads = 1;
+    BOOL m_bBwdif = FALSE;
+
+    // the same frame may be referenced multiple times, ie. at the start and the end of the stream
+    LAVFrame *m_pPrev = nullptr;
+    LAVFrame *m_pCur = nullptr;
+    LAVFrame *m_pNext = nullptr;
+
+    // start time of the next frame, or an extrapolated time at the end of the stream
+    REFERENCE_TIME m_rtNext = AV_NOPTS_VALUE;
+    BOOL m_bEOF = FALSE;
+
+    int m_nOutputs = 0;    // number of output frames for the current frame
+    int m_nNextOutput = 0; // index of the next output frame
+};
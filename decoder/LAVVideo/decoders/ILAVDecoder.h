@@ -57,6 +57,14 @@ typedef enum LAVPixelFormat {
     LAVPixFmt_DXVA2,       ///< DXVA2 Surface
     LAVPixFmt_D3D11,       ///< D3D11 Surface
 
+    /* planar RGB */
+    LAVPixFmt_GBRP,        ///< RGB, planar, 8 bit, planes in G/B/R order
+    LAVPixFmt_GBRPbX,      ///< RGB, planar, 9-16 bit, planes in G/B/R order
+
+    /* packed/half-packed YUV with swapped chroma order */
+    LAVPixFmt_NV21,        ///< YUV 4:2:0, V/U interleaved
+    LAVPixFmt_UYVY,        ///< YUV 4:2:2, packed, UYVY order
+
     LAVPixFmt_NB,          ///< number of formats
 } LAVPixelFormat;
 // clang-format on
@@ -30,6 +30,8 @@
 #include "IMediaSideDataFFmpeg.h"
 #include "ByteParser.h"
 
+#include <emmintrin.h>
+
 #ifdef DEBUG
 #include "lavf_log.h"
 #endif
@@ -37,6 +39,7 @@
 extern "C"
 {
 #include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/mastering_display_metadata.h"
 #include "libavutil/hdr_dynamic_metadata.h"
 };
@@ -81,6 +84,9 @@ static DXVA2_ExtendedFormat GetDXVA2ExtendedFlags(AVCodecContext *ctx, AVFrame *
 
 // This mapping table should contain all pixel formats, except hardware formats (VDPAU, XVMC, DXVA, etc)
 // A format that is not listed will be converted to YUV420
+// Formats flagged for conversion are converted in the decoder, and then again by the pixel format converter.
+// Paletted RGB, 15/16-bit RGB and the big-endian variants of the LAV formats are converted directly, all other
+// flagged formats are converted by swscale.
 static struct PixelFormatMapping
 {
     AVPixelFormat ffpixfmt;
@@ -103,7 +109,7 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_YUVJ420P, LAVPixFmt_YUV420, FALSE},
     {AV_PIX_FMT_YUVJ422P, LAVPixFmt_YUV422, FALSE},
     {AV_PIX_FMT_YUVJ444P, LAVPixFmt_YUV444, FALSE},
-    {AV_PIX_FMT_UYVY422, LAVPixFmt_YUV422, TRUE},
+    {AV_PIX_FMT_UYVY422, LAVPixFmt_UYVY, FALSE},
     {AV_PIX_FMT_UYYVYY411, LAVPixFmt_YUV422, TRUE},
     {AV_PIX_FMT_BGR8, LAVPixFmt_RGB32, TRUE},
     {AV_PIX_FMT_BGR4, LAVPixFmt_RGB32, TRUE},
@@ -112,7 +118,7 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_RGB4, LAVPixFmt_RGB32, TRUE},
     {AV_PIX_FMT_RGB4_BYTE, LAVPixFmt_RGB32, TRUE},
     {AV_PIX_FMT_NV12, LAVPixFmt_NV12, FALSE},
-    {AV_PIX_FMT_NV21, LAVPixFmt_NV12, TRUE},
+    {AV_PIX_FMT_NV21, LAVPixFmt_NV21, FALSE},
 
     {AV_PIX_FMT_ARGB, LAVPixFmt_ARGB32, TRUE},
     {AV_PIX_FMT_RGBA, LAVPixFmt_ARGB32, TRUE},
@@ -123,7 +129,7 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_GRAY16LE, LAVPixFmt_YUV420, TRUE},
     {AV_PIX_FMT_YUV440P, LAVPixFmt_YUV444, TRUE},
     {AV_PIX_FMT_YUVJ440P, LAVPixFmt_YUV444, TRUE},
-    {AV_PIX_FMT_YUVA420P, LAVPixFmt_YUV420, TRUE},
+    {AV_PIX_FMT_YUVA420P, LAVPixFmt_YUV420, FALSE},
     {AV_PIX_FMT_RGB48BE, LAVPixFmt_RGB48, TRUE},
     {AV_PIX_FMT_RGB48LE, LAVPixFmt_RGB48, FALSE},
 
@@ -165,16 +171,16 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_YUV422P9BE, LAVPixFmt_YUV422bX, TRUE, 9},
     {AV_PIX_FMT_YUV422P9LE, LAVPixFmt_YUV422bX, FALSE, 9},
 
-    {AV_PIX_FMT_GBRP, LAVPixFmt_RGB32, TRUE},
-    {AV_PIX_FMT_GBRP9BE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP9LE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP10BE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP10LE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP16BE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP16LE, LAVPixFmt_RGB48, TRUE},
+    {AV_PIX_FMT_GBRP, LAVPixFmt_GBRP, FALSE},
+    {AV_PIX_FMT_GBRP9BE, LAVPixFmt_GBRPbX, TRUE, 9},
+    {AV_PIX_FMT_GBRP9LE, LAVPixFmt_GBRPbX, FALSE, 9},
+    {AV_PIX_FMT_GBRP10BE, LAVPixFmt_GBRPbX, TRUE, 10},
+    {AV_PIX_FMT_GBRP10LE, LAVPixFmt_GBRPbX, FALSE, 10},
+    {AV_PIX_FMT_GBRP16BE, LAVPixFmt_GBRPbX, TRUE, 16},
+    {AV_PIX_FMT_GBRP16LE, LAVPixFmt_GBRPbX, FALSE, 16},
 
-    {AV_PIX_FMT_YUVA422P, LAVPixFmt_YUV422, TRUE},
-    {AV_PIX_FMT_YUVA444P, LAVPixFmt_YUV444, TRUE},
+    {AV_PIX_FMT_YUVA422P, LAVPixFmt_YUV422, FALSE},
+    {AV_PIX_FMT_YUVA444P, LAVPixFmt_YUV444, FALSE},
     {AV_PIX_FMT_YUVA420P9BE, LAVPixFmt_YUV420bX, TRUE, 9},
     {AV_PIX_FMT_YUVA420P9LE, LAVPixFmt_YUV420bX, FALSE, 9},
     {AV_PIX_FMT_YUVA422P9BE, LAVPixFmt_YUV422bX, TRUE, 9},
@@ -209,9 +215,9 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_YA16BE, LAVPixFmt_YUV420bX, TRUE, 16},
     {AV_PIX_FMT_YA16LE, LAVPixFmt_YUV420bX, TRUE, 16},
 
-    {AV_PIX_FMT_GBRAP, LAVPixFmt_ARGB32, TRUE},
-    {AV_PIX_FMT_GBRAP16BE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRAP16LE, LAVPixFmt_RGB48, TRUE},
+    {AV_PIX_FMT_GBRAP, LAVPixFmt_GBRP, FALSE},
+    {AV_PIX_FMT_GBRAP16BE, LAVPixFmt_GBRPbX, TRUE, 16},
+    {AV_PIX_FMT_GBRAP16LE, LAVPixFmt_GBRPbX, FALSE, 16},
 
     {AV_PIX_FMT_0RGB, LAVPixFmt_RGB32, TRUE},
     {AV_PIX_FMT_RGB0, LAVPixFmt_RGB32, TRUE},
@@ -230,10 +236,10 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_YUV444P12LE, LAVPixFmt_YUV444bX, FALSE, 12},
     {AV_PIX_FMT_YUV444P14BE, LAVPixFmt_YUV444bX, TRUE, 14},
     {AV_PIX_FMT_YUV444P14LE, LAVPixFmt_YUV444bX, FALSE, 14},
-    {AV_PIX_FMT_GBRP12BE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP12LE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP14BE, LAVPixFmt_RGB48, TRUE},
-    {AV_PIX_FMT_GBRP14LE, LAVPixFmt_RGB48, TRUE},
+    {AV_PIX_FMT_GBRP12BE, LAVPixFmt_GBRPbX, TRUE, 12},
+    {AV_PIX_FMT_GBRP12LE, LAVPixFmt_GBRPbX, FALSE, 12},
+    {AV_PIX_FMT_GBRP14BE, LAVPixFmt_GBRPbX, TRUE, 14},
+    {AV_PIX_FMT_GBRP14LE, LAVPixFmt_GBRPbX, FALSE, 14},
     {AV_PIX_FMT_YUVJ411P, LAVPixFmt_YUV422, TRUE},
 
     {AV_PIX_FMT_YUV440P10LE, LAVPixFmt_YUV444bX, TRUE, 10},
@@ -241,6 +247,11 @@ static struct PixelFormatMapping
     {AV_PIX_FMT_YUV440P12LE, LAVPixFmt_YUV444bX, TRUE, 12},
     {AV_PIX_FMT_YUV440P12BE, LAVPixFmt_YUV444bX, TRUE, 12},
 
+    {AV_PIX_FMT_GBRAP12LE, LAVPixFmt_GBRPbX, FALSE, 12},
+    {AV_PIX_FMT_GBRAP10LE, LAVPixFmt_GBRPbX, FALSE, 10},
+    {AV_PIX_FMT_YUVA422P12LE, LAVPixFmt_YUV422bX, FALSE, 12},
+    {AV_PIX_FMT_YUVA444P12LE, LAVPixFmt_YUV444bX, FALSE, 12},
+
     {AV_PIX_FMT_P010LE, LAVPixFmt_P016, FALSE, 10},
     {AV_PIX_FMT_P016LE, LAVPixFmt_P016, FALSE, 16},
 
@@ -266,7 +277,7 @@ static struct PixelFormatMapping getPixFmtMapping(AVPixelFormat pixfmt)
         }
     }
     if (result.lavpixfmt != LAVPixFmt_YUV420bX && result.lavpixfmt != LAVPixFmt_YUV422bX &&
-        result.lavpixfmt != LAVPixFmt_YUV444bX)
+        result.lavpixfmt != LAVPixFmt_YUV444bX && result.lavpixfmt != LAVPixFmt_GBRPbX)
         result.bpp = 8;
 
     return result;
@@ -1414,6 +1425,160 @@ STDMETHODIMP CDecAvcodec::GetPixelFormat(LAVPixelFormat *pPix, int *pBpp)
     return S_OK;
 }
 
+// Expand 8-bit paletted pixels to RGB32, the palette entries are already stored in BGRA order
+static void ConvertPAL8ToRGB32(const AVFrame *pFrame, BYTE *dst, ptrdiff_t dstStride)
+{
+    const uint32_t *pal = (const uint32_t *)pFrame->data[1];
+    for (int line = 0; line < pFrame->height; line++)
+    {
+        const uint8_t *src = pFrame->data[0] + line * pFrame->linesize[0];
+        uint32_t *out = (uint32_t *)(dst + line * dstStride);
+        for (int i = 0; i < pFrame->width; i++)
+            out[i] = pal[src[i]];
+    }
+}
+
+// Expand 15/16-bit RGB to RGB32
+// gBits is 5 for RGB555 and 6 for RGB565, bSwapRB selects the BGR variants, the top bit of 555 is ignored
+template <int gBits, int bSwapRB, int bBigEndian>
+static void ConvertRGB16ToRGB32(const AVFrame *pFrame, BYTE *dst, ptrdiff_t dstStride)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i maskG = _mm_set1_epi16((1 << gBits) - 1);
+    const __m128i alpha = _mm_set1_epi16((short)0xff00);
+
+    for (int line = 0; line < pFrame->height; line++)
+    {
+        const uint8_t *src = pFrame->data[0] + line * pFrame->linesize[0];
+        uint8_t *out = dst + line * dstStride;
+
+        int i = 0;
+        for (; i < (pFrame->width - 7); i += 8)
+        {
+            __m128i xmm0 = _mm_loadu_si128((const __m128i *)(src + i * 2));
+            if (bBigEndian)
+                xmm0 = _mm_or_si128(_mm_slli_epi16(xmm0, 8), _mm_srli_epi16(xmm0, 8));
+
+            // low, middle and high component, each in 16-bit words
+            __m128i xmm1 = _mm_and_si128(xmm0, mask5);
+            __m128i xmm2 = _mm_and_si128(_mm_srli_epi16(xmm0, 5), maskG);
+            __m128i xmm3 = _mm_and_si128(_mm_srli_epi16(xmm0, 5 + gBits), mask5);
+
+            // replicate the high bits into the low bits to cover the full 8-bit range
+            xmm1 = _mm_or_si128(_mm_slli_epi16(xmm1, 3), _mm_srli_epi16(xmm1, 2));
+            xmm2 = _mm_or_si128(_mm_slli_epi16(xmm2, 8 - gBits), _mm_srli_epi16(xmm2, 2 * gBits - 8));
+            xmm3 = _mm_or_si128(_mm_slli_epi16(xmm3, 3), _mm_srli_epi16(xmm3, 2));
+
+            // RGB565 stores blue in the low bits, BGR565 stores red there
+            __m128i b = bSwapRB ? xmm3 : xmm1;
+            __m128i r = bSwapRB ? xmm1 : xmm3;
+
+            __m128i bg = _mm_or_si128(b, _mm_slli_epi16(xmm2, 8));
+            __m128i ra = _mm_or_si128(r, alpha);
+
+            _mm_storeu_si128((__m128i *)(out + i * 4), _mm_unpacklo_epi16(bg, ra));
+            _mm_storeu_si128((__m128i *)(out + i * 4 + 16), _mm_unpackhi_epi16(bg, ra));
+        }
+
+        for (; i < pFrame->width; i++)
+        {
+            unsigned v = bBigEndian ? AV_RB16(src + i * 2) : AV_RL16(src + i * 2);
+            unsigned c1 = v & 0x1f, c2 = (v >> 5) & ((1 << gBits) - 1), c3 = (v >> (5 + gBits)) & 0x1f;
+            c1 = (c1 << 3) | (c1 >> 2);
+            c2 = (c2 << (8 - gBits)) | (c2 >> (2 * gBits - 8));
+            c3 = (c3 << 3) | (c3 >> 2);
+            out[i * 4 + 0] = bSwapRB ? c3 : c1;
+            out[i * 4 + 1] = c2;
+            out[i * 4 + 2] = bSwapRB ? c1 : c3;
+            out[i * 4 + 3] = 0xff;
+        }
+    }
+}
+
+// Check if the destination format is the little-endian version of the big-endian source format
+// An alpha plane in the source is allowed and will be dropped
+static BOOL IsByteSwappedFormat(AVPixelFormat srcFormat, AVPixelFormat dstFormat)
+{
+    const AVPixFmtDescriptor *src = av_pix_fmt_desc_get(srcFormat);
+    const AVPixFmtDescriptor *dst = av_pix_fmt_desc_get(dstFormat);
+    if (!src || !dst || !(src->flags & AV_PIX_FMT_FLAG_BE) || (dst->flags & AV_PIX_FMT_FLAG_BE))
+        return FALSE;
+
+    const uint64_t flags = AV_PIX_FMT_FLAG_PLANAR | AV_PIX_FMT_FLAG_RGB;
+    if ((src->flags & flags) != (dst->flags & flags) || src->log2_chroma_w != dst->log2_chroma_w ||
+        src->log2_chroma_h != dst->log2_chroma_h)
+        return FALSE;
+
+    int nb_components = src->nb_components;
+    if ((src->flags & AV_PIX_FMT_FLAG_ALPHA) && !(dst->flags & AV_PIX_FMT_FLAG_ALPHA))
+        nb_components--;
+    if (nb_components != dst->nb_components)
+        return FALSE;
+
+    for (int i = 0; i < nb_components; i++)
+    {
+        if (src->comp[i].plane != dst->comp[i].plane || src->comp[i].step != dst->comp[i].step ||
+            src->comp[i].offset != dst->comp[i].offset || src->comp[i].shift != dst->comp[i].shift ||
+            src->comp[i].depth != dst->comp[i].depth || src->comp[i].depth <= 8)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+// Byte-swap the 16-bit samples of all planes used by the destination format
+static void ConvertByteSwap16(const AVFrame *pFrame, AVPixelFormat dstFormat, BYTE *const dst[4],
+                              const ptrdiff_t dstStride[4])
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(dstFormat);
+
+    int planes = 0;
+    for (int i = 0; i < desc->nb_components; i++)
+        planes = max(planes, desc->comp[i].plane + 1);
+
+    for (int plane = 0; plane < planes; plane++)
+    {
+        const int lineSize = av_image_get_linesize(dstFormat, pFrame->width, plane);
+        const int height = (plane == 1 || plane == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB)
+                               ? AV_CEIL_RSHIFT(pFrame->height, desc->log2_chroma_h)
+                               : pFrame->height;
+
+        for (int line = 0; line < height; line++)
+        {
+            const uint8_t *src = pFrame->data[plane] + line * pFrame->linesize[plane];
+            uint8_t *out = dst[plane] + line * dstStride[plane];
+
+            int i = 0;
+            for (; i < (lineSize - 15); i += 16)
+            {
+                __m128i xmm0 = _mm_loadu_si128((const __m128i *)(src + i));
+                xmm0 = _mm_or_si128(_mm_slli_epi16(xmm0, 8), _mm_srli_epi16(xmm0, 8));
+                _mm_storeu_si128((__m128i *)(out + i), xmm0);
+            }
+            for (; i < lineSize; i += 2)
+                AV_WL16(out + i, AV_RB16(src + i));
+        }
+    }
+}
+
+typedef void (*RGB32ConvFunc)(const AVFrame *pFrame, BYTE *dst, ptrdiff_t dstStride);
+
+static RGB32ConvFunc GetRGB32ConvFunc(int format)
+{
+    switch (format)
+    {
+    case AV_PIX_FMT_PAL8: return ConvertPAL8ToRGB32;
+    case AV_PIX_FMT_RGB565LE: return ConvertRGB16ToRGB32<6, 0, 0>;
+    case AV_PIX_FMT_RGB565BE: return ConvertRGB16ToRGB32<6, 0, 1>;
+    case AV_PIX_FMT_RGB555LE: return ConvertRGB16ToRGB32<5, 0, 0>;
+    case AV_PIX_FMT_RGB555BE: return ConvertRGB16ToRGB32<5, 0, 1>;
+    case AV_PIX_FMT_BGR565LE: return ConvertRGB16ToRGB32<6, 1, 0>;
+    case AV_PIX_FMT_BGR565BE: return ConvertRGB16ToRGB32<6, 1, 1>;
+    case AV_PIX_FMT_BGR555LE: return ConvertRGB16ToRGB32<5, 1, 0>;
+    case AV_PIX_FMT_BGR555BE: return ConvertRGB16ToRGB32<5, 1, 1>;
+    }
+    return nullptr;
+}
+
 STDMETHODIMP CDecAvcodec::ConvertPixFmt(AVFrame *pFrame, LAVFrame *pOutFrame)
 {
     // Allocate the buffers to write into
@@ -1424,6 +1589,19 @@ STDMETHODIMP CDecAvcodec::ConvertPixFmt(AVFrame *pFrame, LAVFrame *pOutFrame)
     // Map to swscale compatible format
     AVPixelFormat dstFormat = getFFPixelFormatFromLAV(pOutFrame->format, pOutFrame->bpp);
 
+    // Paletted and 15/16-bit RGB, as well as big-endian formats, have a direct conversion
+    RGB32ConvFunc convFunc = (pOutFrame->format == LAVPixFmt_RGB32) ? GetRGB32ConvFunc(pFrame->format) : nullptr;
+    if (convFunc)
+    {
+        convFunc(pFrame, pOutFrame->data[0], pOutFrame->stride[0]);
+        return S_OK;
+    }
+    else if (IsByteSwappedFormat((AVPixelFormat)pFrame->format, dstFormat))
+    {
+        ConvertByteSwap16(pFrame, dstFormat, pOutFrame->data, pOutFrame->stride);
+        return S_OK;
+    }
+
     // Get a context
     m_pSwsContext = sws_getCachedContext(m_pSwsContext, pFrame->width, pFrame->height, (AVPixelFormat)pFrame->format,
                                          pFrame->width, pFrame->height, dstFormat,
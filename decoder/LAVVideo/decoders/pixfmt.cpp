@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "ILAVDecoder.h"
+#include "LAVFramePool.h"
 
 static LAVPixFmtDesc lav_pixfmt_desc[] = {
     {1, 3, {1, 2, 2}, {1, 2, 2}}, ///< LAVPixFmt_YUV420
@@ -34,6 +35,12 @@ static LAVPixFmtDesc lav_pixfmt_desc[] = {
     {4, 1, {1}, {1}},             ///< LAVPixFmt_RGB32
     {4, 1, {1}, {1}},             ///< LAVPixFmt_ARGB32
     {6, 1, {1}, {1}},             ///< LAVPixFmt_RGB48
+    {0, 0, {0}, {0}},             ///< LAVPixFmt_DXVA2 (hardware surface)
+    {0, 0, {0}, {0}},             ///< LAVPixFmt_D3D11 (hardware surface)
+    {1, 3, {1, 1, 1}, {1, 1, 1}}, ///< LAVPixFmt_GBRP
+    {2, 3, {1, 1, 1}, {1, 1, 1}}, ///< LAVPixFmt_GBRPbX
+    {1, 2, {1, 1}, {1, 2}},       ///< LAVPixFmt_NV21
+    {2, 1, {1}, {1}},             ///< LAVPixFmt_UYVY
 };
 
 LAVPixFmtDesc getPixelFormatDesc(LAVPixelFormat pixFmt)
@@ -50,7 +57,8 @@ static struct
     {LAVPixFmt_YUV444, AV_PIX_FMT_YUV444P}, {LAVPixFmt_NV12, AV_PIX_FMT_NV12},
     {LAVPixFmt_YUY2, AV_PIX_FMT_YUYV422},   {LAVPixFmt_RGB24, AV_PIX_FMT_BGR24},
     {LAVPixFmt_RGB32, AV_PIX_FMT_BGRA},     {LAVPixFmt_ARGB32, AV_PIX_FMT_BGRA},
-    {LAVPixFmt_RGB48, AV_PIX_FMT_RGB48LE},
+    {LAVPixFmt_RGB48, AV_PIX_FMT_RGB48LE},  {LAVPixFmt_GBRP, AV_PIX_FMT_GBRP},
+    {LAVPixFmt_NV21, AV_PIX_FMT_NV21},      {LAVPixFmt_UYVY, AV_PIX_FMT_UYVY422},
 };
 
 AVPixelFormat getFFPixelFormatFromLAV(LAVPixelFormat pixFmt, int bpp)
@@ -89,6 +97,13 @@ AVPixelFormat getFFPixelFormatFromLAV(LAVPixelFormat pixFmt, int bpp)
                                      : ((bpp == 12) ? AV_PIX_FMT_YUV444P12LE
                                                     : ((bpp == 14) ? AV_PIX_FMT_YUV444P14LE : AV_PIX_FMT_YUV444P16LE)));
             break;
+        case LAVPixFmt_GBRPbX:
+            fmt = (bpp == 9)
+                      ? AV_PIX_FMT_GBRP9LE
+                      : ((bpp == 10) ? AV_PIX_FMT_GBRP10LE
+                                     : ((bpp == 12) ? AV_PIX_FMT_GBRP12LE
+                                                    : ((bpp == 14) ? AV_PIX_FMT_GBRP14LE : AV_PIX_FMT_GBRP16LE)));
+            break;
         case LAVPixFmt_P016: fmt = (bpp <= 10) ? AV_PIX_FMT_P010LE : AV_PIX_FMT_P016LE; break;
         default: ASSERT(0);
         }
@@ -98,16 +113,13 @@ AVPixelFormat getFFPixelFormatFromLAV(LAVPixelFormat pixFmt, int bpp)
 
 static void free_buffers(struct LAVFrame *pFrame)
 {
-    _aligned_free(pFrame->data[0]);
-    _aligned_free(pFrame->data[1]);
-    _aligned_free(pFrame->data[2]);
-    _aligned_free(pFrame->data[3]);
+    CLAVFramePool &pool = CLAVFramePool::Get();
+    for (int plane = 0; plane < 4; plane++)
+    {
+        pool.FreeBuffer(pFrame->data[plane]);
+        pool.FreeBuffer(pFrame->stereo[plane]);
+    }
     memset(pFrame->data, 0, sizeof(pFrame->data));
-
-    _aligned_free(pFrame->stereo[0]);
-    _aligned_free(pFrame->stereo[1]);
-    _aligned_free(pFrame->stereo[2]);
-    _aligned_free(pFrame->stereo[3]);
     memset(pFrame->stereo, 0, sizeof(pFrame->stereo));
 }
 
@@ -132,7 +144,7 @@ HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, ptrdiff_t stride)
     {
         ptrdiff_t planeStride = stride / desc.planeWidth[plane];
         size_t size = planeStride * (alignedHeight / desc.planeHeight[plane]);
-        pFrame->data[plane] = (BYTE *)_aligned_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE, 64);
+        pFrame->data[plane] = CLAVFramePool::Get().AllocBuffer(size + AV_INPUT_BUFFER_PADDING_SIZE);
         if (pFrame->data[plane] == nullptr)
         {
             free_buffers(pFrame);
@@ -146,7 +158,7 @@ HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, ptrdiff_t stride)
         for (int plane = 0; plane < desc.planes; plane++)
         {
             size_t size = pFrame->stride[plane] * (alignedHeight / desc.planeHeight[plane]);
-            pFrame->stereo[plane] = (BYTE *)_aligned_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE, 64);
+            pFrame->stereo[plane] = CLAVFramePool::Get().AllocBuffer(size + AV_INPUT_BUFFER_PADDING_SIZE);
             if (pFrame->stereo[plane] == nullptr)
             {
                 free_buffers(pFrame);
@@ -177,7 +189,7 @@ HRESULT FreeLAVFrameBuffers(LAVFrame *pFrame)
 
     for (int i = 0; i < pFrame->side_data_count; i++)
     {
-        SAFE_CO_FREE(pFrame->side_data[i].data);
+        CLAVFramePool::Get().FreeBuffer(pFrame->side_data[i].data);
     }
     SAFE_CO_FREE(pFrame->side_data);
     pFrame->side_data_count = 0;
@@ -188,7 +200,7 @@ HRESULT FreeLAVFrameBuffers(LAVFrame *pFrame)
 HRESULT CopyLAVFrame(LAVFrame *pSrc, LAVFrame **ppDst)
 {
     ASSERT(pSrc->format != LAVPixFmt_DXVA2 && pSrc->format != LAVPixFmt_D3D11);
-    *ppDst = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+    *ppDst = CLAVFramePool::Get().AllocFrame();
     if (!*ppDst)
         return E_OUTOFMEMORY;
     **ppDst = *pSrc;
@@ -248,7 +260,7 @@ HRESULT CopyLAVFrameInPlace(LAVFrame *pFrame)
     CopyLAVFrame(pFrame, &tmpFrame);
     FreeLAVFrameBuffers(pFrame);
     *pFrame = *tmpFrame;
-    SAFE_CO_FREE(tmpFrame);
+    CLAVFramePool::Get().FreeFrame(tmpFrame);
     return S_OK;
 }
 
@@ -260,7 +272,7 @@ BYTE *AddLAVFrameSideData(LAVFrame *pFrame, GUID guidType, size_t size)
 
     pFrame->side_data = (LAVFrameSideData *)ptr;
     pFrame->side_data[pFrame->side_data_count].guidType = guidType;
-    pFrame->side_data[pFrame->side_data_count].data = (BYTE *)CoTaskMemAlloc(size);
+    pFrame->side_data[pFrame->side_data_count].data = CLAVFramePool::Get().AllocBuffer(size);
     pFrame->side_data[pFrame->side_data_count].size = size;
 
     if (!pFrame->side_data[pFrame->side_data_count].data)
@@ -191,3 +191,171 @@ template <int out32> DECLARE_CONV_FUNC_IMPL(convert_rgb48_rgb)
 
 template HRESULT CLAVPixFmtConverter::convert_rgb48_rgb<0> CONV_FUNC_PARAMS;
 template HRESULT CLAVPixFmtConverter::convert_rgb48_rgb<1> CONV_FUNC_PARAMS;
+
+// Planar RGB (GBR plane order, 8-bit or 9-16 bit) to packed RGB24/RGB32
+template <int hbd, int out32> DECLARE_CONV_FUNC_IMPL(convert_gbrp_rgb)
+{
+    const ptrdiff_t outStride = dstStride[0];
+    ptrdiff_t line, i;
+
+    LAVDitherMode ditherMode = m_pSettings->GetDitherMode();
+    const uint16_t *dithers = hbd ? GetRandomDitherCoeffs(height, 3, 8, 0) : nullptr;
+    if (dithers == nullptr)
+        ditherMode = LAVDither_Ordered;
+
+    __m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6;
+    __m128i ditherG = _mm_setzero_si128(), ditherB = _mm_setzero_si128(), ditherR = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32(-1);
+
+    DECLARE_ALIGNED(16, uint32_t, rgb32buffer)[16];
+
+    _mm_sfence();
+    for (line = 0; line < height; line++)
+    {
+        const uint8_t *g = src[0] + line * srcStride[0];
+        const uint8_t *b = src[1] + line * srcStride[1];
+        const uint8_t *r = src[2] + line * srcStride[2];
+
+        __m128i *dst128 = (__m128i *)(dst[0] + line * outStride);
+        uint32_t *dst24 = (uint32_t *)(dst[0] + line * outStride);
+
+        if (hbd)
+        {
+            // Load dithering coefficients for this line
+            if (ditherMode == LAVDither_Random)
+            {
+                ditherG = _mm_load_si128((const __m128i *)(dithers + (line * 24) + 0));
+                ditherB = _mm_load_si128((const __m128i *)(dithers + (line * 24) + 8));
+                ditherR = _mm_load_si128((const __m128i *)(dithers + (line * 24) + 16));
+            }
+            else
+            {
+                PIXCONV_LOAD_DITHER_COEFFS(ditherR, line, 8, dithers);
+                ditherG = ditherB = ditherR;
+            }
+        }
+
+        for (i = 0; i < width; i += 16)
+        {
+            if (hbd)
+            {
+                const uint16_t *g16 = (const uint16_t *)g;
+                const uint16_t *b16 = (const uint16_t *)b;
+                const uint16_t *r16 = (const uint16_t *)r;
+
+                PIXCONV_LOAD_PIXEL16_DITHER(xmm0, ditherG, (g16 + i), bpp);
+                PIXCONV_LOAD_PIXEL16_DITHER(xmm4, ditherG, (g16 + i + 8), bpp);
+                PIXCONV_LOAD_PIXEL16_DITHER(xmm1, ditherB, (b16 + i), bpp);
+                PIXCONV_LOAD_PIXEL16_DITHER(xmm5, ditherB, (b16 + i + 8), bpp);
+                PIXCONV_LOAD_PIXEL16_DITHER(xmm2, ditherR, (r16 + i), bpp);
+                PIXCONV_LOAD_PIXEL16_DITHER(xmm6, ditherR, (r16 + i + 8), bpp);
+
+                xmm0 = _mm_packus_epi16(xmm0, xmm4); /* GGGGGGGG */
+                xmm1 = _mm_packus_epi16(xmm1, xmm5); /* BBBBBBBB */
+                xmm2 = _mm_packus_epi16(xmm2, xmm6); /* RRRRRRRR */
+            }
+            else
+            {
+                PIXCONV_LOAD_PIXEL8_ALIGNED(xmm0, (g + i)); /* GGGGGGGG */
+                PIXCONV_LOAD_PIXEL8_ALIGNED(xmm1, (b + i)); /* BBBBBBBB */
+                PIXCONV_LOAD_PIXEL8_ALIGNED(xmm2, (r + i)); /* RRRRRRRR */
+            }
+
+            // Interleave into BGRA
+            xmm3 = _mm_unpacklo_epi8(xmm1, xmm0);  /* BGBGBGBG */
+            xmm4 = _mm_unpackhi_epi8(xmm1, xmm0);  /* BGBGBGBG */
+            xmm5 = _mm_unpacklo_epi8(xmm2, alpha); /* RARARARA */
+            xmm6 = _mm_unpackhi_epi8(xmm2, alpha); /* RARARARA */
+
+            xmm0 = _mm_unpacklo_epi16(xmm3, xmm5); /* BGRABGRA */
+            xmm1 = _mm_unpackhi_epi16(xmm3, xmm5); /* BGRABGRA */
+            xmm2 = _mm_unpacklo_epi16(xmm4, xmm6); /* BGRABGRA */
+            xmm3 = _mm_unpackhi_epi16(xmm4, xmm6); /* BGRABGRA */
+
+            if (out32)
+            {
+                _mm_stream_si128(dst128++, xmm0);
+                _mm_stream_si128(dst128++, xmm1);
+                _mm_stream_si128(dst128++, xmm2);
+                _mm_stream_si128(dst128++, xmm3);
+            }
+            else
+            {
+                _mm_store_si128((__m128i *)rgb32buffer + 0, xmm0);
+                _mm_store_si128((__m128i *)rgb32buffer + 1, xmm1);
+                _mm_store_si128((__m128i *)rgb32buffer + 2, xmm2);
+                _mm_store_si128((__m128i *)rgb32buffer + 3, xmm3);
+
+                // Pack 4 BGRA pixels into 3 BGR words at a time
+                const uint32_t *src32 = rgb32buffer;
+                for (int p = 0; p < 16; p += 4)
+                {
+                    *dst24++ = (src32[0] & 0xffffff) | (src32[1] << 24);
+                    *dst24++ = ((src32[1] >> 8) & 0xffff) | (src32[2] << 16);
+                    *dst24++ = ((src32[2] >> 16) & 0xff) | (src32[3] << 8);
+                    src32 += 4;
+                }
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+template HRESULT CLAVPixFmtConverter::convert_gbrp_rgb<0, 0> CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_gbrp_rgb<0, 1> CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_gbrp_rgb<1, 0> CONV_FUNC_PARAMS;
+template HRESULT CLAVPixFmtConverter::convert_gbrp_rgb<1, 1> CONV_FUNC_PARAMS;
+
+// Planar RGB (GBR plane order, 9-16 bit) to packed RGB48
+DECLARE_CONV_FUNC_IMPL(convert_gbrp_rgb48)
+{
+    const ptrdiff_t outStride = dstStride[0];
+    ptrdiff_t line, i;
+
+    __m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5;
+    const __m128i zero = _mm_setzero_si128();
+
+    for (line = 0; line < height; line++)
+    {
+        const uint16_t *g = (const uint16_t *)(src[0] + line * srcStride[0]);
+        const uint16_t *b = (const uint16_t *)(src[1] + line * srcStride[1]);
+        const uint16_t *r = (const uint16_t *)(src[2] + line * srcStride[2]);
+
+        uint8_t *out = dst[0] + line * outStride;
+
+        for (i = 0; i < width; i += 8)
+        {
+            PIXCONV_LOAD_PIXEL16(xmm0, (r + i), bpp); /* RRRRRRRR */
+            PIXCONV_LOAD_PIXEL16(xmm1, (g + i), bpp); /* GGGGGGGG */
+            PIXCONV_LOAD_PIXEL16(xmm2, (b + i), bpp); /* BBBBBBBB */
+
+            xmm3 = _mm_unpacklo_epi16(xmm0, xmm1); /* RGRGRGRG */
+            xmm0 = _mm_unpackhi_epi16(xmm0, xmm1); /* RGRGRGRG */
+            xmm4 = _mm_unpacklo_epi16(xmm2, zero); /* B0B0B0B0 */
+            xmm2 = _mm_unpackhi_epi16(xmm2, zero); /* B0B0B0B0 */
+
+            xmm5 = _mm_unpacklo_epi32(xmm3, xmm4); /* RGB0RGB0 */
+            xmm3 = _mm_unpackhi_epi32(xmm3, xmm4); /* RGB0RGB0 */
+            xmm4 = _mm_unpacklo_epi32(xmm0, xmm2); /* RGB0RGB0 */
+            xmm0 = _mm_unpackhi_epi32(xmm0, xmm2); /* RGB0RGB0 */
+
+            // Write the 6-byte pixels with overlapping 8-byte stores, the last one of the block can't overlap
+            _mm_storel_epi64((__m128i *)(out + 0), xmm5);
+            _mm_storel_epi64((__m128i *)(out + 6), _mm_srli_si128(xmm5, 8));
+            _mm_storel_epi64((__m128i *)(out + 12), xmm3);
+            _mm_storel_epi64((__m128i *)(out + 18), _mm_srli_si128(xmm3, 8));
+            _mm_storel_epi64((__m128i *)(out + 24), xmm4);
+            _mm_storel_epi64((__m128i *)(out + 30), _mm_srli_si128(xmm4, 8));
+            _mm_storel_epi64((__m128i *)(out + 36), xmm0);
+
+            xmm0 = _mm_srli_si128(xmm0, 8);
+            *(uint32_t *)(out + 42) = _mm_cvtsi128_si32(xmm0);
+            *(uint16_t *)(out + 46) = (uint16_t)_mm_extract_epi16(xmm0, 2);
+
+            out += 48;
+        }
+    }
+
+    return S_OK;
+}
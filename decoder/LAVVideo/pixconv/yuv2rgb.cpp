@@ -59,7 +59,7 @@ __forceinline static int yuv2rgb_convert_pixels(const uint8_t *&srcY, const uint
         xmm0 = _mm_unpacklo_epi16(xmm1, xmm0); /* 0V0U0V0U */
         xmm2 = _mm_unpacklo_epi16(xmm3, xmm2); /* 0V0U0V0U */
     }
-    else if (inputFormat == LAVPixFmt_NV12)
+    else if (inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21)
     {
         // Load 4 16-bit macro pixels, which contain 4 UV samples
         PIXCONV_LOAD_4PIXEL16(xmm0, srcU);
@@ -68,6 +68,13 @@ __forceinline static int yuv2rgb_convert_pixels(const uint8_t *&srcY, const uint
         // Expand to 16-bit
         xmm0 = _mm_unpacklo_epi8(xmm0, xmm7); /* 0V0U0V0U */
         xmm2 = _mm_unpacklo_epi8(xmm2, xmm7); /* 0V0U0V0U */
+
+        // NV21 stores V first, swap every pair of samples
+        if (inputFormat == LAVPixFmt_NV21)
+        {
+            xmm0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(xmm0, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            xmm2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(xmm2, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        }
     }
     else
     {
@@ -89,15 +96,15 @@ __forceinline static int yuv2rgb_convert_pixels(const uint8_t *&srcY, const uint
     // bitdepth
 
     // Chroma upsampling required
-    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_YUV422 ||
-        inputFormat == LAVPixFmt_P016)
+    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+        inputFormat == LAVPixFmt_YUV422 || inputFormat == LAVPixFmt_P016)
     {
         if (inputFormat == LAVPixFmt_P016)
         {
             srcU += 8;
             srcV += 8;
         }
-        else if (shift > 0 || inputFormat == LAVPixFmt_NV12)
+        else if (shift > 0 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21)
         {
             srcU += 4;
             srcV += 4;
@@ -129,7 +136,8 @@ __forceinline static int yuv2rgb_convert_pixels(const uint8_t *&srcY, const uint
         }
 
         // 4:2:0 - upsample to 4:2:2 using 75:25
-        if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_P016)
+        if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+            inputFormat == LAVPixFmt_P016)
         {
             // Too high bitdepth, shift down to 14-bit
             if (shift >= 7)
@@ -230,7 +238,8 @@ __forceinline static int yuv2rgb_convert_pixels(const uint8_t *&srcY, const uint
                 xmm3 = _mm_slli_epi16(xmm3, 3 - shift);
             }
         }
-        else if ((inputFormat == LAVPixFmt_YUV420 && shift == 0) || inputFormat == LAVPixFmt_NV12)
+        else if ((inputFormat == LAVPixFmt_YUV420 && shift == 0) || inputFormat == LAVPixFmt_NV12 ||
+                 inputFormat == LAVPixFmt_NV21)
         {
             xmm1 = _mm_slli_epi16(xmm1, 1);
             xmm3 = _mm_slli_epi16(xmm3, 1);
@@ -492,7 +501,8 @@ static int __stdcall yuv2rgb_convert(const uint8_t *srcY, const uint8_t *srcU, c
     _mm_sfence();
 
     // 4:2:0 needs special handling for the first and the last line
-    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_P016)
+    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+        inputFormat == LAVPixFmt_P016)
     {
         if (line == 0)
         {
@@ -521,7 +531,8 @@ static int __stdcall yuv2rgb_convert(const uint8_t *srcY, const uint8_t *srcU, c
             lineDither = dithers + (line * 24 * DITHER_STEPS);
         y = srcY + line * srcStrideY;
 
-        if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_P016)
+        if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+            inputFormat == LAVPixFmt_P016)
         {
             u = srcU + (line >> 1) * srcStrideUV;
             v = srcV + (line >> 1) * srcStrideUV;
@@ -543,15 +554,16 @@ static int __stdcall yuv2rgb_convert(const uint8_t *srcY, const uint8_t *srcU, c
             y, u, v, rgb, srcStrideY, srcStrideUV, dstStride, line, coeffs, lineDither, 0);
     }
 
-    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_P016 ||
-        lastLineInOddHeight)
+    if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+        inputFormat == LAVPixFmt_P016 || lastLineInOddHeight)
     {
         if (sliceYEnd == height)
         {
             if (dithertype == LAVDither_Random)
                 lineDither = dithers + ((height - 2) * 24 * DITHER_STEPS);
             y = srcY + (height - 1) * srcStrideY;
-            if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_P016)
+            if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+                inputFormat == LAVPixFmt_P016)
             {
                 u = srcU + ((height >> 1) - 1) * srcStrideUV;
                 v = srcV + ((height >> 1) - 1) * srcStrideUV;
@@ -631,7 +643,8 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_rgb)
     else
     {
         const int is_odd =
-            (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_P016);
+            (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21 ||
+             inputFormat == LAVPixFmt_P016);
         const ptrdiff_t lines_per_thread = (height / m_NumThreads) & ~1;
 
         Concurrency::parallel_for(0, m_NumThreads, [&](int i) {
@@ -674,6 +687,7 @@ void CLAVPixFmtConverter::InitRGBConvDispatcher()
     ZeroMemory(&m_RGBConvFuncs, sizeof(m_RGBConvFuncs));
 
     CONV_FUNC(LAVPixFmt_NV12, 0);
+    CONV_FUNC(LAVPixFmt_NV21, 0);
     CONV_FUNC(LAVPixFmt_P016, 8);
 
     CONV_FUNCX(LAVPixFmt_YUV420);
@@ -484,11 +484,15 @@ DECLARE_CONV_FUNC_IMPL(convert_nv12_yv12)
         PIXCONV_MEMCPY_ALIGNED(dst[0] + outLumaStride * line, src[0] + inLumaStride * line, width);
     }
 
+    // NV21 has V in the low bytes, so its chroma goes into the planes the other way around
+    const int planeU = (inputFormat == LAVPixFmt_NV21) ? 1 : 2;
+    const int planeV = (inputFormat == LAVPixFmt_NV21) ? 2 : 1;
+
     for (line = 0; line < chromaHeight; line++)
     {
         const uint8_t *const uv = src[1] + line * inChromaStride;
-        uint8_t *const dv = dst[1] + outChromaStride * line;
-        uint8_t *const du = dst[2] + outChromaStride * line;
+        uint8_t *const dv = dst[planeV] + outChromaStride * line;
+        uint8_t *const du = dst[planeU] + outChromaStride * line;
 
         for (i = 0; i < width; i += 32)
         {
@@ -515,6 +519,48 @@ DECLARE_CONV_FUNC_IMPL(convert_nv12_yv12)
     return S_OK;
 }
 
+// Swap the bytes of every 16-bit word, which turns NV21 chroma into NV12 chroma, and YUY2 into UYVY and back
+DECLARE_CONV_FUNC_IMPL(convert_swap_uv)
+{
+    const BOOL bSemiPlanar = (inputFormat == LAVPixFmt_NV21);
+    const int plane = bSemiPlanar ? 1 : 0;
+    const ptrdiff_t inStride = srcStride[plane];
+    const ptrdiff_t outStride = dstStride[plane];
+    const ptrdiff_t byteWidth = bSemiPlanar ? width : width << 1;
+    const ptrdiff_t planeHeight = bSemiPlanar ? height >> 1 : height;
+
+    ptrdiff_t line, i;
+    __m128i xmm0, xmm1;
+
+    _mm_sfence();
+
+    // Copy the y of NV21
+    if (bSemiPlanar)
+    {
+        for (line = 0; line < height; line++)
+        {
+            PIXCONV_MEMCPY_ALIGNED(dst[0] + dstStride[0] * line, src[0] + srcStride[0] * line, width);
+        }
+    }
+
+    for (line = 0; line < planeHeight; line++)
+    {
+        const uint8_t *const in = src[plane] + line * inStride;
+        uint8_t *const out = dst[plane] + line * outStride;
+
+        for (i = 0; i < byteWidth; i += 16)
+        {
+            PIXCONV_LOAD_PIXEL8_ALIGNED(xmm0, in + i);
+            xmm1 = _mm_slli_epi16(xmm0, 8);
+            xmm0 = _mm_srli_epi16(xmm0, 8);
+            xmm0 = _mm_or_si128(xmm0, xmm1);
+            PIXCONV_PUT_STREAM(out + i, xmm0);
+        }
+    }
+
+    return S_OK;
+}
+
 DECLARE_CONV_FUNC_IMPL(convert_p010_nv12_sse2)
 {
     const ptrdiff_t inStride = srcStride[0];
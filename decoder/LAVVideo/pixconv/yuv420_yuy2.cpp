@@ -50,7 +50,7 @@ __forceinline static int yuv420yuy2_convert_pixels(const uint8_t *&srcY, const u
         xmm0 = _mm_unpacklo_epi16(xmm1, xmm0); /* 0V0U0V0U */
         xmm2 = _mm_unpacklo_epi16(xmm3, xmm2); /* 0V0U0V0U */
     }
-    else if (inputFormat == LAVPixFmt_NV12)
+    else if (inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21)
     {
         // Load 4 16-bit macro pixels, which contain 4 UV samples
         PIXCONV_LOAD_4PIXEL16(xmm0, srcU);
@@ -59,6 +59,13 @@ __forceinline static int yuv420yuy2_convert_pixels(const uint8_t *&srcY, const u
         // Expand to 16-bit
         xmm0 = _mm_unpacklo_epi8(xmm0, xmm7); /* 0V0U0V0U */
         xmm2 = _mm_unpacklo_epi8(xmm2, xmm7); /* 0V0U0V0U */
+
+        // NV21 stores V first, swap every pair of samples
+        if (inputFormat == LAVPixFmt_NV21)
+        {
+            xmm0 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(xmm0, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            xmm2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(xmm2, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        }
     }
     else
     {
@@ -80,7 +87,7 @@ __forceinline static int yuv420yuy2_convert_pixels(const uint8_t *&srcY, const u
     // bitdepth
 
     // Chroma upsampling
-    if (shift > 0 || inputFormat == LAVPixFmt_NV12)
+    if (shift > 0 || inputFormat == LAVPixFmt_NV12 || inputFormat == LAVPixFmt_NV21)
     {
         srcU += 8;
         srcV += 8;
@@ -257,6 +264,9 @@ static int __stdcall yuv420yuy2_dispatch(LAVPixelFormat inputFormat, int bpp, co
     case LAVPixFmt_NV12:
         return yuv420yuy2_process_lines<LAVPixFmt_NV12, 0, uyvy, dithertype>(
             srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, dithers);
+    case LAVPixFmt_NV21:
+        return yuv420yuy2_process_lines<LAVPixFmt_NV21, 0, uyvy, dithertype>(
+            srcY, srcU, srcV, dst, width, height, srcStrideY, srcStrideUV, dstStride, dithers);
     case LAVPixFmt_YUV420bX:
         if (bpp == 9)
             return yuv420yuy2_process_lines<LAVPixFmt_YUV420, 1, uyvy, dithertype>(
@@ -44,6 +44,26 @@ CLAVSubtitleConsumer::CLAVSubtitleConsumer(CLAVVideo *pLAVVideo)
     context.name = TEXT(LAV_VIDEO);
     context.version = TEXT(LAV_VERSION_STR);
     m_evFrame.Reset();
+
+    const int cpuFlags = av_get_cpu_flags();
+    if (cpuFlags & AV_CPU_FLAG_AVX2)
+    {
+        unpremultiply = unpremultiply_bgra_avx2;
+        bgra_to_yuva = bgra_to_yuva_line_avx2;
+        downsample_chroma = downsample_chroma_avx2;
+    }
+    else if (cpuFlags & AV_CPU_FLAG_SSE2)
+    {
+        unpremultiply = unpremultiply_bgra_sse2;
+        bgra_to_yuva = bgra_to_yuva_line_sse2;
+        downsample_chroma = downsample_chroma_sse2;
+    }
+    else
+    {
+        unpremultiply = unpremultiply_bgra_c;
+        bgra_to_yuva = bgra_to_yuva_line_c;
+        downsample_chroma = downsample_chroma_c;
+    }
 }
 
 CLAVSubtitleConsumer::~CLAVSubtitleConsumer(void)
@@ -74,6 +94,7 @@ STDMETHODIMP CLAVSubtitleConsumer::Connect(ISubRenderProvider *subtitleRenderer)
 STDMETHODIMP CLAVSubtitleConsumer::Disconnect(void)
 {
     SafeRelease(&m_pProvider);
+    PurgeBitmapCache(TRUE);
     if (m_pSwsContext)
     {
         sws_freeContext(m_pSwsContext);
@@ -125,6 +146,7 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessFrame(LAVFrame *pFrame)
 
         if (count == 0)
         {
+            PurgeBitmapCache(TRUE);
             SafeRelease(&m_SubtitleFrame);
             return S_FALSE;
         }
@@ -233,9 +255,13 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessFrame(LAVFrame *pFrame)
                 DbgLog((LOG_TRACE, 10, L"GetBitmap() failed on index %d", i));
                 break;
             }
-            ProcessSubtitleBitmap(format, bpp, videoRect, data, stride, subRect, position, size, rgbData, pitch);
+            ProcessSubtitleBitmap(format, bpp, videoRect, data, stride, subRect, id, position, size, rgbData,
+                                  pitch);
         }
 
+        // Drop all converted bitmaps that are no longer on screen
+        PurgeBitmapCache(FALSE);
+
         if (pSurface)
             pSurface->UnlockRect();
 
@@ -257,6 +283,8 @@ static struct
     {LAVPixFmt_NV12, AV_PIX_FMT_YUVA420P},   {LAVPixFmt_P016, AV_PIX_FMT_YUVA420P},
     {LAVPixFmt_YUY2, AV_PIX_FMT_YUVA422P},   {LAVPixFmt_RGB24, AV_PIX_FMT_BGRA},
     {LAVPixFmt_RGB32, AV_PIX_FMT_BGRA},      {LAVPixFmt_ARGB32, AV_PIX_FMT_BGRA},
+    {LAVPixFmt_GBRP, AV_PIX_FMT_GBRAP},      {LAVPixFmt_GBRPbX, AV_PIX_FMT_GBRAP},
+    {LAVPixFmt_NV21, AV_PIX_FMT_YUVA420P},   {LAVPixFmt_UYVY, AV_PIX_FMT_YUVA422P},
 };
 
 static LAVPixFmtDesc ff_sub_pixfmt_desc[] = {
@@ -264,6 +292,7 @@ static LAVPixFmtDesc ff_sub_pixfmt_desc[] = {
     {1, 4, {1, 2, 2, 1}, {1, 1, 1, 1}}, ///< PIX_FMT_YUVA422P
     {1, 4, {1, 1, 1, 1}, {1, 1, 1, 1}}, ///< PIX_FMT_YUVA444P
     {4, 1, {1}, {1}},                   ///< PIX_FMT_BGRA
+    {1, 4, {1, 1, 1, 1}, {1, 1, 1, 1}}, ///< PIX_FMT_GBRAP
 };
 
 static LAVPixFmtDesc getFFSubPixelFormatDesc(AVPixelFormat pixFmt)
@@ -275,6 +304,7 @@ static LAVPixFmtDesc getFFSubPixelFormatDesc(AVPixelFormat pixFmt)
     case AV_PIX_FMT_YUVA422P: index = 1; break;
     case AV_PIX_FMT_YUVA444P: index = 2; break;
     case AV_PIX_FMT_BGRA: index = 3; break;
+    case AV_PIX_FMT_GBRAP: index = 4; break;
     default: ASSERT(0);
     }
     return ff_sub_pixfmt_desc[index];
@@ -300,24 +330,220 @@ STDMETHODIMP CLAVSubtitleConsumer::SelectBlendFunction()
     {
     case LAVPixFmt_RGB32:
     case LAVPixFmt_RGB24: blend = &CLAVSubtitleConsumer::blend_rgb_c; break;
-    case LAVPixFmt_NV12: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint8_t, 1>; break;
+    case LAVPixFmt_NV12:
+    case LAVPixFmt_NV21: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint8_t, 1>; break;
     case LAVPixFmt_P016: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint16_t, 1>; break;
     case LAVPixFmt_YUV420:
     case LAVPixFmt_YUV422:
-    case LAVPixFmt_YUV444: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint8_t, 0>; break;
+    case LAVPixFmt_YUV444:
+    case LAVPixFmt_GBRP: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint8_t, 0>; break;
     case LAVPixFmt_YUV420bX:
     case LAVPixFmt_YUV422bX:
-    case LAVPixFmt_YUV444bX: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint16_t, 0>; break;
+    case LAVPixFmt_YUV444bX:
+    case LAVPixFmt_GBRPbX: blend = &CLAVSubtitleConsumer::blend_yuv_c<uint16_t, 0>; break;
     default: DbgLog((LOG_ERROR, 10, L"ProcessSubtitleBitmap(): No Blend function available")); blend = nullptr;
     }
 
     return S_OK;
 }
 
+CLAVSubtitleConsumer::CachedBitmap *CLAVSubtitleConsumer::FindCachedBitmap(ULONGLONG id, LAVPixelFormat pixFmt,
+                                                                           RECT videoRect, RECT subRect,
+                                                                           POINT subPosition, SIZE subSize)
+{
+    for (CachedBitmap *pBitmap : m_BitmapCache)
+    {
+        if (pBitmap->id == id && pBitmap->pixFmt == pixFmt && EqualRect(&pBitmap->videoRect, &videoRect) &&
+            EqualRect(&pBitmap->subRect, &subRect) && pBitmap->srcPosition.x == subPosition.x &&
+            pBitmap->srcPosition.y == subPosition.y && pBitmap->srcSize.cx == subSize.cx &&
+            pBitmap->srcSize.cy == subSize.cy)
+            return pBitmap;
+    }
+    return nullptr;
+}
+
+void CLAVSubtitleConsumer::FreeCachedBitmap(CachedBitmap *pBitmap)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        av_freep(&pBitmap->data[i]);
+    }
+    delete pBitmap;
+}
+
+void CLAVSubtitleConsumer::PurgeBitmapCache(BOOL bAll)
+{
+    auto it = m_BitmapCache.begin();
+    while (it != m_BitmapCache.end())
+    {
+        if (bAll || !(*it)->bUsed)
+        {
+            FreeCachedBitmap(*it);
+            it = m_BitmapCache.erase(it);
+        }
+        else
+        {
+            (*it)->bUsed = FALSE;
+            it++;
+        }
+    }
+}
+
+CLAVSubtitleConsumer::CachedBitmap *CLAVSubtitleConsumer::ConvertSubtitleBitmap(ULONGLONG id, LAVPixelFormat pixFmt,
+                                                                                RECT videoRect, RECT subRect,
+                                                                                POINT subPosition, SIZE subSize,
+                                                                                const uint8_t *rgbData,
+                                                                                ptrdiff_t pitch)
+{
+    uint8_t *tmpBuf = nullptr;
+    const AVPixelFormat avPixFmt = getFFPixFmtForSubtitle(pixFmt);
+
+    CachedBitmap *pBitmap = new CachedBitmap();
+    pBitmap->id = id;
+    pBitmap->pixFmt = pixFmt;
+    pBitmap->videoRect = videoRect;
+    pBitmap->subRect = subRect;
+    pBitmap->srcPosition = subPosition;
+    pBitmap->srcSize = subSize;
+
+    // Calculate scaled size
+    // We must ensure that the scaled subs still fit into the video
+
+    // HACK: Scale to video size. In the future, we should take AR and the likes into account
+    RECT newRect = videoRect;
+    /*
+    float subAR = (float)subRect.right / (float)subRect.bottom;
+    if (newRect.right != videoRect.right) {
+      newRect.right = videoRect.right;
+      newRect.bottom = (LONG)(newRect.right / subAR);
+    }
+    if (newRect.bottom > videoRect.bottom) {
+      newRect.bottom = videoRect.bottom;
+      newRect.right = (LONG)(newRect.bottom * subAR);
+    }*/
+
+    SIZE newSize;
+    newSize.cx = (LONG)av_rescale(subSize.cx, newRect.right, subRect.right);
+    newSize.cy = (LONG)av_rescale(subSize.cy, newRect.bottom, subRect.bottom);
+
+    // And scaled position
+    pBitmap->position.x = (LONG)av_rescale(subPosition.x, newSize.cx, subSize.cx);
+    pBitmap->position.y = (LONG)av_rescale(subPosition.y, newSize.cy, subSize.cy);
+    pBitmap->size = newSize;
+
+    const uint8_t *src[4] = {(const uint8_t *)rgbData, nullptr, nullptr, nullptr};
+    const ptrdiff_t srcStride[4] = {pitch, 0, 0, 0};
+
+    const LAVPixFmtDesc desc = getFFSubPixelFormatDesc(avPixFmt);
+    const ptrdiff_t stride = FFALIGN(newSize.cx, 64) * desc.codedbytes;
+
+    for (int plane = 0; plane < desc.planes; plane++)
+    {
+        pBitmap->stride[plane] = stride / desc.planeWidth[plane];
+        const size_t size = pBitmap->stride[plane] * FFALIGN(newSize.cy, 2) / desc.planeHeight[plane];
+        pBitmap->data[plane] = (BYTE *)av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (pBitmap->data[plane] == nullptr)
+            goto fail;
+    }
+
+    // Without scaling, YUV is converted in a single pass
+    if (newSize.cx == subSize.cx && newSize.cy == subSize.cy &&
+        (avPixFmt == AV_PIX_FMT_YUVA420P || avPixFmt == AV_PIX_FMT_YUVA422P || avPixFmt == AV_PIX_FMT_YUVA444P))
+    {
+        if (FAILED(ConvertBGRAToYUVA(pBitmap, avPixFmt, rgbData, pitch)))
+            goto fail;
+
+        m_BitmapCache.push_back(pBitmap);
+        return pBitmap;
+    }
+
+    m_pSwsContext = sws_getCachedContext(m_pSwsContext, subSize.cx, subSize.cy, AV_PIX_FMT_BGRA, newSize.cx, newSize.cy,
+                                         avPixFmt, SWS_BILINEAR | SWS_FULL_CHR_H_INP, nullptr, nullptr, nullptr);
+
+    // Un-pre-multiply alpha for YUV formats
+    if (avPixFmt != AV_PIX_FMT_BGRA)
+    {
+        tmpBuf = (uint8_t *)av_malloc(pitch * subSize.cy);
+        if (tmpBuf == nullptr)
+            goto fail;
+
+        unpremultiply(tmpBuf, pitch, rgbData, pitch, subSize.cx, subSize.cy);
+        src[0] = tmpBuf;
+    }
+
+    sws_scale2(m_pSwsContext, src, srcStride, 0, subSize.cy, pBitmap->data, pBitmap->stride);
+
+    if (tmpBuf)
+        av_free(tmpBuf);
+
+    m_BitmapCache.push_back(pBitmap);
+    return pBitmap;
+
+fail:
+    FreeCachedBitmap(pBitmap);
+    return nullptr;
+}
+
+HRESULT CLAVSubtitleConsumer::ConvertBGRAToYUVA(CachedBitmap *pBitmap, AVPixelFormat avPixFmt, const uint8_t *rgbData,
+                                                ptrdiff_t pitch)
+{
+    const int width = pBitmap->size.cx, height = pBitmap->size.cy;
+    const int hsub = (avPixFmt != AV_PIX_FMT_YUVA444P);
+    const int vsub = (avPixFmt == AV_PIX_FMT_YUVA420P);
+
+    // One line of un-pre-multiplied pixels, and two lines of chroma at full resolution to be subsampled
+    const ptrdiff_t chromaStride = FFALIGN(width + 1, 64);
+    uint8_t *buffer = (uint8_t *)av_malloc(width * 4 + chromaStride * 4 + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (buffer == nullptr)
+        return E_OUTOFMEMORY;
+
+    uint8_t *bgra = buffer + chromaStride * 4;
+    uint8_t *chromaU[2] = {buffer, buffer + chromaStride};
+    uint8_t *chromaV[2] = {buffer + chromaStride * 2, buffer + chromaStride * 3};
+
+    for (int line = 0; line < height; line += 1 << vsub)
+    {
+        const int lines = (vsub && line + 1 < height) ? 2 : 1;
+        for (int i = 0; i < lines; i++)
+        {
+            uint8_t *u = chromaU[i], *v = chromaV[i];
+            if (!hsub)
+            {
+                u = pBitmap->data[1] + (line + i) * pBitmap->stride[1];
+                v = pBitmap->data[2] + (line + i) * pBitmap->stride[2];
+            }
+
+            unpremultiply(bgra, 0, rgbData + (line + i) * pitch, 0, width, 1);
+            bgra_to_yuva(pBitmap->data[0] + (line + i) * pBitmap->stride[0], u, v,
+                         pBitmap->data[3] + (line + i) * pBitmap->stride[3], bgra, width);
+
+            // repeat the last chroma sample of odd widths for the subsampling
+            if (hsub && (width & 1))
+            {
+                u[width] = u[width - 1];
+                v[width] = v[width - 1];
+            }
+        }
+
+        // the last line of odd heights is only subsampled horizontally
+        if (hsub)
+        {
+            const int chromaLine = line >> vsub;
+            downsample_chroma(pBitmap->data[1] + chromaLine * pBitmap->stride[1], chromaU[0], chromaU[lines - 1],
+                              (width + 1) >> 1);
+            downsample_chroma(pBitmap->data[2] + chromaLine * pBitmap->stride[2], chromaV[0], chromaV[lines - 1],
+                              (width + 1) >> 1);
+        }
+    }
+
+    av_free(buffer);
+    return S_OK;
+}
+
 STDMETHODIMP CLAVSubtitleConsumer::ProcessSubtitleBitmap(LAVPixelFormat pixFmt, int bpp, RECT videoRect,
                                                          BYTE *videoData[4], ptrdiff_t videoStride[4], RECT subRect,
-                                                         POINT subPosition, SIZE subSize, const uint8_t *rgbData,
-                                                         ptrdiff_t pitch)
+                                                         ULONGLONG id, POINT subPosition, SIZE subSize,
+                                                         const uint8_t *rgbData, ptrdiff_t pitch)
 {
     if (subRect.left != 0 || subRect.top != 0)
     {
@@ -351,85 +577,22 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessSubtitleBitmap(LAVPixelFormat pixFmt,
     ptrdiff_t subStride[4] = {0, 0, 0, 0};
 
     // If we need scaling (either scaling or pixel conversion), do it here before starting the blend process
+    // The result is cached, and re-used as long as the subtitle renderer keeps delivering the same bitmap
     if (bNeedScaling)
     {
-        uint8_t *tmpBuf = nullptr;
-        const AVPixelFormat avPixFmt = getFFPixFmtForSubtitle(pixFmt);
-
-        // Calculate scaled size
-        // We must ensure that the scaled subs still fit into the video
-
-        // HACK: Scale to video size. In the future, we should take AR and the likes into account
-        RECT newRect = videoRect;
-        /*
-        float subAR = (float)subRect.right / (float)subRect.bottom;
-        if (newRect.right != videoRect.right) {
-          newRect.right = videoRect.right;
-          newRect.bottom = (LONG)(newRect.right / subAR);
-        }
-        if (newRect.bottom > videoRect.bottom) {
-          newRect.bottom = videoRect.bottom;
-          newRect.right = (LONG)(newRect.bottom * subAR);
-        }*/
-
-        SIZE newSize;
-        newSize.cx = (LONG)av_rescale(subSize.cx, newRect.right, subRect.right);
-        newSize.cy = (LONG)av_rescale(subSize.cy, newRect.bottom, subRect.bottom);
-
-        // And scaled position
-        subPosition.x = (LONG)av_rescale(subPosition.x, newSize.cx, subSize.cx);
-        subPosition.y = (LONG)av_rescale(subPosition.y, newSize.cy, subSize.cy);
-
-        m_pSwsContext =
-            sws_getCachedContext(m_pSwsContext, subSize.cx, subSize.cy, AV_PIX_FMT_BGRA, newSize.cx, newSize.cy,
-                                 avPixFmt, SWS_BILINEAR | SWS_FULL_CHR_H_INP, nullptr, nullptr, nullptr);
-
-        const uint8_t *src[4] = {(const uint8_t *)rgbData, nullptr, nullptr, nullptr};
-        const ptrdiff_t srcStride[4] = {pitch, 0, 0, 0};
-
-        const LAVPixFmtDesc desc = getFFSubPixelFormatDesc(avPixFmt);
-        const ptrdiff_t stride = FFALIGN(newSize.cx, 64) * desc.codedbytes;
-
-        for (int plane = 0; plane < desc.planes; plane++)
+        CachedBitmap *pBitmap = FindCachedBitmap(id, pixFmt, videoRect, subRect, subPosition, subSize);
+        if (pBitmap == nullptr)
         {
-            subStride[plane] = stride / desc.planeWidth[plane];
-            const size_t size = subStride[plane] * FFALIGN(newSize.cy, 2) / desc.planeHeight[plane];
-            subData[plane] = (BYTE *)av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
-            if (subData[plane] == nullptr)
-                goto fail;
-        }
-
-        // Un-pre-multiply alpha for YUV formats
-        // TODO: Can we SIMD this? See ARGBUnattenuateRow_C/SSE2 in libyuv
-        if (avPixFmt != AV_PIX_FMT_BGRA)
-        {
-            tmpBuf = (uint8_t *)av_malloc(pitch * subSize.cy);
-            if (tmpBuf == nullptr)
-                goto fail;
-
-            memcpy(tmpBuf, rgbData, pitch * subSize.cy);
-            for (int line = 0; line < subSize.cy; line++)
-            {
-                uint8_t *p = tmpBuf + line * pitch;
-                for (int col = 0; col < subSize.cx; col++)
-                {
-                    if (p[3] != 0 && p[3] != 255)
-                    {
-                        p[0] = av_clip_uint8(p[0] * 255 / p[3]);
-                        p[1] = av_clip_uint8(p[1] * 255 / p[3]);
-                        p[2] = av_clip_uint8(p[2] * 255 / p[3]);
-                    }
-                    p += 4;
-                }
-            }
-            src[0] = tmpBuf;
+            pBitmap = ConvertSubtitleBitmap(id, pixFmt, videoRect, subRect, subPosition, subSize, rgbData, pitch);
+            if (pBitmap == nullptr)
+                return E_OUTOFMEMORY;
         }
+        pBitmap->bUsed = TRUE;
 
-        int ret = sws_scale2(m_pSwsContext, src, srcStride, 0, subSize.cy, subData, subStride);
-        subSize = newSize;
-
-        if (tmpBuf)
-            av_free(tmpBuf);
+        memcpy(subData, pBitmap->data, sizeof(subData));
+        memcpy(subStride, pBitmap->stride, sizeof(subStride));
+        subPosition = pBitmap->position;
+        subSize = pBitmap->size;
     }
     else
     {
@@ -437,26 +600,19 @@ STDMETHODIMP CLAVSubtitleConsumer::ProcessSubtitleBitmap(LAVPixelFormat pixFmt,
         subStride[0] = pitch;
     }
 
+    // NV21 is blended like NV12, with the chroma of the subtitle in the opposite order
+    if (pixFmt == LAVPixFmt_NV21)
+    {
+        BYTE *subU = subData[1];
+        subData[1] = subData[2];
+        subData[2] = subU;
+    }
+
     ASSERT((subPosition.x + subSize.cx) <= videoRect.right);
     ASSERT((subPosition.y + subSize.cy) <= videoRect.bottom);
 
     if (blend)
         (this->*blend)(videoData, videoStride, videoRect, subData, subStride, subPosition, subSize, pixFmt, bpp);
 
-    if (bNeedScaling)
-    {
-        for (int i = 0; i < 4; i++)
-        {
-            av_freep(&subData[i]);
-        }
-    }
-
     return S_OK;
-
-fail:
-    for (int i = 0; i < 4; i++)
-    {
-        av_freep(&subData[i]);
-    }
-    return E_OUTOFMEMORY;
 }
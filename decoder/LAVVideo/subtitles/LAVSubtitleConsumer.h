@@ -23,6 +23,9 @@
 #include "LAVSubtitleFrame.h"
 
 #include "../decoders/ILAVDecoder.h"
+#include "blend/blend_dsp.h"
+
+#include <list>
 
 #define BLEND_FUNC_PARAMS                                                                                \
     (BYTE * video[4], ptrdiff_t videoStride[4], RECT vidRect, BYTE * subData[4], ptrdiff_t subStride[4], \
@@ -88,9 +91,37 @@ class CLAVSubtitleConsumer
     }
 
   private:
+    // Subtitle bitmap, converted to the video format and scaled to the video size
+    struct CachedBitmap
+    {
+        // identity of the source bitmap
+        ULONGLONG id = 0;
+        LAVPixelFormat pixFmt = LAVPixFmt_None;
+        RECT videoRect = {0};
+        RECT subRect = {0};
+        POINT srcPosition = {0};
+        SIZE srcSize = {0};
+
+        // converted bitmap
+        POINT position = {0};
+        SIZE size = {0};
+        BYTE *data[4] = {nullptr};
+        ptrdiff_t stride[4] = {0};
+
+        BOOL bUsed = FALSE; ///< bitmap was used in the current frame
+    };
+
     STDMETHODIMP ProcessSubtitleBitmap(LAVPixelFormat pixFmt, int bpp, RECT videoRect, BYTE *videoData[4],
-                                       ptrdiff_t videoStride[4], RECT subRect, POINT subPosition, SIZE subSize,
-                                       const uint8_t *rgbData, ptrdiff_t pitch);
+                                       ptrdiff_t videoStride[4], RECT subRect, ULONGLONG id, POINT subPosition,
+                                       SIZE subSize, const uint8_t *rgbData, ptrdiff_t pitch);
+
+    CachedBitmap *ConvertSubtitleBitmap(ULONGLONG id, LAVPixelFormat pixFmt, RECT videoRect, RECT subRect,
+                                        POINT subPosition, SIZE subSize, const uint8_t *rgbData, ptrdiff_t pitch);
+    CachedBitmap *FindCachedBitmap(ULONGLONG id, LAVPixelFormat pixFmt, RECT videoRect, RECT subRect,
+                                   POINT subPosition, SIZE subSize);
+    void FreeCachedBitmap(CachedBitmap *pBitmap);
+    // Free all bitmaps not used since the last purge, or all of them
+    void PurgeBitmapCache(BOOL bAll);
 
     STDMETHODIMP SelectBlendFunction();
     typedef HRESULT(CLAVSubtitleConsumer::*BlendFn) BLEND_FUNC_PARAMS;
@@ -99,6 +130,14 @@ class CLAVSubtitleConsumer
     DECLARE_BLEND_FUNC(blend_rgb_c);
     template <class pixT, int nv12> DECLARE_BLEND_FUNC(blend_yuv_c);
 
+    // Convert an unscaled bitmap to planar YUVA in one pass, without swscale
+    HRESULT ConvertBGRAToYUVA(CachedBitmap *pBitmap, AVPixelFormat avPixFmt, const uint8_t *rgbData, ptrdiff_t pitch);
+
+    // Pixel kernels, selected by the CPU features
+    UnpremultiplyFn unpremultiply = nullptr;
+    BGRAToYUVAFn bgra_to_yuva = nullptr;
+    DownsampleChromaFn downsample_chroma = nullptr;
+
   private:
     ISubRenderProvider *m_pProvider = nullptr;
     ISubRenderFrame *m_SubtitleFrame = nullptr;
@@ -107,6 +146,8 @@ class CLAVSubtitleConsumer
     SwsContext *m_pSwsContext = nullptr;
     LAVPixelFormat m_PixFmt = LAVPixFmt_None;
 
+    std::list<CachedBitmap *> m_BitmapCache;
+
     LAVSubtitleConsumerContext context;
 
     CLAVVideo *m_pLAVVideo = nullptr;
@@ -0,0 +1,199 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "blend_dsp.h"
+
+#include <immintrin.h>
+
+// Both SIMD versions produce results identical to the C version
+
+void bgra_to_yuva_line_c BGRA_TO_YUVA_FUNC_PARAMS
+{
+    for (int col = 0; col < width; col++, src += 4)
+    {
+        const int b = src[0], g = src[1], r = src[2];
+        y[col] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[col] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[col] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        a[col] = src[3];
+    }
+}
+
+// The coefficients of a component are multiplied with B0G0R0A0 words and summed in pairs (pmaddwd), which leaves the
+// B+G and R+A parts of every pixel in two dwords. Those are summed after separating the even and odd dwords.
+#define BGRA_COEFFS(cb, cg, cr) (short)(cb), (short)(cg), (short)(cr), 0, (short)(cb), (short)(cg), (short)(cr), 0
+
+// Sum of the coefficients of 4 pixels, (BG, RA) dword pairs in lo and hi
+static inline __m128i bgra_dot4_sse2(__m128i lo, __m128i hi, __m128i coeffs)
+{
+    const __m128 plo = _mm_castsi128_ps(_mm_madd_epi16(lo, coeffs));
+    const __m128 phi = _mm_castsi128_ps(_mm_madd_epi16(hi, coeffs));
+    return _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(plo, phi, _MM_SHUFFLE(2, 0, 2, 0))),
+                         _mm_castps_si128(_mm_shuffle_ps(plo, phi, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+void bgra_to_yuva_line_sse2 BGRA_TO_YUVA_FUNC_PARAMS
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(128);
+    const __m128i coeffY = _mm_setr_epi16(BGRA_COEFFS(25, 129, 66));
+    const __m128i coeffU = _mm_setr_epi16(BGRA_COEFFS(112, -74, -38));
+    const __m128i coeffV = _mm_setr_epi16(BGRA_COEFFS(-18, -94, 112));
+    const __m128i offsetY = _mm_set1_epi16(16);
+    const __m128i offsetUV = _mm_set1_epi16(128);
+
+    int col = 0;
+    for (; col + 8 <= width; col += 8, src += 32)
+    {
+        const __m128i px0 = _mm_loadu_si128((const __m128i *)src);
+        const __m128i px1 = _mm_loadu_si128((const __m128i *)(src + 16));
+        const __m128i lo0 = _mm_unpacklo_epi8(px0, zero), hi0 = _mm_unpackhi_epi8(px0, zero);
+        const __m128i lo1 = _mm_unpacklo_epi8(px1, zero), hi1 = _mm_unpackhi_epi8(px1, zero);
+
+#define BGRA_COMPONENT(coeffs, offset)                                                                          \
+    _mm_add_epi16(                                                                                              \
+        _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(bgra_dot4_sse2(lo0, hi0, coeffs), round), 8),             \
+                        _mm_srai_epi32(_mm_add_epi32(bgra_dot4_sse2(lo1, hi1, coeffs), round), 8)),            \
+        offset)
+
+        const __m128i yw = BGRA_COMPONENT(coeffY, offsetY);
+        const __m128i uw = BGRA_COMPONENT(coeffU, offsetUV);
+        const __m128i vw = BGRA_COMPONENT(coeffV, offsetUV);
+#undef BGRA_COMPONENT
+        const __m128i aw = _mm_packs_epi32(_mm_srli_epi32(px0, 24), _mm_srli_epi32(px1, 24));
+
+        _mm_storel_epi64((__m128i *)(y + col), _mm_packus_epi16(yw, yw));
+        _mm_storel_epi64((__m128i *)(u + col), _mm_packus_epi16(uw, uw));
+        _mm_storel_epi64((__m128i *)(v + col), _mm_packus_epi16(vw, vw));
+        _mm_storel_epi64((__m128i *)(a + col), _mm_packus_epi16(aw, aw));
+    }
+
+    if (col < width)
+        bgra_to_yuva_line_c(y + col, u + col, v + col, a + col, src, width - col);
+}
+
+// Same as the SSE2 version per 128-bit lane. The packs work within each lane, so the words of 16 pixels come out as
+// 0-3, 8-11 | 4-7, 12-15, and are put in order with a 64-bit permute.
+static inline __m256i bgra_dot8_avx2(__m256i lo, __m256i hi, __m256i coeffs)
+{
+    const __m256 plo = _mm256_castsi256_ps(_mm256_madd_epi16(lo, coeffs));
+    const __m256 phi = _mm256_castsi256_ps(_mm256_madd_epi16(hi, coeffs));
+    return _mm256_add_epi32(_mm256_castps_si256(_mm256_shuffle_ps(plo, phi, _MM_SHUFFLE(2, 0, 2, 0))),
+                            _mm256_castps_si256(_mm256_shuffle_ps(plo, phi, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+static inline __m128i pack_words_avx2(__m256i words)
+{
+    words = _mm256_permute4x64_epi64(words, _MM_SHUFFLE(3, 1, 2, 0));
+    const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm256_castsi256_si128(bytes);
+}
+
+void bgra_to_yuva_line_avx2 BGRA_TO_YUVA_FUNC_PARAMS
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i coeffY = _mm256_setr_epi16(BGRA_COEFFS(25, 129, 66), BGRA_COEFFS(25, 129, 66));
+    const __m256i coeffU = _mm256_setr_epi16(BGRA_COEFFS(112, -74, -38), BGRA_COEFFS(112, -74, -38));
+    const __m256i coeffV = _mm256_setr_epi16(BGRA_COEFFS(-18, -94, 112), BGRA_COEFFS(-18, -94, 112));
+    const __m256i offsetY = _mm256_set1_epi16(16);
+    const __m256i offsetUV = _mm256_set1_epi16(128);
+
+    int col = 0;
+    for (; col + 16 <= width; col += 16, src += 64)
+    {
+        const __m256i px0 = _mm256_loadu_si256((const __m256i *)src);
+        const __m256i px1 = _mm256_loadu_si256((const __m256i *)(src + 32));
+        const __m256i lo0 = _mm256_unpacklo_epi8(px0, zero), hi0 = _mm256_unpackhi_epi8(px0, zero);
+        const __m256i lo1 = _mm256_unpacklo_epi8(px1, zero), hi1 = _mm256_unpackhi_epi8(px1, zero);
+
+#define BGRA_COMPONENT(coeffs, offset)                                                                          \
+    _mm256_add_epi16(                                                                                           \
+        _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(bgra_dot8_avx2(lo0, hi0, coeffs), round), 8),    \
+                           _mm256_srai_epi32(_mm256_add_epi32(bgra_dot8_avx2(lo1, hi1, coeffs), round), 8)),   \
+        offset)
+
+        const __m256i yw = BGRA_COMPONENT(coeffY, offsetY);
+        const __m256i uw = BGRA_COMPONENT(coeffU, offsetUV);
+        const __m256i vw = BGRA_COMPONENT(coeffV, offsetUV);
+#undef BGRA_COMPONENT
+        const __m256i aw = _mm256_packs_epi32(_mm256_srli_epi32(px0, 24), _mm256_srli_epi32(px1, 24));
+
+        _mm_storeu_si128((__m128i *)(y + col), pack_words_avx2(yw));
+        _mm_storeu_si128((__m128i *)(u + col), pack_words_avx2(uw));
+        _mm_storeu_si128((__m128i *)(v + col), pack_words_avx2(vw));
+        _mm_storeu_si128((__m128i *)(a + col), pack_words_avx2(aw));
+    }
+
+    if (col < width)
+        bgra_to_yuva_line_sse2(y + col, u + col, v + col, a + col, src, width - col);
+}
+
+void downsample_chroma_c DOWNSAMPLE_CHROMA_FUNC_PARAMS
+{
+    for (int col = 0; col < width; col++)
+    {
+        const int c0 = (src0[2 * col] + src1[2 * col] + 1) >> 1;
+        const int c1 = (src0[2 * col + 1] + src1[2 * col + 1] + 1) >> 1;
+        dst[col] = (uint8_t)((c0 + c1 + 1) >> 1);
+    }
+}
+
+// The vertical average is a byte average, the horizontal one a word average of the even and odd bytes
+void downsample_chroma_sse2 DOWNSAMPLE_CHROMA_FUNC_PARAMS
+{
+    const __m128i mask = _mm_set1_epi16(0xff);
+
+    int col = 0;
+    for (; col + 16 <= width; col += 16)
+    {
+        const __m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(src0 + 2 * col)),
+                                        _mm_loadu_si128((const __m128i *)(src1 + 2 * col)));
+        const __m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(src0 + 2 * col + 16)),
+                                        _mm_loadu_si128((const __m128i *)(src1 + 2 * col + 16)));
+        const __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, mask), _mm_srli_epi16(v0, 8));
+        const __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, mask), _mm_srli_epi16(v1, 8));
+        _mm_storeu_si128((__m128i *)(dst + col), _mm_packus_epi16(h0, h1));
+    }
+
+    if (col < width)
+        downsample_chroma_c(dst + col, src0 + 2 * col, src1 + 2 * col, width - col);
+}
+
+void downsample_chroma_avx2 DOWNSAMPLE_CHROMA_FUNC_PARAMS
+{
+    const __m256i mask = _mm256_set1_epi16(0xff);
+
+    int col = 0;
+    for (; col + 32 <= width; col += 32)
+    {
+        const __m256i v0 = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(src0 + 2 * col)),
+                                           _mm256_loadu_si256((const __m256i *)(src1 + 2 * col)));
+        const __m256i v1 = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(src0 + 2 * col + 32)),
+                                           _mm256_loadu_si256((const __m256i *)(src1 + 2 * col + 32)));
+        const __m256i h0 = _mm256_avg_epu16(_mm256_and_si256(v0, mask), _mm256_srli_epi16(v0, 8));
+        const __m256i h1 = _mm256_avg_epu16(_mm256_and_si256(v1, mask), _mm256_srli_epi16(v1, 8));
+        const __m256i packed = _mm256_packus_epi16(h0, h1);
+        _mm256_storeu_si256((__m256i *)(dst + col), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    if (col < width)
+        downsample_chroma_sse2(dst + col, src0 + 2 * col, src1 + 2 * col, width - col);
+}
@@ -0,0 +1,61 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Pixel kernels for the conversion of subtitle bitmaps
+//
+// Every kernel has a C version, which is the reference, and SSE2 and AVX2 versions which produce bit-exact results.
+// They only depend on the C runtime and the intrinsics, so that they can be tested on their own.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Un-pre-multiply alpha of BGRA pixels, ie. c = c * 255 / a
+// Copies from src to dst while converting.
+#define UNPREMULTIPLY_FUNC_PARAMS \
+    (uint8_t * dst, ptrdiff_t dstStride, const uint8_t *src, ptrdiff_t srcStride, int width, int height)
+
+typedef void(*UnpremultiplyFn) UNPREMULTIPLY_FUNC_PARAMS;
+
+void unpremultiply_bgra_c UNPREMULTIPLY_FUNC_PARAMS;
+void unpremultiply_bgra_sse2 UNPREMULTIPLY_FUNC_PARAMS;
+void unpremultiply_bgra_avx2 UNPREMULTIPLY_FUNC_PARAMS;
+
+// Convert a line of (un-pre-multiplied) BGRA pixels to BT.601 limited range YUV and alpha, all at full resolution
+// Y = ((66 R + 129 G + 25 B + 128) >> 8) + 16, U = ((-38 R - 74 G + 112 B + 128) >> 8) + 128,
+// V = ((112 R - 94 G - 18 B + 128) >> 8) + 128
+#define BGRA_TO_YUVA_FUNC_PARAMS (uint8_t * y, uint8_t * u, uint8_t * v, uint8_t * a, const uint8_t *src, int width)
+
+typedef void(*BGRAToYUVAFn) BGRA_TO_YUVA_FUNC_PARAMS;
+
+void bgra_to_yuva_line_c BGRA_TO_YUVA_FUNC_PARAMS;
+void bgra_to_yuva_line_sse2 BGRA_TO_YUVA_FUNC_PARAMS;
+void bgra_to_yuva_line_avx2 BGRA_TO_YUVA_FUNC_PARAMS;
+
+// Halve a line of chroma horizontally, and average it with the next line
+// dst[i] = avg(avg(src0[2i], src1[2i]), avg(src0[2i + 1], src1[2i + 1])), with avg(x, y) = (x + y + 1) >> 1
+// Both source lines hold 2 * width samples, pass the same line twice to only downsample horizontally.
+#define DOWNSAMPLE_CHROMA_FUNC_PARAMS (uint8_t * dst, const uint8_t *src0, const uint8_t *src1, int width)
+
+typedef void(*DownsampleChromaFn) DOWNSAMPLE_CHROMA_FUNC_PARAMS;
+
+void downsample_chroma_c DOWNSAMPLE_CHROMA_FUNC_PARAMS;
+void downsample_chroma_sse2 DOWNSAMPLE_CHROMA_FUNC_PARAMS;
+void downsample_chroma_avx2 DOWNSAMPLE_CHROMA_FUNC_PARAMS;
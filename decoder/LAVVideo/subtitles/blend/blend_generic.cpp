@@ -65,9 +65,10 @@ DECLARE_BLEND_FUNC_IMPL(blend_rgb_c)
 
 template <class pixT, int nv12> DECLARE_BLEND_FUNC_IMPL(blend_yuv_c)
 {
-    ASSERT(pixFmt == LAVPixFmt_YUV420 || pixFmt == LAVPixFmt_NV12 || pixFmt == LAVPixFmt_YUV422 ||
-           pixFmt == LAVPixFmt_YUV444 || pixFmt == LAVPixFmt_YUV420bX || pixFmt == LAVPixFmt_YUV422bX ||
-           pixFmt == LAVPixFmt_YUV444bX || pixFmt == LAVPixFmt_P016);
+    ASSERT(pixFmt == LAVPixFmt_YUV420 || pixFmt == LAVPixFmt_NV12 || pixFmt == LAVPixFmt_NV21 ||
+           pixFmt == LAVPixFmt_YUV422 || pixFmt == LAVPixFmt_YUV444 || pixFmt == LAVPixFmt_YUV420bX ||
+           pixFmt == LAVPixFmt_YUV422bX || pixFmt == LAVPixFmt_YUV444bX || pixFmt == LAVPixFmt_P016 ||
+           pixFmt == LAVPixFmt_GBRP || pixFmt == LAVPixFmt_GBRPbX);
 
     BYTE *y = video[0];
     BYTE *u = video[1];
@@ -89,7 +90,8 @@ template <class pixT, int nv12> DECLARE_BLEND_FUNC_IMPL(blend_yuv_c)
     int xPos = position.x;
 
     const int hsub = nv12 || (pixFmt == LAVPixFmt_YUV420 || pixFmt == LAVPixFmt_YUV420bX || pixFmt == LAVPixFmt_NV12);
-    const int vsub = nv12 || (pixFmt != LAVPixFmt_YUV444 && pixFmt != LAVPixFmt_YUV444bX);
+    const int vsub = nv12 || (pixFmt != LAVPixFmt_YUV444 && pixFmt != LAVPixFmt_YUV444bX && pixFmt != LAVPixFmt_GBRP &&
+                              pixFmt != LAVPixFmt_GBRPbX);
     const int shift = sizeof(pixT) > 1 ? bpp - 8 : 0;
 
     for (line = 0; line < h; line++)
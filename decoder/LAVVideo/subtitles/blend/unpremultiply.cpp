@@ -0,0 +1,192 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "blend_dsp.h"
+
+#include <immintrin.h>
+
+// Both SIMD versions produce results identical to the C version
+
+static inline uint8_t clip_uint8(int value)
+{
+    return value > 255 ? 255 : (uint8_t)value;
+}
+
+void unpremultiply_bgra_c UNPREMULTIPLY_FUNC_PARAMS
+{
+    for (int line = 0; line < height; line++)
+    {
+        const uint8_t *s = src + line * srcStride;
+        uint8_t *d = dst + line * dstStride;
+        for (int col = 0; col < width; col++)
+        {
+            const uint8_t a = s[3];
+            if (a != 0 && a != 255)
+            {
+                d[0] = clip_uint8(s[0] * 255 / a);
+                d[1] = clip_uint8(s[1] * 255 / a);
+                d[2] = clip_uint8(s[2] * 255 / a);
+            }
+            else
+            {
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+            }
+            d[3] = a;
+            s += 4;
+            d += 4;
+        }
+    }
+}
+
+// Reciprocal table for the division by alpha
+// c * 255 / a == (c * ceil(255 * 65536 / a)) >> 16 for all c <= a, which is split into a high and a low 16-bit word
+// so that the product can be formed with 16-bit multiplies. Each entry holds the factors for a whole BGRA pixel, the
+// alpha component is multiplied by one. Alpha 0 uses the same identity factors as alpha 255.
+static struct UnpremultiplyTable
+{
+    UnpremultiplyTable()
+    {
+        for (int a = 0; a < 256; a++)
+        {
+            const uint32_t r = (a == 0) ? 65536 : (255 * 65536 + a - 1) / a;
+            const uint64_t hi = r >> 16, lo = r & 0xffff;
+            factorHi[a] = hi | (hi << 16) | (hi << 32) | (1ULL << 48);
+            factorLo[a] = lo | (lo << 16) | (lo << 32);
+        }
+    }
+
+    uint64_t factorHi[256];
+    uint64_t factorLo[256];
+} unpremultiply_table;
+
+// Load the factors of two pixels, by their alpha values
+#define LOAD_FACTORS(table, a0, a1) \
+    _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)&table[a0]), _mm_loadl_epi64((const __m128i *)&table[a1]))
+
+void unpremultiply_bgra_sse2 UNPREMULTIPLY_FUNC_PARAMS
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(255);
+    const uint64_t *hi = unpremultiply_table.factorHi;
+    const uint64_t *lo = unpremultiply_table.factorLo;
+
+    for (int line = 0; line < height; line++)
+    {
+        const uint8_t *s = src + line * srcStride;
+        uint8_t *d = dst + line * dstStride;
+
+        int col = 0;
+        for (; col + 4 <= width; col += 4, s += 16, d += 16)
+        {
+            __m128i xmm0 = _mm_loadu_si128((const __m128i *)s);
+
+            // fully transparent and fully opaque pixels are not modified
+            __m128i xmm1 = _mm_srli_epi32(xmm0, 24);      /* 000A000A */
+            __m128i xmm2 = _mm_cmpeq_epi32(xmm1, zero);   /* alpha == 0 */
+            __m128i xmm3 = _mm_cmpeq_epi32(xmm1, opaque); /* alpha == 255 */
+            if (_mm_movemask_epi8(_mm_or_si128(xmm2, xmm3)) == 0xffff)
+            {
+                _mm_storeu_si128((__m128i *)d, xmm0);
+                continue;
+            }
+
+            // clamp the color components to alpha, which clips the result to 255
+            xmm1 = _mm_or_si128(xmm1, _mm_slli_epi32(xmm1, 8));
+            xmm1 = _mm_or_si128(xmm1, _mm_slli_epi32(xmm1, 16)); /* AAAAAAAA */
+            xmm1 = _mm_or_si128(xmm1, xmm2);                     /* alpha 0 is not clamped */
+            xmm0 = _mm_min_epu8(xmm0, xmm1);
+
+            xmm1 = LOAD_FACTORS(hi, s[3], s[7]);
+            xmm2 = LOAD_FACTORS(lo, s[3], s[7]);
+            xmm3 = _mm_unpacklo_epi8(xmm0, zero); /* B0G0R0A0 */
+            xmm3 = _mm_add_epi16(_mm_mullo_epi16(xmm3, xmm1), _mm_mulhi_epu16(xmm3, xmm2));
+
+            xmm1 = LOAD_FACTORS(hi, s[11], s[15]);
+            xmm2 = LOAD_FACTORS(lo, s[11], s[15]);
+            xmm0 = _mm_unpackhi_epi8(xmm0, zero); /* B0G0R0A0 */
+            xmm0 = _mm_add_epi16(_mm_mullo_epi16(xmm0, xmm1), _mm_mulhi_epu16(xmm0, xmm2));
+
+            _mm_storeu_si128((__m128i *)d, _mm_packus_epi16(xmm3, xmm0));
+        }
+
+        if (col < width)
+            unpremultiply_bgra_c(d, dstStride, s, srcStride, width - col, 1);
+    }
+}
+
+// Same as the SSE2 version, with 8 pixels at a time
+// The byte unpacks work within each 128-bit lane, so the low half holds pixels 0, 1, 4, 5 and the high half pixels
+// 2, 3, 6, 7, and the factors are loaded in that order.
+void unpremultiply_bgra_avx2 UNPREMULTIPLY_FUNC_PARAMS
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32(255);
+    const uint64_t *hi = unpremultiply_table.factorHi;
+    const uint64_t *lo = unpremultiply_table.factorLo;
+
+    for (int line = 0; line < height; line++)
+    {
+        const uint8_t *s = src + line * srcStride;
+        uint8_t *d = dst + line * dstStride;
+
+        int col = 0;
+        for (; col + 8 <= width; col += 8, s += 32, d += 32)
+        {
+            __m256i ymm0 = _mm256_loadu_si256((const __m256i *)s);
+
+            // fully transparent and fully opaque pixels are not modified
+            __m256i ymm1 = _mm256_srli_epi32(ymm0, 24);
+            __m256i ymm2 = _mm256_cmpeq_epi32(ymm1, zero);
+            __m256i ymm3 = _mm256_cmpeq_epi32(ymm1, opaque);
+            if (_mm256_movemask_epi8(_mm256_or_si256(ymm2, ymm3)) == -1)
+            {
+                _mm256_storeu_si256((__m256i *)d, ymm0);
+                continue;
+            }
+
+            // clamp the color components to alpha, which clips the result to 255
+            ymm1 = _mm256_or_si256(ymm1, _mm256_slli_epi32(ymm1, 8));
+            ymm1 = _mm256_or_si256(ymm1, _mm256_slli_epi32(ymm1, 16));
+            ymm1 = _mm256_or_si256(ymm1, ymm2);
+            ymm0 = _mm256_min_epu8(ymm0, ymm1);
+
+            ymm1 = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD_FACTORS(hi, s[3], s[7])),
+                                           LOAD_FACTORS(hi, s[19], s[23]), 1);
+            ymm2 = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD_FACTORS(lo, s[3], s[7])),
+                                           LOAD_FACTORS(lo, s[19], s[23]), 1);
+            ymm3 = _mm256_unpacklo_epi8(ymm0, zero);
+            ymm3 = _mm256_add_epi16(_mm256_mullo_epi16(ymm3, ymm1), _mm256_mulhi_epu16(ymm3, ymm2));
+
+            ymm1 = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD_FACTORS(hi, s[11], s[15])),
+                                           LOAD_FACTORS(hi, s[27], s[31]), 1);
+            ymm2 = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD_FACTORS(lo, s[11], s[15])),
+                                           LOAD_FACTORS(lo, s[27], s[31]), 1);
+            ymm0 = _mm256_unpackhi_epi8(ymm0, zero);
+            ymm0 = _mm256_add_epi16(_mm256_mullo_epi16(ymm0, ymm1), _mm256_mulhi_epu16(ymm0, ymm2));
+
+            _mm256_storeu_si256((__m256i *)d, _mm256_packus_epi16(ymm3, ymm0));
+        }
+
+        if (col < width)
+            unpremultiply_bgra_sse2(d, dstStride, s, srcStride, width - col, 1);
+    }
+}
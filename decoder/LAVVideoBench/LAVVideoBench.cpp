@@ -0,0 +1,334 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Headless benchmark of the LAV Video decoding and output pipeline
+//
+// Usage: LAVVideoBench <file> [<file> ...]
+//
+// LAVSplitter.ax and LAVVideo.ax are loaded from the working directory without registration. LAV Splitter Source
+// reads the video stream of every file, LAV Video decodes it, and a stub renderer pin discards the output without a
+// clock. Every file is decoded once for every combination of decoding threads and output format. The frame rate of
+// the whole run, the time per frame of every stage (see ILAVVideoStatus::GetProcessingStats) and the frame buffer
+// allocations (see ILAVVideoStatus::GetFramePoolStats) are printed as one line per run.
+
+#include "stdafx.h"
+
+// Initialize the GUIDs
+#include <InitGuid.h>
+
+#include "moreuuids.h"
+#include "LAVVideoSettings.h"
+#include "ProcessingCounter.h"
+
+// The base classes expect the factory template table of a filter DLL
+CFactoryTemplate g_Templates[1] = {};
+int g_cTemplates = 0;
+
+struct BenchOutputFormat
+{
+    const char *szName;
+    LAVOutPixFmts pixFmt;
+};
+
+// 0 lets the decoder pick the thread count from the number of CPU cores
+static const DWORD s_Threads[] = {1, 2, 4, 0};
+
+static const BenchOutputFormat s_OutputFormats[] = {{"NV12", LAVOutPixFmt_NV12},
+                                                    {"YV12", LAVOutPixFmt_YV12},
+                                                    {"P010", LAVOutPixFmt_P010},
+                                                    {"YUY2", LAVOutPixFmt_YUY2},
+                                                    {"RGB32", LAVOutPixFmt_RGB32}};
+
+struct BenchConfig
+{
+    LPCWSTR pszFile;
+    DWORD dwThreads;
+    const BenchOutputFormat *pOutput;
+};
+
+// Stub renderer, accepts any uncompressed video and discards it, counting the frames
+class CBenchRenderer : public CBaseRenderer
+{
+  public:
+    CBenchRenderer(HRESULT *phr)
+        : CBaseRenderer(GUID_NULL, NAME("Bench Renderer"), nullptr, phr)
+    {
+    }
+
+    HRESULT CheckMediaType(const CMediaType *pmt) override
+    {
+        return (pmt->majortype == MEDIATYPE_Video &&
+                (pmt->formattype == FORMAT_VideoInfo || pmt->formattype == FORMAT_VideoInfo2))
+                   ? S_OK
+                   : S_FALSE;
+    }
+
+    HRESULT DoRenderSample(IMediaSample *pSample) override
+    {
+        m_ullFrames++;
+        return S_OK;
+    }
+
+    ULONGLONG GetFrames() const { return m_ullFrames; }
+
+  private:
+    ULONGLONG m_ullFrames = 0;
+};
+
+static HRESULT GetFilterPin(IBaseFilter *pFilter, PIN_DIRECTION dir, IPin **ppPin)
+{
+    CComPtr<IEnumPins> pEnum;
+    HRESULT hr = pFilter->EnumPins(&pEnum);
+    if (FAILED(hr))
+        return hr;
+
+    CComPtr<IPin> pPin;
+    while (pEnum->Next(1, &pPin, nullptr) == S_OK)
+    {
+        PIN_DIRECTION pinDir;
+        if (SUCCEEDED(pPin->QueryDirection(&pinDir)) && pinDir == dir)
+        {
+            *ppPin = pPin.Detach();
+            return S_OK;
+        }
+        pPin.Release();
+    }
+    return VFW_E_NOT_FOUND;
+}
+
+// Find the first video output pin of the splitter, and name its codec after the FourCC of the media subtype
+static HRESULT GetVideoPin(IBaseFilter *pSplitter, IPin **ppPin, char szCodec[5])
+{
+    CComPtr<IEnumPins> pEnum;
+    HRESULT hr = pSplitter->EnumPins(&pEnum);
+    if (FAILED(hr))
+        return hr;
+
+    CComPtr<IPin> pPin;
+    while (pEnum->Next(1, &pPin, nullptr) == S_OK)
+    {
+        PIN_DIRECTION pinDir;
+        CComPtr<IEnumMediaTypes> pEnumMT;
+        if (SUCCEEDED(pPin->QueryDirection(&pinDir)) && pinDir == PINDIR_OUTPUT &&
+            SUCCEEDED(pPin->EnumMediaTypes(&pEnumMT)))
+        {
+            AM_MEDIA_TYPE *pmt = nullptr;
+            if (pEnumMT->Next(1, &pmt, nullptr) == S_OK)
+            {
+                const BOOL bVideo = (pmt->majortype == MEDIATYPE_Video);
+                for (int i = 0; i < 4; i++)
+                {
+                    const char c = (char)(pmt->subtype.Data1 >> (8 * i));
+                    szCodec[i] = (c >= 0x20 && c < 0x7f) ? c : '?';
+                }
+                szCodec[4] = 0;
+                DeleteMediaType(pmt);
+
+                if (bVideo)
+                {
+                    *ppPin = pPin.Detach();
+                    return S_OK;
+                }
+            }
+        }
+        pPin.Release();
+    }
+    return VFW_E_NOT_FOUND;
+}
+
+static LPCWSTR GetFileName(LPCWSTR pszPath)
+{
+    LPCWSTR pszName = wcsrchr(pszPath, L'\\');
+    return pszName ? pszName + 1 : pszPath;
+}
+
+static HRESULT ConfigureDecoder(IBaseFilter *pDecoder, const BenchConfig &config)
+{
+    CComQIPtr<ILAVVideoSettings> pSettings(pDecoder);
+    if (!pSettings)
+        return E_NOINTERFACE;
+
+    // runtime config, so the settings in the registry are neither used nor changed
+    HRESULT hr = pSettings->SetRuntimeConfig(TRUE);
+    if (FAILED(hr))
+        return hr;
+
+    for (int i = 0; i < LAVOutPixFmt_NB; i++)
+        pSettings->SetPixelFormat((LAVOutPixFmts)i, i == config.pOutput->pixFmt);
+
+    pSettings->SetNumThreads(config.dwThreads);
+    pSettings->SetTrayIcon(FALSE);
+
+    return S_OK;
+}
+
+// Build the graph for the configuration, run it to the end of the stream, and print the results
+static HRESULT RunBenchmark(IClassFactory *pSplitterFactory, IClassFactory *pDecoderFactory,
+                            const BenchConfig &config)
+{
+    HRESULT hr = S_OK;
+
+    CComPtr<IGraphBuilder> pGraph;
+    CComPtr<IBaseFilter> pSource, pDecoder, pRenderer;
+    CComPtr<IPin> pSourceOut, pDecoderIn, pDecoderOut, pRendererIn;
+    char szCodec[5] = {0};
+
+    CBenchRenderer *pBenchRenderer = new CBenchRenderer(&hr);
+    pRenderer = pBenchRenderer;
+    if (FAILED(hr))
+        return hr;
+
+    if (FAILED(hr = pGraph.CoCreateInstance(CLSID_FilterGraph)) ||
+        FAILED(hr = pSplitterFactory->CreateInstance(nullptr, IID_PPV_ARGS(&pSource))) ||
+        FAILED(hr = pDecoderFactory->CreateInstance(nullptr, IID_PPV_ARGS(&pDecoder))) ||
+        FAILED(hr = ConfigureDecoder(pDecoder, config)))
+        return hr;
+
+    CComQIPtr<IFileSourceFilter> pFileSource(pSource);
+    if (!pFileSource)
+        return E_NOINTERFACE;
+
+    if (FAILED(hr = pGraph->AddFilter(pSource, L"Source")) || FAILED(hr = pGraph->AddFilter(pDecoder, L"Decoder")) ||
+        FAILED(hr = pGraph->AddFilter(pRenderer, L"Renderer")))
+        return hr;
+
+    // only the video stream is connected, the splitter does not demux the others
+    if (FAILED(hr = pFileSource->Load(config.pszFile, nullptr)) ||
+        FAILED(hr = GetVideoPin(pSource, &pSourceOut, szCodec)) ||
+        FAILED(hr = GetFilterPin(pDecoder, PINDIR_INPUT, &pDecoderIn)) ||
+        FAILED(hr = GetFilterPin(pDecoder, PINDIR_OUTPUT, &pDecoderOut)) ||
+        FAILED(hr = GetFilterPin(pRenderer, PINDIR_INPUT, &pRendererIn)))
+        return hr;
+
+    if (FAILED(hr = pGraph->ConnectDirect(pSourceOut, pDecoderIn, nullptr)) ||
+        FAILED(hr = pGraph->ConnectDirect(pDecoderOut, pRendererIn, nullptr)))
+        return hr;
+
+    // without a clock, the renderer consumes every frame right away
+    CComQIPtr<IMediaFilter> pMediaFilter(pGraph);
+    CComQIPtr<IMediaControl> pControl(pGraph);
+    CComQIPtr<IMediaEvent> pEvent(pGraph);
+    CComQIPtr<ILAVVideoStatus> pStatus(pDecoder);
+    if (!pMediaFilter || !pControl || !pEvent || !pStatus)
+        return E_NOINTERFACE;
+
+    if (FAILED(hr = pMediaFilter->SetSyncSource(nullptr)))
+        return hr;
+
+    const LONGLONG llStart = CProcessingCounter::Now();
+    if (FAILED(hr = pControl->Run()))
+        return hr;
+
+    long lEventCode = 0;
+    hr = pEvent->WaitForCompletion(INFINITE, &lEventCode);
+    const REFERENCE_TIME rtElapsed = CProcessingCounter::TicksToTime(CProcessingCounter::Now() - llStart);
+
+    // the statistics are reset when streaming starts again, so read them before stopping
+    ULONGLONG ullStageFrames[LAVStage_NB] = {0};
+    REFERENCE_TIME rtStageTime[LAVStage_NB] = {0};
+    for (int i = 0; i < LAVStage_NB; i++)
+        pStatus->GetProcessingStats((LAVVideoStage)i, &ullStageFrames[i], &rtStageTime[i]);
+
+    ULONGLONG ullPoolHits = 0, ullPoolMisses = 0;
+    DWORD dwPoolKB = 0;
+    pStatus->GetFramePoolStats(&ullPoolHits, &ullPoolMisses, &dwPoolKB);
+
+    pControl->Stop();
+
+    if (FAILED(hr) || lEventCode != EC_COMPLETE)
+        return FAILED(hr) ? hr : E_FAIL;
+
+    const ULONGLONG ullFrames = pBenchRenderer->GetFrames();
+    printf("%-24.24S %-5s %7u %-5s %8I64u %8.1f", GetFileName(config.pszFile), szCodec, config.dwThreads,
+           config.pOutput->szName, ullFrames, rtElapsed ? ullFrames * 10000000.0 / rtElapsed : 0.0);
+
+    // microseconds per frame of every stage
+    for (int i = 0; i < LAVStage_NB; i++)
+        printf(" %9.1f", ullStageFrames[i] ? rtStageTime[i] / 10.0 / ullStageFrames[i] : 0.0);
+
+    // every miss of the frame pool is a heap allocation
+    printf(" %9I64u %9I64u %8u\n", ullPoolHits, ullPoolMisses, dwPoolKB);
+
+    return S_OK;
+}
+
+typedef HRESULT(STDAPICALLTYPE *PFN_DLLGETCLASSOBJECT)(REFCLSID, REFIID, LPVOID *);
+
+static HRESULT GetClassFactory(HMODULE hModule, REFCLSID clsid, IClassFactory **ppFactory)
+{
+    PFN_DLLGETCLASSOBJECT pfnGetClassObject =
+        hModule ? (PFN_DLLGETCLASSOBJECT)GetProcAddress(hModule, "DllGetClassObject") : nullptr;
+    if (!pfnGetClassObject)
+        return E_FAIL;
+
+    return pfnGetClassObject(clsid, IID_PPV_ARGS(ppFactory));
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+    if (argc < 2)
+    {
+        fwprintf(stderr, L"Usage: %s <file> [<file> ...]\n", argv[0]);
+        return 1;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+        return 1;
+
+    int ret = 1;
+    HMODULE hSplitter = LoadLibrary(L"LAVSplitter.ax");
+    HMODULE hDecoder = LoadLibrary(L"LAVVideo.ax");
+
+    CComPtr<IClassFactory> pSplitterFactory, pDecoderFactory;
+    if (FAILED(GetClassFactory(hSplitter, CLSID_LAVSplitterSource, &pSplitterFactory)) ||
+        FAILED(GetClassFactory(hDecoder, CLSID_LAVVideo, &pDecoderFactory)))
+    {
+        fwprintf(stderr, L"LAVSplitter.ax and LAVVideo.ax could not be loaded from the working directory\n");
+        goto done;
+    }
+
+    printf("%-24s %-5s %7s %-5s %8s %8s %9s %9s %9s %9s %9s %9s %9s %8s\n", "file", "codec", "threads", "out",
+           "frames", "fps", "decode", "deint", "convert", "subtitle", "deliver", "pool hits", "allocs", "pool KB");
+
+    for (int i = 1; i < argc; i++)
+    {
+        for (DWORD dwThreads : s_Threads)
+        {
+            for (const BenchOutputFormat &output : s_OutputFormats)
+            {
+                const BenchConfig config = {argv[i], dwThreads, &output};
+                HRESULT hr = RunBenchmark(pSplitterFactory, pDecoderFactory, config);
+                if (FAILED(hr))
+                    printf("%-24.24S %-5s %7u %-5s failed (0x%08x)\n", GetFileName(argv[i]), "", dwThreads,
+                           output.szName, hr);
+            }
+        }
+    }
+    ret = 0;
+
+done:
+    pSplitterFactory.Release();
+    pDecoderFactory.Release();
+    if (hDecoder)
+        FreeLibrary(hDecoder);
+    if (hSplitter)
+        FreeLibrary(hSplitter);
+    CoUninitialize();
+    return ret;
+}
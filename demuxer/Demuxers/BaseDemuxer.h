@@ -91,11 +91,14 @@ class CBaseDemuxer : public CUnknown
     virtual STDMETHODIMP Start() { return E_NOTIMPL; }
     // Abort opening the file
     virtual STDMETHODIMP AbortOpening(int mode = 1, int timeout = 0) { return E_NOTIMPL; }
+    // Abort a seek in progress (or one about to start), or clear the abort request again
+    virtual STDMETHODIMP AbortSeek(BOOL bAbort) { return E_NOTIMPL; }
     // Get Duration
     virtual REFERENCE_TIME GetDuration() const = 0;
     // Get the next packet from the file
     virtual STDMETHODIMP GetNextPacket(Packet **ppPacket) = 0;
     // Seek to the given position
+    // Returns S_FALSE if the seek was aborted through AbortSeek, the position is undefined then
     virtual STDMETHODIMP Seek(REFERENCE_TIME rTime) = 0;
     // Reset the demuxer, start reading at position 0
     virtual STDMETHODIMP Reset() = 0;
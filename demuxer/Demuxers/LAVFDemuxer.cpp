@@ -163,6 +163,7 @@ STDMETHODIMP CLAVFDemuxer::Start()
                 m_bH264MVCCombine = FALSE;
                 m_nH264MVCBaseStream = -1;
                 m_nH264MVCExtensionStream = -1;
+                InvalidateStreamProfiles();
             }
         }
     }
@@ -180,6 +181,12 @@ STDMETHODIMP CLAVFDemuxer::AbortOpening(int mode, int timeout)
     return S_OK;
 }
 
+STDMETHODIMP CLAVFDemuxer::AbortSeek(BOOL bAbort)
+{
+    m_bAbortSeek = bAbort;
+    return S_OK;
+}
+
 int CLAVFDemuxer::avio_interrupt_cb(void *opaque)
 {
     CLAVFDemuxer *demux = (CLAVFDemuxer *)opaque;
@@ -192,6 +199,10 @@ int CLAVFDemuxer::avio_interrupt_cb(void *opaque)
     if (demux->m_Abort && now > demux->m_timeAbort)
         return 1;
 
+    // Only seeks are aborted, reading packets has to continue normally
+    if (demux->m_bSeeking && demux->m_bAbortSeek)
+        return 1;
+
     return 0;
 }
 
@@ -947,6 +958,7 @@ void CLAVFDemuxer::CleanupAVFormat()
         avformat_close_input(&m_avFormat);
     }
     SAFE_CO_FREE(m_stOrigParser);
+    m_StreamProfiles.clear();
 }
 
 AVStream *CLAVFDemuxer::GetAVStreamByPID(int pid)
@@ -1030,9 +1042,106 @@ HRESULT CLAVFDemuxer::SetActiveStream(StreamType type, int pid)
         }
     }
 
+    InvalidateStreamProfiles();
+
     return hr;
 }
 
+// Flag the stream profiles as outdated
+// The profiles are only compiled on the demux thread in GetNextPacket, which uses them without locking
+void CLAVFDemuxer::InvalidateStreamProfiles()
+{
+    InterlockedExchange(&m_lStreamProfilesOutdated, TRUE);
+}
+
+void CLAVFDemuxer::UpdateStreamProfiles()
+{
+    m_StreamProfiles.clear();
+    m_StreamProfiles.resize(m_avFormat->nb_streams);
+
+    for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
+    {
+        const AVCodecParameters *par = m_avFormat->streams[idx]->codecpar;
+        StreamProfile &profile = m_StreamProfiles[idx];
+
+        const BOOL bForcedSubStream = m_dActiveStreams[subpic] == FORCED_SUBTITLE_PID && m_ForcedSubStream == idx;
+        for (int i = 0; i < unknown; ++i)
+        {
+            if (m_dActiveStreams[i] == idx)
+                profile.bActive = TRUE;
+        }
+
+        // Accept the forced subpic stream, and H264 MVC streams, as they get combined with the base stream later
+        if (bForcedSubStream || (m_bH264MVCCombine && par->codec_id == AV_CODEC_ID_H264_MVC))
+            profile.bActive = TRUE;
+
+        if (par->codec_id == AV_CODEC_ID_H264)
+        {
+            if (m_bMatroska || m_bOgg)
+            {
+                if (!par->extradata_size || par->extradata[0] != 1)
+                    profile.dwFlags |= LAV_PACKET_H264_ANNEXB;
+                else
+                    profile.timestamps = TimestampsH264Native;
+            }
+            else if (!m_bPMP && !m_bAVI)
+            { // For most formats, DTS timestamps for h.264 are no fun
+                profile.bNoDTS = TRUE;
+            }
+        }
+
+        // AVI's always have borked pts, specially if m_pFormatContext->flags includes
+        // AVFMT_FLAG_GENPTS so always use dts
+        if (m_bAVI && par->codec_type == AVMEDIA_TYPE_VIDEO)
+            profile.bNoPTS = TRUE;
+
+        if (par->codec_id == AV_CODEC_ID_RV10 || par->codec_id == AV_CODEC_ID_RV20 ||
+            par->codec_id == AV_CODEC_ID_RV30 || par->codec_id == AV_CODEC_ID_RV40)
+            profile.bNoPTS = TRUE;
+
+        // Never use DTS for these formats
+        if (!m_bAVI && (par->codec_id == AV_CODEC_ID_MPEG2VIDEO || par->codec_id == AV_CODEC_ID_MPEG1VIDEO))
+            profile.bNoDTS = TRUE;
+
+        if (par->codec_id == AV_CODEC_ID_VC1 && m_bVC1Correction)
+        {
+            if (m_bMatroska)
+                profile.timestamps = TimestampsVC1PTS;
+            else
+            {
+                profile.timestamps = TimestampsVC1DTS;
+                profile.dwFlags |= LAV_PACKET_PARSED;
+            }
+        }
+        else if (par->codec_id == AV_CODEC_ID_MOV_TEXT)
+        {
+            profile.dwFlags |= LAV_PACKET_MOV_TEXT;
+        }
+
+        // Mark the packet as parsed, so the forced subtitle parser doesn't hit it
+        if (par->codec_id == AV_CODEC_ID_HDMV_PGS_SUBTITLE && m_bPGSNoParsing)
+            profile.dwFlags |= LAV_PACKET_PARSED;
+
+        profile.bKeepZeroDuration = (par->codec_id == AV_CODEC_ID_TRUEHD);
+
+        if (par->codec_type == AVMEDIA_TYPE_SUBTITLE)
+        {
+            if (bForcedSubStream)
+            {
+                profile.dwFlags |= LAV_PACKET_FORCED_SUBTITLE;
+                profile.dwFlags &= ~LAV_PACKET_PARSED;
+            }
+
+            if (par->codec_id == AV_CODEC_ID_SRT)
+                profile.dwFlags |= LAV_PACKET_SRT;
+        }
+
+        if (par->codec_id == AV_CODEC_ID_PCM_S16BE_PLANAR || par->codec_id == AV_CODEC_ID_PCM_S16LE_PLANAR ||
+            par->codec_id == AV_CODEC_ID_PCM_S24LE_PLANAR || par->codec_id == AV_CODEC_ID_PCM_S32LE_PLANAR)
+            profile.dwFlags |= LAV_PACKET_PLANAR_PCM;
+    }
+}
+
 void CLAVFDemuxer::UpdateSubStreams()
 {
     for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
@@ -1154,6 +1263,8 @@ void CLAVFDemuxer::SettingsChanged(ILAVFSettingsInternal *pSettings)
     }
 
     m_bPGSNoParsing = !pSettings->GetPGSOnlyForced();
+
+    InvalidateStreamProfiles();
 }
 
 REFERENCE_TIME CLAVFDemuxer::GetDuration() const
@@ -1484,30 +1595,15 @@ STDMETHODIMP CLAVFDemuxer::GetNextPacket(Packet **ppPacket)
     }
     else
     {
+        // Re-compile the profiles after stream selection or settings changed, or when new streams appeared while reading
+        if ((m_lStreamProfilesOutdated && InterlockedExchange(&m_lStreamProfilesOutdated, FALSE)) ||
+            (unsigned)pkt.stream_index >= m_StreamProfiles.size())
+            UpdateStreamProfiles();
+
         // Check right here if the stream is active, we can drop the package otherwise.
         AVStream *stream = m_avFormat->streams[pkt.stream_index];
-        BOOL streamActive = FALSE;
-        BOOL forcedSubStream = FALSE;
-        for (int i = 0; i < unknown; ++i)
-        {
-            if (m_dActiveStreams[i] == pkt.stream_index)
-            {
-                streamActive = TRUE;
-                break;
-            }
-        }
-
-        // Accept it if its the forced subpic stream
-        if (m_dActiveStreams[subpic] == FORCED_SUBTITLE_PID && pkt.stream_index == m_ForcedSubStream)
-        {
-            forcedSubStream = streamActive = TRUE;
-        }
-
-        // Accept H264 MVC streams, as they get combined with the base stream later
-        if (m_bH264MVCCombine && stream->codecpar->codec_id == AV_CODEC_ID_H264_MVC)
-            streamActive = TRUE;
-
-        if (!streamActive)
+        const StreamProfile &profile = m_StreamProfiles[pkt.stream_index];
+        if (!profile.bActive)
         {
             av_packet_unref(&pkt);
             return S_FALSE;
@@ -1526,43 +1622,19 @@ STDMETHODIMP CLAVFDemuxer::GetNextPacket(Packet **ppPacket)
         pPacket->rtDTS = dts;
         pPacket->StreamId = (DWORD)pkt.stream_index;
         pPacket->bPosition = pkt.pos;
+        pPacket->dwFlags = profile.dwFlags;
 
-        if (stream->codecpar->codec_id == AV_CODEC_ID_H264)
+        if (profile.timestamps == TimestampsH264Native)
         {
-            if (m_bMatroska || m_bOgg)
-            {
-                if (!stream->codecpar->extradata_size || stream->codecpar->extradata[0] != 1 ||
-                    AV_RB32(pkt.data) == 0x00000001)
-                {
-                    pPacket->dwFlags |= LAV_PACKET_H264_ANNEXB;
-                }
-                else
-                { // No DTS for H264 in native format
-                    dts = Packet::INVALID_TIME;
-                }
-            }
-            else if (!m_bPMP && !m_bAVI)
-            { // For most formats, DTS timestamps for h.264 are no fun
+            if (AV_RB32(pkt.data) == 0x00000001)
+                pPacket->dwFlags |= LAV_PACKET_H264_ANNEXB;
+            else // No DTS for H264 in native format
                 dts = Packet::INVALID_TIME;
-            }
         }
 
-        if (m_bAVI && stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
-        {
-            // AVI's always have borked pts, specially if m_pFormatContext->flags includes
-            // AVFMT_FLAG_GENPTS so always use dts
+        if (profile.bNoPTS)
             pts = Packet::INVALID_TIME;
-        }
-
-        if (stream->codecpar->codec_id == AV_CODEC_ID_RV10 || stream->codecpar->codec_id == AV_CODEC_ID_RV20 ||
-            stream->codecpar->codec_id == AV_CODEC_ID_RV30 || stream->codecpar->codec_id == AV_CODEC_ID_RV40)
-        {
-            pts = Packet::INVALID_TIME;
-        }
-
-        // Never use DTS for these formats
-        if (!m_bAVI && (stream->codecpar->codec_id == AV_CODEC_ID_MPEG2VIDEO ||
-                        stream->codecpar->codec_id == AV_CODEC_ID_MPEG1VIDEO))
+        if (profile.bNoDTS)
             dts = Packet::INVALID_TIME;
 
         if (pkt.data)
@@ -1587,74 +1659,41 @@ STDMETHODIMP CLAVFDemuxer::GetNextPacket(Packet **ppPacket)
             rt = dts;
         }
 
-        if (stream->codecpar->codec_id == AV_CODEC_ID_VC1)
+        if (profile.timestamps == TimestampsVC1PTS)
         {
-            if (m_bMatroska && m_bVC1Correction)
-            {
-                rt = pts;
-                if (!m_bVC1SeenTimestamp)
-                {
-                    if (rt == Packet::INVALID_TIME && dts != Packet::INVALID_TIME)
-                        rt = dts;
-                    m_bVC1SeenTimestamp = (pts != Packet::INVALID_TIME);
-                }
-            }
-            else if (m_bVC1Correction)
+            rt = pts;
+            if (!m_bVC1SeenTimestamp)
             {
-                rt = dts;
-                pPacket->dwFlags |= LAV_PACKET_PARSED;
+                if (rt == Packet::INVALID_TIME && dts != Packet::INVALID_TIME)
+                    rt = dts;
+                m_bVC1SeenTimestamp = (pts != Packet::INVALID_TIME);
             }
         }
-        else if (stream->codecpar->codec_id == AV_CODEC_ID_MOV_TEXT)
+        else if (profile.timestamps == TimestampsVC1DTS)
         {
-            pPacket->dwFlags |= LAV_PACKET_MOV_TEXT;
-        }
-
-        // Mark the packet as parsed, so the forced subtitle parser doesn't hit it
-        if (stream->codecpar->codec_id == AV_CODEC_ID_HDMV_PGS_SUBTITLE && m_bPGSNoParsing)
-        {
-            pPacket->dwFlags |= LAV_PACKET_PARSED;
+            rt = dts;
         }
 
         pPacket->rtStart = pPacket->rtStop = rt;
         if (rt != Packet::INVALID_TIME)
         {
-            pPacket->rtStop += (duration > 0 || stream->codecpar->codec_id == AV_CODEC_ID_TRUEHD) ? duration : 1;
+            pPacket->rtStop += (duration > 0 || profile.bKeepZeroDuration) ? duration : 1;
         }
 
-        if (stream->codecpar->codec_type == AVMEDIA_TYPE_SUBTITLE)
+        // Update extradata and send new mediatype, when required
+        if (pkt.side_data_elems)
         {
-            pPacket->bDiscontinuity = TRUE;
-
-            if (forcedSubStream)
+            int sidedata_size = 0;
+            uint8_t *sidedata = av_packet_get_side_data(&pkt, AV_PKT_DATA_NEW_EXTRADATA, &sidedata_size);
+            int paramchange_size = 0;
+            uint8_t *paramchange = av_packet_get_side_data(&pkt, AV_PKT_DATA_PARAM_CHANGE, &paramchange_size);
+            if ((sidedata && sidedata_size) || (paramchange && paramchange_size))
             {
-                pPacket->dwFlags |= LAV_PACKET_FORCED_SUBTITLE;
-                pPacket->dwFlags &= ~LAV_PACKET_PARSED;
-            }
-
-            if (stream->codecpar->codec_id == AV_CODEC_ID_SRT)
-            {
-                pPacket->dwFlags |= LAV_PACKET_SRT;
+                CreatePacketMediaType(pPacket, stream->codecpar->codec_id, sidedata, sidedata_size, paramchange,
+                                      paramchange_size);
             }
         }
 
-        if (stream->codecpar->codec_id == AV_CODEC_ID_PCM_S16BE_PLANAR ||
-            stream->codecpar->codec_id == AV_CODEC_ID_PCM_S16LE_PLANAR ||
-            stream->codecpar->codec_id == AV_CODEC_ID_PCM_S24LE_PLANAR ||
-            stream->codecpar->codec_id == AV_CODEC_ID_PCM_S32LE_PLANAR)
-            pPacket->dwFlags |= LAV_PACKET_PLANAR_PCM;
-
-        // Update extradata and send new mediatype, when required
-        int sidedata_size = 0;
-        uint8_t *sidedata = av_packet_get_side_data(&pkt, AV_PKT_DATA_NEW_EXTRADATA, &sidedata_size);
-        int paramchange_size = 0;
-        uint8_t *paramchange = av_packet_get_side_data(&pkt, AV_PKT_DATA_PARAM_CHANGE, &paramchange_size);
-        if ((sidedata && sidedata_size) || (paramchange && paramchange_size))
-        {
-            CreatePacketMediaType(pPacket, stream->codecpar->codec_id, sidedata, sidedata_size, paramchange,
-                                  paramchange_size);
-        }
-
         pPacket->bSyncPoint = pkt.flags & AV_PKT_FLAG_KEY;
         pPacket->bDiscontinuity = !m_pBluRay && (pkt.flags & AV_PKT_FLAG_CORRUPT);
 #ifdef DEBUG
@@ -1809,8 +1848,17 @@ retry:
 
     int flags = AVSEEK_FLAG_BACKWARD;
 
+    m_bSeeking = TRUE;
     int ret = av_seek_frame(m_avFormat, seekStreamId, seek_pts, flags);
-    if (ret < 0)
+    m_bSeeking = FALSE;
+
+    // A newer seek request superseded this one, don't bother with the fallbacks
+    const BOOL bAborted = (ret < 0 && m_bAbortSeek);
+    if (bAborted)
+    {
+        DbgLog((LOG_TRACE, 10, L"::Seek() -- Seek was aborted"));
+    }
+    else if (ret < 0)
     {
         DbgLog((LOG_CUSTOM1, 1, L"::Seek() -- Key-Frame Seek failed"));
         ret = av_seek_frame(m_avFormat, seekStreamId, seek_pts, flags | AVSEEK_FLAG_ANY);
@@ -1842,7 +1890,7 @@ retry:
     // Flush MVC extensions on seek (no-op if empty)
     FlushMVCExtensionQueue();
 
-    return S_OK;
+    return bAborted ? S_FALSE : S_OK;
 }
 
 STDMETHODIMP CLAVFDemuxer::SeekByte(int64_t pos, int flags)
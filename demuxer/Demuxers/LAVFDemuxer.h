@@ -21,6 +21,7 @@
 
 #include <Qnetwork.h>
 #include <set>
+#include <vector>
 #include <algorithm>
 #include <sstream>
 
@@ -72,6 +73,7 @@ class CLAVFDemuxer
     STDMETHODIMP Open(LPCOLESTR pszFileName);
     STDMETHODIMP Start();
     STDMETHODIMP AbortOpening(int mode = 1, int timeout = 0);
+    STDMETHODIMP AbortSeek(BOOL bAbort);
     REFERENCE_TIME GetDuration() const;
     STDMETHODIMP GetNextPacket(Packet **ppPacket);
     STDMETHODIMP Seek(REFERENCE_TIME rTime);
@@ -183,6 +185,8 @@ class CLAVFDemuxer
     HRESULT CheckBDM2TSCPLI(LPCOLESTR pszFileName);
 
     HRESULT UpdateForcedSubtitleStream(unsigned audio_pid);
+    void InvalidateStreamProfiles();
+    void UpdateStreamProfiles();
 
     static int avio_interrupt_cb(void *opaque);
 
@@ -223,6 +227,28 @@ class CLAVFDemuxer
     int m_ForcedSubStream = -1;
     unsigned int m_program = 0;
 
+    // Packet handling of every stream, compiled from the stream selection and settings
+    // GetNextPacket only needs a lookup by stream index instead of comparing the codec for every packet
+    enum StreamTimestamps : BYTE
+    {
+        TimestampsDefault,    // PTS, or DTS if PTS is not set
+        TimestampsH264Native, // H264 in Matroska/Ogg, DTS only for Annex B packets
+        TimestampsVC1PTS,     // VC-1 in Matroska, PTS only after the first valid timestamp
+        TimestampsVC1DTS,     // VC-1 with timestamp correction, DTS only
+    };
+
+    struct StreamProfile
+    {
+        BOOL bActive = FALSE;
+        BOOL bNoPTS = FALSE;
+        BOOL bNoDTS = FALSE;
+        BOOL bKeepZeroDuration = FALSE; // TrueHD uses the duration as-is, even if zero
+        StreamTimestamps timestamps = TimestampsDefault;
+        DWORD dwFlags = 0;
+    };
+    std::vector<StreamProfile> m_StreamProfiles;
+    volatile LONG m_lStreamProfilesOutdated = FALSE;
+
     REFERENCE_TIME m_rtCurrent = 0;
 
     AVStreamParseType *m_stOrigParser = nullptr;
@@ -237,4 +263,7 @@ class CLAVFDemuxer
     int m_Abort = 0;
     time_t m_timeAbort = 0;
     time_t m_timeOpening = 0;
+
+    volatile BOOL m_bSeeking = FALSE;
+    volatile BOOL m_bAbortSeek = FALSE;
 };
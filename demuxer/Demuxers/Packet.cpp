@@ -20,19 +20,28 @@
 #include <stdafx.h>
 #include "Packet.h"
 
+thread_local volatile LONGLONG *Packet::s_pAllocations = nullptr;
+
 Packet::Packet()
 {
+    CountAllocation();
 }
 
 Packet::~Packet()
 {
     DeleteMediaType(pmt);
     av_packet_free(&m_Packet);
+    for (AVPacket *pkt : m_Segments)
+        av_packet_free(&pkt);
 }
 
 int Packet::SetDataSize(int len)
 {
-    if (len < 0)
+    if (len < 0 || Flatten() < 0)
+        return -1;
+
+    // Never resize a buffer that is shared with another packet
+    if (m_Packet && m_Packet->buf && !av_buffer_is_writable(m_Packet->buf) && av_packet_make_writable(m_Packet) < 0)
         return -1;
 
     if (len <= GetDataSize())
@@ -41,6 +50,7 @@ int Packet::SetDataSize(int len)
         return 0;
     }
 
+    CountAllocation();
     if (!m_Packet)
     {
         m_Packet = av_packet_alloc();
@@ -70,8 +80,9 @@ int Packet::SetData(const void *ptr, int len)
 
 int Packet::SetPacket(AVPacket *pkt)
 {
-    ASSERT(!m_Packet);
+    ASSERT(!m_Packet && m_Segments.empty());
 
+    CountAllocation();
     m_Packet = av_packet_alloc();
     if (!m_Packet)
         return -1;
@@ -79,13 +90,87 @@ int Packet::SetPacket(AVPacket *pkt)
     return av_packet_ref(m_Packet, pkt);
 }
 
+int Packet::AppendSegment(AVPacket *pkt, bool bPadded)
+{
+    CountAllocation();
+
+    // The first segment becomes our own data
+    if (!m_Packet)
+    {
+        m_Packet = pkt;
+        m_bUnpadded = !bPadded;
+        return 0;
+    }
+
+    m_Segments.push_back(pkt);
+    m_nSegmentsSize += pkt->size;
+    return 0;
+}
+
 int Packet::Append(Packet *ptr)
 {
-    return AppendData(ptr->GetData(), ptr->GetDataSize());
+    if (!ptr->m_Packet || ptr->GetDataSize() == 0)
+        return 0;
+
+    int ret = AppendSlice(ptr, 0, ptr->m_Packet->size);
+    for (size_t i = 0; i < ptr->m_Segments.size() && ret >= 0; i++)
+    {
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt)
+            return -1;
+
+        ret = av_packet_ref(pkt, ptr->m_Segments[i]);
+        if (ret < 0)
+        {
+            av_packet_free(&pkt);
+            return ret;
+        }
+        ret = AppendSegment(pkt, false);
+    }
+    return ret;
+}
+
+int Packet::AppendSlice(Packet *ptr, int offset, int len)
+{
+    if (!ptr->m_Packet || offset < 0 || len < 0 || offset + len > ptr->m_Packet->size)
+        return -1;
+
+    if (!ptr->m_Packet->buf)
+        return AppendData(ptr->m_Packet->data + offset, len);
+
+    AVPacket *pkt = av_packet_alloc();
+    if (!pkt)
+        return -1;
+
+    // Only the data is shared, properties and side data stay with the first segment
+    pkt->buf = av_buffer_ref(ptr->m_Packet->buf);
+    if (!pkt->buf)
+    {
+        av_packet_free(&pkt);
+        return -1;
+    }
+    pkt->data = ptr->m_Packet->data + offset;
+    pkt->size = len;
+
+    // Only a slice that reaches the end of the source keeps its padding
+    return AppendSegment(pkt, !ptr->m_bUnpadded && offset + len == ptr->m_Packet->size);
 }
 
 int Packet::AppendData(const void *ptr, int len)
 {
+    // With segments present, the data goes into a new segment, instead of growing (and copying) everything else
+    if (!m_Segments.empty())
+    {
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt || av_new_packet(pkt, len) < 0)
+        {
+            av_packet_free(&pkt);
+            return -1;
+        }
+        memcpy(pkt->data, ptr, len);
+        return AppendSegment(pkt, true);
+    }
+
     int prevSize = GetDataSize();
     int ret = SetDataSize(prevSize + len);
     if (ret < 0)
@@ -94,8 +179,106 @@ int Packet::AppendData(const void *ptr, int len)
     return 0;
 }
 
+void Packet::CopyData(BYTE *pDst) const
+{
+    if (!m_Packet)
+        return;
+
+    memcpy(pDst, m_Packet->data, m_Packet->size);
+    pDst += m_Packet->size;
+
+    for (const AVPacket *pkt : m_Segments)
+    {
+        memcpy(pDst, pkt->data, pkt->size);
+        pDst += pkt->size;
+    }
+}
+
+void Packet::CopyData(BYTE *pDst, int offset, int len) const
+{
+    for (int i = 0; i < GetNumSegments() && len > 0; i++)
+    {
+        const int size = GetSegmentSize(i);
+        if (offset >= size)
+        {
+            offset -= size;
+            continue;
+        }
+
+        const int count = min(size - offset, len);
+        memcpy(pDst, GetSegmentData(i) + offset, count);
+        pDst += count;
+        len -= count;
+        offset = 0;
+    }
+}
+
+int Packet::Flatten()
+{
+    if (!m_Packet || (m_Segments.empty() && !m_bUnpadded))
+        return 0;
+
+    const int prevSize = m_Packet->size;
+    const int size = GetDataSize();
+
+    CountAllocation();
+
+    // The first segment can only be grown in place if nobody else references its buffer
+    if (m_Packet->buf && av_buffer_is_writable(m_Packet->buf))
+    {
+        if (av_grow_packet(m_Packet, size - prevSize) < 0)
+            return -1;
+    }
+    else
+    {
+        AVPacket *pkt = av_packet_alloc();
+        if (!pkt || av_new_packet(pkt, size) < 0 || av_packet_copy_props(pkt, m_Packet) < 0)
+        {
+            av_packet_free(&pkt);
+            return -1;
+        }
+        memcpy(pkt->data, m_Packet->data, prevSize);
+        av_packet_free(&m_Packet);
+        m_Packet = pkt;
+    }
+
+    BYTE *pDst = m_Packet->data + prevSize;
+    for (AVPacket *pkt : m_Segments)
+    {
+        memcpy(pDst, pkt->data, pkt->size);
+        pDst += pkt->size;
+        av_packet_free(&pkt);
+    }
+    m_Segments.clear();
+    m_nSegmentsSize = 0;
+    m_bUnpadded = false;
+
+    return 0;
+}
+
 int Packet::RemoveHead(int count)
 {
+    if (count < 0 || count > GetDataSize())
+        return -1;
+    if (count == 0)
+        return 0;
+
+    // Drop the segments that are removed entirely, the properties and side data move on to the next one
+    while (!m_Segments.empty() && count >= m_Packet->size)
+    {
+        AVPacket *pkt = m_Segments.front();
+        if (av_packet_copy_props(pkt, m_Packet) < 0)
+            return -1;
+
+        count -= m_Packet->size;
+        av_packet_free(&m_Packet);
+        m_Packet = pkt;
+        m_Segments.erase(m_Segments.begin());
+        m_nSegmentsSize -= pkt->size;
+        // Whether the segment was followed by padding is not tracked
+        m_bUnpadded = true;
+    }
+
     m_Packet->data += count;
     m_Packet->size -= (int)count;
     return 0;
@@ -19,7 +19,13 @@
 
 #pragma once
 
+#include <vector>
+
 // Data Packet for queue storage
+//
+// Appending another packet only takes a reference to its data, which is kept as a separate segment.
+// The segments are merged into one buffer when the data is accessed through GetData(), or copied straight into
+// the destination with CopyData(), so that large frames assembled from many pieces are copied only once.
 class Packet
 {
   public:
@@ -28,8 +34,18 @@ class Packet
     Packet();
     ~Packet();
 
-    int GetDataSize() const { return m_Packet ? m_Packet->size : 0; }
-    BYTE *GetData() { return m_Packet ? m_Packet->data : nullptr; }
+    int GetDataSize() const { return m_Packet ? m_Packet->size + m_nSegmentsSize : 0; }
+    BYTE *GetData() { return (m_Packet && Flatten() >= 0) ? m_Packet->data : nullptr; }
+    // Copy the data of all segments to pDst, which needs to hold GetDataSize() bytes
+    void CopyData(BYTE *pDst) const;
+    // Copy len bytes at offset of the data of all segments to pDst
+    void CopyData(BYTE *pDst, int offset, int len) const;
+
+    // Direct access to the data segments, without merging them
+    // Only GetData() guarantees the zeroed AV_INPUT_BUFFER_PADDING_SIZE bytes after the data.
+    int GetNumSegments() const { return m_Packet ? 1 + (int)m_Segments.size() : 0; }
+    const BYTE *GetSegmentData(int index) const { return index ? m_Segments[index - 1]->data : m_Packet->data; }
+    int GetSegmentSize(int index) const { return index ? m_Segments[index - 1]->size : m_Packet->size; }
 
     int GetNumSideData() const { return m_Packet ? m_Packet->side_data_elems : 0; }
     AVPacketSideData *GetSideData() { return m_Packet ? m_Packet->side_data : nullptr; }
@@ -38,14 +54,20 @@ class Packet
     int SetData(const void *ptr, int len);
     int SetPacket(AVPacket *pkt);
 
-    // Append the data of the package to our data buffer
+    // Append the data of the package to our data buffer, by reference
     int Append(Packet *ptr);
+    // Append len bytes at offset of the packets data, by reference
+    int AppendSlice(Packet *ptr, int offset, int len);
     int AppendData(const void *ptr, int len);
     // Remove count bytes from position index
     int RemoveHead(int count);
 
     bool CopyProperties(const Packet *src);
 
+    // Count the packets and packet buffers allocated on the calling thread into pCounter, or stop with nullptr
+    // Every splitter registers its own counter on its threads, so the counts of several instances do not mix
+    static void SetThreadAllocationCounter(volatile LONGLONG *pCounter) { s_pAllocations = pCounter; }
+
   public:
     DWORD StreamId = 0;
     BOOL bDiscontinuity = FALSE;
@@ -69,5 +91,21 @@ class Packet
     DWORD dwFlags = 0;
 
   private:
+    static void CountAllocation()
+    {
+        if (s_pAllocations)
+            InterlockedIncrement64(s_pAllocations);
+    }
+    static thread_local volatile LONGLONG *s_pAllocations;
+
+    int AppendSegment(AVPacket *pkt, bool bPadded);
+    // Merge all segments into the first one, and restore its padding
+    int Flatten();
+
     AVPacket *m_Packet = nullptr;
+    // The first segment is a slice of a larger buffer, not followed by zeroed padding
+    bool m_bUnpadded = false;
+
+    std::vector<AVPacket *> m_Segments;
+    int m_nSegmentsSize = 0;
 };
@@ -0,0 +1,46 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "ProcessingCounter.h"
+
+// Packet count, data size and processing time of one stage of the splitter
+class CDemuxStats : public CProcessingCounter
+{
+  public:
+    void Reset()
+    {
+        CProcessingCounter::Reset();
+        InterlockedExchange64(&m_llBytes, 0);
+    }
+
+    // Adds one packet of nBytes and the time since llStart (obtained from Now())
+    void Add(LONGLONG llStart, int nBytes)
+    {
+        CProcessingCounter::Add(llStart);
+        InterlockedExchangeAdd64(&m_llBytes, nBytes);
+    }
+
+    ULONGLONG GetPackets() const { return GetCount(); }
+    ULONGLONG GetBytes() const { return (ULONGLONG)m_llBytes; }
+
+  private:
+    volatile LONGLONG m_llBytes = 0;
+};
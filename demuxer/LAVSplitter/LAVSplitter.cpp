@@ -750,12 +750,24 @@ DWORD CLAVSplitter::ThreadProc()
 
     m_pDemuxer->Start();
 
+    m_DemuxStats.Reset();
+    {
+        CAutoLock lock(&m_csParserStats);
+        for (ParserStats &parser : m_ParserStats)
+            parser.stats.Reset();
+    }
+    InterlockedExchange64(&m_llPacketAllocations, 0);
+    Packet::SetThreadAllocationCounter(&m_llPacketAllocations);
+
     m_fFlushing = false;
     m_eEndFlush.Set();
     for (DWORD cmd = (DWORD)-1;; cmd = GetRequest())
     {
         if (cmd == CMD_EXIT)
         {
+#ifdef DEBUG
+            LogDemuxStats();
+#endif
             Reply(S_OK);
             m_ePlaybackInit.Set();
             return 0;
@@ -768,15 +780,25 @@ DWORD CLAVSplitter::ThreadProc()
 
         if (m_bPlaybackStarted || m_rtStart != 0 || cmd == CMD_SEEK)
         {
-            HRESULT hr = S_FALSE;
-            if (m_pInput)
+            BOOL bSeekCommand = (cmd == CMD_SEEK);
+            HRESULT hr = S_OK;
+            do
             {
-                hr = m_pInput->SeekStream(m_rtStart);
-                if (SUCCEEDED(hr))
-                    m_pDemuxer->Reset();
-            }
-            if (hr != S_OK)
-                DemuxSeek(m_rtStart);
+                BeginSeek(bSeekCommand);
+
+                hr = S_FALSE;
+                if (m_pInput)
+                {
+                    hr = m_pInput->SeekStream(m_rtStart);
+                    if (SUCCEEDED(hr))
+                        m_pDemuxer->Reset();
+                }
+                if (hr != S_OK)
+                    hr = DemuxSeek(m_rtStart);
+
+                // a repeated seek always goes to the newest target
+                bSeekCommand = TRUE;
+            } while (EndSeek(hr));
         }
 
         if (cmd != (DWORD)-1)
@@ -799,6 +821,8 @@ DWORD CLAVSplitter::ThreadProc()
 
         m_bDiscontinuitySent.clear();
 
+        InitTrickPlay();
+
         m_bPlaybackStarted = TRUE;
         m_ePlaybackInit.Set();
 
@@ -806,6 +830,9 @@ DWORD CLAVSplitter::ThreadProc()
         while (SUCCEEDED(hr) && !CheckRequest(&cmd))
         {
             hr = DemuxNextPacket();
+
+            if (SUCCEEDED(hr) && m_rtTrickPlaySeek != AV_NOPTS_VALUE)
+                DemuxTrickPlaySeek();
         }
 
         // If we didnt exit by request, deliver end-of-stream
@@ -840,6 +867,7 @@ HRESULT CLAVSplitter::DemuxNextPacket()
 {
     Packet *pPacket;
     HRESULT hr = S_OK;
+    const LONGLONG llStart = CDemuxStats::Now();
     hr = m_pDemuxer->GetNextPacket(&pPacket);
     // Only S_OK indicates we have a proper packet
     // S_FALSE is a "soft error", don't deliver the packet
@@ -847,6 +875,7 @@ HRESULT CLAVSplitter::DemuxNextPacket()
     {
         return hr;
     }
+    m_DemuxStats.Add(llStart, pPacket->GetDataSize());
     return DeliverPacket(pPacket);
 }
 
@@ -864,6 +893,22 @@ HRESULT CLAVSplitter::DeliverPacket(Packet *pPacket)
         return S_FALSE;
     }
 
+    // In trick-play, only the video pins remain active, and they only receive keyframes spaced far enough apart
+    // Timestamps before the last keyframe can only be a discontinuity, and are accepted
+    REFERENCE_TIME rtTrickPlayKeyFrame = Packet::INVALID_TIME;
+    if (m_bTrickPlay && pPin->IsVideoPin())
+    {
+        if (!pPacket->bSyncPoint || pPacket->rtStart == Packet::INVALID_TIME ||
+            (m_rtTrickPlayLast != AV_NOPTS_VALUE && pPacket->rtStart >= m_rtTrickPlayLast &&
+             pPacket->rtStart < TrickPlayNextKeyFrame()))
+        {
+            delete pPacket;
+            return S_FALSE;
+        }
+
+        rtTrickPlayKeyFrame = m_rtTrickPlayLast = pPacket->rtStart;
+    }
+
     if (pPacket->rtStart != Packet::INVALID_TIME)
     {
         m_rtCurrent = pPacket->rtStop;
@@ -943,6 +988,186 @@ HRESULT CLAVSplitter::DeliverPacket(Packet *pPacket)
         m_bDiscontinuitySent.insert(streamId);
     }
 
+    if (rtTrickPlayKeyFrame != Packet::INVALID_TIME)
+        TrickPlaySeek(rtTrickPlayKeyFrame);
+
+    return hr;
+}
+
+// Get the sorted keyframe timestamps of the video stream, if the demuxer has a reliable index
+HRESULT CLAVSplitter::GetKeyFrameIndex(std::vector<REFERENCE_TIME> &keyFrames)
+{
+    keyFrames.clear();
+
+    IKeyFrameInfo *pKFI = nullptr;
+    HRESULT hr = m_pDemuxer->QueryInterface(__uuidof(IKeyFrameInfo), (void **)&pKFI);
+    if (FAILED(hr))
+        return hr;
+
+    UINT nKFs = 0;
+    hr = pKFI->GetKeyFrameCount(nKFs);
+    if (hr == S_OK && nKFs > 0)
+    {
+        keyFrames.resize(nKFs);
+        hr = pKFI->GetKeyFrames(&TIME_FORMAT_MEDIA_TIME, keyFrames.data(), nKFs);
+        if (hr == S_OK)
+        {
+            keyFrames.resize(nKFs);
+            std::sort(keyFrames.begin(), keyFrames.end());
+        }
+        else
+            keyFrames.clear();
+    }
+    SafeRelease(&pKFI);
+
+    return keyFrames.empty() ? S_FALSE : S_OK;
+}
+
+// Find the keyframe closest to rt, or rt itself if there is no keyframe index
+REFERENCE_TIME CLAVSplitter::GetNearestKeyFrame(REFERENCE_TIME rt)
+{
+    std::vector<REFERENCE_TIME> keyFrames;
+    if (GetKeyFrameIndex(keyFrames) != S_OK)
+        return rt;
+
+    auto it = std::upper_bound(keyFrames.begin(), keyFrames.end(), rt);
+    if (it == keyFrames.begin())
+        return *it;
+    if (it == keyFrames.end() || rt - *(it - 1) <= *it - rt)
+        return *(it - 1);
+    return *it;
+}
+
+// Prepare a seek in the demux thread
+// A seek command goes to the target of the newest absolute seek request, if it was not picked up yet. This collapses
+// all requests that came in since the last seek into one.
+void CLAVSplitter::BeginSeek(BOOL bSeekCommand)
+{
+    BOOL bSeekToKeyFrame = FALSE;
+    {
+        CAutoLock lock(&m_csSeek);
+        if (bSeekCommand && m_lSeekTicketDone != m_lSeekTicket)
+        {
+            if (m_rtPendingSeek != m_rtNewStart)
+                DbgLog((LOG_TRACE, 20, " -> Collapsing into the newest seek request to %I64d", m_rtPendingSeek));
+            m_rtNewStart = m_rtCurrent = m_rtPendingSeek;
+            m_bNewSeekToKeyFrame = m_bPendingSeekToKeyFrame;
+            m_lSeekTicketDone = m_lSeekTicket;
+        }
+
+        m_rtStart = m_rtNewStart;
+        m_rtSeekInProgress = m_rtNewStart;
+        m_bSeekInProgress = TRUE;
+        bSeekToKeyFrame = bSeekCommand && m_bNewSeekToKeyFrame;
+    }
+
+    // Scrubbing only asks for the nearest keyframe, which can be shown without decoding up to the target
+    if (bSeekToKeyFrame)
+    {
+        m_rtStart = m_rtNewStart = m_rtCurrent = GetNearestKeyFrame(m_rtStart);
+        DbgLog((LOG_TRACE, 20, " -> Seeking to the nearest keyframe at %I64d", m_rtStart));
+    }
+}
+
+// Finish a seek in the demux thread
+// Returns TRUE if the seek was aborted by a newer request, and has to be repeated with its target
+BOOL CLAVSplitter::EndSeek(HRESULT hrSeek)
+{
+    CAutoLock lock(&m_csSeek);
+    m_bSeekInProgress = FALSE;
+    m_pDemuxer->AbortSeek(FALSE);
+
+    if (hrSeek == S_FALSE && m_lSeekTicketDone != m_lSeekTicket)
+    {
+        DbgLog((LOG_TRACE, 20, " -> Seek was aborted, repeating it with the newest target"));
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+// Setup trick-play for the new segment
+// At high rates, decoding every frame is wasted effort, so only video keyframes are delivered, and the demuxer
+// seeks ahead to the next keyframe that is due, if the keyframe index is available.
+void CLAVSplitter::InitTrickPlay()
+{
+    m_bTrickPlay = FALSE;
+    m_rtTrickPlayLast = AV_NOPTS_VALUE;
+    m_rtTrickPlaySeek = AV_NOPTS_VALUE;
+    m_TrickPlayKeyFrames.clear();
+
+    if (m_dRate < TRICKPLAY_MIN_RATE)
+        return;
+
+    auto isVideoPin = [](CLAVOutputPin *pPin) { return pPin->IsVideoPin(); };
+    if (std::none_of(m_pActivePins.begin(), m_pActivePins.end(), isVideoPin))
+        return;
+
+    DbgLog((LOG_TRACE, 10, L"::InitTrickPlay(): Delivering keyframes only at rate %.2f", m_dRate));
+    m_bTrickPlay = TRUE;
+
+    // Audio and subtitles are not played at these rates, end their streams right away
+    for (auto it = m_pActivePins.begin(); it != m_pActivePins.end();)
+    {
+        if (!(*it)->IsVideoPin())
+        {
+            (*it)->QueueEndOfStream();
+            it = m_pActivePins.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    GetKeyFrameIndex(m_TrickPlayKeyFrames);
+    DbgLog((LOG_TRACE, 10, L" -> Keyframe index with %u entries", (unsigned)m_TrickPlayKeyFrames.size()));
+}
+
+// Schedule the skip to the next keyframe due in trick-play, after the keyframe at rtKeyFrame was delivered
+// The seek itself is performed by the demux loop, see DemuxTrickPlaySeek. Returns S_FALSE if reading on is cheaper
+// than seeking.
+HRESULT CLAVSplitter::TrickPlaySeek(REFERENCE_TIME rtKeyFrame)
+{
+    if (m_TrickPlayKeyFrames.empty())
+        return S_FALSE;
+
+    auto itFollowing = std::upper_bound(m_TrickPlayKeyFrames.begin(), m_TrickPlayKeyFrames.end(), rtKeyFrame);
+    auto itTarget = std::lower_bound(itFollowing, m_TrickPlayKeyFrames.end(), TrickPlayNextKeyFrame());
+
+    // Either no keyframe is left, or the next one is also the one due
+    if (itTarget == m_TrickPlayKeyFrames.end() || itTarget == itFollowing)
+        return S_FALSE;
+
+    // Aim between the target keyframe and the one after it, so that the backwards seek lands exactly on the
+    // target, even if the timestamp conversion rounds down
+    REFERENCE_TIME rtSeek = *itTarget;
+    if (itTarget + 1 != m_TrickPlayKeyFrames.end())
+        rtSeek += (*(itTarget + 1) - *itTarget) / 2;
+
+    m_rtTrickPlaySeek = rtSeek;
+    return S_OK;
+}
+
+// Perform the seek scheduled by trick-play in the demux thread
+// It is published like a seek command, so that a seek request coming in meanwhile aborts it, and it is skipped if
+// such a request is already pending, since that one replaces the position anyway.
+HRESULT CLAVSplitter::DemuxTrickPlaySeek()
+{
+    const REFERENCE_TIME rtSeek = m_rtTrickPlaySeek;
+    m_rtTrickPlaySeek = AV_NOPTS_VALUE;
+
+    {
+        CAutoLock lock(&m_csSeek);
+        if (m_lSeekTicketDone != m_lSeekTicket)
+            return S_FALSE;
+
+        m_rtSeekInProgress = rtSeek;
+        m_bSeekInProgress = TRUE;
+    }
+
+    HRESULT hr = DemuxSeek(rtSeek);
+
+    // an aborted seek is followed by the seek command of the request that aborted it
+    EndSeek(hr);
     return hr;
 }
 
@@ -1156,8 +1381,41 @@ STDMETHODIMP CLAVSplitter::SetPositionsInternal(void *caller, LONGLONG *pCurrent
             "::SetPositions() - seek request; caller: %p, current: %I64d; start: %I64d; flags: 0x%x, stop: %I64d; "
             "flags: 0x%x",
             caller, m_rtCurrent, pCurrent ? *pCurrent : -1, dwCurrentFlags, pStop ? *pStop : -1, dwStopFlags));
+
+    // An absolute seek supersedes any seek still in progress. Its target is published before waiting for the filter
+    // lock, so the demux thread can go there directly, and a running seek to a different target is aborted.
+    const BOOL bAbsoluteSeek =
+        pCurrent && (dwCurrentFlags & AM_SEEKING_PositioningBitsMask) == AM_SEEKING_AbsolutePositioning &&
+        (!pStop || (dwStopFlags & AM_SEEKING_PositioningBitsMask) == AM_SEEKING_NoPositioning);
+    LONG lSeekTicket = 0;
+    if (bAbsoluteSeek)
+    {
+        CAutoLock lock(&m_csSeek);
+        lSeekTicket = ++m_lSeekTicket;
+        m_rtPendingSeek = *pCurrent;
+        m_bPendingSeekToKeyFrame = (dwCurrentFlags & AM_SEEKING_SeekToKeyFrame) ? TRUE : FALSE;
+        if (m_bSeekInProgress && m_rtSeekInProgress != m_rtPendingSeek)
+            m_pDemuxer->AbortSeek(TRUE);
+    }
+
     CAutoLock cAutoLock(this);
 
+    HRESULT hr = SetPositionsLocked(caller, pCurrent, dwCurrentFlags, pStop, dwStopFlags, lSeekTicket);
+
+    // The newest request is handled now, its target must not be picked up by any later seek
+    if (bAbsoluteSeek)
+    {
+        CAutoLock lock(&m_csSeek);
+        if (lSeekTicket == m_lSeekTicket)
+            m_lSeekTicketDone = lSeekTicket;
+    }
+
+    return hr;
+}
+
+STDMETHODIMP CLAVSplitter::SetPositionsLocked(void *caller, LONGLONG *pCurrent, DWORD dwCurrentFlags, LONGLONG *pStop,
+                                              DWORD dwStopFlags, LONG lSeekTicket)
+{
     if (!pCurrent && !pStop || (dwCurrentFlags & AM_SEEKING_PositioningBitsMask) == AM_SEEKING_NoPositioning &&
                                    (dwStopFlags & AM_SEEKING_PositioningBitsMask) == AM_SEEKING_NoPositioning)
     {
@@ -1198,6 +1456,32 @@ STDMETHODIMP CLAVSplitter::SetPositionsInternal(void *caller, LONGLONG *pCurrent
         }
     }
 
+    if (lSeekTicket)
+    {
+        CAutoLock lock(&m_csSeek);
+
+        // Another request came in while this one was waiting for the lock, only the latest target matters
+        if (lSeekTicket != m_lSeekTicket)
+        {
+            DbgLog((LOG_TRACE, 20, " -> Superseded by a newer seek request"));
+            return S_OK;
+        }
+
+        // The demux thread already went to this target while serving an earlier request
+        if (lSeekTicket == m_lSeekTicketDone)
+        {
+            DbgLog((LOG_TRACE, 20, " -> Target was already reached by an earlier seek request"));
+            m_rtLastStart = rtCurrent;
+            m_rtLastStop = rtStop;
+            m_LastSeekers.clear();
+            m_LastSeekers.insert(caller);
+
+            if (dwCurrentFlags & AM_SEEKING_ReturnTime)
+                *pCurrent = m_rtNewStart;
+            return S_OK;
+        }
+    }
+
     if (m_rtCurrent == rtCurrent && m_rtStop == rtStop)
     {
         return S_OK;
@@ -1216,6 +1500,7 @@ STDMETHODIMP CLAVSplitter::SetPositionsInternal(void *caller, LONGLONG *pCurrent
 
     m_rtNewStart = m_rtCurrent = rtCurrent;
     m_rtNewStop = rtStop;
+    m_bNewSeekToKeyFrame = pCurrent && (dwCurrentFlags & AM_SEEKING_SeekToKeyFrame);
 
     DbgLog((LOG_TRACE, 20, " -> Performing seek to %I64d", m_rtNewStart));
     if (ThreadExists())
@@ -1224,8 +1509,13 @@ STDMETHODIMP CLAVSplitter::SetPositionsInternal(void *caller, LONGLONG *pCurrent
         CallWorker(CMD_SEEK);
         DeliverEndFlush();
     }
+    m_bNewSeekToKeyFrame = FALSE;
     DbgLog((LOG_TRACE, 20, " -> Seek finished", m_rtNewStart));
 
+    // The keyframe seek may have moved the start position
+    if (pCurrent && (dwCurrentFlags & AM_SEEKING_ReturnTime))
+        *pCurrent = m_rtNewStart;
+
     return S_OK;
 }
 STDMETHODIMP CLAVSplitter::GetPositions(LONGLONG *pCurrent, LONGLONG *pStop)
@@ -1244,7 +1534,29 @@ STDMETHODIMP CLAVSplitter::GetAvailable(LONGLONG *pEarliest, LONGLONG *pLatest)
 }
 STDMETHODIMP CLAVSplitter::SetRate(double dRate)
 {
-    return dRate > 0 ? m_dRate = dRate, S_OK : E_INVALIDARG;
+    if (dRate <= 0)
+        return E_INVALIDARG;
+
+    CAutoLock cAutoLock(this);
+
+    // every output pin forwards the call
+    if (dRate == m_dRate)
+        return S_OK;
+
+    // The new segment carries the rate, and trick-play depends on it, so demuxing restarts at the current position
+    DbgLog((LOG_TRACE, 10, L"::SetRate(): Changing the rate from %.2f to %.2f", m_dRate, dRate));
+    if (ThreadExists())
+    {
+        DeliverBeginFlush();
+        m_dRate = dRate;
+        m_rtNewStart = m_rtCurrent;
+        CallWorker(CMD_SEEK);
+        DeliverEndFlush();
+    }
+    else
+        m_dRate = dRate;
+
+    return S_OK;
 }
 STDMETHODIMP CLAVSplitter::GetRate(double *pdRate)
 {
@@ -2116,6 +2428,78 @@ STDMETHODIMP_(DWORD) CLAVSplitter::GetMaxQueueSize()
     return m_settings.QueueMaxPackets;
 }
 
+STDMETHODIMP CLAVSplitter::GetDemuxStats(int iCodec, GUID *pSubtype, ULONGLONG *pPackets, ULONGLONG *pBytes,
+                                         REFERENCE_TIME *prtTime)
+{
+    CAutoLock lock(&m_csParserStats);
+
+    const CDemuxStats *pStats = &m_DemuxStats;
+    GUID subtype = GUID_NULL;
+    if (iCodec >= 0)
+    {
+        if ((size_t)iCodec >= m_ParserStats.size())
+            return S_FALSE;
+        const ParserStats &parser = *std::next(m_ParserStats.begin(), iCodec);
+        pStats = &parser.stats;
+        subtype = parser.subtype;
+    }
+
+    if (pSubtype)
+        *pSubtype = subtype;
+    if (pPackets)
+        *pPackets = pStats->GetPackets();
+    if (pBytes)
+        *pBytes = pStats->GetBytes();
+    if (prtTime)
+        *prtTime = pStats->GetTime();
+    return S_OK;
+}
+
+// Get the statistics of the parser for a media subtype, they are created on first use
+CDemuxStats *CLAVSplitter::GetParserStats(REFGUID subtype)
+{
+    CAutoLock lock(&m_csParserStats);
+    for (ParserStats &parser : m_ParserStats)
+    {
+        if (parser.subtype == subtype)
+            return &parser.stats;
+    }
+
+    m_ParserStats.emplace_back();
+    m_ParserStats.back().subtype = subtype;
+    return &m_ParserStats.back().stats;
+}
+
+STDMETHODIMP CLAVSplitter::GetPacketAllocations(ULONGLONG *pAllocations)
+{
+    CheckPointer(pAllocations, E_POINTER);
+    *pAllocations = (ULONGLONG)m_llPacketAllocations;
+    return S_OK;
+}
+
+#ifdef DEBUG
+void CLAVSplitter::LogDemuxStats()
+{
+    const ULONGLONG packets = m_DemuxStats.GetPackets();
+    const REFERENCE_TIME rtTime = m_DemuxStats.GetTime();
+    if (!packets || !rtTime)
+        return;
+
+    DbgLog((LOG_TRACE, 10, L"CLAVSplitter: Demuxed %I64u packets, %.0f packets/s, %.1f MB/s, %.2f allocations/packet",
+            packets, packets * 10000000.0 / rtTime, m_DemuxStats.GetBytes() * 10.0 / rtTime,
+            (double)m_llPacketAllocations / packets));
+
+    CAutoLock lock(&m_csParserStats);
+    for (const ParserStats &parser : m_ParserStats)
+    {
+        const CDemuxStats &stats = parser.stats;
+        if (stats.GetPackets())
+            DbgLog((LOG_TRACE, 10, L" -> Parser for %08lx: %I64u packets, %.3f ms/packet", parser.subtype.Data1,
+                    stats.GetPackets(), stats.GetTime() / 10000.0 / stats.GetPackets()));
+    }
+}
+#endif
+
 STDMETHODIMP_(std::set<FormatInfo> &) CLAVSplitter::GetInputFormats()
 {
     return m_InputFormats;
@@ -38,6 +38,7 @@
 #include "ISpecifyPropertyPages2.h"
 
 #include "LAVSplitterTrayIcon.h"
+#include "DemuxStats.h"
 
 #define LAVF_REGISTRY_KEY L"Software\\LAV\\Splitter"
 #define LAVF_REGISTRY_KEY_FORMATS LAVF_REGISTRY_KEY L"\\Formats"
@@ -45,6 +46,11 @@
 
 #define MAX_PTS_SHIFT 50000000i64
 
+// Playback rates at or above this only deliver video keyframes (trick-play)
+#define TRICKPLAY_MIN_RATE 4.0
+// Minimum distance between two trick-play keyframes in output time (100ms)
+#define TRICKPLAY_MIN_INTERVAL 1000000i64
+
 class CLAVOutputPin;
 class CLAVInputPin;
 
@@ -174,6 +180,9 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     STDMETHODIMP_(DWORD) GetNetworkStreamAnalysisDuration();
     STDMETHODIMP SetMaxQueueSize(DWORD dwMaxSize);
     STDMETHODIMP_(DWORD) GetMaxQueueSize();
+    STDMETHODIMP GetDemuxStats(int iCodec, GUID *pSubtype, ULONGLONG *pPackets, ULONGLONG *pBytes,
+                               REFERENCE_TIME *prtTime);
+    STDMETHODIMP GetPacketAllocations(ULONGLONG *pAllocations);
 
     // ILAVSplitterSettingsInternal
     STDMETHODIMP_(LPCSTR) GetInputFormat()
@@ -227,6 +236,8 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
 
     bool IsAnyPinDrying();
     void SetFakeASFReader(BOOL bFlag) { m_bFakeASFReader = bFlag; }
+    volatile LONGLONG *GetPacketAllocationCounter() { return &m_llPacketAllocations; }
+    CDemuxStats *GetParserStats(REFGUID subtype);
 
   protected:
     // CAMThread
@@ -239,8 +250,25 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
 
     HRESULT DemuxSeek(REFERENCE_TIME rtStart);
     HRESULT DemuxNextPacket();
+#ifdef DEBUG
+    void LogDemuxStats();
+#endif
     HRESULT DeliverPacket(Packet *pPacket);
 
+    HRESULT GetKeyFrameIndex(std::vector<REFERENCE_TIME> &keyFrames);
+    REFERENCE_TIME GetNearestKeyFrame(REFERENCE_TIME rt);
+
+    void BeginSeek(BOOL bSeekCommand);
+    BOOL EndSeek(HRESULT hrSeek);
+
+    void InitTrickPlay();
+    HRESULT TrickPlaySeek(REFERENCE_TIME rtKeyFrame);
+    HRESULT DemuxTrickPlaySeek();
+    REFERENCE_TIME TrickPlayNextKeyFrame() const
+    {
+        return m_rtTrickPlayLast + (REFERENCE_TIME)(TRICKPLAY_MIN_INTERVAL * m_dRate);
+    }
+
     void DeliverBeginFlush();
     void DeliverEndFlush();
 
@@ -252,6 +280,8 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     friend class CLAVOutputPin;
     STDMETHODIMP SetPositionsInternal(void *caller, LONGLONG *pCurrent, DWORD dwCurrentFlags, LONGLONG *pStop,
                                       DWORD dwStopFlags);
+    STDMETHODIMP SetPositionsLocked(void *caller, LONGLONG *pCurrent, DWORD dwCurrentFlags, LONGLONG *pStop,
+                                    DWORD dwStopFlags, LONG lSeekTicket);
 
   public:
     CLAVOutputPin *GetOutputPin(DWORD streamId, BOOL bActiveOnly = FALSE);
@@ -301,9 +331,42 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     REFERENCE_TIME m_rtLastStart = _I64_MIN;
     REFERENCE_TIME m_rtLastStop = _I64_MIN;
     std::set<void *> m_LastSeekers;
+    BOOL m_bNewSeekToKeyFrame = FALSE;
+
+    // Seek coalescing
+    // Every absolute seek takes a ticket and publishes its target before waiting for the filter lock. The demux thread
+    // always seeks to the newest published target, and repeats a seek that was aborted by a newer request. Requests
+    // that were overtaken while waiting, or whose target was already reached that way, return right away.
+    CCritSec m_csSeek;
+    LONG m_lSeekTicket = 0;                  // ticket of the newest request
+    LONG m_lSeekTicketDone = 0;              // ticket of the newest request whose target was picked up
+    REFERENCE_TIME m_rtPendingSeek = 0;      // target of the newest request
+    BOOL m_bPendingSeekToKeyFrame = FALSE;   // keyframe mode of the newest request
+    BOOL m_bSeekInProgress = FALSE;          // the demux thread is seeking
+    REFERENCE_TIME m_rtSeekInProgress = 0;   // target of the seek in progress
+
+    // Trick-play
+    BOOL m_bTrickPlay = FALSE;
+    REFERENCE_TIME m_rtTrickPlayLast = AV_NOPTS_VALUE;
+    REFERENCE_TIME m_rtTrickPlaySeek = AV_NOPTS_VALUE; // target of the scheduled keyframe seek
+    std::vector<REFERENCE_TIME> m_TrickPlayKeyFrames;
 
     CAMEvent m_ePlaybackInit{TRUE};
 
+    CDemuxStats m_DemuxStats;
+
+    // Statistics of the stream parsers, for every media subtype
+    // Entries are only reset and never removed, so the pins can keep pointers to them
+    struct ParserStats
+    {
+        GUID subtype;
+        CDemuxStats stats;
+    };
+    CCritSec m_csParserStats;
+    std::list<ParserStats> m_ParserStats;
+    // Packet allocations on the demux and output pin threads, see Packet::SetThreadAllocationCounter
+    volatile LONGLONG m_llPacketAllocations = 0;
+
     // flushing
     bool m_fFlushing = FALSE;
     CAMEvent m_eEndFlush;
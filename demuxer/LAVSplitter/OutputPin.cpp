@@ -389,7 +389,22 @@ HRESULT CLAVOutputPin::QueuePacket(Packet *pPacket)
         }
     }
 
-    m_Parser.Parse(m_StreamMT.subtype, pPacket);
+    if (pPacket)
+    {
+        // the statistics are kept per codec, which can change with a new media type
+        if (!m_pParserStats || m_ParserStatsSubtype != m_StreamMT.subtype)
+        {
+            m_ParserStatsSubtype = m_StreamMT.subtype;
+            m_pParserStats = pSplitter->GetParserStats(m_ParserStatsSubtype);
+        }
+
+        const int nBytes = pPacket->GetDataSize();
+        const LONGLONG llStart = CDemuxStats::Now();
+        m_Parser.Parse(m_StreamMT.subtype, pPacket);
+        m_pParserStats->Add(llStart, nBytes);
+    }
+    else
+        m_Parser.Parse(m_StreamMT.subtype, pPacket);
 
     return m_hrDeliver;
 }
@@ -406,6 +421,9 @@ DWORD CLAVOutputPin::ThreadProc()
     std::string name = "CLAVOutputPin " + std::string(CBaseDemuxer::CStreamList::ToString(m_pinType));
     SetThreadName(-1, name.c_str());
 
+    // Packets are merged for delivery on this thread
+    Packet::SetThreadAllocationCounter(static_cast<CLAVSplitter *>(m_pFilter)->GetPacketAllocationCounter());
+
     m_hrDeliver = S_OK;
     m_fFlushing = m_fFlushed = false;
     m_eEndFlush.Set();
@@ -526,7 +544,7 @@ HRESULT CLAVOutputPin::DeliverPacket(Packet *pPacket)
         if (FAILED(hr = pSample->GetPointer(&pData)) || !pData)
             goto done;
 
-        memcpy(pData, pPacket->GetData(), nBytes);
+        pPacket->CopyData(pData);
     }
 
     if (pPacket->pmt)
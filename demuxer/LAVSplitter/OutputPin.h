@@ -188,6 +188,8 @@ class CLAVOutputPin
     CBaseDemuxer::StreamType m_pinType;
 
     CStreamParser m_Parser;
+    CDemuxStats *m_pParserStats = nullptr; // statistics of the parser for m_ParserStatsSubtype, owned by the splitter
+    GUID m_ParserStatsSubtype = GUID_NULL;
     BOOL m_bPacketAllocator = FALSE;
 
     // IBitRateInfo
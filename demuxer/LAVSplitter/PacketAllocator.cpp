@@ -92,6 +92,7 @@ STDMETHODIMP CMediaPacketSample::SetPacket(Packet *pPacket)
 {
     SAFE_DELETE(m_pPacket);
     m_pPacket = pPacket;
+    // The decoder needs contiguous, padded data, this is the only place segmented packets are merged
     SetPointer(pPacket->GetData(), (LONG)pPacket->GetDataSize());
 
     SAFE_DELETE(m_pSideData);
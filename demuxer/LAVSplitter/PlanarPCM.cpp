@@ -0,0 +1,277 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "PlanarPCM.h"
+
+#include <emmintrin.h>
+
+template <int nBytes, int nChannels>
+static void interleave_pcm_c(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nStart, size_t nSamples)
+{
+    dst += nStart * nBytes * nChannels;
+    for (size_t i = nStart; i < nSamples; i++)
+    {
+        for (int c = 0; c < nChannels; c++)
+        {
+            memcpy(dst, src + c * nPlaneSize + i * nBytes, nBytes);
+            dst += nBytes;
+        }
+    }
+}
+
+template <int nBytes, int nChannels>
+static void interleave_pcm(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples)
+{
+    interleave_pcm_c<nBytes, nChannels>(dst, src, nPlaneSize, 0, nSamples);
+}
+
+void interleave_pcm_generic(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples, int nBytes,
+                            int nChannels)
+{
+    for (size_t i = 0; i < nSamples; i++)
+    {
+        for (int c = 0; c < nChannels; c++)
+        {
+            memcpy(dst, src + c * nPlaneSize + i * nBytes, nBytes);
+            dst += nBytes;
+        }
+    }
+}
+
+// Interleave three vectors of 32-bit elements: a0 b0 c0 a1 | b1 c1 a2 b2 | c2 a3 b3 c3
+static __forceinline void store_interleave_3x32(__m128i *dst, __m128i a, __m128i b, __m128i c)
+{
+    const __m128 fa = _mm_castsi128_ps(a), fb = _mm_castsi128_ps(b), fc = _mm_castsi128_ps(c);
+    const __m128 ab_lo = _mm_unpacklo_ps(fa, fb), ab_hi = _mm_unpackhi_ps(fa, fb);
+    const __m128 ca = _mm_shuffle_ps(fc, fa, _MM_SHUFFLE(1, 1, 0, 0));
+    const __m128 bc = _mm_shuffle_ps(fb, fc, _MM_SHUFFLE(1, 1, 1, 1));
+    const __m128 cab = _mm_shuffle_ps(fc, ab_hi, _MM_SHUFFLE(3, 2, 3, 2));
+    _mm_storeu_si128(dst + 0, _mm_castps_si128(_mm_shuffle_ps(ab_lo, ca, _MM_SHUFFLE(2, 0, 1, 0))));
+    _mm_storeu_si128(dst + 1, _mm_castps_si128(_mm_shuffle_ps(bc, ab_hi, _MM_SHUFFLE(1, 0, 2, 0))));
+    _mm_storeu_si128(dst + 2, _mm_castps_si128(_mm_shuffle_ps(cab, cab, _MM_SHUFFLE(1, 3, 2, 0))));
+}
+
+// Interleave three vectors of 64-bit elements: a0 b0 | c0 a1 | b1 c1
+static __forceinline void interleave_3x64(__m128i *out, __m128i a, __m128i b, __m128i c)
+{
+    out[0] = _mm_unpacklo_epi64(a, b);
+    out[1] = _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(c), _mm_castsi128_pd(a), 2));
+    out[2] = _mm_unpackhi_epi64(b, c);
+}
+
+// Interleave 4 samples of every channel, held as 32-bit elements, into nChannels vectors
+template <int nChannels> static __forceinline void interleave_4x32(const __m128i *in, __m128i *out)
+{
+    if (nChannels == 2)
+    {
+        out[0] = _mm_unpacklo_epi32(in[0], in[1]);
+        out[1] = _mm_unpackhi_epi32(in[0], in[1]);
+    }
+    else if (nChannels == 4)
+    {
+        const __m128i ab0 = _mm_unpacklo_epi32(in[0], in[1]), ab1 = _mm_unpackhi_epi32(in[0], in[1]);
+        const __m128i cd0 = _mm_unpacklo_epi32(in[2], in[3]), cd1 = _mm_unpackhi_epi32(in[2], in[3]);
+        out[0] = _mm_unpacklo_epi64(ab0, cd0);
+        out[1] = _mm_unpackhi_epi64(ab0, cd0);
+        out[2] = _mm_unpacklo_epi64(ab1, cd1);
+        out[3] = _mm_unpackhi_epi64(ab1, cd1);
+    }
+    else if (nChannels == 6)
+    {
+        // channel pairs as 64-bit elements, interleaved three-way
+        const __m128i ab0 = _mm_unpacklo_epi32(in[0], in[1]), ab1 = _mm_unpackhi_epi32(in[0], in[1]);
+        const __m128i cd0 = _mm_unpacklo_epi32(in[2], in[3]), cd1 = _mm_unpackhi_epi32(in[2], in[3]);
+        const __m128i ef0 = _mm_unpacklo_epi32(in[4], in[5]), ef1 = _mm_unpackhi_epi32(in[4], in[5]);
+        interleave_3x64(out + 0, ab0, cd0, ef0);
+        interleave_3x64(out + 3, ab1, cd1, ef1);
+    }
+    else if (nChannels == 8)
+    {
+        const __m128i ab0 = _mm_unpacklo_epi32(in[0], in[1]), ab1 = _mm_unpackhi_epi32(in[0], in[1]);
+        const __m128i cd0 = _mm_unpacklo_epi32(in[2], in[3]), cd1 = _mm_unpackhi_epi32(in[2], in[3]);
+        const __m128i ef0 = _mm_unpacklo_epi32(in[4], in[5]), ef1 = _mm_unpackhi_epi32(in[4], in[5]);
+        const __m128i gh0 = _mm_unpacklo_epi32(in[6], in[7]), gh1 = _mm_unpackhi_epi32(in[6], in[7]);
+        out[0] = _mm_unpacklo_epi64(ab0, cd0);
+        out[1] = _mm_unpacklo_epi64(ef0, gh0);
+        out[2] = _mm_unpackhi_epi64(ab0, cd0);
+        out[3] = _mm_unpackhi_epi64(ef0, gh0);
+        out[4] = _mm_unpacklo_epi64(ab1, cd1);
+        out[5] = _mm_unpacklo_epi64(ef1, gh1);
+        out[6] = _mm_unpackhi_epi64(ab1, cd1);
+        out[7] = _mm_unpackhi_epi64(ef1, gh1);
+    }
+}
+
+#define PCM_LOAD(c) _mm_loadu_si128((const __m128i *)(src + (c)*nPlaneSize + i * nBytes))
+#define PCM_STORE(n, v) _mm_storeu_si128(out + (n), v)
+
+// 16-bit, 8 samples of every channel per iteration
+template <int nChannels>
+static void interleave_pcm16_sse2(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples)
+{
+    static const int nBytes = 2;
+
+    size_t i = 0;
+    for (; i + 8 <= nSamples; i += 8)
+    {
+        __m128i *out = (__m128i *)(dst + i * nBytes * nChannels);
+        if (nChannels == 2)
+        {
+            const __m128i a = PCM_LOAD(0), b = PCM_LOAD(1);
+            PCM_STORE(0, _mm_unpacklo_epi16(a, b));
+            PCM_STORE(1, _mm_unpackhi_epi16(a, b));
+        }
+        else if (nChannels == 4)
+        {
+            const __m128i a = PCM_LOAD(0), b = PCM_LOAD(1), c = PCM_LOAD(2), d = PCM_LOAD(3);
+            const __m128i ab0 = _mm_unpacklo_epi16(a, b), ab1 = _mm_unpackhi_epi16(a, b);
+            const __m128i cd0 = _mm_unpacklo_epi16(c, d), cd1 = _mm_unpackhi_epi16(c, d);
+            PCM_STORE(0, _mm_unpacklo_epi32(ab0, cd0));
+            PCM_STORE(1, _mm_unpackhi_epi32(ab0, cd0));
+            PCM_STORE(2, _mm_unpacklo_epi32(ab1, cd1));
+            PCM_STORE(3, _mm_unpackhi_epi32(ab1, cd1));
+        }
+        else if (nChannels == 6)
+        {
+            // channel pairs as 32-bit elements, interleaved three-way
+            const __m128i a = PCM_LOAD(0), b = PCM_LOAD(1), c = PCM_LOAD(2), d = PCM_LOAD(3), e = PCM_LOAD(4),
+                          f = PCM_LOAD(5);
+            const __m128i ab0 = _mm_unpacklo_epi16(a, b), ab1 = _mm_unpackhi_epi16(a, b);
+            const __m128i cd0 = _mm_unpacklo_epi16(c, d), cd1 = _mm_unpackhi_epi16(c, d);
+            const __m128i ef0 = _mm_unpacklo_epi16(e, f), ef1 = _mm_unpackhi_epi16(e, f);
+            store_interleave_3x32(out + 0, ab0, cd0, ef0);
+            store_interleave_3x32(out + 3, ab1, cd1, ef1);
+        }
+        else if (nChannels == 8)
+        {
+            const __m128i a = PCM_LOAD(0), b = PCM_LOAD(1), c = PCM_LOAD(2), d = PCM_LOAD(3), e = PCM_LOAD(4),
+                          f = PCM_LOAD(5), g = PCM_LOAD(6), h = PCM_LOAD(7);
+            const __m128i ab0 = _mm_unpacklo_epi16(a, b), ab1 = _mm_unpackhi_epi16(a, b);
+            const __m128i cd0 = _mm_unpacklo_epi16(c, d), cd1 = _mm_unpackhi_epi16(c, d);
+            const __m128i ef0 = _mm_unpacklo_epi16(e, f), ef1 = _mm_unpackhi_epi16(e, f);
+            const __m128i gh0 = _mm_unpacklo_epi16(g, h), gh1 = _mm_unpackhi_epi16(g, h);
+            const __m128i abcd0 = _mm_unpacklo_epi32(ab0, cd0), abcd1 = _mm_unpackhi_epi32(ab0, cd0);
+            const __m128i abcd2 = _mm_unpacklo_epi32(ab1, cd1), abcd3 = _mm_unpackhi_epi32(ab1, cd1);
+            const __m128i efgh0 = _mm_unpacklo_epi32(ef0, gh0), efgh1 = _mm_unpackhi_epi32(ef0, gh0);
+            const __m128i efgh2 = _mm_unpacklo_epi32(ef1, gh1), efgh3 = _mm_unpackhi_epi32(ef1, gh1);
+            PCM_STORE(0, _mm_unpacklo_epi64(abcd0, efgh0));
+            PCM_STORE(1, _mm_unpackhi_epi64(abcd0, efgh0));
+            PCM_STORE(2, _mm_unpacklo_epi64(abcd1, efgh1));
+            PCM_STORE(3, _mm_unpackhi_epi64(abcd1, efgh1));
+            PCM_STORE(4, _mm_unpacklo_epi64(abcd2, efgh2));
+            PCM_STORE(5, _mm_unpackhi_epi64(abcd2, efgh2));
+            PCM_STORE(6, _mm_unpacklo_epi64(abcd3, efgh3));
+            PCM_STORE(7, _mm_unpackhi_epi64(abcd3, efgh3));
+        }
+    }
+
+    interleave_pcm_c<nBytes, nChannels>(dst, src, nPlaneSize, i, nSamples);
+}
+
+// 24-bit, 4 samples of every channel per iteration
+// SSE2 has no byte shuffle, so the samples are widened to 32-bit elements with byte shifts, interleaved like 32-bit
+// samples, and packed back to 3 bytes each with 64-bit shifts and masks. Every iteration loads and stores 16 bytes
+// per vector, of which 12 are used, so the loop stops while at least two samples of every channel are left.
+template <int nChannels>
+static void interleave_pcm24_sse2(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples)
+{
+    static const int nBytes = 3;
+
+    const __m128i mask24 = _mm_set1_epi32(0x00ffffff);
+    const __m128i maskLo32 = _mm_set_epi32(0, -1, 0, -1);
+    const __m128i maskLo6 = _mm_set_epi32(0, 0, 0x0000ffff, -1);
+    const __m128i maskHi6 = _mm_set_epi32(0, -1, (int)0xffff0000, 0);
+
+    size_t i = 0;
+    for (; i + 6 <= nSamples; i += 4)
+    {
+        BYTE *out = dst + i * nBytes * nChannels;
+
+        __m128i in[nChannels], res[nChannels];
+        for (int c = 0; c < nChannels; c++)
+        {
+            const __m128i v = PCM_LOAD(c);
+            const __m128i v01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+            const __m128i v23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+            in[c] = _mm_and_si128(_mm_unpacklo_epi64(v01, v23), mask24);
+        }
+
+        interleave_4x32<nChannels>(in, res);
+
+        for (int n = 0; n < nChannels; n++)
+        {
+            // two samples per 64-bit element, then the upper 6 bytes next to the lower ones
+            const __m128i hi = _mm_slli_epi64(_mm_srli_epi64(res[n], 32), 24);
+            const __m128i v = _mm_or_si128(_mm_and_si128(res[n], maskLo32), hi);
+            const __m128i packed =
+                _mm_or_si128(_mm_and_si128(v, maskLo6), _mm_and_si128(_mm_srli_si128(v, 2), maskHi6));
+            _mm_storeu_si128((__m128i *)(out + n * 12), packed);
+        }
+    }
+
+    interleave_pcm_c<nBytes, nChannels>(dst, src, nPlaneSize, i, nSamples);
+}
+
+// 32-bit, 4 samples of every channel per iteration
+template <int nChannels>
+static void interleave_pcm32_sse2(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples)
+{
+    static const int nBytes = 4;
+
+    size_t i = 0;
+    for (; i + 4 <= nSamples; i += 4)
+    {
+        __m128i *out = (__m128i *)(dst + i * nBytes * nChannels);
+
+        __m128i in[nChannels], res[nChannels];
+        for (int c = 0; c < nChannels; c++)
+            in[c] = PCM_LOAD(c);
+
+        interleave_4x32<nChannels>(in, res);
+
+        for (int n = 0; n < nChannels; n++)
+            PCM_STORE(n, res[n]);
+    }
+
+    interleave_pcm_c<nBytes, nChannels>(dst, src, nPlaneSize, i, nSamples);
+}
+
+#undef PCM_LOAD
+#undef PCM_STORE
+
+// Channel counts without a SIMD function use a scalar function unrolled for the sample size and channel count
+PlanarPCMFunc GetPlanarPCMFunc(int nBytes, int nChannels)
+{
+    // clang-format off
+    static const PlanarPCMFunc funcs[3][7] = {
+        { interleave_pcm16_sse2<2>, interleave_pcm<2, 3>, interleave_pcm16_sse2<4>, interleave_pcm<2, 5>,
+          interleave_pcm16_sse2<6>, interleave_pcm<2, 7>, interleave_pcm16_sse2<8> },
+        { interleave_pcm24_sse2<2>, interleave_pcm<3, 3>, interleave_pcm24_sse2<4>, interleave_pcm<3, 5>,
+          interleave_pcm24_sse2<6>, interleave_pcm<3, 7>, interleave_pcm24_sse2<8> },
+        { interleave_pcm32_sse2<2>, interleave_pcm<4, 3>, interleave_pcm32_sse2<4>, interleave_pcm<4, 5>,
+          interleave_pcm32_sse2<6>, interleave_pcm<4, 7>, interleave_pcm32_sse2<8> },
+    };
+    // clang-format on
+
+    if (nBytes < 2 || nBytes > 4 || nChannels < 2 || nChannels > 8)
+        return nullptr;
+
+    return funcs[nBytes - 2][nChannels - 2];
+}
@@ -0,0 +1,33 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Planar PCM interleaving
+// The input holds one plane per channel with nSamples samples each, the planes are nPlaneSize bytes apart. The
+// output holds the samples of all channels one after another.
+
+typedef void (*PlanarPCMFunc)(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples);
+
+// Select the interleaving function for 2 to 4 bytes per sample and 2 to 8 channels, or nullptr for other formats
+PlanarPCMFunc GetPlanarPCMFunc(int nBytes, int nChannels);
+
+// Reference implementation for any sample size and channel count
+void interleave_pcm_generic(BYTE *dst, const BYTE *src, size_t nPlaneSize, size_t nSamples, int nBytes,
+                            int nChannels);
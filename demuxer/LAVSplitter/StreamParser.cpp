@@ -112,6 +112,7 @@ HRESULT CStreamParser::Flush()
     m_queue.Clear();
     m_bPGSDropState = FALSE;
     m_bHasAccessUnitDelimiters = false;
+    m_PlanarPCM.nChannels = 0;
 
     return S_OK;
 }
@@ -145,11 +146,57 @@ static Packet *InitPacket(Packet *pSource)
     return pNew;
 }
 
-#define MOVE_TO_H264_START_CODE(b, e)                                                                  \
-    while (b <= e - 4 && !((*(DWORD *)b == 0x01000000) || ((*(DWORD *)b & 0x00FFFFFF) == 0x00010000))) \
-        b++;                                                                                           \
-    if ((b <= e - 4) && *(DWORD *)b == 0x01000000)                                                     \
-        b++;
+// Find the next 00 00 01 start code at or after offset, which is followed by at least one byte
+// The segments of the packet are scanned in place. If none is found, the offset of the last 3 bytes is returned.
+static int FindH264StartCode(const Packet *pPacket, int offset)
+{
+    const int end = pPacket->GetDataSize() - 4;
+
+    DWORD state = 0xFFFFFFFF;
+    int pos = 0;
+    for (int i = 0; i < pPacket->GetNumSegments() && pos - 2 <= end; i++)
+    {
+        const BYTE *data = pPacket->GetSegmentData(i);
+        const int size = pPacket->GetSegmentSize(i);
+
+        for (int j = max(offset - pos, 0); j < size; j++)
+        {
+            state = (state << 8) | data[j];
+            if ((state & 0x00FFFFFF) == 0x000001)
+            {
+                const int code = pos + j - 2;
+                if (code > end)
+                    break;
+                if (code >= offset)
+                    return code;
+            }
+        }
+        pos += size;
+    }
+
+    return max(offset, end + 1);
+}
+
+// Get len bytes at offset of the packet data, which are only gathered into the buffer if they span segments
+static const BYTE *GetPacketRange(const Packet *pPacket, int offset, int len, GrowableArray<BYTE> &buffer)
+{
+    int pos = offset;
+    for (int i = 0; i < pPacket->GetNumSegments(); i++)
+    {
+        const int size = pPacket->GetSegmentSize(i);
+        if (pos < size)
+        {
+            if (pos + len <= size)
+                return pPacket->GetSegmentData(i) + pos;
+            break;
+        }
+        pos -= size;
+    }
+
+    buffer.SetSize(len);
+    pPacket->CopyData(buffer.Ptr(), offset, len);
+    return buffer.Ptr();
+}
 
 HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
 {
@@ -160,16 +207,13 @@ HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
 
     m_pPacketBuffer->Append(pPacket);
 
-    BYTE *start = m_pPacketBuffer->GetData();
-    BYTE *end = start + m_pPacketBuffer->GetDataSize();
+    const int end = m_pPacketBuffer->GetDataSize();
 
-    MOVE_TO_H264_START_CODE(start, end);
+    int start = FindH264StartCode(m_pPacketBuffer, 0);
 
     while (start <= end - 4)
     {
-        BYTE *next = start + 1;
-
-        MOVE_TO_H264_START_CODE(next, end);
+        int next = FindH264StartCode(m_pPacketBuffer, start + 1);
 
         // End of buffer reached
         if (next >= end - 4)
@@ -177,10 +221,10 @@ HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
             break;
         }
 
-        size_t size = next - start;
+        int size = next - start;
 
         CH264Nalu Nalu;
-        Nalu.SetBuffer(start, (int)size, 0);
+        Nalu.SetBuffer(GetPacketRange(m_pPacketBuffer, start, size, m_NALBuffer), size, 0);
 
         Packet *p2 = nullptr;
 
@@ -251,9 +295,9 @@ HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
         start = next;
     }
 
-    if (start > m_pPacketBuffer->GetData())
+    if (start > 0)
     {
-        m_pPacketBuffer->RemoveHead((int)(start - m_pPacketBuffer->GetData()));
+        m_pPacketBuffer->RemoveHead(start);
     }
 
     SAFE_DELETE(pPacket);
@@ -274,7 +318,8 @@ HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
             }
 
             Packet *p = *it;
-            BYTE *pData = p->GetData();
+            // The NALU type follows the size, both are always in the first segment
+            const BYTE *pData = p->GetSegmentData(0);
 
             if ((pData[4] & 0x1f) == 0x09)
             {
@@ -505,7 +550,7 @@ HRESULT CStreamParser::ParseSRT(Packet *pPacket)
             p->StreamId = pPacket->StreamId;
             p->rtStart = pPacket->rtStart;
             p->rtStop = pPacket->rtStop;
-            p->AppendData(linestart, (int)size);
+            p->AppendSlice(pPacket, (int)(linestart - (const char *)pPacket->GetData()), (int)size);
             Queue(p);
         }
     }
@@ -516,37 +561,50 @@ HRESULT CStreamParser::ParseSRT(Packet *pPacket)
 
 HRESULT CStreamParser::ParsePlanarPCM(Packet *pPacket)
 {
-    CMediaType mt = m_pPin->GetActiveMediaType();
+    // The format only changes with a new media type, otherwise it is parsed once after a flush
+    if (pPacket->pmt || m_PlanarPCM.nChannels == 0)
+    {
+        WORD nChannels = 0, nBPS = 0;
+        if (pPacket->pmt)
+            audioFormatTypeHandler(pPacket->pmt->pbFormat, &pPacket->pmt->formattype, nullptr, &nChannels, &nBPS,
+                                   nullptr, nullptr);
+        else
+        {
+            const CMediaType &mt = m_pPin->GetActiveMediaType();
+            audioFormatTypeHandler(mt.Format(), mt.FormatType(), nullptr, &nChannels, &nBPS, nullptr, nullptr);
+        }
 
-    WORD nChannels = 0, nBPS = 0, nBlockAlign = 0;
-    audioFormatTypeHandler(mt.Format(), mt.FormatType(), nullptr, &nChannels, &nBPS, &nBlockAlign, nullptr);
+        m_PlanarPCM.nChannels = nChannels;
+        m_PlanarPCM.nBytesPerSample = nBPS / 8;
+        m_PlanarPCM.pfnInterleave = GetPlanarPCMFunc(m_PlanarPCM.nBytesPerSample, nChannels);
+    }
 
     // Mono needs no special handling
-    if (nChannels == 1)
+    if (m_PlanarPCM.nChannels <= 1 || m_PlanarPCM.nBytesPerSample == 0)
         return Queue(pPacket);
 
     Packet *out = new Packet();
     out->CopyProperties(pPacket);
     out->SetDataSize(pPacket->GetDataSize());
 
-    int nBytesPerChannel = nBPS / 8;
-    int nAudioBlocks = pPacket->GetDataSize() / nChannels;
+    const int nChannels = m_PlanarPCM.nChannels;
+    const int nBytesPerChannel = m_PlanarPCM.nBytesPerSample;
+    const size_t nPlaneSize = pPacket->GetDataSize() / nChannels;
     BYTE *out_data = out->GetData();
     const BYTE *in_data = pPacket->GetData();
 
-    for (int i = 0; i < nAudioBlocks; i += nBytesPerChannel)
-    {
-        // interleave the channels into audio blocks
-        for (int c = 0; c < nChannels; c++)
-        {
-            memcpy(out_data + (c * nBytesPerChannel), in_data + (nAudioBlocks * c), nBytesPerChannel);
-        }
-        // Skip to the next output block
-        out_data += nChannels * nBytesPerChannel;
+    // only complete samples are interleaved, a truncated sample at the end of the planes is replaced by silence
+    const size_t nSamples = nPlaneSize / nBytesPerChannel;
+    const size_t nInterleaved = nSamples * nBytesPerChannel * nChannels;
 
-        // skip to the next input sample
-        in_data += nBytesPerChannel;
-    }
+    if (m_PlanarPCM.pfnInterleave)
+        m_PlanarPCM.pfnInterleave(out_data, in_data, nPlaneSize, nSamples);
+    else
+        interleave_pcm_generic(out_data, in_data, nPlaneSize, nSamples, nBytesPerChannel, nChannels);
 
+    if (nInterleaved < (size_t)out->GetDataSize())
+        memset(out_data + nInterleaved, 0, out->GetDataSize() - nInterleaved);
+
+    SAFE_DELETE(pPacket);
     return Queue(out);
 }
@@ -23,6 +23,7 @@
 
 #include "PacketQueue.h"
 #include "growarray.h"
+#include "PlanarPCM.h"
 
 class CLAVOutputPin;
 
@@ -52,6 +53,7 @@ class CStreamParser
     GUID m_gSubtype = GUID_NULL;
 
     Packet *m_pPacketBuffer = nullptr;
+    GrowableArray<BYTE> m_NALBuffer;
 
     BOOL m_bPGSDropState = FALSE;
     GrowableArray<BYTE> m_pgsBuffer;
@@ -59,4 +61,11 @@ class CStreamParser
     CPacketQueue m_queue;
 
     bool m_bHasAccessUnitDelimiters = false;
+
+    struct
+    {
+        WORD nChannels;
+        WORD nBytesPerSample;
+        PlanarPCMFunc pfnInterleave;
+    } m_PlanarPCM = {0};
 };
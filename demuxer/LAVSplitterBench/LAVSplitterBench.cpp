@@ -0,0 +1,255 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Headless benchmark of the LAV Splitter demuxing pipeline
+//
+// Usage: LAVSplitterBench <file> [<file> ...]
+//
+// LAVSplitter.ax is loaded from the working directory without registration. LAV Splitter Source reads every file with
+// all of its output pins connected to stub renderer pins, which discard the packets without a clock. The packet and
+// data rate of the whole run, the time per packet spent in the demuxer and the packet allocations (see
+// ILAVFSettings::GetDemuxStats and GetPacketAllocations) are printed as one line per file, followed by one line for the
+// stream parser of every codec. make_corpus.sh generates a set of test files in the common containers.
+
+#include "stdafx.h"
+
+#include <vector>
+
+// Initialize the GUIDs
+#include <InitGuid.h>
+
+#include "moreuuids.h"
+#include "LAVSplitterSettings.h"
+#include "ProcessingCounter.h"
+
+// The base classes expect the factory template table of a filter DLL
+CFactoryTemplate g_Templates[1] = {};
+int g_cTemplates = 0;
+
+// Stub renderer, accepts any media type and discards the samples
+class CBenchRenderer : public CBaseRenderer
+{
+  public:
+    CBenchRenderer(HRESULT *phr)
+        : CBaseRenderer(GUID_NULL, NAME("Bench Renderer"), nullptr, phr)
+    {
+    }
+
+    HRESULT CheckMediaType(const CMediaType *pmt) override { return S_OK; }
+    HRESULT DoRenderSample(IMediaSample *pSample) override { return S_OK; }
+};
+
+static HRESULT GetFilterPin(IBaseFilter *pFilter, PIN_DIRECTION dir, IPin **ppPin)
+{
+    CComPtr<IEnumPins> pEnum;
+    HRESULT hr = pFilter->EnumPins(&pEnum);
+    if (FAILED(hr))
+        return hr;
+
+    CComPtr<IPin> pPin;
+    while (pEnum->Next(1, &pPin, nullptr) == S_OK)
+    {
+        PIN_DIRECTION pinDir;
+        if (SUCCEEDED(pPin->QueryDirection(&pinDir)) && pinDir == dir)
+        {
+            *ppPin = pPin.Detach();
+            return S_OK;
+        }
+        pPin.Release();
+    }
+    return VFW_E_NOT_FOUND;
+}
+
+static LPCWSTR GetFileName(LPCWSTR pszPath)
+{
+    LPCWSTR pszName = wcsrchr(pszPath, L'\\');
+    return pszName ? pszName + 1 : pszPath;
+}
+
+// Most media subtypes are derived from a FourCC, the others are shown as the first part of the GUID
+static void GetSubtypeName(REFGUID subtype, char szName[9])
+{
+    BOOL bFourCC = TRUE;
+    for (int i = 0; i < 4; i++)
+    {
+        const char c = (char)(subtype.Data1 >> (8 * i));
+        bFourCC = bFourCC && c >= 0x20 && c < 0x7f;
+        szName[i] = c;
+    }
+    szName[4] = 0;
+
+    if (!bFourCC)
+        sprintf_s(szName, 9, "%08lx", subtype.Data1);
+}
+
+// Build the graph for the file, run it to the end of the stream, and print the results
+static HRESULT RunBenchmark(IClassFactory *pFactory, LPCWSTR pszFile)
+{
+    HRESULT hr = S_OK;
+
+    CComPtr<IGraphBuilder> pGraph;
+    CComPtr<IBaseFilter> pSource;
+
+    if (FAILED(hr = pGraph.CoCreateInstance(CLSID_FilterGraph)) ||
+        FAILED(hr = pFactory->CreateInstance(nullptr, IID_PPV_ARGS(&pSource))))
+        return hr;
+
+    CComQIPtr<IFileSourceFilter> pFileSource(pSource);
+    CComQIPtr<ILAVFSettings> pSettings(pSource);
+    if (!pFileSource || !pSettings)
+        return E_NOINTERFACE;
+
+    // runtime config, so the settings in the registry are neither used nor changed
+    if (FAILED(hr = pSettings->SetRuntimeConfig(TRUE)))
+        return hr;
+    pSettings->SetTrayIcon(FALSE);
+
+    if (FAILED(hr = pGraph->AddFilter(pSource, L"Source")) || FAILED(hr = pFileSource->Load(pszFile, nullptr)))
+        return hr;
+
+    // every output pin gets its own renderer, the pins are collected before any of them is connected
+    std::vector<CComPtr<IPin>> pSourcePins;
+    {
+        CComPtr<IEnumPins> pEnum;
+        if (FAILED(hr = pSource->EnumPins(&pEnum)))
+            return hr;
+
+        CComPtr<IPin> pPin;
+        while (pEnum->Next(1, &pPin, nullptr) == S_OK)
+        {
+            PIN_DIRECTION pinDir;
+            if (SUCCEEDED(pPin->QueryDirection(&pinDir)) && pinDir == PINDIR_OUTPUT)
+                pSourcePins.push_back(pPin);
+            pPin.Release();
+        }
+    }
+
+    for (IPin *pSourceOut : pSourcePins)
+    {
+        CComPtr<IBaseFilter> pRenderer = new CBenchRenderer(&hr);
+        CComPtr<IPin> pRendererIn;
+        if (FAILED(hr) || FAILED(hr = pGraph->AddFilter(pRenderer, L"Renderer")) ||
+            FAILED(hr = GetFilterPin(pRenderer, PINDIR_INPUT, &pRendererIn)) ||
+            FAILED(hr = pGraph->ConnectDirect(pSourceOut, pRendererIn, nullptr)))
+            return hr;
+    }
+
+    // without a clock, the renderers consume every sample right away
+    CComQIPtr<IMediaFilter> pMediaFilter(pGraph);
+    CComQIPtr<IMediaControl> pControl(pGraph);
+    CComQIPtr<IMediaEvent> pEvent(pGraph);
+    if (!pMediaFilter || !pControl || !pEvent)
+        return E_NOINTERFACE;
+
+    if (FAILED(hr = pMediaFilter->SetSyncSource(nullptr)))
+        return hr;
+
+    const LONGLONG llStart = CProcessingCounter::Now();
+    if (FAILED(hr = pControl->Run()))
+        return hr;
+
+    long lEventCode = 0;
+    hr = pEvent->WaitForCompletion(INFINITE, &lEventCode);
+    const REFERENCE_TIME rtElapsed = CProcessingCounter::TicksToTime(CProcessingCounter::Now() - llStart);
+
+    // the statistics are reset when streaming starts again, so read them before stopping
+    ULONGLONG ullPackets = 0, ullBytes = 0, ullAllocations = 0;
+    REFERENCE_TIME rtDemux = 0;
+    pSettings->GetDemuxStats(-1, nullptr, &ullPackets, &ullBytes, &rtDemux);
+    pSettings->GetPacketAllocations(&ullAllocations);
+
+    struct CodecStats
+    {
+        GUID subtype;
+        ULONGLONG ullPackets, ullBytes;
+        REFERENCE_TIME rtTime;
+    };
+    std::vector<CodecStats> codecs;
+    CodecStats codec = {};
+    for (int i = 0; pSettings->GetDemuxStats(i, &codec.subtype, &codec.ullPackets, &codec.ullBytes,
+                                             &codec.rtTime) == S_OK;
+         i++)
+        codecs.push_back(codec);
+
+    pControl->Stop();
+
+    if (FAILED(hr) || lEventCode != EC_COMPLETE)
+        return FAILED(hr) ? hr : E_FAIL;
+
+    printf("%-24.24S %-8s %10I64u %10.1f %10.0f %9.2f %9.2f\n", GetFileName(pszFile), "demuxer", ullPackets,
+           rtElapsed ? ullBytes * 10.0 / rtElapsed : 0.0, rtElapsed ? ullPackets * 10000000.0 / rtElapsed : 0.0,
+           ullPackets ? rtDemux / 10.0 / ullPackets : 0.0, ullPackets ? (double)ullAllocations / ullPackets : 0.0);
+
+    // microseconds per packet spent in the stream parser
+    for (const CodecStats &stats : codecs)
+    {
+        if (!stats.ullPackets)
+            continue;
+
+        char szSubtype[9];
+        GetSubtypeName(stats.subtype, szSubtype);
+        printf("%-24s %-8s %10I64u %10.1f %10s %9.2f\n", "", szSubtype, stats.ullPackets,
+               rtElapsed ? stats.ullBytes * 10.0 / rtElapsed : 0.0, "", stats.rtTime / 10.0 / stats.ullPackets);
+    }
+
+    return S_OK;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+    if (argc < 2)
+    {
+        fwprintf(stderr, L"Usage: %s <file> [<file> ...]\n", argv[0]);
+        return 1;
+    }
+
+    if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
+        return 1;
+
+    int ret = 1;
+    HMODULE hSplitter = LoadLibrary(L"LAVSplitter.ax");
+    typedef HRESULT(STDAPICALLTYPE * PFN_DLLGETCLASSOBJECT)(REFCLSID, REFIID, LPVOID *);
+    PFN_DLLGETCLASSOBJECT pfnGetClassObject =
+        hSplitter ? (PFN_DLLGETCLASSOBJECT)GetProcAddress(hSplitter, "DllGetClassObject") : nullptr;
+
+    CComPtr<IClassFactory> pFactory;
+    if (!pfnGetClassObject || FAILED(pfnGetClassObject(CLSID_LAVSplitterSource, IID_PPV_ARGS(&pFactory))))
+    {
+        fwprintf(stderr, L"LAVSplitter.ax could not be loaded from the working directory\n");
+        goto done;
+    }
+
+    printf("%-24s %-8s %10s %10s %10s %9s %9s\n", "file", "stage", "packets", "MB/s", "packets/s", "us/packet",
+           "allocs");
+
+    for (int i = 1; i < argc; i++)
+    {
+        HRESULT hr = RunBenchmark(pFactory, argv[i]);
+        if (FAILED(hr))
+            printf("%-24.24S failed (0x%08x)\n", GetFileName(argv[i]), hr);
+    }
+    ret = 0;
+
+done:
+    pFactory.Release();
+    if (hSplitter)
+        FreeLibrary(hSplitter);
+    CoUninitialize();
+    return ret;
+}
@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Generate the test files for LAVSplitterBench
+#
+# Usage: make_corpus.sh [output directory] [seconds]
+#
+# The streams are encoded once into a Matroska file, and then remuxed into MP4, MPEG-TS and M2TS (MPEG-TS with the
+# 4-byte timestamps of Blu-ray), so that all containers carry the same H.264, AAC and AC3 streams. An MPEG-2 video
+# file in MPEG-TS covers the other common video parser. Needs an ffmpeg binary with libx264, either in the PATH or
+# given in the FFMPEG environment variable.
+
+outdir=${1:-corpus}
+seconds=${2:-300}
+ffmpeg=${FFMPEG:-ffmpeg}
+
+video="testsrc2=size=1920x1080:rate=24000/1001"
+audio1="sine=frequency=440:sample_rate=48000"
+audio2="sine=frequency=880:sample_rate=48000"
+
+mkdir -p "$outdir" || exit 1
+
+encode() (
+  "$ffmpeg" -hide_banner -loglevel error -y \
+    -f lavfi -i "$video" -f lavfi -i "$audio1" -f lavfi -i "$audio2" -t "$seconds" \
+    -map 0:v -map 1:a -map 2:a "$@"
+)
+
+remux() (
+  "$ffmpeg" -hide_banner -loglevel error -y -i "$outdir/h264.mkv" -map 0 -c copy "$@"
+)
+
+echo "Encoding $seconds seconds of H.264 with AAC and AC3"
+encode -c:v libx264 -preset veryfast -g 48 -b:v 8M -c:a:0 aac -b:a:0 192k -c:a:1 ac3 -b:a:1 448k \
+  "$outdir/h264.mkv" || exit 1
+
+echo "Remuxing into MP4, MPEG-TS and M2TS"
+remux "$outdir/h264.mp4" || exit 1
+remux -f mpegts "$outdir/h264.ts" || exit 1
+remux -f mpegts -mpegts_m2ts_mode 1 "$outdir/h264.m2ts" || exit 1
+
+echo "Encoding $seconds seconds of MPEG-2 with AC3"
+encode -c:v mpeg2video -g 12 -b:v 15M -maxrate 15M -bufsize 9M -c:a ac3 -b:a 448k -f mpegts \
+  "$outdir/mpeg2.ts" || exit 1
+
+echo "Done, run: LAVSplitterBench" "$outdir"/*
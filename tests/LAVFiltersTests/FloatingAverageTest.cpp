@@ -0,0 +1,252 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Compares FloatingAverage with the scan-based implementation it replaced, and measures both on the jitter tracking
+// of LAV Audio.
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "FloatingAverage.h"
+
+// The scan-based implementation, every query walks the whole window
+template <class T> class ScanFloatingAverage
+{
+  public:
+    ScanFloatingAverage(unsigned int iNumSamples = 10) { SetNumSamples(iNumSamples); }
+
+    ~ScanFloatingAverage() { free(m_Samples); }
+
+    void SetNumSamples(unsigned int iNumSamples)
+    {
+        if (iNumSamples > m_NumSamplesAlloc)
+        {
+            m_Samples = (T *)realloc(m_Samples, iNumSamples * sizeof(T));
+            m_NumSamplesAlloc = iNumSamples;
+        }
+        if (iNumSamples > m_NumSamples)
+            memset(m_Samples + m_NumSamples, 0, sizeof(T) * (iNumSamples - m_NumSamples));
+        m_NumSamples = iNumSamples;
+    }
+
+    void Sample(T fSample)
+    {
+        m_Samples[m_CurrentSample] = fSample;
+        if (++m_CurrentSample >= m_NumSamples)
+        {
+            m_CurrentSample = 0;
+        }
+    }
+
+    T Average() const
+    {
+        T fAverage = 0;
+        for (unsigned int i = 0; i < m_NumSamples; ++i)
+        {
+            fAverage += m_Samples[i] / m_NumSamples;
+        }
+        return fAverage;
+    }
+
+    T Minimum() const
+    {
+        T min = m_Samples[0];
+        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        {
+            if (m_Samples[i] < min)
+                min = m_Samples[i];
+        }
+        return min;
+    }
+
+    T AbsMinimum() const
+    {
+        T min = m_Samples[0];
+        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        {
+            if (abs(m_Samples[i]) < abs(min))
+                min = m_Samples[i];
+        }
+        return min;
+    }
+
+    T Maximum() const
+    {
+        T max = m_Samples[0];
+        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        {
+            if (m_Samples[i] > max)
+                max = m_Samples[i];
+        }
+        return max;
+    }
+
+    T AbsMaximum() const
+    {
+        T max = m_Samples[0];
+        for (unsigned int i = 1; i < m_NumSamples; ++i)
+        {
+            if (abs(m_Samples[i]) > abs(max))
+                max = m_Samples[i];
+        }
+        return max;
+    }
+
+    void OffsetValues(T value)
+    {
+        for (unsigned int i = 0; i < m_NumSamples; ++i)
+        {
+            m_Samples[i] += value;
+        }
+    }
+
+    unsigned int CurrentSample() const { return m_CurrentSample; }
+
+  private:
+    T *m_Samples = nullptr;
+    unsigned int m_NumSamples = 0;
+    unsigned int m_NumSamplesAlloc = 0;
+    unsigned int m_CurrentSample = 0;
+};
+
+// Feed both implementations the same random operations, with values from a small range so that ties of equal and
+// opposite values are frequent. Resizing is only done when the write position stays inside the new window, the scan
+// implementation wrote one sample past the window otherwise.
+template <class T> static bool CompareImplementations(uint32_t seed, int nOperations)
+{
+    TestRandom rnd(seed);
+
+    unsigned int nSamples = rnd.Range(1, 64);
+    FloatingAverage<T> fa(nSamples);
+    ScanFloatingAverage<T> ref(nSamples);
+
+    for (int i = 0; i < nOperations; i++)
+    {
+        const int op = rnd.Range(0, 999);
+        if (op < 2)
+        {
+            const unsigned int nNewSamples = rnd.Range(1, 96);
+            if (ref.CurrentSample() < nNewSamples)
+            {
+                fa.SetNumSamples(nNewSamples);
+                ref.SetNumSamples(nNewSamples);
+                nSamples = nNewSamples;
+            }
+        }
+        else if (op < 10)
+        {
+            const T offset = (T)rnd.Range(-3, 3);
+            fa.OffsetValues(offset);
+            ref.OffsetValues(offset);
+        }
+        else
+        {
+            const T value = (T)rnd.Range(-4, 4);
+            fa.Sample(value);
+            ref.Sample(value);
+        }
+
+        TEST_CHECK(fa.CurrentSample() == ref.CurrentSample(), "seed %u, operation %d", seed, i);
+        TEST_CHECK(fa.Minimum() == ref.Minimum(), "seed %u, operation %d", seed, i);
+        TEST_CHECK(fa.Maximum() == ref.Maximum(), "seed %u, operation %d", seed, i);
+        TEST_CHECK(fa.AbsMinimum() == ref.AbsMinimum(), "seed %u, operation %d", seed, i);
+        TEST_CHECK(fa.AbsMaximum() == ref.AbsMaximum(), "seed %u, operation %d", seed, i);
+
+        // the running average rounds differently with floating point types, and is exact with integers
+        const double dAverage = (double)fa.Average(), dRefAverage = (double)ref.Average();
+        TEST_CHECK(abs(dAverage - dRefAverage) <= abs(dRefAverage) * 1e-5 + 1e-5, "seed %u, operation %d: %f vs %f",
+                   seed, i, dAverage, dRefAverage);
+    }
+    return true;
+}
+
+bool TestFloatingAverage()
+{
+    for (uint32_t seed = 1; seed <= 20; seed++)
+    {
+        if (!CompareImplementations<REFERENCE_TIME>(seed, 50000) || !CompareImplementations<float>(seed, 50000) ||
+            !CompareImplementations<double>(seed, 50000))
+            return false;
+    }
+
+    // the window keeps its samples when resized
+    FloatingAverage<int> fa(4);
+    fa.Sample(-3);
+    fa.Sample(3);
+    fa.Sample(1);
+    fa.SetNumSamples(8);
+    TEST_CHECK(fa.CurrentSample() == 3, "%u", fa.CurrentSample());
+    TEST_CHECK(fa.AbsMaximum() == -3, "%d", fa.AbsMaximum());
+    TEST_CHECK(fa.AbsMinimum() == 0, "%d", fa.AbsMinimum());
+    TEST_CHECK(fa.Average() == 0, "%d", fa.Average());
+    fa.SetNumSamples(4);
+    fa.Sample(2);
+    TEST_CHECK(fa.CurrentSample() == 0, "%u", fa.CurrentSample());
+    TEST_CHECK(fa.AbsMinimum() == 1, "%d", fa.AbsMinimum());
+    TEST_CHECK(fa.Maximum() == 3, "%d", fa.Maximum());
+
+    return true;
+}
+
+// The jitter tracking in CLAVAudio::Deliver: one sample and one AbsMinimum query per delivered buffer, and an offset
+// of the window whenever the jitter exceeds the limit
+template <class FA> static double RunJitterTracking(unsigned int nWindow, int nBuffers, REFERENCE_TIME &rtCheck)
+{
+    const REFERENCE_TIME rtJitterLimit = nWindow == 200 ? 1000000 : 100000;
+
+    FA fa(nWindow);
+    TestRandom rnd(nWindow);
+    REFERENCE_TIME rtDrift = 0;
+
+    const double dStart = TestTime();
+    for (int i = 0; i < nBuffers; i++)
+    {
+        // timestamps with a few ms of noise, drifting away slowly
+        rtDrift += 20;
+        const REFERENCE_TIME rtJitter = rtDrift + rnd.Range(-20000, 20000);
+
+        fa.Sample(rtJitter);
+        const REFERENCE_TIME rtJitterMin = fa.AbsMinimum();
+        if (abs(rtJitterMin) > rtJitterLimit)
+        {
+            rtDrift -= rtJitterMin;
+            fa.OffsetValues(-rtJitterMin);
+        }
+        rtCheck += rtJitterMin;
+    }
+    return TestTime() - dStart;
+}
+
+bool BenchFloatingAverage()
+{
+    // the window sizes LAV Audio uses for the jitter, for PCM and for bitstreaming
+    static const unsigned int s_Windows[] = {50, 200};
+    const int nBuffers = 2000000;
+
+    for (unsigned int nWindow : s_Windows)
+    {
+        REFERENCE_TIME rtCheck = 0, rtRefCheck = 0;
+        const double dScan = RunJitterTracking<ScanFloatingAverage<REFERENCE_TIME>>(nWindow, nBuffers, rtRefCheck);
+        const double dQueue = RunJitterTracking<FloatingAverage<REFERENCE_TIME>>(nWindow, nBuffers, rtCheck);
+
+        TEST_CHECK(rtCheck == rtRefCheck, "window %u", nWindow);
+        printf("  window %3u: scan %6.1f ns/sample, queues %6.1f ns/sample, speedup %.1fx\n", nWindow,
+               dScan * 1e9 / nBuffers, dQueue * 1e9 / nBuffers, dScan / dQueue);
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Unit tests and micro-benchmarks of the LAV Filters building blocks
+//
+// Usage: LAVFiltersTests [--bench] [name]
+//
+// Runs every test, or only those whose name contains the given string. With --bench, the benchmarks are run as well.
+// The exit code is the number of failed tests.
+
+#include "stdafx.h"
+#include "Tests.h"
+
+// The base classes expect the factory template table of a filter DLL
+CFactoryTemplate g_Templates[1] = {};
+int g_cTemplates = 0;
+
+static const TestEntry s_Tests[] = {
+    {"FloatingAverage", TestFloatingAverage, false},
+    {"FloatingAverageBench", BenchFloatingAverage, true},
+    {"Mixer", TestMixer, false},
+    {"MixerConvert", TestMixerConvert, false},
+    {"MixerBench", BenchMixer, true},
+    {"PlanarPCM", TestPlanarPCM, false},
+    {"PlanarPCMBench", BenchPlanarPCM, true},
+    {"SubtitleUnpremultiply", TestSubtitleUnpremultiply, false},
+    {"SubtitleBGRAToYUVA", TestSubtitleBGRAToYUVA, false},
+    {"SubtitleDownsampleChroma", TestSubtitleDownsampleChroma, false},
+    {"SubtitleConversionBench", BenchSubtitleConversion, true},
+};
+
+int main(int argc, char *argv[])
+{
+    bool bBenchmarks = false;
+    const char *szFilter = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+            bBenchmarks = true;
+        else
+            szFilter = argv[i];
+    }
+
+    int nFailed = 0, nRun = 0;
+    for (const TestEntry &test : s_Tests)
+    {
+        if (test.bBenchmark && !bBenchmarks)
+            continue;
+        if (szFilter && strstr(test.szName, szFilter) == nullptr)
+            continue;
+
+        printf("%s\n", test.szName);
+        nRun++;
+        if (!test.pfnTest())
+        {
+            printf("  FAILED\n");
+            nFailed++;
+        }
+    }
+
+    printf("%d of %d passed\n", nRun - nFailed, nRun);
+    return nFailed;
+}
@@ -0,0 +1,291 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Compares the SSE2 and AVX2 kernels of the audio mixer against a double-precision reference
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "../../decoder/LAVAudio/Mixer.h"
+
+#include <vector>
+
+static const int s_CPUFlags[] = {AV_CPU_FLAG_SSE2, AV_CPU_FLAG_AVX2};
+static const char *s_CPUNames[] = {"sse2", "avx2"};
+
+static bool IsSupported(int index, bool bReport = false)
+{
+    if (!(av_get_cpu_flags() & s_CPUFlags[index]))
+    {
+        if (bReport)
+            printf("  %s: not supported by this CPU, skipped\n", s_CPUNames[index]);
+        return false;
+    }
+    return true;
+}
+
+static const LAVAudioSampleFormat s_InputFormats[] = {SampleFormat_U8, SampleFormat_16, SampleFormat_24,
+                                                      SampleFormat_32, SampleFormat_FP32};
+
+static int SampleSize(LAVAudioSampleFormat sfFormat)
+{
+    switch (sfFormat)
+    {
+    case SampleFormat_U8: return 1;
+    case SampleFormat_16: return 2;
+    case SampleFormat_24: return 3;
+    }
+    return 4;
+}
+
+static double LoadSample(const BYTE *p, LAVAudioSampleFormat sfFormat)
+{
+    switch (sfFormat)
+    {
+    case SampleFormat_U8: return (p[0] - 128) / 128.0;
+    case SampleFormat_16: return *(const int16_t *)p / 32768.0;
+    case SampleFormat_24: return (int32_t)((p[0] << 8) | (p[1] << 16) | (p[2] << 24)) / 2147483648.0;
+    case SampleFormat_32: return *(const int32_t *)p / 2147483648.0;
+    }
+    return *(const float *)p;
+}
+
+static int64_t LoadInteger(const BYTE *p, LAVAudioSampleFormat sfFormat)
+{
+    switch (sfFormat)
+    {
+    case SampleFormat_16: return *(const int16_t *)p;
+    case SampleFormat_24: return (int32_t)((p[0] << 8) | (p[1] << 16) | (p[2] << 24)) >> 8;
+    }
+    return *(const int32_t *)p;
+}
+
+static void FillSamples(std::vector<BYTE> &buffer, LAVAudioSampleFormat sfFormat, TestRandom &rnd)
+{
+    if (sfFormat == SampleFormat_FP32)
+    {
+        for (size_t i = 0; i + 4 <= buffer.size(); i += 4)
+            *(float *)&buffer[i] = (float)rnd.Range(-100000, 100000) / 100000.0f;
+    }
+    else
+    {
+        for (BYTE &b : buffer)
+            b = (BYTE)rnd.Next();
+    }
+}
+
+// Every input format with 1-10 input and 1-8 output channels, a random matrix and the identity matrix, and sample
+// counts around the two samples the AVX2 kernel mixes at once
+bool TestMixer()
+{
+    static const unsigned s_SampleCounts[] = {0, 1, 2, 3, 7, 64, 101};
+    TestRandom rnd(43);
+
+    for (LAVAudioSampleFormat sfFormat : s_InputFormats)
+    {
+        for (unsigned nIn = 1; nIn <= 10; nIn++)
+        {
+            for (unsigned nOut = 1; nOut <= LAV_MIXER_MAX_OUT_CHANNELS; nOut++)
+            {
+                for (int identity = 0; identity < 2; identity++)
+                {
+                    if (identity && nIn != nOut)
+                        continue;
+
+                    std::vector<double> matrix(nIn * nOut);
+                    for (unsigned out = 0; out < nOut; out++)
+                        for (unsigned in = 0; in < nIn; in++)
+                            matrix[out * nIn + in] = identity ? (in == out) : rnd.Range(-1000, 1000) / 1000.0;
+
+                    for (unsigned nSamples : s_SampleCounts)
+                    {
+                        std::vector<BYTE> in(nSamples * nIn * SampleSize(sfFormat));
+                        FillSamples(in, sfFormat, rnd);
+
+                        std::vector<float> out[2];
+                        for (int cpu = 0; cpu < 2; cpu++)
+                        {
+                            if (!IsSupported(cpu))
+                                continue;
+
+                            CAudioMixer mixer;
+                            mixer.SetCPUFlags(s_CPUFlags[cpu]);
+                            TEST_CHECK(mixer.SetMatrix(matrix.data(), nIn, nIn, nOut), "%u to %u channels", nIn, nOut);
+
+                            out[cpu].assign(nSamples * nOut + LAV_MIXER_MAX_OUT_CHANNELS, 1234.0f);
+                            mixer.Mix(out[cpu].data(), in.data(), nSamples, sfFormat);
+
+                            for (unsigned i = 0; i < nSamples; i++)
+                            {
+                                for (unsigned o = 0; o < nOut; o++)
+                                {
+                                    double ref = 0.0;
+                                    for (unsigned c = 0; c < nIn; c++)
+                                        ref += matrix[o * nIn + c] *
+                                               LoadSample(&in[(i * nIn + c) * SampleSize(sfFormat)], sfFormat);
+                                    TEST_CHECK(fabs(out[cpu][i * nOut + o] - ref) < 1e-5,
+                                               "%s, format %d, %u to %u channels, sample %u, channel %u: %f != %f",
+                                               s_CPUNames[cpu], sfFormat, nIn, nOut, i, o, out[cpu][i * nOut + o],
+                                               ref);
+                                }
+                            }
+                        }
+
+                        // the AVX2 kernels use the same operations per channel, so the results are identical
+                        if (!out[0].empty() && !out[1].empty())
+                            TEST_CHECK(memcmp(out[0].data(), out[1].data(), nSamples * nOut * sizeof(float)) == 0,
+                                       "avx2, format %d, %u to %u channels, %u samples: differs from sse2", sfFormat,
+                                       nIn, nOut, nSamples);
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Conversion to 16, 24 and 32-bit with and without dither, including clipping and the SIMD remainders
+bool TestMixerConvert()
+{
+    static const LAVAudioSampleFormat s_OutputFormats[] = {SampleFormat_16, SampleFormat_24, SampleFormat_32};
+    static const unsigned s_SampleCounts[] = {1, 3, 5, 17, 1000};
+    const double identity[4] = {1.0, 0.0, 0.0, 1.0};
+    TestRandom rnd(44);
+
+    for (LAVAudioSampleFormat sfFormat : s_OutputFormats)
+    {
+        const int nSize = SampleSize(sfFormat);
+        const double scale = (sfFormat == SampleFormat_16) ? 32768.0 : (sfFormat == SampleFormat_24) ? 8388608.0
+                                                                                                      : 2147483648.0;
+        for (int dither = 0; dither < 2; dither++)
+        {
+            if (dither && sfFormat != SampleFormat_16)
+                continue;
+
+            for (unsigned nSamples : s_SampleCounts)
+            {
+                const size_t nCount = nSamples * 2;
+                std::vector<float> src(nCount);
+                for (float &f : src)
+                    f = (float)rnd.Range(-120000, 120000) / 100000.0f;
+
+                std::vector<BYTE> out[2];
+                for (int cpu = 0; cpu < 2; cpu++)
+                {
+                    if (!IsSupported(cpu))
+                        continue;
+
+                    CAudioMixer mixer;
+                    mixer.SetCPUFlags(s_CPUFlags[cpu]);
+                    mixer.SetMatrix(identity, 2, 2, 2);
+
+                    out[cpu].assign(nCount * nSize + 16, 0xcc);
+                    mixer.Convert(out[cpu].data(), src.data(), nSamples, sfFormat, !!dither);
+
+                    for (size_t i = 0; i < nCount; i++)
+                    {
+                        const int64_t v = LoadInteger(&out[cpu][i * nSize], sfFormat);
+                        const double ref = min(max(src[i] * scale, -scale), scale - 1.0);
+                        // rounding, plus up to one step of dither noise
+                        const double tolerance = (sfFormat == SampleFormat_32) ? 128.0 : (dither ? 1.5 : 0.5);
+                        TEST_CHECK(fabs(v - ref) <= tolerance, "%s, format %d, dither %d, sample %Iu: %lld != %f",
+                                   s_CPUNames[cpu], sfFormat, dither, i, v, ref);
+                    }
+                    for (size_t i = nCount * nSize; i < out[cpu].size(); i++)
+                        TEST_CHECK(out[cpu][i] == 0xcc, "%s, format %d: wrote past the output", s_CPUNames[cpu],
+                                   sfFormat);
+                }
+
+                // the dither noise is the same for both, so the results are identical
+                if (!out[0].empty() && !out[1].empty())
+                    TEST_CHECK(memcmp(out[0].data(), out[1].data(), nCount * nSize) == 0,
+                               "avx2, format %d, dither %d, %u samples: differs from sse2", sfFormat, dither, nSamples);
+            }
+        }
+    }
+
+    // the dither noise is triangular around zero, and has to be there
+    CAudioMixer mixer;
+    mixer.SetMatrix(identity, 2, 2, 2);
+    std::vector<float> silence(2 * 48000, 0.25f / 32768.0f);
+    std::vector<int16_t> out(silence.size());
+    mixer.Convert((BYTE *)out.data(), silence.data(), 48000, SampleFormat_16, true);
+
+    double sum = 0.0;
+    int nonZero = 0;
+    for (int16_t v : out)
+    {
+        TEST_CHECK(v >= -1 && v <= 1, "dither noise out of range: %d", v);
+        sum += v;
+        nonZero += (v != 0);
+    }
+    TEST_CHECK(fabs(sum / out.size() - 0.25) < 0.02, "dither noise is not centered: %f", sum / out.size());
+    TEST_CHECK(nonZero > (int)out.size() / 8, "no dither noise");
+    return true;
+}
+
+bool BenchMixer()
+{
+    struct Layout
+    {
+        const char *szName;
+        unsigned nIn, nOut;
+        LAVAudioSampleFormat sfIn, sfOut;
+    };
+    static const Layout s_Layouts[] = {
+        {"5.1 to stereo, 16-bit", 6, 2, SampleFormat_16, SampleFormat_16},
+        {"7.1 to 5.1, 24-bit", 8, 6, SampleFormat_24, SampleFormat_24},
+        {"7.1 to stereo, float", 8, 2, SampleFormat_FP32, SampleFormat_FP32},
+        {"stereo, float to 16-bit", 2, 2, SampleFormat_FP32, SampleFormat_16},
+    };
+    const unsigned nSamples = 48000 / 25, nIterations = 2000;
+
+    TestRandom rnd(45);
+    for (const Layout &layout : s_Layouts)
+    {
+        std::vector<double> matrix(layout.nIn * layout.nOut);
+        for (unsigned i = 0; i < layout.nIn * layout.nOut; i++)
+            matrix[i] = (layout.nIn == layout.nOut) ? (i % (layout.nIn + 1) == 0) : rnd.Range(0, 500) / 1000.0;
+
+        std::vector<BYTE> in(nSamples * layout.nIn * SampleSize(layout.sfIn));
+        FillSamples(in, layout.sfIn, rnd);
+        std::vector<float> out(nSamples * layout.nOut + LAV_MIXER_MAX_OUT_CHANNELS);
+
+        for (int cpu = 0; cpu < 2; cpu++)
+        {
+            if (!IsSupported(cpu, true))
+                continue;
+
+            CAudioMixer mixer;
+            mixer.SetCPUFlags(s_CPUFlags[cpu]);
+            mixer.SetMatrix(matrix.data(), layout.nIn, layout.nIn, layout.nOut);
+
+            const double dStart = TestTime();
+            for (unsigned n = 0; n < nIterations; n++)
+            {
+                mixer.Mix(out.data(), in.data(), nSamples, layout.sfIn);
+                if (layout.sfOut != SampleFormat_FP32)
+                    mixer.Convert((BYTE *)out.data(), out.data(), nSamples, layout.sfOut, true);
+            }
+            const double dTime = TestTime() - dStart;
+            printf("  %s, %s: %.1f Msamples/s\n", layout.szName, s_CPUNames[cpu],
+                   (double)nSamples * nIterations / dTime / 1e6);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Compares the planar PCM interleaving functions of the splitter against the scalar reference
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "../../demuxer/LAVSplitter/PlanarPCM.h"
+
+#include <vector>
+
+// Every sample size and channel count with an interleaving function, with sample counts around the SIMD block sizes
+// of 4 and 8 samples and a gap between the planes, so reads past a plane or writes past the output are detected
+bool TestPlanarPCM()
+{
+    static const size_t s_SampleCounts[] = {0, 1, 3, 4, 5, 6, 7, 8, 9, 15, 16, 17, 63, 1001};
+    const size_t nPlaneGap = 13, nGuard = 32;
+
+    TestRandom rnd(41);
+    for (int nBytes = 2; nBytes <= 4; nBytes++)
+    {
+        for (int nChannels = 2; nChannels <= 8; nChannels++)
+        {
+            PlanarPCMFunc pfn = GetPlanarPCMFunc(nBytes, nChannels);
+            TEST_CHECK(pfn != nullptr, "%d bytes, %d channels", nBytes, nChannels);
+
+            for (size_t nSamples : s_SampleCounts)
+            {
+                const size_t nPlaneSize = nSamples * nBytes + nPlaneGap;
+                const size_t nOutSize = nSamples * nBytes * nChannels;
+
+                std::vector<BYTE> src(nPlaneSize * nChannels), ref(nOutSize + nGuard), dst(nOutSize + nGuard);
+                for (BYTE &b : src)
+                    b = (BYTE)rnd.Next();
+
+                memset(ref.data(), 0xcc, ref.size());
+                memset(dst.data(), 0xcc, dst.size());
+                interleave_pcm_generic(ref.data(), src.data(), nPlaneSize, nSamples, nBytes, nChannels);
+                pfn(dst.data(), src.data(), nPlaneSize, nSamples);
+
+                TEST_CHECK(memcmp(dst.data(), ref.data(), nOutSize) == 0, "%d bytes, %d channels, %Iu samples", nBytes,
+                           nChannels, nSamples);
+                for (size_t i = nOutSize; i < dst.size(); i++)
+                    TEST_CHECK(dst[i] == 0xcc, "%d bytes, %d channels, %Iu samples: wrote past the output", nBytes,
+                               nChannels, nSamples);
+            }
+        }
+    }
+
+    // sample sizes and channel counts without a function
+    TEST_CHECK(GetPlanarPCMFunc(1, 2) == nullptr && GetPlanarPCMFunc(8, 2) == nullptr, "unsupported sample size");
+    TEST_CHECK(GetPlanarPCMFunc(2, 1) == nullptr && GetPlanarPCMFunc(2, 9) == nullptr, "unsupported channel count");
+    return true;
+}
+
+bool BenchPlanarPCM()
+{
+    const size_t nSamples = 48000 / 25, nIterations = 2000;
+
+    for (int nBytes = 2; nBytes <= 4; nBytes++)
+    {
+        for (int nChannels = 2; nChannels <= 8; nChannels += 2)
+        {
+            const size_t nPlaneSize = nSamples * nBytes;
+            std::vector<BYTE> src(nPlaneSize * nChannels, 0x5a), dst(nPlaneSize * nChannels);
+            PlanarPCMFunc pfn = GetPlanarPCMFunc(nBytes, nChannels);
+
+            double dStart = TestTime();
+            for (size_t i = 0; i < nIterations; i++)
+                interleave_pcm_generic(dst.data(), src.data(), nPlaneSize, nSamples, nBytes, nChannels);
+            const double dGeneric = TestTime() - dStart;
+
+            dStart = TestTime();
+            for (size_t i = 0; i < nIterations; i++)
+                pfn(dst.data(), src.data(), nPlaneSize, nSamples);
+            const double dSelected = TestTime() - dStart;
+
+            printf("  %d-bit, %d channels: generic %6.2f us, selected %6.2f us per 40 ms packet\n", nBytes * 8,
+                   nChannels, dGeneric * 1e6 / nIterations, dSelected * 1e6 / nIterations);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,236 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// Compares the SIMD versions of the subtitle bitmap kernels against their C references
+
+#include "stdafx.h"
+#include "Tests.h"
+#include "../../decoder/LAVVideo/subtitles/blend/blend_dsp.h"
+
+#include <vector>
+
+struct SubtitleKernels
+{
+    const char *szName;
+    int cpuFlag;
+    UnpremultiplyFn unpremultiply;
+    BGRAToYUVAFn bgraToYUVA;
+    DownsampleChromaFn downsampleChroma;
+};
+
+static const SubtitleKernels s_Kernels[] = {
+    {"c", 0, unpremultiply_bgra_c, bgra_to_yuva_line_c, downsample_chroma_c},
+    {"sse2", AV_CPU_FLAG_SSE2, unpremultiply_bgra_sse2, bgra_to_yuva_line_sse2, downsample_chroma_sse2},
+    {"avx2", AV_CPU_FLAG_AVX2, unpremultiply_bgra_avx2, bgra_to_yuva_line_avx2, downsample_chroma_avx2},
+};
+
+static bool IsSupported(const SubtitleKernels &kernels, bool bReport = false)
+{
+    if (kernels.cpuFlag && !(av_get_cpu_flags() & kernels.cpuFlag))
+    {
+        if (bReport)
+            printf("  %s: not supported by this CPU, skipped\n", kernels.szName);
+        return false;
+    }
+    return true;
+}
+
+// Every color/alpha combination, with a width that leaves a remainder for the C fallback of every SIMD version
+bool TestSubtitleUnpremultiply()
+{
+    const int width = 263, height = 256;
+    const ptrdiff_t stride = (width + 5) * 4;
+
+    std::vector<uint8_t> src(stride * height), ref(stride * height), dst(stride * height);
+    for (int a = 0; a < height; a++)
+    {
+        uint8_t *p = &src[a * stride];
+        for (int c = 0; c < width; c++, p += 4)
+        {
+            p[0] = (uint8_t)c;
+            p[1] = (uint8_t)(255 - c);
+            p[2] = (uint8_t)(c ^ 0x55);
+            p[3] = (uint8_t)a;
+        }
+    }
+
+    unpremultiply_bgra_c(ref.data(), stride, src.data(), stride, width, height);
+
+    // spot checks of the reference: exact division, clipping of colors above alpha, untouched 0 and 255 alpha
+    TEST_CHECK(ref[128 * stride + 64 * 4] == 64 * 255 / 128, "%d", ref[128 * stride + 64 * 4]);
+    TEST_CHECK(ref[128 * stride + 200 * 4] == 255, "%d", ref[128 * stride + 200 * 4]);
+    TEST_CHECK(ref[0 * stride + 17 * 4] == 17 && ref[255 * stride + 17 * 4] == 17, "%d %d", ref[17 * 4],
+               ref[255 * stride + 17 * 4]);
+
+    for (const SubtitleKernels &kernels : s_Kernels)
+    {
+        if (!IsSupported(kernels, true))
+            continue;
+
+        memset(dst.data(), 0xcc, dst.size());
+        kernels.unpremultiply(dst.data(), stride, src.data(), stride, width, height);
+        for (int line = 0; line < height; line++)
+        {
+            TEST_CHECK(memcmp(&dst[line * stride], &ref[line * stride], width * 4) == 0, "%s, alpha %d",
+                       kernels.szName, line);
+            TEST_CHECK(dst[line * stride + width * 4] == 0xcc, "%s wrote past the line, alpha %d", kernels.szName,
+                       line);
+        }
+    }
+    return true;
+}
+
+bool TestSubtitleBGRAToYUVA()
+{
+    // the reference against known BT.601 limited range values
+    static const struct
+    {
+        uint8_t bgra[4];
+        uint8_t yuva[4];
+    } s_Colors[] = {
+        {{0, 0, 0, 255}, {16, 128, 128, 255}},    {{255, 255, 255, 128}, {235, 128, 128, 128}},
+        {{0, 0, 255, 255}, {82, 90, 240, 255}},   {{0, 255, 0, 255}, {144, 54, 34, 255}},
+        {{255, 0, 0, 255}, {41, 240, 110, 255}},
+    };
+    for (const auto &color : s_Colors)
+    {
+        uint8_t y, u, v, a;
+        bgra_to_yuva_line_c(&y, &u, &v, &a, color.bgra, 1);
+        TEST_CHECK(y == color.yuva[0] && u == color.yuva[1] && v == color.yuva[2] && a == color.yuva[3],
+                   "BGRA %d,%d,%d: YUVA %d,%d,%d,%d", color.bgra[0], color.bgra[1], color.bgra[2], y, u, v, a);
+    }
+
+    TestRandom rnd(34);
+    const int maxWidth = 100;
+    std::vector<uint8_t> src(maxWidth * 4);
+    std::vector<uint8_t> ref(maxWidth * 4), dst(maxWidth * 4 + 4);
+
+    for (int width = 1; width <= maxWidth; width++)
+    {
+        for (uint8_t &b : src)
+            b = (uint8_t)rnd.Next();
+
+        bgra_to_yuva_line_c(&ref[0], &ref[maxWidth], &ref[maxWidth * 2], &ref[maxWidth * 3], src.data(), width);
+        for (const SubtitleKernels &kernels : s_Kernels)
+        {
+            if (!IsSupported(kernels))
+                continue;
+
+            memset(dst.data(), 0xcc, dst.size());
+            kernels.bgraToYUVA(&dst[0], &dst[maxWidth], &dst[maxWidth * 2], &dst[maxWidth * 3], src.data(), width);
+            for (int plane = 0; plane < 4; plane++)
+            {
+                TEST_CHECK(memcmp(&dst[plane * maxWidth], &ref[plane * maxWidth], width) == 0,
+                           "%s, width %d, plane %d", kernels.szName, width, plane);
+            }
+            TEST_CHECK(width == maxWidth || dst[width] == 0xcc, "%s wrote past the line, width %d", kernels.szName,
+                       width);
+        }
+    }
+    return true;
+}
+
+bool TestSubtitleDownsampleChroma()
+{
+    TestRandom rnd(35);
+    const int maxWidth = 150;
+    std::vector<uint8_t> src0(maxWidth * 2), src1(maxWidth * 2), ref(maxWidth), dst(maxWidth + 1);
+
+    // both averages round up, so a quarter rounds to one
+    src0[0] = 1, src0[1] = 0, src1[0] = 0, src1[1] = 0;
+    downsample_chroma_c(ref.data(), src0.data(), src1.data(), 1);
+    TEST_CHECK(ref[0] == 1, "%d", ref[0]);
+
+    for (int width = 1; width <= maxWidth; width++)
+    {
+        for (int i = 0; i < maxWidth * 2; i++)
+        {
+            src0[i] = (uint8_t)rnd.Next();
+            src1[i] = (uint8_t)rnd.Next();
+        }
+
+        for (int vertical = 0; vertical < 2; vertical++)
+        {
+            const uint8_t *pSrc1 = vertical ? src1.data() : src0.data();
+            downsample_chroma_c(ref.data(), src0.data(), pSrc1, width);
+            for (const SubtitleKernels &kernels : s_Kernels)
+            {
+                if (!IsSupported(kernels))
+                    continue;
+
+                memset(dst.data(), 0xcc, dst.size());
+                kernels.downsampleChroma(dst.data(), src0.data(), pSrc1, width);
+                TEST_CHECK(memcmp(dst.data(), ref.data(), width) == 0, "%s, width %d", kernels.szName, width);
+                TEST_CHECK(dst[width] == 0xcc, "%s wrote past the line, width %d", kernels.szName, width);
+            }
+        }
+    }
+    return true;
+}
+
+// Un-pre-multiply and convert a full screen 2160p bitmap to YUVA 4:2:0, line by line like
+// CLAVSubtitleConsumer::ConvertBGRAToYUVA. Two thirds of the lines are transparent, the others hold text-like runs of
+// opaque and anti-aliased pixels.
+bool BenchSubtitleConversion()
+{
+    const int width = 3840, height = 2160, frames = 20;
+    const ptrdiff_t pitch = width * 4, chromaStride = width + 64;
+
+    std::vector<uint8_t> bitmap(pitch * height);
+    TestRandom rnd(36);
+    for (int line = 0; line < height; line++)
+    {
+        if ((line / 60) % 3 != 2)
+            continue;
+        uint8_t *p = &bitmap[line * pitch];
+        for (int col = 0; col < width; col++, p += 4)
+        {
+            const int a = (col % 40 < 30) ? ((col % 8 == 0) ? rnd.Range(1, 254) : 255) : 0;
+            p[0] = p[1] = p[2] = (uint8_t)(a * 235 / 255);
+            p[3] = (uint8_t)a;
+        }
+    }
+
+    std::vector<uint8_t> bgra(pitch), y(width * height), a(width * height), u(chromaStride * height / 2),
+        v(chromaStride * height / 2), lineU(chromaStride * 2), lineV(chromaStride * 2);
+
+    for (const SubtitleKernels &kernels : s_Kernels)
+    {
+        if (!IsSupported(kernels, true))
+            continue;
+
+        const double dStart = TestTime();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int line = 0; line < height; line += 2)
+            {
+                for (int i = 0; i < 2; i++)
+                {
+                    kernels.unpremultiply(bgra.data(), 0, &bitmap[(line + i) * pitch], 0, width, 1);
+                    kernels.bgraToYUVA(&y[(line + i) * width], &lineU[i * chromaStride], &lineV[i * chromaStride],
+                                       &a[(line + i) * width], bgra.data(), width);
+                }
+                kernels.downsampleChroma(&u[(line / 2) * chromaStride], &lineU[0], &lineU[chromaStride], width / 2);
+                kernels.downsampleChroma(&v[(line / 2) * chromaStride], &lineV[0], &lineV[chromaStride], width / 2);
+            }
+        }
+        printf("  %-4s: %6.2f ms per 2160p bitmap\n", kernels.szName, (TestTime() - dStart) * 1000.0 / frames);
+    }
+    return true;
+}
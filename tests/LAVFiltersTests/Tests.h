@@ -0,0 +1,95 @@
+/*
+ *      Copyright (C) 2010-2019 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// A test returns true on success, and prints the reason of any failure itself
+typedef bool (*TestFunc)();
+
+struct TestEntry
+{
+    const char *szName;
+    TestFunc pfnTest;
+    bool bBenchmark;
+};
+
+// Print a failed check and return false from the test
+#define TEST_CHECK(cond, ...)                                                                                          \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(cond))                                                                                                   \
+        {                                                                                                              \
+            printf("  %s(%d): check failed: %s: ", __FILE__, __LINE__, #cond);                                        \
+            printf(__VA_ARGS__);                                                                                       \
+            printf("\n");                                                                                              \
+            return false;                                                                                              \
+        }                                                                                                              \
+    } while (0)
+
+// Wall-clock time in seconds, for the benchmarks
+inline double TestTime()
+{
+    static LARGE_INTEGER freq = {};
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+}
+
+// Small deterministic random number generator, so failures can be reproduced on every platform
+class TestRandom
+{
+  public:
+    TestRandom(uint32_t seed = 1) : m_State(seed ? seed : 1) {}
+
+    uint32_t Next()
+    {
+        m_State ^= m_State << 13;
+        m_State ^= m_State >> 17;
+        m_State ^= m_State << 5;
+        return m_State;
+    }
+
+    // uniform in [min, max]
+    int Range(int min, int max) { return min + (int)(Next() % (uint32_t)(max - min + 1)); }
+
+  private:
+    uint32_t m_State;
+};
+
+// FloatingAverageTest.cpp
+bool TestFloatingAverage();
+bool BenchFloatingAverage();
+
+// MixerTest.cpp
+bool TestMixer();
+bool TestMixerConvert();
+bool BenchMixer();
+
+// PlanarPCMTest.cpp
+bool TestPlanarPCM();
+bool BenchPlanarPCM();
+
+// SubtitleDSPTest.cpp
+bool TestSubtitleUnpremultiply();
+bool TestSubtitleBGRAToYUVA();
+bool TestSubtitleDownsampleChroma();
+bool BenchSubtitleConversion();